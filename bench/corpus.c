@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "corpus.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* xorshift64, the corpora must be identical across runs */
+static uint64_t random_state;
+
+static uint64_t next_random(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+static void reset_random(void) { random_state = 0x9E3779B97F4A7C15; }
+
+static void check(bool success) {
+  if (!success) {
+    fprintf(stderr, "Corpus generation failed\n");
+    exit(1);
+  }
+}
+
+static cbor_item_t* random_string(size_t min_length, size_t max_length) {
+  char buffer[256];
+  size_t length = min_length + next_random() % (max_length - min_length + 1);
+  for (size_t i = 0; i < length; i++) {
+    buffer[i] = (char)('a' + next_random() % 26);
+  }
+  return cbor_build_stringn(buffer, length);
+}
+
+/* Use the shortest width, like a decoded document would */
+static cbor_item_t* build_shortest_uint(uint64_t value) {
+  if (value <= UINT8_MAX) return cbor_build_uint8((uint8_t)value);
+  if (value <= UINT16_MAX) return cbor_build_uint16((uint16_t)value);
+  if (value <= UINT32_MAX) return cbor_build_uint32((uint32_t)value);
+  return cbor_build_uint64(value);
+}
+
+/* Mixed-width positive and negative integers */
+static cbor_item_t* generate_integers(void) {
+  reset_random();
+  const size_t count = 200000;
+  cbor_item_t* root = cbor_new_definite_array(count);
+  for (size_t i = 0; i < count; i++) {
+    cbor_item_t* item =
+        build_shortest_uint(next_random() >> (next_random() % 64));
+    if (next_random() % 4 == 0) cbor_mark_negint(item);
+    check(cbor_array_push(root, cbor_move(item)));
+  }
+  return root;
+}
+
+/* Short text strings */
+static cbor_item_t* generate_strings(void) {
+  reset_random();
+  const size_t count = 30000;
+  cbor_item_t* root = cbor_new_definite_array(count);
+  for (size_t i = 0; i < count; i++) {
+    check(cbor_array_push(root, cbor_move(random_string(4, 64))));
+  }
+  return root;
+}
+
+/* Many deep chains of single-element arrays, within the decoder stack limit */
+static cbor_item_t* generate_nested(void) {
+  const size_t chains = 500, depth = 1000;
+  cbor_item_t* root = cbor_new_definite_array(chains);
+  for (size_t i = 0; i < chains; i++) {
+    cbor_item_t* chain = cbor_build_uint8(1);
+    for (size_t j = 0; j < depth; j++) {
+      cbor_item_t* parent = cbor_new_definite_array(1);
+      check(cbor_array_push(parent, cbor_move(chain)));
+      chain = parent;
+    }
+    check(cbor_array_push(root, cbor_move(chain)));
+  }
+  return root;
+}
+
+/* A single map with many string keys */
+static cbor_item_t* generate_wide_map(void) {
+  reset_random();
+  const size_t count = 50000;
+  cbor_item_t* root = cbor_new_definite_map(count);
+  for (size_t i = 0; i < count; i++) {
+    check(cbor_map_add(
+        root, (struct cbor_pair){
+                  .key = cbor_move(random_string(8, 16)),
+                  .value = cbor_move(cbor_build_uint32((uint32_t)i))}));
+  }
+  return root;
+}
+
+/* A few large byte strings */
+static cbor_item_t* generate_blobs(void) {
+  reset_random();
+  const size_t count = 16, blob_size = 64 * 1024;
+  unsigned char* blob = malloc(blob_size);
+  check(blob != NULL);
+  cbor_item_t* root = cbor_new_definite_array(count);
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < blob_size; j++) {
+      blob[j] = (unsigned char)next_random();
+    }
+    check(cbor_array_push(root,
+                          cbor_move(cbor_build_bytestring(blob, blob_size))));
+  }
+  free(blob);
+  return root;
+}
+
+const struct bench_corpus bench_corpora[] = {
+    {"integers", generate_integers}, {"strings", generate_strings},
+    {"nested", generate_nested},     {"wide_map", generate_wide_map},
+    {"blobs", generate_blobs},
+};
+
+const size_t bench_corpora_count =
+    sizeof(bench_corpora) / sizeof(bench_corpora[0]);
+
+size_t bench_count_items(const cbor_item_t* item) {
+  size_t count = 1;
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_BYTESTRING:
+      if (cbor_bytestring_is_indefinite(item)) {
+        for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++)
+          count += bench_count_items(cbor_bytestring_chunks_handle(item)[i]);
+      }
+      break;
+    case CBOR_TYPE_STRING:
+      if (cbor_string_is_indefinite(item)) {
+        for (size_t i = 0; i < cbor_string_chunk_count(item); i++)
+          count += bench_count_items(cbor_string_chunks_handle(item)[i]);
+      }
+      break;
+    case CBOR_TYPE_ARRAY:
+      for (size_t i = 0; i < cbor_array_size(item); i++)
+        count += bench_count_items(cbor_array_handle(item)[i]);
+      break;
+    case CBOR_TYPE_MAP:
+      for (size_t i = 0; i < cbor_map_size(item); i++) {
+        count += bench_count_items(cbor_map_handle(item)[i].key);
+        count += bench_count_items(cbor_map_handle(item)[i].value);
+      }
+      break;
+    case CBOR_TYPE_TAG:
+      count += bench_count_items(cbor_move(cbor_tag_item(item)));
+      break;
+    default:
+      break;
+  }
+  return count;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_BENCH_CORPUS_H
+#define LIBCBOR_BENCH_CORPUS_H
+
+#include "cbor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deterministic synthetic documents of roughly 1 MB each, covering the shapes
+ * that stress different parts of the library.
+ */
+
+struct bench_corpus {
+  const char* name;
+  cbor_item_t* (*generate)(void);
+};
+
+extern const struct bench_corpus bench_corpora[];
+extern const size_t bench_corpora_count;
+
+/** Number of data items in \p item, including itself and all subitems */
+size_t bench_count_items(const cbor_item_t* item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_BENCH_CORPUS_H
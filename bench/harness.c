@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// clock_gettime
+#define _POSIX_C_SOURCE 199309L
+
+#include "harness.h"
+
+#include <stdio.h>
+#include <time.h>
+
+double bench_min_time = 0.5;
+
+volatile size_t bench_sink;
+
+double bench_now_ns(void) {
+#ifdef _WIN32
+  return (double)clock() * 1e9 / CLOCKS_PER_SEC;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+double bench_measure(bench_fn setup, bench_fn run, void* context) {
+  // Warm up caches and the allocator
+  if (setup != NULL) setup(context);
+  run(context);
+
+  double elapsed = 0;
+  size_t iterations = 0;
+  while (elapsed < bench_min_time * 1e9 || iterations < 3) {
+    if (setup != NULL) setup(context);
+    double start = bench_now_ns();
+    run(context);
+    elapsed += bench_now_ns() - start;
+    iterations++;
+  }
+  return elapsed / (double)iterations;
+}
+
+void bench_report_header(void) {
+  printf(
+      "benchmark,corpus,bytes,items,ns_per_iteration,mb_per_s,items_per_s\n");
+}
+
+void bench_report(const char* benchmark, const char* corpus, size_t bytes,
+                  size_t items, double ns_per_iteration) {
+  double seconds = ns_per_iteration / 1e9;
+  printf("%s,%s,%zu,%zu,%.0f,%.2f,%.0f\n", benchmark, corpus, bytes, items,
+         ns_per_iteration, (double)bytes / seconds / 1e6,
+         (double)items / seconds);
+  fflush(stdout);
+}
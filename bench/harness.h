@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_BENCH_HARNESS_H
+#define LIBCBOR_BENCH_HARNESS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Minimal dependency-free timing harness. Results are printed as CSV, one row
+ * per benchmark and corpus, see bench_report_header.
+ */
+
+/** Monotonic time in nanoseconds */
+double bench_now_ns(void);
+
+/** Untimed per-iteration preparation and timed work */
+typedef void (*bench_fn)(void* context);
+
+/** Minimal total measured time per benchmark, in seconds */
+extern double bench_min_time;
+
+/** Measure \p run, calling \p setup (may be `NULL`) before each iteration
+ *
+ * Iterates until at least #bench_min_time has been spent in \p run.
+ *
+ * @return Mean time per iteration in nanoseconds
+ */
+double bench_measure(bench_fn setup, bench_fn run, void* context);
+
+/** Print the CSV header */
+void bench_report_header(void);
+
+/** Print a CSV row
+ *
+ * @param benchmark Name of the measured operation
+ * @param corpus Name of the input
+ * @param bytes Serialized size of the input processed per iteration
+ * @param items Number of data items processed per iteration
+ * @param ns_per_iteration Result of #bench_measure
+ */
+void bench_report(const char* benchmark, const char* corpus, size_t bytes,
+                  size_t items, double ns_per_iteration);
+
+/** Prevents the compiler from discarding benchmark results */
+extern volatile size_t bench_sink;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_BENCH_HARNESS_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+
+#include "cbor.h"
+#include "cbor/internal/uint_kernels.h"
+#include "harness.h"
+
+/*
+ * Microbenchmarks for the integer header kernels, one per encoded width.
+ * Prints CSV: operation,width,ns_per_item
+ */
+
+#define VALUES 4096
+#define ROUNDS 2000
+
+struct width_class {
+  const char* name;
+  uint64_t min, max;
+};
+
+static const struct width_class widths[] = {
+    {"embedded", 0, 23},
+    {"uint8", 24, UINT8_MAX},
+    {"uint16", UINT8_MAX + 1, UINT16_MAX},
+    {"uint32", UINT16_MAX + 1, UINT32_MAX},
+    {"uint64", (uint64_t)UINT32_MAX + 1, UINT64_MAX},
+};
+
+static uint64_t values[VALUES];
+static unsigned char encoded[VALUES * 9];
+
+static void fill_values(const struct width_class* width) {
+  uint64_t state = 0x9E3779B97F4A7C15;
+  uint64_t span = width->max - width->min;
+  for (size_t i = 0; i < VALUES; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    values[i] = width->min + (span == UINT64_MAX ? state : state % (span + 1));
+  }
+}
+
+static void uint_callback(void* context, uint64_t value) {
+  *(uint64_t*)context += value;
+}
+
+static void uint8_callback(void* context, uint8_t value) {
+  uint_callback(context, value);
+}
+
+static void uint16_callback(void* context, uint16_t value) {
+  uint_callback(context, value);
+}
+
+static void uint32_callback(void* context, uint32_t value) {
+  uint_callback(context, value);
+}
+
+static void uint64_callback(void* context, uint64_t value) {
+  uint_callback(context, value);
+}
+
+static void report(const char* operation, const char* width, double start) {
+  printf("%s,%s,%.3f\n", operation, width,
+         (bench_now_ns() - start) / ((double)VALUES * ROUNDS));
+}
+
+int main(void) {
+  struct cbor_callbacks callbacks = cbor_empty_callbacks;
+  callbacks.uint8 = uint8_callback;
+  callbacks.uint16 = uint16_callback;
+  callbacks.uint32 = uint32_callback;
+  callbacks.uint64 = uint64_callback;
+
+  printf("operation,width,ns_per_item\n");
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    fill_values(&widths[w]);
+
+    double start = bench_now_ns();
+    size_t length = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+      length = 0;
+      for (size_t i = 0; i < VALUES; i++) {
+        length += cbor_encode_uint(values[i], encoded + length,
+                                   sizeof(encoded) - length);
+      }
+    }
+    report("encode", widths[w].name, start);
+
+    start = bench_now_ns();
+    uint64_t sum = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+      size_t offset = 0;
+      while (offset < length) {
+        offset += cbor_stream_decode(encoded + offset, length - offset,
+                                     &callbacks, &sum)
+                      .read;
+      }
+    }
+    bench_sink = (size_t)sum;
+    report("decode", widths[w].name, start);
+
+    start = bench_now_ns();
+    size_t total = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+      for (size_t i = 0; i < VALUES; i++) {
+        total += _cbor_uint_header_size(values[i]);
+      }
+    }
+    bench_sink = total;
+    report("header_size", widths[w].name, start);
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cbor.h"
+#include "corpus.h"
+#include "harness.h"
+
+#ifdef HAS_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Workloads dominated by creating and releasing items: decoding and
+ * discarding each corpus, copying it, and building arrays of small integers.
+ * Every workload runs twice, with the default hooks, which use the item pool
+ * in builds with CBOR_ITEM_POOL, and with hooks that forward to malloc, which
+ * bypass it.
+ */
+
+#define SCALARS 100000
+#define THREADS 4
+
+struct bench_state {
+  unsigned char* encoded;
+  size_t encoded_size;
+  cbor_item_t* item;
+};
+
+static void* forward_malloc(size_t size) { return malloc(size); }
+
+static void* forward_realloc(void* pointer, size_t size) {
+  return realloc(pointer, size);
+}
+
+static void forward_free(void* pointer) { free(pointer); }
+
+static void run_load(void* context) {
+  struct bench_state* state = context;
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(state->encoded, state->encoded_size, &result);
+  if (item == NULL) {
+    fprintf(stderr, "cbor_load failed\n");
+    exit(1);
+  }
+  bench_sink = result.read;
+  cbor_decref(&item);
+}
+
+static void run_copy(void* context) {
+  struct bench_state* state = context;
+  cbor_item_t* copy = cbor_copy(state->item);
+  if (copy == NULL) {
+    fprintf(stderr, "cbor_copy failed\n");
+    exit(1);
+  }
+  bench_sink = cbor_refcount(copy);
+  cbor_decref(&copy);
+}
+
+static void* build_scalars(void* context) {
+  cbor_item_t* array = cbor_new_definite_array(SCALARS);
+  for (size_t i = 0; i < SCALARS; i++) {
+    if (array == NULL ||
+        !cbor_array_push(array, cbor_move(cbor_build_uint32((uint32_t)i)))) {
+      fprintf(stderr, "Allocation failed\n");
+      exit(1);
+    }
+  }
+  bench_sink = cbor_array_size(array);
+  cbor_decref(&array);
+  return context;
+}
+
+static void run_scalars(void* context) { build_scalars(context); }
+
+#ifdef HAS_PTHREADS
+static void run_scalars_threaded(void* context) {
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    pthread_create(&threads[i], NULL, build_scalars, context);
+  for (size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+}
+#endif
+
+static void report(const char* benchmark, const char* hooks,
+                   const char* corpus, size_t bytes, size_t items,
+                   bench_fn run, void* context) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s/%s", benchmark, hooks);
+  bench_report(name, corpus, bytes, items, bench_measure(NULL, run, context));
+}
+
+static void run_all(const char* hooks, const char* corpus_filter) {
+  report("build_scalars", hooks, "uint32", 0, SCALARS + 1, run_scalars, NULL);
+#ifdef HAS_PTHREADS
+  report("build_scalars_4_threads", hooks, "uint32", 0,
+         THREADS * (SCALARS + 1), run_scalars_threaded, NULL);
+#endif
+
+  for (size_t c = 0; c < bench_corpora_count; c++) {
+    const struct bench_corpus* corpus = &bench_corpora[c];
+    if (corpus_filter != NULL && strcmp(corpus_filter, corpus->name) != 0)
+      continue;
+
+    struct bench_state state = {.item = corpus->generate()};
+    size_t items = bench_count_items(state.item);
+    cbor_serialize_alloc(state.item, &state.encoded, &state.encoded_size);
+    if (state.encoded == NULL) {
+      fprintf(stderr, "Allocation failed\n");
+      exit(1);
+    }
+    report("cbor_load+cbor_decref", hooks, corpus->name, state.encoded_size,
+           items, run_load, &state);
+    report("cbor_copy+cbor_decref", hooks, corpus->name, state.encoded_size,
+           items, run_copy, &state);
+    free(state.encoded);
+    cbor_decref(&state.item);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1) bench_min_time = atof(argv[1]);
+  const char* corpus_filter = argc > 2 ? argv[2] : NULL;
+
+  fprintf(stderr, "CBOR_ITEM_POOL=%d\n", CBOR_ITEM_POOL);
+  bench_report_header();
+  run_all(CBOR_ITEM_POOL ? "pool" : "default", corpus_filter);
+  cbor_set_allocs(forward_malloc, forward_realloc, forward_free);
+  run_all("malloc", corpus_filter);
+  cbor_set_allocs(malloc, realloc, free);
+  return 0;
+}
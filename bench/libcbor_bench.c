@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cbor.h"
+#include "corpus.h"
+#include "harness.h"
+
+/*
+ * Throughput of the high-level APIs on each corpus. Usage:
+ *
+ *   libcbor_bench [min_seconds_per_benchmark] [corpus]
+ */
+
+struct bench_state {
+  cbor_item_t* item;
+  unsigned char* encoded;
+  size_t encoded_size;
+  /* Output buffer for serialization */
+  unsigned char* buffer;
+  /* Copy to be released by the decref benchmark */
+  cbor_item_t* copy;
+  /* Equal item that shares no nested items with item */
+  cbor_item_t* twin;
+  /* The item converted to JSON */
+  struct cbor_writer_memory json;
+};
+
+static void run_load(void* context) {
+  struct bench_state* state = context;
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(state->encoded, state->encoded_size, &result);
+  if (item == NULL) {
+    fprintf(stderr, "cbor_load failed with error %d\n", result.error.code);
+    exit(1);
+  }
+  bench_sink = result.read;
+  cbor_decref(&item);
+}
+
+static void run_stream_decode(void* context) {
+  struct bench_state* state = context;
+  size_t offset = 0;
+  while (offset < state->encoded_size) {
+    struct cbor_decoder_result result = cbor_stream_decode(
+        state->encoded + offset, state->encoded_size - offset,
+        &cbor_empty_callbacks, NULL);
+    if (result.status != CBOR_DECODER_FINISHED) {
+      fprintf(stderr, "cbor_stream_decode failed\n");
+      exit(1);
+    }
+    offset += result.read;
+  }
+  bench_sink = offset;
+}
+
+/* Visits every item like the cbor_load and cbor_stream_decode runs, except
+ * for those nested deeper than CBOR_READER_MAX_DEPTH, which are skipped */
+static void run_reader(void* context) {
+  struct bench_state* state = context;
+  struct cbor_reader reader;
+  size_t items = 0;
+  cbor_reader_init(&reader, state->encoded, state->encoded_size);
+  while (cbor_reader_next(&reader) || cbor_reader_leave(&reader)) {
+    if (!cbor_reader_has_item(&reader)) continue;
+    items++;
+    if (cbor_reader_depth(&reader) < CBOR_READER_MAX_DEPTH &&
+        !cbor_reader_enter(&reader) &&
+        cbor_reader_error(&reader).code != CBOR_ERR_NONE)
+      break;
+  }
+  if (cbor_reader_error(&reader).code != CBOR_ERR_NONE) {
+    fprintf(stderr, "cbor_reader failed\n");
+    exit(1);
+  }
+  bench_sink = items;
+}
+
+static void run_serialize(void* context) {
+  struct bench_state* state = context;
+  bench_sink = cbor_serialize(state->item, state->buffer, state->encoded_size);
+}
+
+static void run_serialize_preferred(void* context) {
+  struct bench_state* state = context;
+  bench_sink = cbor_serialize_with_options(state->item, state->buffer,
+                                           state->encoded_size,
+                                           CBOR_SERIALIZE_PREFERRED);
+}
+
+static void run_serialize_alloc(void* context) {
+  struct bench_state* state = context;
+  unsigned char* buffer;
+  size_t buffer_size;
+  bench_sink = cbor_serialize_alloc(state->item, &buffer, &buffer_size);
+  free(buffer);
+}
+
+static void run_copy(void* context) {
+  struct bench_state* state = context;
+  cbor_item_t* copy = cbor_copy(state->item);
+  bench_sink = (size_t)copy;
+  cbor_decref(&copy);
+}
+
+static void setup_decref(void* context) {
+  struct bench_state* state = context;
+  state->copy = cbor_copy(state->item);
+}
+
+static void run_decref(void* context) {
+  struct bench_state* state = context;
+  cbor_decref(&state->copy);
+}
+
+static void run_equal(void* context) {
+  struct bench_state* state = context;
+  bench_sink = cbor_equal(state->item, state->twin);
+}
+
+static void run_equal_unordered(void* context) {
+  struct bench_state* state = context;
+  bench_sink = cbor_equal_with_options(state->item, state->twin,
+                                       CBOR_EQUAL_IGNORE_MAP_ORDER);
+}
+
+static void run_hash(void* context) {
+  struct bench_state* state = context;
+  bench_sink = (size_t)cbor_hash(state->item, 0);
+}
+
+static bool counting_sink(void* context, cbor_data data _CBOR_UNUSED,
+                          size_t length) {
+  *(size_t*)context += length;
+  return true;
+}
+
+static void run_to_json(void* context) {
+  struct bench_state* state = context;
+  size_t written = 0;
+  struct cbor_json_result result =
+      cbor_to_json(state->encoded, state->encoded_size, NULL, counting_sink,
+                   &written);
+  if (result.error != CBOR_JSON_ERR_NONE) {
+    fprintf(stderr, "cbor_to_json failed with error %d\n", result.error);
+    exit(1);
+  }
+  bench_sink = written;
+}
+
+static void run_from_json(void* context) {
+  struct bench_state* state = context;
+  size_t written = 0;
+  struct cbor_json_result result =
+      cbor_from_json((const char*)state->json.data, state->json.length,
+                     CBOR_FROM_JSON_DEFAULT, counting_sink, &written);
+  if (result.error != CBOR_JSON_ERR_NONE) {
+    fprintf(stderr, "cbor_from_json failed with error %d\n", result.error);
+    exit(1);
+  }
+  bench_sink = written;
+}
+
+struct benchmark {
+  const char* name;
+  bench_fn setup;
+  bench_fn run;
+};
+
+static const struct benchmark benchmarks[] = {
+    {"cbor_load", NULL, run_load},
+    {"cbor_stream_decode", NULL, run_stream_decode},
+    {"cbor_reader", NULL, run_reader},
+    {"cbor_serialize", NULL, run_serialize},
+    {"cbor_serialize_preferred", NULL, run_serialize_preferred},
+    {"cbor_serialize_alloc", NULL, run_serialize_alloc},
+    {"cbor_copy", NULL, run_copy},
+    {"cbor_decref", setup_decref, run_decref},
+    {"cbor_equal", NULL, run_equal},
+    {"cbor_equal_unordered", NULL, run_equal_unordered},
+    {"cbor_hash", NULL, run_hash},
+    {"cbor_to_json", NULL, run_to_json},
+    {"cbor_from_json", NULL, run_from_json},
+};
+
+int main(int argc, char* argv[]) {
+  if (argc > 1) bench_min_time = atof(argv[1]);
+  const char* corpus_filter = argc > 2 ? argv[2] : NULL;
+
+  bench_report_header();
+  for (size_t c = 0; c < bench_corpora_count; c++) {
+    const struct bench_corpus* corpus = &bench_corpora[c];
+    if (corpus_filter != NULL && strcmp(corpus_filter, corpus->name) != 0)
+      continue;
+
+    struct bench_state state = {.item = corpus->generate()};
+    state.twin = cbor_copy(state.item);
+    size_t items = bench_count_items(state.item);
+    cbor_serialize_alloc(state.item, &state.encoded, &state.encoded_size);
+    state.buffer = malloc(state.encoded_size);
+    struct cbor_json_result json =
+        cbor_to_json(state.encoded, state.encoded_size, NULL,
+                     cbor_writer_memory_sink, &state.json);
+    if (state.encoded == NULL || state.buffer == NULL || state.twin == NULL ||
+        json.error != CBOR_JSON_ERR_NONE) {
+      fprintf(stderr, "Allocation failed\n");
+      return 1;
+    }
+
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+      double ns = bench_measure(benchmarks[b].setup, benchmarks[b].run, &state);
+      bench_report(benchmarks[b].name, corpus->name, state.encoded_size, items,
+                   ns);
+    }
+
+    free(state.json.data);
+    free(state.buffer);
+    free(state.encoded);
+    cbor_decref(&state.twin);
+    cbor_decref(&state.item);
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "cbor.hpp"
+#include "corpus.h"
+#include "harness.h"
+
+/*
+ * The same consumer, summing unsigned integers and string lengths, driven by
+ * cbor_stream_decode through a callback table and by cbor::parse with the
+ * handler inlined. Note that cbor::parse also validates the nesting, which
+ * the cbor_stream_decode loop does not. Usage:
+ *
+ *   parse_bench [min_seconds_per_benchmark] [corpus]
+ */
+
+struct bench_state {
+  unsigned char* encoded;
+  size_t encoded_size;
+};
+
+static void sum_uint8(void* context, uint8_t value) {
+  *static_cast<uint64_t*>(context) += value;
+}
+
+static void sum_uint16(void* context, uint16_t value) {
+  *static_cast<uint64_t*>(context) += value;
+}
+
+static void sum_uint32(void* context, uint32_t value) {
+  *static_cast<uint64_t*>(context) += value;
+}
+
+static void sum_uint64(void* context, uint64_t value) {
+  *static_cast<uint64_t*>(context) += value;
+}
+
+static void sum_string(void* context, cbor_data, uint64_t length) {
+  *static_cast<uint64_t*>(context) += length;
+}
+
+static struct cbor_callbacks summing_callbacks() {
+  struct cbor_callbacks callbacks = cbor_empty_callbacks;
+  callbacks.uint8 = sum_uint8;
+  callbacks.uint16 = sum_uint16;
+  callbacks.uint32 = sum_uint32;
+  callbacks.uint64 = sum_uint64;
+  callbacks.string = sum_string;
+  callbacks.byte_string = sum_string;
+  return callbacks;
+}
+
+static void run_stream_decode(void* context) {
+  static const struct cbor_callbacks callbacks = summing_callbacks();
+  auto* state = static_cast<bench_state*>(context);
+  uint64_t sum = 0;
+  size_t offset = 0;
+  while (offset < state->encoded_size) {
+    struct cbor_decoder_result result =
+        cbor_stream_decode(state->encoded + offset,
+                           state->encoded_size - offset, &callbacks, &sum);
+    if (result.status != CBOR_DECODER_FINISHED) {
+      fprintf(stderr, "cbor_stream_decode failed\n");
+      exit(1);
+    }
+    offset += result.read;
+  }
+  bench_sink = static_cast<size_t>(sum);
+}
+
+struct summing_handler {
+  uint64_t sum = 0;
+  void uint64(uint64_t value) { sum += value; }
+  void string(cbor_data, uint64_t length) { sum += length; }
+  void byte_string(cbor_data, uint64_t length) { sum += length; }
+};
+
+static void run_parse(void* context) {
+  auto* state = static_cast<bench_state*>(context);
+  summing_handler handler;
+  struct cbor_load_result result =
+      cbor::parse(state->encoded, state->encoded_size, handler);
+  if (result.error.code != CBOR_ERR_NONE) {
+    fprintf(stderr, "cbor::parse failed with error %d\n", result.error.code);
+    exit(1);
+  }
+  bench_sink = static_cast<size_t>(handler.sum);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1) bench_min_time = atof(argv[1]);
+  const char* corpus_filter = argc > 2 ? argv[2] : NULL;
+
+  bench_report_header();
+  for (size_t c = 0; c < bench_corpora_count; c++) {
+    const struct bench_corpus* corpus = &bench_corpora[c];
+    if (corpus_filter != NULL && strcmp(corpus_filter, corpus->name) != 0)
+      continue;
+
+    cbor_item_t* item = corpus->generate();
+    size_t items = bench_count_items(item);
+    bench_state state = {NULL, 0};
+    cbor_serialize_alloc(item, &state.encoded, &state.encoded_size);
+    cbor_decref(&item);
+    if (state.encoded == NULL) {
+      fprintf(stderr, "Allocation failed\n");
+      return 1;
+    }
+
+    bench_report("cbor_stream_decode", corpus->name, state.encoded_size, items,
+                 bench_measure(NULL, run_stream_decode, &state));
+    bench_report("cbor::parse", corpus->name, state.encoded_size, items,
+                 bench_measure(NULL, run_parse, &state));
+    free(state.encoded);
+  }
+  return 0;
+}
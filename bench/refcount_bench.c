@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cbor.h"
+#include "corpus.h"
+#include "harness.h"
+
+/*
+ * Single-threaded cost of reference counting, to be compared between builds
+ * with and without CBOR_ATOMIC_REFCOUNT, and the cost of handing a decoded
+ * tree to a number of workers by reference versus by copying it. Usage:
+ *
+ *   refcount_bench [min_seconds_per_benchmark] [corpus]
+ */
+
+#define PAIRS 1000000
+#define WORKERS 64
+
+struct bench_state {
+  cbor_item_t* item;
+  cbor_item_t* references[WORKERS];
+};
+
+static void run_incref_decref(void* context) {
+  struct bench_state* state = context;
+  for (size_t i = 0; i < PAIRS; i++) {
+    cbor_item_t* reference = cbor_incref(state->item);
+    cbor_decref(&reference);
+  }
+  bench_sink = cbor_refcount(state->item);
+}
+
+static void run_share(void* context) {
+  struct bench_state* state = context;
+  for (size_t i = 0; i < WORKERS; i++)
+    state->references[i] = cbor_incref(state->item);
+  for (size_t i = 0; i < WORKERS; i++) cbor_decref(&state->references[i]);
+  bench_sink = cbor_refcount(state->item);
+}
+
+static void run_copy(void* context) {
+  struct bench_state* state = context;
+  for (size_t i = 0; i < WORKERS; i++)
+    state->references[i] = cbor_copy(state->item);
+  for (size_t i = 0; i < WORKERS; i++) cbor_decref(&state->references[i]);
+  bench_sink = cbor_refcount(state->item);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1) bench_min_time = atof(argv[1]);
+  const char* corpus_filter = argc > 2 ? argv[2] : NULL;
+
+  fprintf(stderr, "CBOR_ATOMIC_REFCOUNT=%d\n", CBOR_ATOMIC_REFCOUNT);
+  bench_report_header();
+
+  struct bench_state state = {.item = cbor_build_uint8(42)};
+  bench_report("cbor_incref+cbor_decref", "single_item", 0, PAIRS,
+               bench_measure(NULL, run_incref_decref, &state));
+  cbor_decref(&state.item);
+
+  for (size_t c = 0; c < bench_corpora_count; c++) {
+    const struct bench_corpus* corpus = &bench_corpora[c];
+    if (corpus_filter != NULL && strcmp(corpus_filter, corpus->name) != 0)
+      continue;
+
+    state.item = corpus->generate();
+    size_t bytes = cbor_serialized_size(state.item);
+    bench_report("share_64", corpus->name, bytes, WORKERS,
+                 bench_measure(NULL, run_share, &state));
+    bench_report("copy_64", corpus->name, bytes, WORKERS,
+                 bench_measure(NULL, run_copy, &state));
+    cbor_decref(&state.item);
+  }
+  return 0;
+}
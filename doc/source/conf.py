@@ -99,6 +99,7 @@ exclude_patterns = ['breathe/*']
 # documents.
 breathe_domain_by_extension = {
         "h" : "C",
+        "hpp" : "cpp",
         }
 #default_role = 'c:func'
 primary_domain = "cpp"
@@ -8,6 +8,9 @@
 #define CBOR_BUFFER_GROWTH 2
 #define CBOR_MAX_STACK_SIZE 2048
 #define CBOR_PRETTY_PRINTER 1
+#define CBOR_ALLOC_STATS 0
+#define CBOR_DECODER_STATS 0
+#define CBOR_ATOMIC_REFCOUNT 0
 
 #define CBOR_RESTRICT_SPECIFIER restrict
 #define CBOR_INLINE_SPECIFIER
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include "cbor.h"
+
+void usage(void) {
+  printf("Usage: cbor2json [input file]\n");
+  exit(1);
+}
+
+/*
+ * Converts a CBOR item to JSON without building any item trees, unlike
+ * cbor2cjson. Tags are preserved as {"tag": ..., "value": ...} objects.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 2) usage();
+  FILE* f = fopen(argv[1], "rb");
+  if (f == NULL) usage();
+  fseek(f, 0, SEEK_END);
+  size_t length = (size_t)ftell(f);
+  fseek(f, 0, SEEK_SET);
+  unsigned char* buffer = malloc(length);
+  fread(buffer, length, 1, f);
+
+  struct cbor_json_options options = {.tags = CBOR_JSON_TAGS_WRAP};
+  struct cbor_json_result result =
+      cbor_to_json(buffer, length, &options, cbor_writer_file_sink, stdout);
+  printf("\n");
+  if (result.error != CBOR_JSON_ERR_NONE) {
+    fprintf(stderr, "Conversion failed with error %d after %zu bytes\n",
+            result.error, result.read);
+  }
+
+  free(buffer);
+  fclose(f);
+  return result.error == CBOR_JSON_ERR_NONE ? 0 : 1;
+}
@@ -20,18 +20,10 @@ void usage(void) {
 
 int main(int argc, char* argv[]) {
   if (argc != 2) usage();
-  FILE* f = fopen(argv[1], "rb");
-  if (f == NULL) usage();
-  fseek(f, 0, SEEK_END);
-  size_t length = (size_t)ftell(f);
-  fseek(f, 0, SEEK_SET);
-  unsigned char* buffer = malloc(length);
-  fread(buffer, length, 1, f);
 
-  /* Assuming `buffer` contains `length` bytes of input data */
+  /* The file is memory-mapped where possible, avoiding a copy to the heap */
   struct cbor_load_result result;
-  cbor_item_t* item = cbor_load(buffer, length, &result);
-  free(buffer);
+  cbor_item_t* item = cbor_load_file(argv[1], CBOR_LOAD_FILE_DEFAULT, &result);
 
   if (result.error.code != CBOR_ERR_NONE) {
     printf(
@@ -61,6 +53,10 @@ int main(int argc, char* argv[]) {
             "https://www.rfc-editor.org/info/std94\n");
         break;
       }
+      case CBOR_ERR_IO: {
+        printf("The file could not be read\n");
+        break;
+      }
       case CBOR_ERR_NONE: {
         // GCC's cheap dataflow analysis gag
         break;
@@ -74,6 +70,4 @@ int main(int argc, char* argv[]) {
   fflush(stdout);
   /* Deallocate the result */
   cbor_decref(&item);
-
-  fclose(f);
 }
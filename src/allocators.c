@@ -6,14 +6,32 @@
  */
 
 #include "cbor/common.h"
+#include "cbor/internal/memory_utils.h"
 
 CBOR_EXPORT _cbor_malloc_t _cbor_malloc = malloc;
 CBOR_EXPORT _cbor_realloc_t _cbor_realloc = realloc;
 CBOR_EXPORT _cbor_free_t _cbor_free = free;
 
+static _CBOR_THREAD_LOCAL const struct cbor_allocator* _cbor_thread_allocator;
+
 void cbor_set_allocs(_cbor_malloc_t custom_malloc,
                      _cbor_realloc_t custom_realloc, _cbor_free_t custom_free) {
   _cbor_malloc = custom_malloc;
   _cbor_realloc = custom_realloc;
   _cbor_free = custom_free;
 }
+
+const struct cbor_allocator* cbor_set_thread_allocator(
+    const struct cbor_allocator* allocator) {
+  const struct cbor_allocator* previous = _cbor_thread_allocator;
+  _cbor_thread_allocator = allocator;
+  return previous;
+}
+
+const struct cbor_allocator* cbor_thread_allocator(void) {
+  return _cbor_thread_allocator;
+}
+
+const struct cbor_allocator* cbor_item_allocator(const cbor_item_t* item) {
+  return item->allocator;
+}
@@ -10,7 +10,11 @@
 
 #include "cbor.h"
 #include "cbor/internal/builder_callbacks.h"
+#include "cbor/internal/file_input.h"
+#include "cbor/internal/instrumentation.h"
 #include "cbor/internal/loaders.h"
+#include "cbor/internal/memory_utils.h"
+#include "cbor/internal/walker.h"
 
 cbor_item_t* cbor_load(cbor_data source, size_t source_size,
                        struct cbor_load_result* result) {
@@ -48,8 +52,16 @@ cbor_item_t* cbor_load(cbor_data source, size_t source_size,
       .float8 = &cbor_builder_float8_callback,
       .indef_break = &cbor_builder_indef_break_callback};
 
+#if CBOR_DECODER_STATS
+  uint64_t start_ns = _cbor_decoder_stats_now_ns();
+  size_t max_depth = 0;
+#endif
+
   if (source_size == 0) {
     result->error.code = CBOR_ERR_NODATA;
+#if CBOR_DECODER_STATS
+    _cbor_decoder_stats_load(/*failed=*/true, max_depth, start_ns);
+#endif
     return NULL;
   }
   struct _cbor_stack stack = _cbor_stack_init();
@@ -101,8 +113,14 @@ cbor_item_t* cbor_load(cbor_data source, size_t source_size,
       result->error.code = CBOR_ERR_SYNTAXERROR;
       goto error;
     }
+#if CBOR_DECODER_STATS
+    if (stack.size > max_depth) max_depth = stack.size;
+#endif
   } while (stack.size > 0);
 
+#if CBOR_DECODER_STATS
+  _cbor_decoder_stats_load(/*failed=*/false, max_depth, start_ns);
+#endif
   return context.root;
 
 error:
@@ -114,9 +132,62 @@ error:
     cbor_decref(&stack.top->item);
     _cbor_stack_pop(&stack);
   }
+#if CBOR_DECODER_STATS
+  _cbor_decoder_stats_load(/*failed=*/true, max_depth, start_ns);
+#endif
   return NULL;
 }
 
+cbor_item_t* cbor_load_with_allocator(cbor_data source, size_t source_size,
+                                      const struct cbor_allocator* allocator,
+                                      struct cbor_load_result* result) {
+  const struct cbor_allocator* previous = cbor_set_thread_allocator(allocator);
+  cbor_item_t* item = cbor_load(source, source_size, result);
+  cbor_set_thread_allocator(previous);
+  return item;
+}
+
+cbor_item_t* cbor_load_file(const char* path, int flags,
+                            struct cbor_load_result* result) {
+  struct _cbor_file_input input;
+  cbor_error_code open_result = _cbor_file_input_open(
+      path, !(flags & CBOR_LOAD_FILE_NO_MMAP), &input);
+  // cbor_load does not reset the position for empty inputs
+  *result = (struct cbor_load_result){.error = {.code = open_result}};
+  if (open_result != CBOR_ERR_NONE) return NULL;
+  cbor_item_t* item = cbor_load(input.data, input.length, result);
+  _cbor_file_input_close(&input);
+  return item;
+}
+
+size_t cbor_load_sequence_file(const char* path, int flags,
+                               cbor_sequence_callback callback, void* context,
+                               struct cbor_load_result* result) {
+  struct _cbor_file_input input;
+  cbor_error_code open_result = _cbor_file_input_open(
+      path, !(flags & CBOR_LOAD_FILE_NO_MMAP), &input);
+  *result = (struct cbor_load_result){.error = {.code = open_result}};
+  if (open_result != CBOR_ERR_NONE) return 0;
+
+  size_t items = 0;
+  while (result->read < input.length) {
+    struct cbor_load_result item_result;
+    cbor_item_t* item = cbor_load(input.data + result->read,
+                                  input.length - result->read, &item_result);
+    if (item == NULL) {
+      result->error = (struct cbor_error){
+          .code = item_result.error.code,
+          .position = result->read + item_result.error.position};
+      break;
+    }
+    result->read += item_result.read;
+    items++;
+    if (!callback(item, context)) break;
+  }
+  _cbor_file_input_close(&input);
+  return items;
+}
+
 static cbor_item_t* _cbor_copy_int(cbor_item_t* item, bool negative) {
   cbor_item_t* res = NULL;
   switch (cbor_int_get_width(item)) {
@@ -155,7 +226,119 @@ static cbor_item_t* _cbor_copy_float_ctrl(cbor_item_t* item) {
   }
 }
 
-cbor_item_t* cbor_copy(cbor_item_t* item) {
+static cbor_item_t* _cbor_copy_indefinite_bytestring(cbor_item_t* item) {
+  cbor_item_t* res = cbor_new_indefinite_bytestring();
+  if (res == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
+    cbor_item_t* chunk = cbor_bytestring_chunks_handle(item)[i];
+    cbor_item_t* chunk_copy = cbor_build_bytestring(
+        cbor_bytestring_handle(chunk), cbor_bytestring_length(chunk));
+    if (chunk_copy == NULL) {
+      cbor_decref(&res);
+      return NULL;
+    }
+    if (!cbor_bytestring_add_chunk(res, chunk_copy)) {
+      cbor_decref(&chunk_copy);
+      cbor_decref(&res);
+      return NULL;
+    }
+    cbor_decref(&chunk_copy);
+  }
+  return res;
+}
+
+static cbor_item_t* _cbor_copy_indefinite_string(cbor_item_t* item) {
+  cbor_item_t* res = cbor_new_indefinite_string();
+  if (res == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
+    cbor_item_t* chunk = cbor_string_chunks_handle(item)[i];
+    cbor_item_t* chunk_copy = cbor_build_stringn(
+        (const char*)cbor_string_handle(chunk), cbor_string_length(chunk));
+    if (chunk_copy == NULL) {
+      cbor_decref(&res);
+      return NULL;
+    }
+    if (!cbor_string_add_chunk(res, chunk_copy)) {
+      cbor_decref(&chunk_copy);
+      cbor_decref(&res);
+      return NULL;
+    }
+    cbor_decref(&chunk_copy);
+  }
+  return res;
+}
+
+static cbor_item_t* _cbor_concatenate_bytestring(cbor_item_t* item) {
+  size_t total_length = 0;
+  for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
+    total_length +=
+        cbor_bytestring_length(cbor_bytestring_chunks_handle(item)[i]);
+  }
+
+  unsigned char* combined_data = _CBOR_MALLOC(
+      cbor_thread_allocator(), CBOR_ALLOC_SITE_STRING_DATA, total_length);
+  if (combined_data == NULL) {
+    return NULL;
+  }
+
+  size_t offset = 0;
+  for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
+    cbor_item_t* chunk = cbor_bytestring_chunks_handle(item)[i];
+    memcpy(combined_data + offset, cbor_bytestring_handle(chunk),
+           cbor_bytestring_length(chunk));
+    offset += cbor_bytestring_length(chunk);
+  }
+
+  cbor_item_t* res = cbor_new_definite_bytestring();
+  if (res == NULL) {
+    _CBOR_FREE(cbor_thread_allocator(), combined_data);
+    return NULL;
+  }
+  cbor_bytestring_set_handle(res, combined_data, total_length);
+  return res;
+}
+
+static cbor_item_t* _cbor_concatenate_string(cbor_item_t* item) {
+  size_t total_length = 0;
+  for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
+    total_length += cbor_string_length(cbor_string_chunks_handle(item)[i]);
+  }
+
+  unsigned char* combined_data = _CBOR_MALLOC(
+      cbor_thread_allocator(), CBOR_ALLOC_SITE_STRING_DATA, total_length);
+  if (combined_data == NULL) {
+    return NULL;
+  }
+
+  size_t offset = 0;
+  for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
+    cbor_item_t* chunk = cbor_string_chunks_handle(item)[i];
+    memcpy(combined_data + offset, cbor_string_handle(chunk),
+           cbor_string_length(chunk));
+    offset += cbor_string_length(chunk);
+  }
+
+  cbor_item_t* res = cbor_new_definite_string();
+  if (res == NULL) {
+    _CBOR_FREE(cbor_thread_allocator(), combined_data);
+    return NULL;
+  }
+  cbor_string_set_handle(res, combined_data, total_length);
+  return res;
+}
+
+/** Copy \p item without its children. Arrays, maps, and tags are returned
+ * empty, with room for the children if they are definite.
+ *
+ * @param definite Whether to turn indefinite items into definite ones
+ */
+static cbor_item_t* _cbor_copy_shallow(cbor_item_t* item, bool definite) {
   switch (cbor_typeof(item)) {
     case CBOR_TYPE_UINT:
       return _cbor_copy_int(item, false);
@@ -165,125 +348,28 @@ cbor_item_t* cbor_copy(cbor_item_t* item) {
       if (cbor_bytestring_is_definite(item)) {
         return cbor_build_bytestring(cbor_bytestring_handle(item),
                                      cbor_bytestring_length(item));
-      } else {
-        cbor_item_t* res = cbor_new_indefinite_bytestring();
-        if (res == NULL) {
-          return NULL;
-        }
-
-        for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
-          cbor_item_t* chunk_copy =
-              cbor_copy(cbor_bytestring_chunks_handle(item)[i]);
-          if (chunk_copy == NULL) {
-            cbor_decref(&res);
-            return NULL;
-          }
-          if (!cbor_bytestring_add_chunk(res, chunk_copy)) {
-            cbor_decref(&chunk_copy);
-            cbor_decref(&res);
-            return NULL;
-          }
-          cbor_decref(&chunk_copy);
-        }
-        return res;
       }
+      return definite ? _cbor_concatenate_bytestring(item)
+                      : _cbor_copy_indefinite_bytestring(item);
     case CBOR_TYPE_STRING:
       if (cbor_string_is_definite(item)) {
         return cbor_build_stringn((const char*)cbor_string_handle(item),
                                   cbor_string_length(item));
-      } else {
-        cbor_item_t* res = cbor_new_indefinite_string();
-        if (res == NULL) {
-          return NULL;
-        }
-
-        for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
-          cbor_item_t* chunk_copy =
-              cbor_copy(cbor_string_chunks_handle(item)[i]);
-          if (chunk_copy == NULL) {
-            cbor_decref(&res);
-            return NULL;
-          }
-          if (!cbor_string_add_chunk(res, chunk_copy)) {
-            cbor_decref(&chunk_copy);
-            cbor_decref(&res);
-            return NULL;
-          }
-          cbor_decref(&chunk_copy);
-        }
-        return res;
-      }
-    case CBOR_TYPE_ARRAY: {
-      cbor_item_t* res;
-      if (cbor_array_is_definite(item)) {
-        res = cbor_new_definite_array(cbor_array_size(item));
-      } else {
-        res = cbor_new_indefinite_array();
-      }
-      if (res == NULL) {
-        return NULL;
       }
-
-      for (size_t i = 0; i < cbor_array_size(item); i++) {
-        cbor_item_t* entry_copy = cbor_copy(cbor_move(cbor_array_get(item, i)));
-        if (entry_copy == NULL) {
-          cbor_decref(&res);
-          return NULL;
-        }
-        if (!cbor_array_push(res, entry_copy)) {
-          cbor_decref(&entry_copy);
-          cbor_decref(&res);
-          return NULL;
-        }
-        cbor_decref(&entry_copy);
-      }
-      return res;
-    }
-    case CBOR_TYPE_MAP: {
-      cbor_item_t* res;
-      if (cbor_map_is_definite(item)) {
-        res = cbor_new_definite_map(cbor_map_size(item));
-      } else {
-        res = cbor_new_indefinite_map();
-      }
-      if (res == NULL) {
-        return NULL;
-      }
-
-      struct cbor_pair* it = cbor_map_handle(item);
-      for (size_t i = 0; i < cbor_map_size(item); i++) {
-        cbor_item_t* key_copy = cbor_copy(it[i].key);
-        if (key_copy == NULL) {
-          cbor_decref(&res);
-          return NULL;
-        }
-        cbor_item_t* value_copy = cbor_copy(it[i].value);
-        if (value_copy == NULL) {
-          cbor_decref(&res);
-          cbor_decref(&key_copy);
-          return NULL;
-        }
-        if (!cbor_map_add(res, (struct cbor_pair){.key = key_copy,
-                                                  .value = value_copy})) {
-          cbor_decref(&res);
-          cbor_decref(&key_copy);
-          cbor_decref(&value_copy);
-          return NULL;
-        }
-        cbor_decref(&key_copy);
-        cbor_decref(&value_copy);
+      return definite ? _cbor_concatenate_string(item)
+                      : _cbor_copy_indefinite_string(item);
+    case CBOR_TYPE_ARRAY:
+      if (definite || cbor_array_is_definite(item)) {
+        return cbor_new_definite_array(cbor_array_size(item));
       }
-      return res;
-    }
-    case CBOR_TYPE_TAG: {
-      cbor_item_t* item_copy = cbor_copy(cbor_move(cbor_tag_item(item)));
-      if (item_copy == NULL) {
-        return NULL;
+      return cbor_new_indefinite_array();
+    case CBOR_TYPE_MAP:
+      if (definite || cbor_map_is_definite(item)) {
+        return cbor_new_definite_map(cbor_map_size(item));
       }
-      cbor_item_t* tag = cbor_build_tag(cbor_tag_value(item), item_copy);
-      cbor_decref(&item_copy);
-      return tag;
-    }
+      return cbor_new_indefinite_map();
+    case CBOR_TYPE_TAG:
+      return cbor_new_tag(cbor_tag_value(item));
     case CBOR_TYPE_FLOAT_CTRL:
       return _cbor_copy_float_ctrl(item);
     default:
@@ -292,132 +378,118 @@ cbor_item_t* cbor_copy(cbor_item_t* item) {
   }
 }
 
-cbor_item_t* cbor_copy_definite(cbor_item_t* item) {
-  switch (cbor_typeof(item)) {
-    case CBOR_TYPE_UINT:
-    case CBOR_TYPE_NEGINT:
-      return cbor_copy(item);
-    case CBOR_TYPE_BYTESTRING:
-      if (cbor_bytestring_is_definite(item)) {
-        return cbor_copy(item);
-      } else {
-        size_t total_length = 0;
-        for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
-          total_length +=
-              cbor_bytestring_length(cbor_bytestring_chunks_handle(item)[i]);
-        }
-
-        unsigned char* combined_data = _cbor_malloc(total_length);
-        if (combined_data == NULL) {
-          return NULL;
-        }
-
-        size_t offset = 0;
-        for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
-          cbor_item_t* chunk = cbor_bytestring_chunks_handle(item)[i];
-          memcpy(combined_data + offset, cbor_bytestring_handle(chunk),
-                 cbor_bytestring_length(chunk));
-          offset += cbor_bytestring_length(chunk);
-        }
-
-        cbor_item_t* res = cbor_new_definite_bytestring();
-        cbor_bytestring_set_handle(res, combined_data, total_length);
-        return res;
+/** Add the copy of the next child to the copy in \p frame */
+static bool _cbor_copy_append(struct _cbor_walk_frame* frame,
+                              cbor_item_t* child) {
+  cbor_item_t* parent = frame->state.copy.item;
+  switch (cbor_typeof(parent)) {
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_push(parent, child);
+    case CBOR_TYPE_MAP: {
+      // Keys and values alternate, see _cbor_child_slot
+      if (frame->next % 2 == 1) {
+        frame->state.copy.key = cbor_incref(child);
+        return true;
       }
-    case CBOR_TYPE_STRING:
-      if (cbor_string_is_definite(item)) {
-        return cbor_copy(item);
-      } else {
-        size_t total_length = 0;
-        for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
-          total_length +=
-              cbor_string_length(cbor_string_chunks_handle(item)[i]);
-        }
+      bool added = cbor_map_add(
+          parent, (struct cbor_pair){.key = frame->state.copy.key,
+                                     .value = child});
+      cbor_decref(&frame->state.copy.key);
+      frame->state.copy.key = NULL;
+      return added;
+    }
+    case CBOR_TYPE_TAG:
+      cbor_tag_set_item(parent, child);
+      return true;
+    default:
+      _CBOR_UNREACHABLE;
+      return false;
+  }
+}
 
-        unsigned char* combined_data = _cbor_malloc(total_length);
-        if (combined_data == NULL) {
-          return NULL;
-        }
+/** Release the copy in \p frame */
+static void _cbor_copy_discard(struct _cbor_walk_frame* frame) {
+  if (frame->state.copy.key != NULL) cbor_decref(&frame->state.copy.key);
+  cbor_decref(&frame->state.copy.item);
+}
 
-        size_t offset = 0;
-        for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
-          cbor_item_t* chunk = cbor_string_chunks_handle(item)[i];
-          memcpy(combined_data + offset, cbor_string_handle(chunk),
-                 cbor_string_length(chunk));
-          offset += cbor_string_length(chunk);
+static cbor_item_t* _cbor_copy_tree(cbor_item_t* item, bool definite) {
+  cbor_item_t* copy = _cbor_copy_shallow(item, definite);
+  if (copy == NULL || !_cbor_is_nesting(item)) return copy;
+
+  // Every frame owns the copy of its item until it is complete and appended to
+  // the copy of the parent
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_walk_frame* frame = _cbor_walk_push(&walk, item);
+  if (frame == NULL) {
+    cbor_decref(&copy);
+    return NULL;
+  }
+  frame->state.copy.item = copy;
+  frame->state.copy.key = NULL;
+  cbor_item_t* result = NULL;
+  while (true) {
+    cbor_item_t* child;
+    if (_cbor_walk_next(frame, &child)) {
+      cbor_item_t* child_copy = _cbor_copy_shallow(child, definite);
+      if (child_copy == NULL) break;
+      if (_cbor_is_nesting(child)) {
+        frame = _cbor_walk_push(&walk, child);
+        if (frame == NULL) {
+          cbor_decref(&child_copy);
+          break;
         }
-
-        cbor_item_t* res = cbor_new_definite_string();
-        cbor_string_set_handle(res, combined_data, total_length);
-        return res;
-      }
-    case CBOR_TYPE_ARRAY: {
-      cbor_item_t* res = cbor_new_definite_array(cbor_array_size(item));
-      if (res == NULL) {
-        return NULL;
+        frame->state.copy.item = child_copy;
+        frame->state.copy.key = NULL;
+        continue;
       }
-
-      for (size_t i = 0; i < cbor_array_size(item); i++) {
-        cbor_item_t* entry_copy =
-            cbor_copy_definite(cbor_array_handle(item)[i]);
-        if (entry_copy == NULL) {
-          cbor_decref(&res);
-          return NULL;
-        }
-        // Cannot fail since we have a definite array preallocated
-        // cppcheck-suppress syntaxError
-        const bool item_pushed _CBOR_UNUSED = cbor_array_push(res, entry_copy);
-        CBOR_ASSERT(item_pushed);
-        cbor_decref(&entry_copy);
+      copy = child_copy;
+    } else {
+      copy = frame->state.copy.item;
+      _cbor_walk_pop(&walk);
+      if (walk.depth == 0) {
+        result = copy;
+        break;
       }
-      return res;
+      frame = _cbor_walk_top(&walk);
     }
-    case CBOR_TYPE_MAP: {
-      cbor_item_t* res;
-      res = cbor_new_definite_map(cbor_map_size(item));
-      if (res == NULL) {
-        return NULL;
-      }
+    bool appended = _cbor_copy_append(frame, copy);
+    cbor_decref(&copy);
+    if (!appended) break;
+  }
 
-      struct cbor_pair* it = cbor_map_handle(item);
-      for (size_t i = 0; i < cbor_map_size(item); i++) {
-        cbor_item_t* key_copy = cbor_copy_definite(it[i].key);
-        if (key_copy == NULL) {
-          cbor_decref(&res);
-          return NULL;
-        }
-        cbor_item_t* value_copy = cbor_copy_definite(it[i].value);
-        if (value_copy == NULL) {
-          cbor_decref(&res);
-          cbor_decref(&key_copy);
-          return NULL;
-        }
-        // Cannot fail since we have a definite map preallocated
-        // cppcheck-suppress syntaxError
-        const bool item_added _CBOR_UNUSED = cbor_map_add(
-            res, (struct cbor_pair){.key = key_copy, .value = value_copy});
-        CBOR_ASSERT(item_added);
-        cbor_decref(&key_copy);
-        cbor_decref(&value_copy);
-      }
-      return res;
-    }
-    case CBOR_TYPE_TAG: {
-      cbor_item_t* item_copy =
-          cbor_copy_definite(cbor_move(cbor_tag_item(item)));
-      if (item_copy == NULL) {
-        return NULL;
-      }
-      cbor_item_t* tag = cbor_build_tag(cbor_tag_value(item), item_copy);
-      cbor_decref(&item_copy);
-      return tag;
-    }
-    case CBOR_TYPE_FLOAT_CTRL:
-      return cbor_copy(item);
-    default:
-      _CBOR_UNREACHABLE;
-      return NULL;
+  // Release the incomplete copies on failure
+  while (walk.depth > 0) {
+    _cbor_copy_discard(_cbor_walk_top(&walk));
+    _cbor_walk_pop(&walk);
   }
+  _cbor_walk_free(&walk);
+  return result;
+}
+
+cbor_item_t* cbor_copy(cbor_item_t* item) {
+  return _cbor_copy_tree(item, /*definite=*/false);
+}
+
+cbor_item_t* cbor_copy_definite(cbor_item_t* item) {
+  return _cbor_copy_tree(item, /*definite=*/true);
+}
+
+cbor_item_t* cbor_copy_with_allocator(cbor_item_t* item,
+                                      const struct cbor_allocator* allocator) {
+  const struct cbor_allocator* previous = cbor_set_thread_allocator(allocator);
+  cbor_item_t* copy = cbor_copy(item);
+  cbor_set_thread_allocator(previous);
+  return copy;
+}
+
+cbor_item_t* cbor_copy_definite_with_allocator(
+    cbor_item_t* item, const struct cbor_allocator* allocator) {
+  const struct cbor_allocator* previous = cbor_set_thread_allocator(allocator);
+  cbor_item_t* copy = cbor_copy_definite(item);
+  cbor_set_thread_allocator(previous);
+  return copy;
 }
 
 #if CBOR_PRETTY_PRINTER
@@ -19,11 +19,19 @@
 #include "cbor/strings.h"
 #include "cbor/tags.h"
 
+#include "cbor/alloc_stats.h"
+#include "cbor/big_endian.h"
 #include "cbor/callbacks.h"
 #include "cbor/cbor_export.h"
+#include "cbor/decoder_stats.h"
+#include "cbor/diag.h"
 #include "cbor/encoding.h"
+#include "cbor/equality.h"
+#include "cbor/json.h"
+#include "cbor/reader.h"
 #include "cbor/serialization.h"
 #include "cbor/streaming.h"
+#include "cbor/writer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +55,77 @@ extern "C" {
 _CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_load(
     cbor_data source, size_t source_size, struct cbor_load_result* result);
 
+/** Loads data item from a buffer using a specific allocator
+ *
+ * Same as #cbor_load, except that the decoded items are allocated using
+ * \p allocator instead of the thread allocator (see
+ * #cbor_set_thread_allocator).
+ *
+ * @param source The buffer
+ * @param source_size
+ * @param allocator The allocator to use, `NULL` for the global memory
+ * management routines
+ * @param[out] result Result indicator. #CBOR_ERR_NONE on success
+ * @return Decoded CBOR item. The item's reference count is initialized to one.
+ * @return `NULL` on failure. In that case, \p result contains the location and
+ * description of the error.
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_load_with_allocator(
+    cbor_data source, size_t source_size,
+    const struct cbor_allocator* allocator, struct cbor_load_result* result);
+
+/** Options for #cbor_load_file and #cbor_load_sequence_file */
+typedef enum {
+  CBOR_LOAD_FILE_DEFAULT = 0,
+  /** Read the file into a heap buffer instead of memory-mapping it */
+  CBOR_LOAD_FILE_NO_MMAP = 1
+} cbor_load_file_flags;
+
+/** Loads data item from a file
+ *
+ * On POSIX systems, regular files are memory-mapped with a sequential access
+ * hint, avoiding an intermediate copy of the input. Other inputs are read into
+ * a temporary buffer. Like with #cbor_load, only the first item is decoded, and
+ * any trailing data is ignored.
+ *
+ * @param path Path to the file
+ * @param flags Bitwise OR of #cbor_load_file_flags
+ * @param[out] result Result indicator. #CBOR_ERR_NONE on success,
+ * #CBOR_ERR_IO if the file cannot be read
+ * @return Decoded CBOR item. The item's reference count is initialized to one.
+ * @return `NULL` on failure. In that case, \p result contains the location and
+ * description of the error.
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_load_file(
+    const char* path, int flags, struct cbor_load_result* result);
+
+/** Callback for #cbor_load_sequence_file
+ *
+ * @param item The decoded item. The callback takes over the reference.
+ * @param context The `context` passed to #cbor_load_sequence_file
+ * @return `true` to continue decoding, `false` to stop
+ */
+typedef bool (*cbor_sequence_callback)(cbor_item_t* item, void* context);
+
+/** Loads a CBOR Sequence (RFC 8742) from a file
+ *
+ * Decodes the items one by one and passes each of them to \p callback as soon
+ * as it is complete. The input is handled as in #cbor_load_file.
+ *
+ * @param path Path to the file
+ * @param flags Bitwise OR of #cbor_load_file_flags
+ * @param callback Invoked for every decoded item
+ * @param context Passed to every \p callback invocation
+ * @param[out] result Result indicator. #CBOR_ERR_NONE if the whole file has
+ * been decoded or the \p callback has stopped the decoding. On error, the
+ * position is relative to the beginning of the file.
+ * @return Number of items passed to the \p callback
+ */
+CBOR_EXPORT size_t cbor_load_sequence_file(const char* path, int flags,
+                                           cbor_sequence_callback callback,
+                                           void* context,
+                                           struct cbor_load_result* result);
+
 /** Take a deep copy of an item
  *
  * All items this item points to (array and map members, string chunks, tagged
@@ -54,6 +133,9 @@ _CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_load(
  * alias or point to any items from the original \p item. All the reference
  * counts in the new structure are set to one.
  *
+ * The copy is allocated using the thread allocator (see
+ * #cbor_set_thread_allocator).
+ *
  * @param item item to copy
  * @return Reference to the new item. The item's reference count is initialized
  * to one.
@@ -72,9 +154,47 @@ _CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_copy(cbor_item_t* item);
  */
 _CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_copy_definite(cbor_item_t* item);
 
+/** Take a deep copy of an item using a specific allocator
+ *
+ * Same as #cbor_copy, except that the copy is allocated using \p allocator
+ * instead of the thread allocator (see #cbor_set_thread_allocator). This can
+ * be used to move items between allocators.
+ *
+ * @param item item to copy
+ * @param allocator The allocator to use, `NULL` for the global memory
+ * management routines
+ * @return Reference to the new item. The item's reference count is initialized
+ * to one.
+ * @return `NULL` if memory allocation fails
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_copy_with_allocator(
+    cbor_item_t* item, const struct cbor_allocator* allocator);
+
+/** Copy the item with all items converted to definite length equivalents
+ * using a specific allocator
+ *
+ * See #cbor_copy_definite and #cbor_copy_with_allocator.
+ *
+ * @param item item to copy
+ * @param allocator The allocator to use, `NULL` for the global memory
+ * management routines
+ * @return Reference to the new item. The item's reference count is initialized
+ * to one.
+ * @return `NULL` if memory allocation fails
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_item_t* cbor_copy_definite_with_allocator(
+    cbor_item_t* item, const struct cbor_allocator* allocator);
+
 #if CBOR_PRETTY_PRINTER
 #include <stdio.h>
 
+/** Print a verbose, indented description of an item for debugging
+ *
+ * See #cbor_diag for a compact representation with bounded output.
+ *
+ * @param item The item
+ * @param out The output stream
+ */
 CBOR_EXPORT void cbor_describe(cbor_item_t* item, FILE* out);
 #endif
 
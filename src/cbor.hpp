@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_HPP
+#define LIBCBOR_HPP
+
+/* The C++17 interface. The C API in cbor.h is available as well. */
+
+#include "cbor.h"
+#include "cbor/codec.hpp"
+#include "cbor/item.hpp"
+#include "cbor/parse.hpp"
+
+#endif  // LIBCBOR_HPP
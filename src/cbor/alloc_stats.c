@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "alloc_stats.h"
+
+#include <string.h>
+
+#include "internal/atomics.h"
+#include "internal/memory_utils.h"
+
+#if CBOR_ALLOC_STATS
+
+#if !_CBOR_HAS_ATOMICS
+#error "CBOR_ALLOC_STATS requires GCC-compatible atomic builtins or MSVC"
+#endif
+
+/*
+ * Live allocations are kept in an open addressing hash table keyed by the
+ * pointer, so that frees can be attributed without changing the layout of the
+ * allocations the client allocator sees. The table itself uses the C library
+ * allocator to stay out of the statistics.
+ */
+
+struct _cbor_tracked_allocation {
+  /** `NULL` for empty slots, #_CBOR_TOMBSTONE for removed entries */
+  void* pointer;
+  size_t size;
+  cbor_alloc_site site;
+};
+
+static char _cbor_tombstone_marker;
+#define _CBOR_TOMBSTONE ((void*)&_cbor_tombstone_marker)
+
+static struct _cbor_tracked_allocation* _cbor_allocations;
+/** Always a power of two */
+static size_t _cbor_allocations_capacity;
+/** Live entries and tombstones */
+static size_t _cbor_allocations_used;
+
+static struct cbor_alloc_stats _cbor_stats;
+
+static _cbor_spin_lock_t _cbor_stats_lock;
+
+static size_t _cbor_pointer_hash(const void* pointer) {
+  uint64_t hash = (uint64_t)(uintptr_t)pointer;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  return (size_t)hash;
+}
+
+static struct _cbor_tracked_allocation* _cbor_allocations_find(
+    const void* pointer) {
+  if (_cbor_allocations_capacity == 0) return NULL;
+  size_t mask = _cbor_allocations_capacity - 1;
+  for (size_t i = _cbor_pointer_hash(pointer) & mask;;
+       i = (i + 1) & mask) {
+    if (_cbor_allocations[i].pointer == pointer) return &_cbor_allocations[i];
+    if (_cbor_allocations[i].pointer == NULL) return NULL;
+  }
+}
+
+static bool _cbor_allocations_grow(void) {
+  size_t new_capacity =
+      _cbor_allocations_capacity == 0 ? 1024 : 2 * _cbor_allocations_capacity;
+  struct _cbor_tracked_allocation* new_allocations =
+      calloc(new_capacity, sizeof(struct _cbor_tracked_allocation));
+  if (new_allocations == NULL) return false;
+  // Rehash, dropping tombstones
+  size_t used = 0;
+  for (size_t i = 0; i < _cbor_allocations_capacity; i++) {
+    void* pointer = _cbor_allocations[i].pointer;
+    if (pointer == NULL || pointer == _CBOR_TOMBSTONE) continue;
+    size_t j = _cbor_pointer_hash(pointer) & (new_capacity - 1);
+    while (new_allocations[j].pointer != NULL) j = (j + 1) & (new_capacity - 1);
+    new_allocations[j] = _cbor_allocations[i];
+    used++;
+  }
+  free(_cbor_allocations);
+  _cbor_allocations = new_allocations;
+  _cbor_allocations_capacity = new_capacity;
+  _cbor_allocations_used = used;
+  return true;
+}
+
+/** Remove the entry for `pointer`, if it is tracked */
+static void _cbor_allocations_remove(void* pointer) {
+  struct _cbor_tracked_allocation* entry = _cbor_allocations_find(pointer);
+  if (entry == NULL) return;
+  _cbor_stats.live_bytes -= entry->size;
+  _cbor_stats.sites[entry->site].live_bytes -= entry->size;
+  entry->pointer = _CBOR_TOMBSTONE;
+}
+
+static void _cbor_allocations_insert(void* pointer, size_t size,
+                                     cbor_alloc_site site) {
+  // The block may have been released without going through the library
+  _cbor_allocations_remove(pointer);
+  // Keep the load factor including tombstones under 1/2
+  if (2 * (_cbor_allocations_used + 1) > _cbor_allocations_capacity &&
+      !_cbor_allocations_grow())
+    return;  // The allocation is not tracked, its free will be ignored
+  size_t mask = _cbor_allocations_capacity - 1;
+  size_t i = _cbor_pointer_hash(pointer) & mask;
+  while (_cbor_allocations[i].pointer != NULL &&
+         _cbor_allocations[i].pointer != _CBOR_TOMBSTONE)
+    i = (i + 1) & mask;
+  if (_cbor_allocations[i].pointer == NULL) _cbor_allocations_used++;
+  _cbor_allocations[i] = (struct _cbor_tracked_allocation){
+      .pointer = pointer, .size = size, .site = site};
+
+  _cbor_stats.live_bytes += size;
+  _cbor_stats.sites[site].live_bytes += size;
+  if (_cbor_stats.live_bytes > _cbor_stats.peak_bytes)
+    _cbor_stats.peak_bytes = _cbor_stats.live_bytes;
+}
+
+void* _cbor_tracked_malloc(const struct cbor_allocator* allocator,
+                           cbor_alloc_site site, size_t size) {
+  void* pointer = _cbor_allocator_malloc(allocator, size);
+  if (pointer == NULL) return NULL;
+  _cbor_spin_lock(&_cbor_stats_lock);
+  _cbor_stats.allocations++;
+  _cbor_stats.sites[site].allocations++;
+  _cbor_allocations_insert(pointer, size, site);
+  _cbor_spin_unlock(&_cbor_stats_lock);
+  return pointer;
+}
+
+void* _cbor_tracked_realloc(const struct cbor_allocator* allocator,
+                            cbor_alloc_site site, void* pointer, size_t size) {
+  // Stop tracking the block before it may be released: once realloc moves it,
+  // another thread may be given the same address and track it first
+  struct _cbor_tracked_allocation old = {NULL, 0, site};
+  if (pointer != NULL) {
+    _cbor_spin_lock(&_cbor_stats_lock);
+    struct _cbor_tracked_allocation* entry = _cbor_allocations_find(pointer);
+    if (entry != NULL) {
+      old = *entry;
+      _cbor_allocations_remove(pointer);
+    }
+    _cbor_spin_unlock(&_cbor_stats_lock);
+  }
+
+  void* new_pointer = _cbor_allocator_realloc(allocator, pointer, size);
+  _cbor_spin_lock(&_cbor_stats_lock);
+  if (new_pointer == NULL) {
+    // The block is unchanged
+    if (old.pointer != NULL)
+      _cbor_allocations_insert(pointer, old.size, old.site);
+  } else {
+    if (pointer == NULL) {
+      _cbor_stats.allocations++;
+      _cbor_stats.sites[site].allocations++;
+    } else {
+      _cbor_stats.reallocations++;
+      _cbor_stats.sites[site].reallocations++;
+    }
+    _cbor_allocations_insert(new_pointer, size, site);
+  }
+  _cbor_spin_unlock(&_cbor_stats_lock);
+  return new_pointer;
+}
+
+void _cbor_tracked_free(const struct cbor_allocator* allocator, void* pointer) {
+  if (pointer != NULL) {
+    _cbor_spin_lock(&_cbor_stats_lock);
+    struct _cbor_tracked_allocation* entry = _cbor_allocations_find(pointer);
+    if (entry != NULL) {
+      _cbor_stats.frees++;
+      _cbor_stats.sites[entry->site].frees++;
+      _cbor_allocations_remove(pointer);
+    }
+    _cbor_spin_unlock(&_cbor_stats_lock);
+  }
+  _cbor_allocator_free(allocator, pointer);
+}
+
+bool cbor_alloc_stats_get(struct cbor_alloc_stats* stats) {
+  _cbor_spin_lock(&_cbor_stats_lock);
+  *stats = _cbor_stats;
+  _cbor_spin_unlock(&_cbor_stats_lock);
+  return true;
+}
+
+void cbor_alloc_stats_reset(void) {
+  _cbor_spin_lock(&_cbor_stats_lock);
+  struct cbor_alloc_stats reset = {.live_bytes = _cbor_stats.live_bytes,
+                                   .peak_bytes = _cbor_stats.live_bytes};
+  for (size_t i = 0; i < CBOR_ALLOC_SITE_COUNT; i++)
+    reset.sites[i].live_bytes = _cbor_stats.sites[i].live_bytes;
+  _cbor_stats = reset;
+  _cbor_spin_unlock(&_cbor_stats_lock);
+}
+
+#else
+
+bool cbor_alloc_stats_get(struct cbor_alloc_stats* stats) {
+  memset(stats, 0, sizeof(struct cbor_alloc_stats));
+  return false;
+}
+
+void cbor_alloc_stats_reset(void) {}
+
+#endif  // CBOR_ALLOC_STATS
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_ALLOC_STATS_H
+#define LIBCBOR_ALLOC_STATS_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Allocation statistics
+ * ============================================================================
+ */
+
+/** Purpose of an allocation made by libcbor */
+typedef enum {
+  /** #cbor_item_t structures, including inline integer and float values */
+  CBOR_ALLOC_SITE_ITEMS,
+  /** String and byte string payloads */
+  CBOR_ALLOC_SITE_STRING_DATA,
+  /** Array and map storage, indefinite string chunk lists */
+  CBOR_ALLOC_SITE_CONTAINERS,
+  /** Decoder stack records and traversal stacks of nested items */
+  CBOR_ALLOC_SITE_STACK,
+  /** Everything else, e.g. writer and file buffers */
+  CBOR_ALLOC_SITE_OTHER,
+  /** Number of sites */
+  CBOR_ALLOC_SITE_COUNT
+} cbor_alloc_site;
+
+/** Counters for a single #cbor_alloc_site */
+struct cbor_alloc_site_stats {
+  /** Bytes currently allocated */
+  size_t live_bytes;
+  /** Number of successful `malloc` calls */
+  size_t allocations;
+  /** Number of successful `realloc` calls */
+  size_t reallocations;
+  /** Number of `free` calls */
+  size_t frees;
+};
+
+/** Allocation statistics, see #cbor_alloc_stats_get */
+struct cbor_alloc_stats {
+  /** Bytes currently allocated */
+  size_t live_bytes;
+  /** Maximum of #live_bytes since the last reset */
+  size_t peak_bytes;
+  /** Number of successful `malloc` calls */
+  size_t allocations;
+  /** Number of successful `realloc` calls */
+  size_t reallocations;
+  /** Number of `free` calls */
+  size_t frees;
+  /** Breakdown by #cbor_alloc_site */
+  struct cbor_alloc_site_stats sites[CBOR_ALLOC_SITE_COUNT];
+};
+
+/** Get a snapshot of the allocation statistics
+ *
+ * Statistics are only collected when libcbor is built with `CBOR_ALLOC_STATS`
+ * (see #CBOR_ALLOC_STATS), otherwise \p stats is zeroed.
+ *
+ * Only memory allocated and released by libcbor is accounted for. Buffers
+ * returned to the client (e.g. by #cbor_serialize_alloc) and handles passed
+ * in by the client (e.g. to #cbor_bytestring_set_handle) are not tracked.
+ *
+ * @param[out] stats The statistics
+ * @return `true` if statistics are available, `false` if they were compiled
+ * out
+ */
+CBOR_EXPORT bool cbor_alloc_stats_get(struct cbor_alloc_stats* stats);
+
+/** Reset the counters
+ *
+ * The call counts are zeroed and the peak is set to the current live bytes.
+ * Live bytes are not affected, since the memory is still allocated.
+ */
+CBOR_EXPORT void cbor_alloc_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_ALLOC_STATS_H
@@ -8,7 +8,9 @@
 #include <stdbool.h>
 
 #include "arrays.h"
+#include "internal/item_pool.h"
 #include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 size_t cbor_array_size(const cbor_item_t* item) {
   CBOR_ASSERT(cbor_isa_array(item));
@@ -35,15 +37,21 @@ bool cbor_array_set(cbor_item_t* item, size_t index, cbor_item_t* value) {
 }
 
 bool cbor_array_replace(cbor_item_t* item, size_t index, cbor_item_t* value) {
+  if (cbor_is_frozen(item)) return false;
   if (index >= item->metadata.array_metadata.end_ptr) return false;
+  cbor_item_t** slot = &((cbor_item_t**)item->data)[index];
+  _cbor_size_cache_unlink(item, *slot);
   /* We cannot use cbor_array_get as that would increase the refcount */
-  cbor_intermediate_decref(((cbor_item_t**)item->data)[index]);
-  ((cbor_item_t**)item->data)[index] = cbor_incref(value);
+  cbor_intermediate_decref(*slot);
+  *slot = cbor_incref(value);
+  _cbor_size_cache_link(item, value);
+  _cbor_size_cache_invalidate(item);
   return true;
 }
 
 bool cbor_array_push(cbor_item_t* array, cbor_item_t* pushee) {
   CBOR_ASSERT(cbor_isa_array(array));
+  if (cbor_is_frozen(array)) return false;
   struct _cbor_array_metadata* metadata =
       (struct _cbor_array_metadata*)&array->metadata;
   cbor_item_t** data = (cbor_item_t**)array->data;
@@ -65,8 +73,9 @@ bool cbor_array_push(cbor_item_t* array, cbor_item_t* pushee) {
                                   ? 1
                                   : CBOR_BUFFER_GROWTH * metadata->allocated;
 
-      unsigned char* new_data = _cbor_realloc_multiple(
-          array->data, sizeof(cbor_item_t*), new_allocation);
+      unsigned char* new_data =
+          _cbor_realloc_multiple(array->allocator, array->data,
+                                 sizeof(cbor_item_t*), new_allocation);
       if (new_data == NULL) {
         return false;
       }
@@ -77,6 +86,8 @@ bool cbor_array_push(cbor_item_t* array, cbor_item_t* pushee) {
     ((cbor_item_t**)array->data)[metadata->end_ptr++] = pushee;
   }
   cbor_incref(pushee);
+  _cbor_size_cache_link(array, pushee);
+  _cbor_size_cache_invalidate(array);
   return true;
 }
 
@@ -96,10 +107,12 @@ cbor_item_t** cbor_array_handle(const cbor_item_t* item) {
 }
 
 cbor_item_t* cbor_new_definite_array(size_t size) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
-  cbor_item_t** data = _cbor_alloc_multiple(sizeof(cbor_item_t*), size);
-  _CBOR_DEPENDENT_NOTNULL(item, data);
+  cbor_item_t** data =
+      _cbor_alloc_multiple(allocator, sizeof(cbor_item_t*), size);
+  _CBOR_ITEM_DEPENDENT_NOTNULL(allocator, item, data);
 
   for (size_t i = 0; i < size; i++) {
     data[i] = NULL;
@@ -107,6 +120,7 @@ cbor_item_t* cbor_new_definite_array(size_t size) {
 
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_ARRAY,
       .metadata = {.array_metadata = {.type = _CBOR_METADATA_DEFINITE,
                                       .allocated = size,
@@ -117,11 +131,13 @@ cbor_item_t* cbor_new_definite_array(size_t size) {
 }
 
 cbor_item_t* cbor_new_indefinite_array(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_ARRAY,
       .metadata = {.array_metadata = {.type = _CBOR_METADATA_INDEFINITE,
                                       .allocated = 0,
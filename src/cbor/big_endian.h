@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_BIG_ENDIAN_H
+#define LIBCBOR_BIG_ENDIAN_H
+
+#include <string.h>
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * All cbor_load_* functions read the big-endian value at `source`, which does
+ * not have to be aligned, e.g. the argument or the float that follows the
+ * initial byte of an item. The cbor_store_* functions write one. Neither
+ * checks bounds. They are meant for encoders and decoders that work on the
+ * encoded data directly.
+ */
+
+/** Load a big-endian 16-bit unsigned integer
+ *
+ * @param source At least 2 bytes
+ * @return The value
+ */
+_CBOR_NODISCARD static inline uint16_t cbor_load_uint16(cbor_data source) {
+  return (uint16_t)((uint16_t)source[0] << 8 | source[1]);
+}
+
+/** Load a big-endian 32-bit unsigned integer
+ *
+ * @param source At least 4 bytes
+ * @return The value
+ */
+_CBOR_NODISCARD static inline uint32_t cbor_load_uint32(cbor_data source) {
+  return (uint32_t)source[0] << 24 | (uint32_t)source[1] << 16 |
+         (uint32_t)source[2] << 8 | (uint32_t)source[3];
+}
+
+/** Load a big-endian 64-bit unsigned integer
+ *
+ * @param source At least 8 bytes
+ * @return The value
+ */
+_CBOR_NODISCARD static inline uint64_t cbor_load_uint64(cbor_data source) {
+  return (uint64_t)cbor_load_uint32(source) << 32 |
+         cbor_load_uint32(source + 4);
+}
+
+/** Load a big-endian half-precision float
+ *
+ * @param source At least 2 bytes
+ * @return The value, which is exactly representable as a float
+ */
+_CBOR_NODISCARD CBOR_EXPORT float cbor_load_half(cbor_data source);
+
+/** Load a big-endian single-precision float
+ *
+ * @param source At least 4 bytes
+ * @return The value
+ */
+_CBOR_NODISCARD static inline float cbor_load_float(cbor_data source) {
+  uint32_t bits = cbor_load_uint32(source);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/** Load a big-endian double-precision float
+ *
+ * @param source At least 8 bytes
+ * @return The value
+ */
+_CBOR_NODISCARD static inline double cbor_load_double(cbor_data source) {
+  uint64_t bits = cbor_load_uint64(source);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/** Store a big-endian 16-bit unsigned integer
+ *
+ * @param target At least 2 bytes
+ * @param value The value
+ */
+static inline void cbor_store_uint16(unsigned char* target, uint16_t value) {
+  target[0] = (unsigned char)(value >> 8);
+  target[1] = (unsigned char)value;
+}
+
+/** Store a big-endian 32-bit unsigned integer
+ *
+ * @param target At least 4 bytes
+ * @param value The value
+ */
+static inline void cbor_store_uint32(unsigned char* target, uint32_t value) {
+  cbor_store_uint16(target, (uint16_t)(value >> 16));
+  cbor_store_uint16(target + 2, (uint16_t)value);
+}
+
+/** Store a big-endian 64-bit unsigned integer
+ *
+ * @param target At least 8 bytes
+ * @param value The value
+ */
+static inline void cbor_store_uint64(unsigned char* target, uint64_t value) {
+  cbor_store_uint32(target, (uint32_t)(value >> 32));
+  cbor_store_uint32(target + 4, (uint32_t)value);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_BIG_ENDIAN_H
@@ -7,7 +7,9 @@
 
 #include "bytestrings.h"
 #include <string.h>
+#include "internal/item_pool.h"
 #include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 size_t cbor_bytestring_length(const cbor_item_t* item) {
   CBOR_ASSERT(cbor_isa_bytestring(item));
@@ -29,10 +31,12 @@ bool cbor_bytestring_is_indefinite(const cbor_item_t* item) {
 }
 
 cbor_item_t* cbor_new_definite_bytestring(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_BYTESTRING,
       .metadata = {.bytestring_metadata = {.type = _CBOR_METADATA_DEFINITE,
                                            .length = 0}}};
@@ -40,15 +44,18 @@ cbor_item_t* cbor_new_definite_bytestring(void) {
 }
 
 cbor_item_t* cbor_new_indefinite_bytestring(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_BYTESTRING,
       .metadata = {.bytestring_metadata = {.type = _CBOR_METADATA_INDEFINITE,
                                            .length = 0}},
-      .data = _cbor_malloc(sizeof(struct cbor_indefinite_string_data))};
-  _CBOR_DEPENDENT_NOTNULL(item, item->data);
+      .data = _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_CONTAINERS,
+                           sizeof(struct cbor_indefinite_string_data))};
+  _CBOR_ITEM_DEPENDENT_NOTNULL(allocator, item, item->data);
   *((struct cbor_indefinite_string_data*)item->data) =
       (struct cbor_indefinite_string_data){
           .chunk_count = 0,
@@ -61,8 +68,9 @@ cbor_item_t* cbor_new_indefinite_bytestring(void) {
 cbor_item_t* cbor_build_bytestring(cbor_data handle, size_t length) {
   cbor_item_t* item = cbor_new_definite_bytestring();
   _CBOR_NOTNULL(item);
-  void* content = _cbor_malloc(length);
-  _CBOR_DEPENDENT_NOTNULL(item, content);
+  void* content =
+      _CBOR_MALLOC(item->allocator, CBOR_ALLOC_SITE_STRING_DATA, length);
+  _CBOR_ITEM_DEPENDENT_NOTNULL(item->allocator, item, content);
   memcpy(content, handle, length);
   cbor_bytestring_set_handle(item, content, length);
   return item;
@@ -71,10 +79,12 @@ cbor_item_t* cbor_build_bytestring(cbor_data handle, size_t length) {
 void cbor_bytestring_set_handle(cbor_item_t* item,
                                 cbor_mutable_data CBOR_RESTRICT_POINTER data,
                                 size_t length) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_isa_bytestring(item));
   CBOR_ASSERT(cbor_bytestring_is_definite(item));
   item->data = data;
   item->metadata.bytestring_metadata.length = length;
+  _cbor_size_cache_invalidate(item);
 }
 
 cbor_item_t** cbor_bytestring_chunks_handle(const cbor_item_t* item) {
@@ -94,6 +104,7 @@ bool cbor_bytestring_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
   CBOR_ASSERT(cbor_bytestring_is_indefinite(item));
   CBOR_ASSERT(cbor_isa_bytestring(chunk));
   CBOR_ASSERT(cbor_bytestring_is_definite(chunk));
+  if (cbor_is_frozen(item)) return false;
   struct cbor_indefinite_string_data* data =
       (struct cbor_indefinite_string_data*)item->data;
   if (data->chunk_count == data->chunk_capacity) {
@@ -105,8 +116,9 @@ bool cbor_bytestring_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
         data->chunk_capacity == 0 ? 1
                                   : CBOR_BUFFER_GROWTH * (data->chunk_capacity);
 
-    cbor_item_t** new_chunks_data = _cbor_realloc_multiple(
-        data->chunks, sizeof(cbor_item_t*), new_chunk_capacity);
+    cbor_item_t** new_chunks_data =
+        _cbor_realloc_multiple(item->allocator, data->chunks,
+                               sizeof(cbor_item_t*), new_chunk_capacity);
 
     if (new_chunks_data == NULL) {
       return false;
@@ -115,5 +127,7 @@ bool cbor_bytestring_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
     data->chunks = new_chunks_data;
   }
   data->chunks[data->chunk_count++] = cbor_incref(chunk);
+  _cbor_size_cache_link(item, chunk);
+  _cbor_size_cache_invalidate(item);
   return true;
 }
@@ -64,8 +64,9 @@ CBOR_EXPORT cbor_mutable_data cbor_bytestring_handle(const cbor_item_t* item);
  *
  * @param item A definite byte string
  * @param data The memory block. The caller gives up the ownership of the block.
- * libcbor will deallocate it when appropriate using the `free` implementation
- * configured using #cbor_set_allocs
+ * libcbor will deallocate it when appropriate, so it must be allocated using
+ * the allocator of \p item (see #cbor_item_allocator), or using the routines
+ * configured by #cbor_set_allocs if the item has none
  * @param length Length of the data block
  */
 CBOR_EXPORT void cbor_bytestring_set_handle(
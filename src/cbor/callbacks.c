@@ -74,6 +74,16 @@ void cbor_null_boolean_callback(void* _ctx _CBOR_UNUSED,
 
 void cbor_null_indef_break_callback(void* _ctx _CBOR_UNUSED) {}
 
+void cbor_null_byte_string_chunk_callback(void* _ctx _CBOR_UNUSED,
+                                          cbor_data _CBOR_UNUSED _val,
+                                          uint64_t _CBOR_UNUSED _val2,
+                                          uint64_t _CBOR_UNUSED _val3) {}
+
+void cbor_null_string_chunk_callback(void* _ctx _CBOR_UNUSED,
+                                     cbor_data _CBOR_UNUSED _val,
+                                     uint64_t _CBOR_UNUSED _val2,
+                                     uint64_t _CBOR_UNUSED _val3) {}
+
 CBOR_EXPORT const struct cbor_callbacks cbor_empty_callbacks = {
     /* Type 0 - Unsigned integers */
     .uint8 = cbor_null_uint8_callback,
@@ -118,4 +128,8 @@ CBOR_EXPORT const struct cbor_callbacks cbor_empty_callbacks = {
 
     /* Shared indefinites */
     .indef_break = cbor_null_indef_break_callback,
+
+    /* Parts of definite strings */
+    .byte_string_chunk = cbor_null_byte_string_chunk_callback,
+    .string_chunk = cbor_null_string_chunk_callback,
 };
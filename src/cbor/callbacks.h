@@ -35,6 +35,14 @@ typedef void (*cbor_simple_callback)(void*);
 /** Callback prototype */
 typedef void (*cbor_string_callback)(void*, cbor_data, uint64_t);
 
+/** Callback prototype
+ *
+ * Receives the data and length of a part of a definite string, followed by
+ * the number of bytes of the string that are still to come.
+ */
+typedef void (*cbor_string_chunk_callback)(void*, cbor_data, uint64_t,
+                                           uint64_t);
+
 /** Callback prototype */
 typedef void (*cbor_collection_callback)(void*, uint64_t);
 
@@ -105,6 +113,11 @@ struct cbor_callbacks {
 
   /** Indefinite item break */
   cbor_simple_callback indef_break;
+
+  /** Part of a definite byte string, see #cbor_stream_decode_partial */
+  cbor_string_chunk_callback byte_string_chunk;
+  /** Part of a definite string, see #cbor_stream_decode_partial */
+  cbor_string_chunk_callback string_chunk;
 };
 
 /** Dummy callback implementation - does nothing */
@@ -179,6 +192,14 @@ CBOR_EXPORT void cbor_null_boolean_callback(void*, bool);
 /** Dummy callback implementation - does nothing */
 CBOR_EXPORT void cbor_null_indef_break_callback(void*);
 
+/** Dummy callback implementation - does nothing */
+CBOR_EXPORT void cbor_null_byte_string_chunk_callback(void*, cbor_data,
+                                                      uint64_t, uint64_t);
+
+/** Dummy callback implementation - does nothing */
+CBOR_EXPORT void cbor_null_string_chunk_callback(void*, cbor_data, uint64_t,
+                                                 uint64_t);
+
 /** Dummy callback bundle - does nothing */
 CBOR_EXPORT extern const struct cbor_callbacks cbor_empty_callbacks;
 
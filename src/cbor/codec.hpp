@@ -0,0 +1,675 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_CODEC_HPP
+#define LIBCBOR_CODEC_HPP
+
+#if __cplusplus < 201703L && (!defined(_MSVC_LANG) || _MSVC_LANG < 201703L)
+#error "cbor/codec.hpp requires C++17"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "cbor/common.h"
+#include "cbor/big_endian.h"
+
+/** Register the members of a struct for #cbor::encode and #cbor::decode
+ *
+ * Use inside the struct definition with the names of the members:
+ *
+ * \code
+ * struct point {
+ *   double x;
+ *   double y;
+ *   std::optional<std::string> label;
+ *   CBOR_FIELDS(x, y, label)
+ * };
+ * \endcode
+ *
+ * The struct is encoded as a map keyed by the member names. Members of type
+ * `std::optional` are left out when empty.
+ */
+#define CBOR_FIELDS(...)                                               \
+  auto _cbor_fields() noexcept { return std::tie(__VA_ARGS__); }       \
+  auto _cbor_fields() const noexcept { return std::tie(__VA_ARGS__); } \
+  static constexpr std::string_view _cbor_field_names() noexcept {     \
+    return #__VA_ARGS__;                                               \
+  }
+
+namespace cbor {
+namespace detail {
+
+template <class T>
+inline constexpr bool unsupported = false;
+
+template <class T>
+struct is_optional : std::false_type {};
+template <class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <class T>
+struct is_vector : std::false_type {};
+template <class T, class Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <class T>
+struct is_array : std::false_type {};
+template <class T, std::size_t N>
+struct is_array<std::array<T, N>> : std::true_type {};
+
+template <class T>
+struct is_map : std::false_type {};
+template <class Key, class T, class Compare, class Allocator>
+struct is_map<std::map<Key, T, Compare, Allocator>> : std::true_type {};
+
+template <class T, class = void>
+struct has_fields : std::false_type {};
+template <class T>
+struct has_fields<T, std::void_t<decltype(std::declval<T&>()._cbor_fields())>>
+    : std::true_type {};
+
+template <class T>
+struct is_bytes : std::false_type {};
+template <class Allocator>
+struct is_bytes<std::vector<std::byte, Allocator>> : std::true_type {};
+template <std::size_t N>
+struct is_bytes<std::array<std::byte, N>> : std::true_type {};
+
+/* Member names of a CBOR_FIELDS struct, split at compile time */
+
+template <std::size_t N>
+constexpr std::array<std::string_view, N> split_names(std::string_view list) {
+  std::array<std::string_view, N> names{};
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    std::size_t end = std::min(list.find(',', start), list.size());
+    std::string_view name = list.substr(start, end - start);
+    while (!name.empty() && name.front() <= ' ') name.remove_prefix(1);
+    while (!name.empty() && name.back() <= ' ') name.remove_suffix(1);
+    names[i] = name;
+    start = end + 1;
+  }
+  return names;
+}
+
+template <class T>
+inline constexpr std::size_t field_count =
+    std::tuple_size_v<decltype(std::declval<T&>()._cbor_fields())>;
+
+template <class T>
+inline constexpr auto field_names =
+    split_names<field_count<T>>(T::_cbor_field_names());
+
+/*
+ * ============================================================================
+ * Encoding
+ * ============================================================================
+ */
+
+/** Output cursor. Once the buffer is full, only the size is counted. */
+struct writer {
+  /** `NULL` once the buffer is full */
+  unsigned char* cursor;
+  unsigned char* end;
+  /** Bytes needed so far */
+  std::size_t size;
+
+  /** Reserve \p length bytes, `NULL` if they do not fit */
+  unsigned char* reserve(std::size_t length) noexcept {
+    size += length;
+    if (cursor == nullptr || static_cast<std::size_t>(end - cursor) < length) {
+      cursor = nullptr;
+      return nullptr;
+    }
+    unsigned char* target = cursor;
+    cursor += length;
+    return target;
+  }
+
+  void write(const void* data, std::size_t length) noexcept {
+    unsigned char* target = reserve(length);
+    if (target != nullptr && length > 0) std::memcpy(target, data, length);
+  }
+};
+
+template <class Argument>
+void write_argument(writer& out, int initial, Argument argument) noexcept {
+  unsigned char* target = out.reserve(1 + sizeof(Argument));
+  if (target == nullptr) return;
+  target[0] = static_cast<unsigned char>(initial);
+  if constexpr (sizeof(Argument) == 1)
+    target[1] = argument;
+  else if constexpr (sizeof(Argument) == 2)
+    cbor_store_uint16(target + 1, argument);
+  else if constexpr (sizeof(Argument) == 4)
+    cbor_store_uint32(target + 1, argument);
+  else
+    cbor_store_uint64(target + 1, argument);
+}
+
+/** Write a head with the shortest encoding of \p argument. Widths that are
+ * wider than \p Unsigned are left out at compile time. */
+template <class Unsigned>
+void write_head(writer& out, unsigned char major, Unsigned argument) noexcept {
+  static_assert(std::is_unsigned_v<Unsigned>);
+  const int initial = major << 5;
+  if (argument < 24) {
+    if (unsigned char* target = out.reserve(1))
+      target[0] =
+          static_cast<unsigned char>(initial | static_cast<int>(argument));
+  } else if constexpr (sizeof(Unsigned) == 1) {
+    write_argument<std::uint8_t>(out, initial | 24, argument);
+  } else if (argument <= std::numeric_limits<std::uint8_t>::max()) {
+    write_argument(out, initial | 24, static_cast<std::uint8_t>(argument));
+  } else if constexpr (sizeof(Unsigned) == 2) {
+    write_argument<std::uint16_t>(out, initial | 25, argument);
+  } else if (argument <= std::numeric_limits<std::uint16_t>::max()) {
+    write_argument(out, initial | 25, static_cast<std::uint16_t>(argument));
+  } else if constexpr (sizeof(Unsigned) == 4) {
+    write_argument<std::uint32_t>(out, initial | 26, argument);
+  } else if (argument <= std::numeric_limits<std::uint32_t>::max()) {
+    write_argument(out, initial | 26, static_cast<std::uint32_t>(argument));
+  } else {
+    write_argument<std::uint64_t>(out, initial | 27, argument);
+  }
+}
+
+template <class T>
+void encode_value(writer& out, const T& value) noexcept;
+
+template <class Container>
+void encode_string(writer& out, unsigned char major,
+                   const Container& string) noexcept {
+  write_head(out, major, string.size());
+  out.write(string.data(), string.size());
+}
+
+/** Members of CBOR_FIELDS structs are left out when they are empty optionals */
+template <class T>
+bool present(const T& member) noexcept {
+  if constexpr (is_optional<T>::value)
+    return member.has_value();
+  else
+    return true;
+}
+
+template <class T>
+void encode_fields(writer& out, const T& value) noexcept {
+  constexpr auto& names = field_names<T>;
+  std::apply(
+      [&](const auto&... member) {
+        write_head(out, 5, (std::size_t{0} + ... + present(member)));
+        std::size_t index = 0;
+        ((present(member) ? (encode_string(out, 3, names[index]),
+                             encode_value(out, member))
+                          : void(),
+          index++),
+         ...);
+      },
+      value._cbor_fields());
+}
+
+template <class T>
+void encode_value(writer& out, const T& value) noexcept {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (unsigned char* target = out.reserve(1))
+      target[0] = value ? 0xF5 : 0xF4;
+  } else if constexpr (std::is_enum_v<T>) {
+    encode_value(out, static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
+    write_head(out, 0, value);
+  } else if constexpr (std::is_integral_v<T>) {
+    using Unsigned = std::make_unsigned_t<T>;
+    if (value >= 0)
+      write_head(out, 0, static_cast<Unsigned>(value));
+    else
+      write_head(out, 1, static_cast<Unsigned>(-1 - value));
+  } else if constexpr (std::is_same_v<T, float>) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_argument(out, 0xFA, bits);
+  } else if constexpr (std::is_same_v<T, double>) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_argument(out, 0xFB, bits);
+  } else if constexpr (std::is_same_v<T, std::string> ||
+                       std::is_same_v<T, std::string_view>) {
+    encode_string(out, 3, value);
+  } else if constexpr (is_bytes<T>::value) {
+    encode_string(out, 2, value);
+  } else if constexpr (is_optional<T>::value) {
+    if (value) {
+      encode_value(out, *value);
+    } else if (unsigned char* target = out.reserve(1)) {
+      target[0] = 0xF6;
+    }
+  } else if constexpr (is_vector<T>::value || is_array<T>::value) {
+    write_head(out, 4, value.size());
+    for (const auto& item : value) encode_value(out, item);
+  } else if constexpr (is_map<T>::value) {
+    write_head(out, 5, value.size());
+    for (const auto& [key, item] : value) {
+      encode_value(out, key);
+      encode_value(out, item);
+    }
+  } else if constexpr (has_fields<T>::value) {
+    encode_fields(out, value);
+  } else {
+    static_assert(unsupported<T>,
+                  "The type cannot be encoded, register its members using "
+                  "CBOR_FIELDS");
+  }
+}
+
+/*
+ * ============================================================================
+ * Decoding
+ * ============================================================================
+ */
+
+struct reader {
+  cbor_data cursor;
+  cbor_data end;
+
+  std::size_t remaining() const noexcept {
+    return static_cast<std::size_t>(end - cursor);
+  }
+
+  /** Consume \p byte if it is next */
+  bool consume(unsigned char byte) noexcept {
+    if (cursor == end || *cursor != byte) return false;
+    cursor++;
+    return true;
+  }
+
+  /** Read the head of an item. The argument of indefinite items is 0. */
+  bool head(unsigned char& major, std::uint64_t& argument,
+            bool& indefinite) noexcept {
+    if (cursor == end) return false;
+    const std::uint8_t initial = *cursor;
+    const std::uint8_t info = initial & 0x1F;
+    const std::size_t size =
+        info < 24 || info == 31 ? 0 : std::size_t{1} << (info - 24);
+    if ((info >= 28 && info <= 30) || remaining() - 1 < size) return false;
+    major = initial >> 5;
+    indefinite = info == 31;
+    switch (size) {
+      case 0:
+        argument = indefinite ? 0 : info;
+        break;
+      case 1:
+        argument = cursor[1];
+        break;
+      case 2:
+        argument = cbor_load_uint16(cursor + 1);
+        break;
+      case 4:
+        argument = cbor_load_uint32(cursor + 1);
+        break;
+      default:
+        argument = cbor_load_uint64(cursor + 1);
+    }
+    cursor += 1 + size;
+    return true;
+  }
+
+  /** Read the head of a definite item of the given major type */
+  bool definite(unsigned char expected_major,
+                std::uint64_t& argument) noexcept {
+    unsigned char major;
+    bool indefinite;
+    return head(major, argument, indefinite) && major == expected_major &&
+           !indefinite;
+  }
+
+  /** Read the head of a container, or of a string split into chunks */
+  bool container(unsigned char expected_major, std::uint64_t& size,
+                 bool& indefinite) noexcept {
+    unsigned char major;
+    return head(major, size, indefinite) && major == expected_major;
+  }
+
+  /** Is there another item in the container? */
+  bool next(bool indefinite, std::uint64_t size, std::uint64_t read) noexcept {
+    return indefinite ? !consume(0xFF) : read < size;
+  }
+};
+
+template <class T>
+bool decode_value(reader& in, T& value);
+
+/** Decode a definite string or the chunks of an indefinite one */
+template <class Container>
+bool decode_string(reader& in, unsigned char major, Container& string) {
+  std::uint64_t length;
+  bool indefinite;
+  if (!in.container(major, length, indefinite)) return false;
+  string.clear();
+  do {
+    if (indefinite) {
+      if (in.consume(0xFF)) return true;
+      if (!in.definite(major, length)) return false;
+    }
+    if (length > in.remaining()) return false;
+    const auto* data = reinterpret_cast<const typename Container::value_type*>(
+        in.cursor);
+    string.insert(string.end(), data, data + length);
+    in.cursor += length;
+  } while (indefinite);
+  return true;
+}
+
+template <class Float>
+bool decode_float(reader& in, Float& value) noexcept {
+  if (in.remaining() < 3) return false;
+  if (*in.cursor == 0xF9) {
+    value = static_cast<Float>(cbor_load_half(in.cursor + 1));
+    in.cursor += 3;
+  } else if (*in.cursor == 0xFA && in.remaining() >= 5) {
+    float number;
+    const std::uint32_t bits = cbor_load_uint32(in.cursor + 1);
+    std::memcpy(&number, &bits, sizeof(number));
+    value = number;
+    in.cursor += 5;
+  } else if constexpr (std::is_same_v<Float, double>) {
+    // Doubles would lose precision as floats
+    if (*in.cursor != 0xFB || in.remaining() < 9) return false;
+    const std::uint64_t bits = cbor_load_uint64(in.cursor + 1);
+    std::memcpy(&value, &bits, sizeof(value));
+    in.cursor += 9;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <class Array>
+bool decode_array(reader& in, Array& value) {
+  std::uint64_t size;
+  bool indefinite;
+  if (!in.container(4, size, indefinite)) return false;
+  if constexpr (is_array<Array>::value) {
+    if (!indefinite && size != value.size()) return false;
+    for (auto& item : value)
+      if (!decode_value(in, item)) return false;
+    return !indefinite || in.consume(0xFF);
+  } else {
+    value.clear();
+    // Every item takes at least a byte, so the size cannot be arbitrarily
+    // large
+    if (!indefinite)
+      value.reserve(static_cast<std::size_t>(
+          std::min<std::uint64_t>(size, in.remaining())));
+    for (std::uint64_t read = 0; in.next(indefinite, size, read); read++) {
+      // Decoded separately for std::vector<bool>
+      typename Array::value_type item{};
+      if (!decode_value(in, item)) return false;
+      value.push_back(std::move(item));
+    }
+    return true;
+  }
+}
+
+template <class Map>
+bool decode_map(reader& in, Map& value) {
+  std::uint64_t size;
+  bool indefinite;
+  if (!in.container(5, size, indefinite)) return false;
+  value.clear();
+  for (std::uint64_t read = 0; in.next(indefinite, size, read); read++) {
+    typename Map::key_type key{};
+    typename Map::mapped_type item{};
+    if (!decode_value(in, key) || !decode_value(in, item)) return false;
+    // Duplicate keys are invalid
+    if (!value.emplace(std::move(key), std::move(item)).second) return false;
+  }
+  return true;
+}
+
+template <class T>
+void reset(T& member) noexcept {
+  if constexpr (is_optional<T>::value) member.reset();
+}
+
+template <class T>
+bool decode_fields(reader& in, T& value) {
+  constexpr std::size_t count = field_count<T>;
+  static_assert(count <= 64, "At most 64 members are supported");
+  constexpr auto& names = field_names<T>;
+  auto fields = value._cbor_fields();
+
+  // Members that are not optional must be present
+  std::uint64_t required = 0;
+  std::apply(
+      [&](auto&... member) {
+        std::size_t index = 0;
+        ((is_optional<std::decay_t<decltype(member)>>::value
+              ? reset(member)
+              : void(required |= std::uint64_t{1} << index),
+          index++),
+         ...);
+      },
+      fields);
+
+  std::uint64_t size;
+  bool indefinite;
+  if (!in.container(5, size, indefinite)) return false;
+  std::uint64_t seen = 0;
+  for (std::uint64_t read = 0; in.next(indefinite, size, read); read++) {
+    std::uint64_t length;
+    if (!in.definite(3, length) || length > in.remaining()) return false;
+    const std::string_view key(reinterpret_cast<const char*>(in.cursor),
+                               static_cast<std::size_t>(length));
+    in.cursor += length;
+    std::size_t index = 0;
+    while (index < count && names[index] != key) index++;
+    // Unknown and duplicate keys are invalid
+    if (index == count || (seen >> index) & 1) return false;
+    seen |= std::uint64_t{1} << index;
+    bool decoded = std::apply(
+        [&](auto&... field) {
+          std::size_t position = 0;
+          return ((position++ == index && decode_value(in, field)) || ...);
+        },
+        fields);
+    if (!decoded) return false;
+  }
+  return (seen & required) == required;
+}
+
+template <class T>
+bool decode_value(reader& in, T& value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (in.consume(0xF4))
+      value = false;
+    else if (in.consume(0xF5))
+      value = true;
+    else
+      return false;
+    return true;
+  } else if constexpr (std::is_enum_v<T>) {
+    std::underlying_type_t<T> number;
+    if (!decode_value(in, number)) return false;
+    value = static_cast<T>(number);
+    return true;
+  } else if constexpr (std::is_integral_v<T>) {
+    unsigned char major;
+    std::uint64_t argument;
+    bool indefinite;
+    if (!in.head(major, argument, indefinite) || indefinite) return false;
+    // Integers of up to 64 bits do not need range checks
+    if constexpr (std::is_unsigned_v<T>) {
+      if (major != 0) return false;
+      if constexpr (sizeof(T) < sizeof(std::uint64_t))
+        if (argument > std::numeric_limits<T>::max()) return false;
+      value = static_cast<T>(argument);
+    } else {
+      if (major > 1 ||
+          argument > static_cast<std::make_unsigned_t<T>>(
+                         std::numeric_limits<T>::max()))
+        return false;
+      value = major == 0 ? static_cast<T>(argument)
+                         : static_cast<T>(-1 - static_cast<T>(argument));
+    }
+    return true;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    static_assert(!std::is_same_v<T, long double>,
+                  "long double cannot be encoded");
+    return decode_float(in, value);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return decode_string(in, 3, value);
+  } else if constexpr (std::is_same_v<T, std::string_view>) {
+    // Points into the input, which can only be done for definite strings
+    std::uint64_t length;
+    if (!in.definite(3, length) || length > in.remaining()) return false;
+    value = std::string_view(reinterpret_cast<const char*>(in.cursor),
+                             static_cast<std::size_t>(length));
+    in.cursor += length;
+    return true;
+  } else if constexpr (is_bytes<T>::value && is_vector<T>::value) {
+    return decode_string(in, 2, value);
+  } else if constexpr (is_bytes<T>::value) {
+    std::uint64_t length;
+    if (!in.definite(2, length) || length != value.size() ||
+        length > in.remaining())
+      return false;
+    std::memcpy(value.data(), in.cursor, value.size());
+    in.cursor += length;
+    return true;
+  } else if constexpr (is_optional<T>::value) {
+    if (in.consume(0xF6)) {
+      value.reset();
+      return true;
+    }
+    return decode_value(in, value.emplace());
+  } else if constexpr (is_vector<T>::value || is_array<T>::value) {
+    return decode_array(in, value);
+  } else if constexpr (is_map<T>::value) {
+    return decode_map(in, value);
+  } else if constexpr (has_fields<T>::value) {
+    return decode_fields(in, value);
+  } else {
+    static_assert(unsupported<T>,
+                  "The type cannot be decoded, register its members using "
+                  "CBOR_FIELDS");
+    return false;
+  }
+}
+
+}  // namespace detail
+
+/** Compute the length of the encoding of a value
+ *
+ * @param value The value
+ * @return Length of the encoding in bytes
+ */
+template <class T>
+std::size_t encoded_size(const T& value) noexcept {
+  detail::writer out{nullptr, nullptr, 0};
+  detail::encode_value(out, value);
+  return out.size;
+}
+
+/** Encode a value into a buffer
+ *
+ * The encoding is specialized for the type at compile time and written
+ * directly into the buffer, no #cbor_item_t is built.
+ *
+ *  - `bool` is encoded as `true` or `false`
+ *  - Integers and enumerations are encoded as (negative) integers in the
+ *    shortest form
+ *  - `float` and `double` are encoded as single and double precision floats
+ *  - `std::string` and `std::string_view` are encoded as text strings,
+ *    `std::vector<std::byte>` and `std::array<std::byte, N>` as byte strings
+ *  - `std::vector` and `std::array` are encoded as arrays, `std::map` as a
+ *    map
+ *  - `std::optional` is encoded as `null` when empty
+ *  - Structs registered using #CBOR_FIELDS are encoded as maps
+ *
+ * @param value The value
+ * @param buffer The output buffer
+ * @param buffer_size Size of the output buffer
+ * @return Number of bytes written, 0 if the buffer is too small
+ */
+template <class T>
+std::size_t encode(const T& value, unsigned char* buffer,
+                   std::size_t buffer_size) noexcept {
+  detail::writer out{buffer, buffer + buffer_size, 0};
+  detail::encode_value(out, value);
+  return out.cursor == nullptr ? 0 : out.size;
+}
+
+/** Encode a value into a new vector
+ *
+ * @param value The value
+ * @return The encoding
+ */
+template <class T>
+std::vector<unsigned char> encode(const T& value) {
+  std::vector<unsigned char> buffer(encoded_size(value));
+  [[maybe_unused]] std::size_t written =
+      encode(value, buffer.data(), buffer.size());
+  CBOR_ASSERT(written == buffer.size());
+  return buffer;
+}
+
+/** Decode the first item in a buffer into a value
+ *
+ * The inverse of #encode. Integers out of the range of the type, floats wider
+ * than the type, and unknown, duplicate, or missing (unless optional) members
+ * of #CBOR_FIELDS structs are rejected. Both definite and indefinite items are
+ * accepted.
+ *
+ * Only the containers in \p value allocate memory, so e.g. decoding into a
+ * struct of numbers, `std::string_view`, and `std::array` does not allocate.
+ * `std::string_view` members point into \p source.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param[out] value The decoded value. Unspecified if decoding fails.
+ * @return Number of bytes read, 0 if the input does not encode a value of
+ *  the type
+ */
+template <class T>
+std::size_t decode(cbor_data source, std::size_t source_size, T& value) {
+  detail::reader in{source, source + source_size};
+  if (!detail::decode_value(in, value)) return 0;
+  return static_cast<std::size_t>(in.cursor - source);
+}
+
+/** Decode the first item in a buffer
+ *
+ * Like #decode(cbor_data, std::size_t, T&) for default constructible types.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @return The decoded value, empty if the input does not encode a value of
+ *  the type
+ */
+template <class T>
+std::optional<T> decode(cbor_data source, std::size_t source_size) {
+  std::optional<T> value(std::in_place);
+  if (decode(source, source_size, *value) == 0) value.reset();
+  return value;
+}
+
+}  // namespace cbor
+
+#endif  // LIBCBOR_CODEC_HPP
@@ -10,6 +10,11 @@
 #include "bytestrings.h"
 #include "data.h"
 #include "floats_ctrls.h"
+#include "internal/atomics.h"
+#include "internal/item_pool.h"
+#include "internal/memory_utils.h"
+#include "internal/size_cache.h"
+#include "internal/walker.h"
 #include "ints.h"
 #include "maps.h"
 #include "strings.h"
@@ -77,87 +82,169 @@ bool cbor_is_float(const cbor_item_t* item) {
   return cbor_isa_float_ctrl(item) && !cbor_float_ctrl_is_ctrl(item);
 }
 
+/* Reference count of frozen items. Never written after freezing, so readers
+ * sharing a frozen tree do not contend on its cache lines. */
+#define _CBOR_FROZEN_REFCOUNT SIZE_MAX
+
 cbor_item_t* cbor_incref(cbor_item_t* item) {
-  item->refcount++;
+  if (_CBOR_SHARED_LOAD(item->refcount) != _CBOR_FROZEN_REFCOUNT)
+    _CBOR_REFCOUNT_INCREMENT(item->refcount);
   return item;
 }
 
+/** Drop a reference to \p item
+ *
+ * @param frozen Whether \p item is a part of a frozen tree being released
+ * @return true if \p item should be deallocated
+ */
+static bool _cbor_release(cbor_item_t* item, bool frozen) {
+  // All items in a frozen tree are owned by the tree exclusively
+  if (frozen) return true;
+  size_t refcount = _CBOR_SHARED_LOAD(item->refcount);
+  CBOR_ASSERT(refcount > 0);
+  if (refcount == _CBOR_FROZEN_REFCOUNT) return false;
+  return _CBOR_REFCOUNT_DECREMENT(item->refcount) == 0;
+}
+
+/** Deallocate an item whose children have been released */
+static void _cbor_free_item(cbor_item_t* item) {
+  switch (item->type) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:
+    case CBOR_TYPE_FLOAT_CTRL:
+      /* Combined allocation, freeing the item suffices */
+      break;
+    case CBOR_TYPE_BYTESTRING:
+      if (cbor_bytestring_is_indefinite(item))
+        _CBOR_FREE(item->allocator,
+                   ((struct cbor_indefinite_string_data*)item->data)->chunks);
+      _CBOR_FREE(item->allocator, item->data);
+      break;
+    case CBOR_TYPE_STRING:
+      if (cbor_string_is_indefinite(item))
+        _CBOR_FREE(item->allocator,
+                   ((struct cbor_indefinite_string_data*)item->data)->chunks);
+      _CBOR_FREE(item->allocator, item->data);
+      break;
+    case CBOR_TYPE_ARRAY:
+    case CBOR_TYPE_MAP:
+    case CBOR_TYPE_TAG:
+      _CBOR_FREE(item->allocator, item->data);
+      break;
+  }
+  _cbor_item_free(item->allocator, item);
+}
+
+/** Deallocate \p item, which has no references left, and release its children
+ *
+ * Releasing cannot fail, so instead of a stack, the path back to the root is
+ * kept in the dying items themselves (pointer reversal): the reference count
+ * of a dying item holds the index of its next child, and the slot of the child
+ * being released holds the parent of the item.
+ */
+static void _cbor_destroy(cbor_item_t* item, bool frozen) {
+  cbor_item_t* parent = NULL;
+  item->refcount = 0;
+  while (true) {
+    cbor_item_t** slot = _cbor_child_slot(item, item->refcount);
+    if (slot != NULL) {
+      item->refcount++;
+      cbor_item_t* child = *slot;
+      if (child == NULL) continue;
+      // Unlinked before the release, the child may be freed by another owner
+      if (!frozen) _cbor_size_cache_unlink(item, child);
+      if (!_cbor_release(child, frozen)) continue;
+      *slot = parent;
+      parent = item;
+      item = child;
+      item->refcount = 0;
+      continue;
+    }
+
+    _cbor_free_item(item);
+    if (parent == NULL) return;
+    item = parent;
+    slot = _cbor_child_slot(item, item->refcount - 1);
+    parent = *slot;
+  }
+}
+
 void cbor_decref(cbor_item_t** item_ref) {
   cbor_item_t* item = *item_ref;
-  CBOR_ASSERT(item->refcount > 0);
-  if (--item->refcount == 0) {
-    switch (item->type) {
-      case CBOR_TYPE_UINT:
-        /* Fallthrough */
-      case CBOR_TYPE_NEGINT:
-        /* Combined allocation, freeing the item suffices */
-        { break; }
-      case CBOR_TYPE_BYTESTRING: {
-        if (cbor_bytestring_is_definite(item)) {
-          _cbor_free(item->data);
-        } else {
-          /* We need to decref all chunks */
-          cbor_item_t** handle = cbor_bytestring_chunks_handle(item);
-          for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++)
-            cbor_decref(&handle[i]);
-          _cbor_free(((struct cbor_indefinite_string_data*)item->data)->chunks);
-          _cbor_free(item->data);
-        }
-        break;
-      }
-      case CBOR_TYPE_STRING: {
-        if (cbor_string_is_definite(item)) {
-          _cbor_free(item->data);
-        } else {
-          /* We need to decref all chunks */
-          cbor_item_t** handle = cbor_string_chunks_handle(item);
-          for (size_t i = 0; i < cbor_string_chunk_count(item); i++)
-            cbor_decref(&handle[i]);
-          _cbor_free(((struct cbor_indefinite_string_data*)item->data)->chunks);
-          _cbor_free(item->data);
-        }
-        break;
-      }
-      case CBOR_TYPE_ARRAY: {
-        /* Get all items and decref them */
-        cbor_item_t** handle = cbor_array_handle(item);
-        size_t size = cbor_array_size(item);
-        for (size_t i = 0; i < size; i++)
-          if (handle[i] != NULL) cbor_decref(&handle[i]);
-        _cbor_free(item->data);
-        break;
-      }
-      case CBOR_TYPE_MAP: {
-        struct cbor_pair* handle = cbor_map_handle(item);
-        for (size_t i = 0; i < item->metadata.map_metadata.end_ptr;
-             i++, handle++) {
-          cbor_decref(&handle->key);
-          if (handle->value != NULL) cbor_decref(&handle->value);
-        }
-        _cbor_free(item->data);
-        break;
-      }
-      case CBOR_TYPE_TAG: {
-        if (item->metadata.tag_metadata.tagged_item != NULL)
-          cbor_decref(&item->metadata.tag_metadata.tagged_item);
-        _cbor_free(item->data);
-        break;
+  if (!_cbor_release(item, false)) return;
+  _cbor_destroy(item, false);
+  *item_ref = NULL;
+}
+
+void cbor_intermediate_decref(cbor_item_t* item) { cbor_decref(&item); }
+
+size_t cbor_refcount(const cbor_item_t* item) {
+  return _CBOR_SHARED_LOAD(item->refcount);
+}
+
+cbor_item_t* cbor_move(cbor_item_t* item) {
+  if (_CBOR_SHARED_LOAD(item->refcount) != _CBOR_FROZEN_REFCOUNT)
+    _CBOR_REFCOUNT_DECREMENT(item->refcount);
+  return item;
+}
+
+/** Check that all items in the tree have the given reference count or, if
+ * \p assign is set, set it
+ *
+ * @return false if an item has a different reference count, or if \p walk
+ *  could not be extended
+ */
+static bool _cbor_tree_refcount(struct _cbor_walk* walk, cbor_item_t* item,
+                                size_t refcount, bool assign) {
+  cbor_item_t* next = item;
+  while (true) {
+    if (next != NULL) {
+      if (assign) {
+        next->refcount = refcount;
+      } else if (next->refcount != refcount) {
+        _cbor_walk_clear(walk);
+        return false;
       }
-      case CBOR_TYPE_FLOAT_CTRL: {
-        /* Floats have combined allocation */
-        break;
+      if (_cbor_child_slot(next, 0) != NULL &&
+          _cbor_walk_push(walk, next) == NULL) {
+        _cbor_walk_clear(walk);
+        return false;
       }
     }
-    _cbor_free(item);
-    *item_ref = NULL;
+    if (walk->depth == 0) return true;
+    while (!_cbor_walk_next(_cbor_walk_top(walk), &next)) {
+      _cbor_walk_pop(walk);
+      if (walk->depth == 0) return true;
+    }
   }
 }
 
-void cbor_intermediate_decref(cbor_item_t* item) { cbor_decref(&item); }
+bool cbor_freeze(cbor_item_t* item) {
+  if (cbor_is_frozen(item)) return true;
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  // An item referenced from outside the tree (or twice within it) could be
+  // released by cbor_frozen_release while still in use
+  bool exclusive = _cbor_tree_refcount(&walk, item, 1, false);
+  if (exclusive) {
+    // The first walk has grown the stack enough for the whole tree, so the
+    // following ones cannot fail. The cached sizes are final, see
+    // _cbor_cached_serialized_size.
+    size_t size _CBOR_UNUSED = _cbor_serialized_size_walk(&walk, item);
+    const bool frozen _CBOR_UNUSED =
+        _cbor_tree_refcount(&walk, item, _CBOR_FROZEN_REFCOUNT, true);
+    CBOR_ASSERT(frozen);
+  }
+  _cbor_walk_free(&walk);
+  return exclusive;
+}
 
-size_t cbor_refcount(const cbor_item_t* item) { return item->refcount; }
+bool cbor_is_frozen(const cbor_item_t* item) {
+  return _CBOR_SHARED_LOAD(item->refcount) == _CBOR_FROZEN_REFCOUNT;
+}
 
-cbor_item_t* cbor_move(cbor_item_t* item) {
-  item->refcount--;
-  return item;
+void cbor_frozen_release(cbor_item_t** item) {
+  CBOR_ASSERT(cbor_is_frozen(*item));
+  _cbor_destroy(*item, true);
+  *item = NULL;
 }
@@ -123,15 +123,6 @@ CBOR_EXPORT extern _cbor_free_t _cbor_free;
     }                            \
   } while (0)
 
-// Macro to short-circuit builders when memory allocation of nested data fails
-#define _CBOR_DEPENDENT_NOTNULL(cbor_item, pointer) \
-  do {                                              \
-    if (pointer == NULL) {                          \
-      _cbor_free(cbor_item);                        \
-      return NULL;                                  \
-    }                                               \
-  } while (0)
-
 /** Sets the memory management routines to use.
  *
  * By default, libcbor will use the standard library `malloc`, `realloc`, and
@@ -156,6 +147,43 @@ CBOR_EXPORT void cbor_set_allocs(_cbor_malloc_t custom_malloc,
                                  _cbor_realloc_t custom_realloc,
                                  _cbor_free_t custom_free);
 
+/** Sets the allocator for items created by the current thread.
+ *
+ * All items created by the calling thread, e.g. by the `cbor_new_*` and
+ * `cbor_build_*` functions or by decoding, will use \p allocator. Operations
+ * on existing items, including #cbor_decref, always use the allocator the
+ * item was created with, regardless of the thread allocator.
+ *
+ * \rst
+ * .. warning:: The allocator structure is referenced, not copied. It must
+ *  outlive all items created with it.
+ * \endrst
+ *
+ * @param allocator The allocator to use. `NULL` restores the global memory
+ * management routines (see #cbor_set_allocs).
+ * @return The previous thread allocator, so that it can be restored
+ */
+CBOR_EXPORT const struct cbor_allocator* cbor_set_thread_allocator(
+    const struct cbor_allocator* allocator);
+
+/** Gets the allocator for items created by the current thread.
+ *
+ * @return The allocator set by #cbor_set_thread_allocator, `NULL` if the global
+ * memory management routines are used
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT const struct cbor_allocator* cbor_thread_allocator(void);
+
+/** Gets the allocator that owns an item.
+ *
+ * @param item An item
+ * @return The allocator the item was created with, `NULL` if it uses the
+ * global memory management routines
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT const struct cbor_allocator* cbor_item_allocator(
+    const cbor_item_t* item);
+
 /*
  * ============================================================================
  * Type manipulation
@@ -291,6 +319,9 @@ CBOR_EXPORT bool cbor_is_undef(const cbor_item_t* item);
  *
  * This function can be used to extend reference counting to client code.
  *
+ * Atomic if libcbor was built with `CBOR_ATOMIC_REFCOUNT`, so that several
+ * threads can hold references to the same item.
+ *
  * @param item Reference to an item
  * @return The input \p item
  */
@@ -323,7 +354,8 @@ CBOR_EXPORT void cbor_intermediate_decref(cbor_item_t* item);
  * @todo Add some inline examples for reference counting
  *
  * @param item the item
- * @return the reference count
+ * @return the reference count, `SIZE_MAX` for frozen items (see
+ *  #cbor_freeze)
  */
 _CBOR_NODISCARD
 CBOR_EXPORT size_t cbor_refcount(const cbor_item_t* item);
@@ -346,6 +378,48 @@ CBOR_EXPORT size_t cbor_refcount(const cbor_item_t* item);
 _CBOR_NODISCARD
 CBOR_EXPORT cbor_item_t* cbor_move(cbor_item_t* item);
 
+/** Make a tree immutable and exempt from reference counting
+ *
+ * Marks \p item and all items nested in it as frozen. #cbor_incref,
+ * #cbor_decref, and #cbor_move have no effect on frozen items, so a frozen tree
+ * can be read from any number of threads concurrently without any writes to
+ * it. Mutators that can fail (e.g. #cbor_array_push) reject frozen items, the
+ * other ones must not be called on them.
+ *
+ * The tree must be owned exclusively by the caller, i.e. every item in it has a
+ * reference count of one. Frozen trees are released using
+ * #cbor_frozen_release.
+ *
+ * Linear complexity. Also memoizes #cbor_serialized_size of all nested
+ * containers.
+ *
+ * @param item The root of the tree
+ * @return true on success or if the tree is frozen already. false if an item in
+ *  the tree is referenced from elsewhere, in which case nothing is changed.
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT bool cbor_freeze(cbor_item_t* item);
+
+/** Is the item frozen?
+ *
+ * @param item the item
+ * @return true if \p item is a part of a tree frozen by #cbor_freeze
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT bool cbor_is_frozen(const cbor_item_t* item);
+
+/** Deallocate a frozen tree
+ *
+ * \rst
+ * .. warning:: The tree must not be in use by any other thread, and must not
+ *  be referenced from any non-frozen item.
+ * \endrst
+ *
+ * @param item Reference to the root of a tree frozen by #cbor_freeze. Will be
+ *  set to `NULL`.
+ */
+CBOR_EXPORT void cbor_frozen_release(cbor_item_t** item);
+
 #ifdef __cplusplus
 }
 #endif
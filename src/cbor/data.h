@@ -51,7 +51,8 @@ typedef enum {
   CBOR_ERR_MEMERROR /** Memory error - item allocation failed. Is it too big for
                        your allocator? */
   ,
-  CBOR_ERR_SYNTAXERROR /** Stack parsing algorithm failed */
+  CBOR_ERR_SYNTAXERROR, /** Stack parsing algorithm failed */
+  CBOR_ERR_IO /** The input file could not be opened or read */
 } cbor_error_code;
 
 /** Possible widths of #CBOR_TYPE_UINT items */
@@ -93,6 +94,14 @@ typedef enum {
 // uint64_t, we wouldn't be able to create them in the first place and can save
 // some space.
 
+/** Memoized #cbor_serialized_size of containers and tags */
+struct _cbor_size_cache {
+  size_t size;
+  /** Generation in which #size was computed, 0 if never or if a nested item
+   * has been modified since */
+  size_t generation;
+};
+
 /** Integers specific metadata */
 struct _cbor_int_metadata {
   cbor_int_width width;
@@ -117,6 +126,7 @@ struct _cbor_array_metadata {
   size_t allocated;
   size_t end_ptr;
   _cbor_dst_metadata type;
+  struct _cbor_size_cache size_cache;
 };
 
 /** Maps specific metadata */
@@ -124,6 +134,7 @@ struct _cbor_map_metadata {
   size_t allocated;
   size_t end_ptr;
   _cbor_dst_metadata type;
+  struct _cbor_size_cache size_cache;
 };
 
 /** Arrays specific metadata
@@ -135,6 +146,7 @@ struct _cbor_map_metadata {
 struct _cbor_tag_metadata {
   struct cbor_item_t* tagged_item;
   uint64_t value;
+  struct _cbor_size_cache size_cache;
 };
 
 /** Floats specific metadata - includes CTRL values */
@@ -167,6 +179,24 @@ union cbor_item_metadata {
   struct _cbor_float_ctrl_metadata float_ctrl_metadata;
 };
 
+/** Memory management routines bound to a user-provided context
+ *
+ * Unlike the global hooks set by #cbor_set_allocs, allocators are selected per
+ * thread (#cbor_set_thread_allocator) or per call (e.g.
+ * #cbor_load_with_allocator), and every item remembers the allocator it was
+ * created with.
+ */
+struct cbor_allocator {
+  /** `malloc` equivalent */
+  void* (*allocate)(void* context, size_t size);
+  /** `realloc` equivalent, must support `NULL` reallocation */
+  void* (*reallocate)(void* context, void* pointer, size_t size);
+  /** `free` equivalent, must accept `NULL` */
+  void (*deallocate)(void* context, void* pointer);
+  /** Passed to the routines above */
+  void* context;
+};
+
 /** The item handle */
 typedef struct cbor_item_t {
   /** Discriminated by type */
@@ -177,6 +207,12 @@ typedef struct cbor_item_t {
   cbor_type type;
   /** Raw data block - interpretation depends on metadata */
   unsigned char* data;
+  /** Allocator that owns the item and its data, `NULL` for the global hooks
+   */
+  const struct cbor_allocator* allocator;
+  /** Container the item has been added to, the item itself if there are
+   * several, `NULL` if none. Used to invalidate memoized sizes. */
+  struct cbor_item_t* parent;
 } cbor_item_t;
 
 /** Defines cbor_item_t#data structure for indefinite strings and bytestrings
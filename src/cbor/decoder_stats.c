@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// clock_gettime
+#define _POSIX_C_SOURCE 199309L
+
+#include "decoder_stats.h"
+
+#include <string.h>
+
+#include "internal/atomics.h"
+#include "internal/instrumentation.h"
+
+#if CBOR_DECODER_STATS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static struct cbor_decoder_stats _cbor_decoder_stats;
+
+/*
+ * The probes run on every decoded item, possibly from several threads, so the
+ * counters are updated with relaxed atomic operations instead of a lock. With
+ * compilers that have no atomics, concurrent decoding may lose updates.
+ */
+
+static void _cbor_decoder_stats_max(size_t* counter, size_t value) {
+  size_t current = _CBOR_ATOMIC_LOAD(*counter);
+  while (current < value && !_CBOR_ATOMIC_CAS(*counter, current, value)) {
+  }
+}
+
+static void _cbor_decoder_stats_max64(uint64_t* counter, uint64_t value) {
+  uint64_t current = _CBOR_ATOMIC64_LOAD(*counter);
+  while (current < value && !_CBOR_ATOMIC64_CAS(*counter, current, value)) {
+  }
+}
+
+void _cbor_decoder_stats_item(uint8_t initial_byte, size_t read) {
+  _CBOR_ATOMIC_ADD(_cbor_decoder_stats.items[initial_byte >> 5], 1);
+  _CBOR_ATOMIC_ADD(_cbor_decoder_stats.bytes, read);
+}
+
+uint64_t _cbor_decoder_stats_now_ns(void) {
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void _cbor_decoder_stats_load(bool failed, size_t max_depth,
+                              uint64_t start_ns) {
+  uint64_t duration = _cbor_decoder_stats_now_ns() - start_ns;
+  _CBOR_ATOMIC_ADD(_cbor_decoder_stats.loads, 1);
+  if (failed) _CBOR_ATOMIC_ADD(_cbor_decoder_stats.failed_loads, 1);
+  _cbor_decoder_stats_max(&_cbor_decoder_stats.max_depth, max_depth);
+  _CBOR_ATOMIC64_ADD(_cbor_decoder_stats.load_time_ns, duration);
+  _cbor_decoder_stats_max64(&_cbor_decoder_stats.max_load_time_ns, duration);
+  _CBOR_ATOMIC64_STORE(_cbor_decoder_stats.last_load_time_ns, duration);
+}
+
+bool cbor_decoder_stats_get(struct cbor_decoder_stats* stats) {
+  for (size_t i = 0; i < 8; i++)
+    stats->items[i] = _CBOR_ATOMIC_LOAD(_cbor_decoder_stats.items[i]);
+  stats->bytes = _CBOR_ATOMIC_LOAD(_cbor_decoder_stats.bytes);
+  stats->loads = _CBOR_ATOMIC_LOAD(_cbor_decoder_stats.loads);
+  stats->failed_loads = _CBOR_ATOMIC_LOAD(_cbor_decoder_stats.failed_loads);
+  stats->max_depth = _CBOR_ATOMIC_LOAD(_cbor_decoder_stats.max_depth);
+  stats->load_time_ns = _CBOR_ATOMIC64_LOAD(_cbor_decoder_stats.load_time_ns);
+  stats->max_load_time_ns =
+      _CBOR_ATOMIC64_LOAD(_cbor_decoder_stats.max_load_time_ns);
+  stats->last_load_time_ns =
+      _CBOR_ATOMIC64_LOAD(_cbor_decoder_stats.last_load_time_ns);
+  return true;
+}
+
+void cbor_decoder_stats_reset(void) {
+  for (size_t i = 0; i < 8; i++)
+    _CBOR_ATOMIC_STORE(_cbor_decoder_stats.items[i], 0);
+  _CBOR_ATOMIC_STORE(_cbor_decoder_stats.bytes, 0);
+  _CBOR_ATOMIC_STORE(_cbor_decoder_stats.loads, 0);
+  _CBOR_ATOMIC_STORE(_cbor_decoder_stats.failed_loads, 0);
+  _CBOR_ATOMIC_STORE(_cbor_decoder_stats.max_depth, 0);
+  _CBOR_ATOMIC64_STORE(_cbor_decoder_stats.load_time_ns, 0);
+  _CBOR_ATOMIC64_STORE(_cbor_decoder_stats.max_load_time_ns, 0);
+  _CBOR_ATOMIC64_STORE(_cbor_decoder_stats.last_load_time_ns, 0);
+}
+
+#else
+
+bool cbor_decoder_stats_get(struct cbor_decoder_stats* stats) {
+  memset(stats, 0, sizeof(struct cbor_decoder_stats));
+  return false;
+}
+
+void cbor_decoder_stats_reset(void) {}
+
+#endif  // CBOR_DECODER_STATS
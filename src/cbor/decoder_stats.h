@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_DECODER_STATS_H
+#define LIBCBOR_DECODER_STATS_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Decoder instrumentation
+ * ============================================================================
+ */
+
+/** Decoder counters, see #cbor_decoder_stats_get */
+struct cbor_decoder_stats {
+  /** Item headers decoded by #cbor_stream_decode, indexed by #cbor_type.
+   * Indefinite item breaks are counted as #CBOR_TYPE_FLOAT_CTRL. */
+  size_t items[8];
+  /** Bytes consumed by #cbor_stream_decode */
+  size_t bytes;
+  /** Number of #cbor_load calls */
+  size_t loads;
+  /** Number of #cbor_load calls that failed */
+  size_t failed_loads;
+  /** Maximum nesting depth reached by #cbor_load */
+  size_t max_depth;
+  /** Total time spent in #cbor_load, in nanoseconds */
+  uint64_t load_time_ns;
+  /** Duration of the slowest #cbor_load call, in nanoseconds */
+  uint64_t max_load_time_ns;
+  /** Duration of the most recent #cbor_load call, in nanoseconds */
+  uint64_t last_load_time_ns;
+};
+
+/** Get a snapshot of the decoder counters
+ *
+ * Counters are only collected when libcbor is built with
+ * `CBOR_DECODER_STATS` (see #CBOR_DECODER_STATS), otherwise \p stats is
+ * zeroed. The counters are global and shared by all threads; individual fields
+ * are updated atomically, but the snapshot as a whole is not.
+ *
+ * @param[out] stats The counters
+ * @return `true` if counters are available, `false` if they were compiled out
+ */
+CBOR_EXPORT bool cbor_decoder_stats_get(struct cbor_decoder_stats* stats);
+
+/** Reset all decoder counters to zero */
+CBOR_EXPORT void cbor_decoder_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_DECODER_STATS_H
@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "diag.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "arrays.h"
+#include "bytestrings.h"
+#include "callbacks.h"
+#include "floats_ctrls.h"
+#include "internal/formatting.h"
+#include "internal/json_kernels.h"
+#include "internal/memory_utils.h"
+#include "internal/walker.h"
+#include "ints.h"
+#include "maps.h"
+#include "streaming.h"
+#include "strings.h"
+#include "tags.h"
+
+/** Number of frames that do not require a heap allocation */
+#define _CBOR_DIAG_INLINE_DEPTH 16
+
+enum _cbor_diag_frame_type {
+  _CBOR_DIAG_ARRAY,
+  _CBOR_DIAG_MAP,
+  _CBOR_DIAG_TAG,
+  _CBOR_DIAG_BYTESTRING,
+  _CBOR_DIAG_STRING
+};
+
+/** An open item. (Byte) strings are open while their chunks are decoded. */
+struct _cbor_diag_frame {
+  enum _cbor_diag_frame_type type;
+  bool indefinite;
+  /** Number of items (pairs for maps) of definite containers */
+  uint64_t size;
+  /** Number of items (keys and values for maps) or chunks so far */
+  uint64_t items;
+};
+
+struct _cbor_diag_context {
+  struct cbor_diag_options options;
+  char* buffer;
+  /** Space in #buffer, excluding the terminating NUL */
+  size_t capacity;
+  size_t length;
+  /** Some output did not fit, so the conversion stops */
+  bool full;
+  bool truncated;
+  /** Stack of open items, innermost last. Either #inline_frames, or a heap
+   * allocation once they run out. */
+  struct _cbor_diag_frame* frames;
+  size_t depth;
+  size_t frames_capacity;
+  const struct cbor_allocator* allocator;
+  /** Depth of the outermost container shown as `[...]`, zero if none. Its
+   * nested items are decoded without any output in the meantime. */
+  size_t elided_depth;
+  /** The top-level item has been converted */
+  bool finished;
+  cbor_diag_error_code error;
+  struct _cbor_diag_frame inline_frames[_CBOR_DIAG_INLINE_DEPTH];
+};
+
+static void _cbor_diag_fail(struct _cbor_diag_context* context,
+                            cbor_diag_error_code error) {
+  if (context->error == CBOR_DIAG_ERR_NONE) context->error = error;
+}
+
+/** Can the conversion continue? */
+static bool _cbor_diag_active(struct _cbor_diag_context* context) {
+  return context->error == CBOR_DIAG_ERR_NONE && !context->full;
+}
+
+static void _cbor_diag_raw(struct _cbor_diag_context* context,
+                           const void* data, size_t length) {
+  if (context->full) return;
+  size_t space = context->capacity - context->length;
+  if (length > space) {
+    length = space;
+    context->full = true;
+    context->truncated = true;
+  }
+  memcpy(context->buffer + context->length, data, length);
+  context->length += length;
+}
+
+#define _CBOR_DIAG_LITERAL(context, literal) \
+  _cbor_diag_raw(context, literal, sizeof(literal) - 1)
+
+/** Terminate the output, marking it with `...` if it did not fit */
+static void _cbor_diag_finish(struct _cbor_diag_context* context,
+                              size_t buffer_size) {
+  if (buffer_size == 0) return;
+  if (context->full) {
+    size_t marker = context->capacity < 3 ? context->capacity : 3;
+    size_t cut = context->capacity - marker;
+    // Do not leave a partial UTF-8 sequence before the marker
+    while (cut > 0 && ((unsigned char)context->buffer[cut] & 0xC0) == 0x80)
+      cut--;
+    memcpy(context->buffer + cut, "...", marker);
+    context->length = cut + marker;
+  }
+  context->buffer[context->length] = '\0';
+}
+
+static struct _cbor_diag_frame* _cbor_diag_top(
+    struct _cbor_diag_context* context) {
+  return context->depth == 0 ? NULL : &context->frames[context->depth - 1];
+}
+
+static bool _cbor_diag_in_string(struct _cbor_diag_context* context) {
+  struct _cbor_diag_frame* frame = _cbor_diag_top(context);
+  return frame != NULL && (frame->type == _CBOR_DIAG_BYTESTRING ||
+                           frame->type == _CBOR_DIAG_STRING);
+}
+
+static void _cbor_diag_push(struct _cbor_diag_context* context,
+                            enum _cbor_diag_frame_type type, bool indefinite,
+                            uint64_t size) {
+  if (context->depth == context->frames_capacity) {
+    if (context->frames_capacity >= CBOR_MAX_STACK_SIZE) {
+      _cbor_diag_fail(context, CBOR_DIAG_ERR_MEMERROR);
+      return;
+    }
+    size_t capacity = context->frames_capacity * 2;
+    if (capacity > CBOR_MAX_STACK_SIZE) capacity = CBOR_MAX_STACK_SIZE;
+    struct _cbor_diag_frame* frames;
+    if (context->frames == context->inline_frames) {
+      frames = _CBOR_MALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                            capacity * sizeof(struct _cbor_diag_frame));
+      if (frames != NULL)
+        memcpy(frames, context->frames,
+               context->depth * sizeof(struct _cbor_diag_frame));
+    } else {
+      frames = _CBOR_REALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                             context->frames,
+                             capacity * sizeof(struct _cbor_diag_frame));
+    }
+    if (frames == NULL) {
+      _cbor_diag_fail(context, CBOR_DIAG_ERR_MEMERROR);
+      return;
+    }
+    context->frames = frames;
+    context->frames_capacity = capacity;
+  }
+  context->frames[context->depth++] = (struct _cbor_diag_frame){
+      .type = type, .indefinite = indefinite, .size = size, .items = 0};
+}
+
+/** Output the closing of the top item and pop it */
+static void _cbor_diag_close(struct _cbor_diag_context* context) {
+  struct _cbor_diag_frame* frame = _cbor_diag_top(context);
+  if (context->elided_depth == 0 || context->elided_depth == context->depth) {
+    switch (frame->type) {
+      case _CBOR_DIAG_ARRAY:
+        _CBOR_DIAG_LITERAL(context, "]");
+        break;
+      case _CBOR_DIAG_MAP:
+        _CBOR_DIAG_LITERAL(context, "}");
+        break;
+      case _CBOR_DIAG_TAG:
+        _CBOR_DIAG_LITERAL(context, ")");
+        break;
+      case _CBOR_DIAG_BYTESTRING:
+        if (frame->items == 0)
+          _CBOR_DIAG_LITERAL(context, "''_");
+        else
+          _CBOR_DIAG_LITERAL(context, ")");
+        break;
+      case _CBOR_DIAG_STRING:
+        if (frame->items == 0)
+          _CBOR_DIAG_LITERAL(context, "\"\"_");
+        else
+          _CBOR_DIAG_LITERAL(context, ")");
+        break;
+    }
+  }
+  if (context->elided_depth == context->depth) context->elided_depth = 0;
+  context->depth--;
+}
+
+/** Output the separator preceding an item
+ *
+ * @return Whether the item is to be shown
+ */
+static bool _cbor_diag_begin_item(struct _cbor_diag_context* context) {
+  if (!_cbor_diag_active(context)) return false;
+  if (_cbor_diag_in_string(context)) {
+    // Only chunks of the same type may appear in an indefinite string
+    _cbor_diag_fail(context, CBOR_DIAG_ERR_MALFORMED);
+    return false;
+  }
+  if (context->elided_depth != 0) return false;
+  struct _cbor_diag_frame* frame = _cbor_diag_top(context);
+  if (frame != NULL && frame->items > 0) {
+    if (frame->type == _CBOR_DIAG_MAP && frame->items % 2 == 1)
+      _CBOR_DIAG_LITERAL(context, ": ");
+    else
+      _CBOR_DIAG_LITERAL(context, ", ");
+  }
+  return _cbor_diag_active(context);
+}
+
+/** Account for a converted item, closing the containers it completes */
+static void _cbor_diag_end_item(struct _cbor_diag_context* context) {
+  while (_cbor_diag_active(context)) {
+    struct _cbor_diag_frame* frame = _cbor_diag_top(context);
+    if (frame == NULL) {
+      context->finished = true;
+      return;
+    }
+    frame->items++;
+    if (frame->indefinite) return;
+    switch (frame->type) {
+      case _CBOR_DIAG_ARRAY:
+        if (frame->items < frame->size) return;
+        break;
+      case _CBOR_DIAG_MAP:
+        if (frame->items % 2 == 1 || frame->items / 2 < frame->size) return;
+        break;
+      case _CBOR_DIAG_TAG:
+        break;
+      default:
+        // Strings are closed by #_cbor_diag_indef_break
+        _CBOR_UNREACHABLE;
+    }
+    _cbor_diag_close(context);
+  }
+}
+
+/** Start an array, a map, or a tag
+ *
+ * @param context The conversion context
+ * @param type The container type
+ * @param indefinite Whether the container is indefinite
+ * @param size Number of items (pairs for maps) of definite containers
+ * @param opening The opening of the container, e.g. `[_ ` or `1(`
+ * @param opening_length Length of \p opening
+ */
+static void _cbor_diag_open(struct _cbor_diag_context* context,
+                            enum _cbor_diag_frame_type type, bool indefinite,
+                            uint64_t size, const char* opening,
+                            size_t opening_length) {
+  bool shown = _cbor_diag_begin_item(context);
+  if (!_cbor_diag_active(context)) return;
+  if (shown) _cbor_diag_raw(context, opening, opening_length);
+  if (!indefinite && size == 0) {
+    if (shown && type == _CBOR_DIAG_MAP)
+      _CBOR_DIAG_LITERAL(context, "}");
+    else if (shown)
+      _CBOR_DIAG_LITERAL(context, "]");
+    _cbor_diag_end_item(context);
+    return;
+  }
+  bool elided = shown && context->options.max_depth != 0 &&
+                context->depth >= context->options.max_depth;
+  if (elided) {
+    _CBOR_DIAG_LITERAL(context, "...");
+    context->truncated = true;
+  }
+  _cbor_diag_push(context, type, indefinite, size);
+  if (elided) context->elided_depth = context->depth;
+}
+
+static void _cbor_diag_uint(void* context, uint64_t value) {
+  if (_cbor_diag_begin_item(context)) {
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* start = _cbor_format_uint(value, end);
+    _cbor_diag_raw(context, start, (size_t)(end - start));
+  }
+  _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_negint(void* context, uint64_t value) {
+  if (_cbor_diag_begin_item(context)) {
+    if (value == UINT64_MAX) {
+      _CBOR_DIAG_LITERAL(context, "-18446744073709551616");
+    } else {
+      char digits[21];
+      char* end = digits + sizeof(digits);
+      char* start = _cbor_format_uint(value + 1, end);
+      *--start = '-';
+      _cbor_diag_raw(context, start, (size_t)(end - start));
+    }
+  }
+  _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_uint8(void* context, uint8_t value) {
+  _cbor_diag_uint(context, value);
+}
+
+static void _cbor_diag_uint16(void* context, uint16_t value) {
+  _cbor_diag_uint(context, value);
+}
+
+static void _cbor_diag_uint32(void* context, uint32_t value) {
+  _cbor_diag_uint(context, value);
+}
+
+static void _cbor_diag_negint8(void* context, uint8_t value) {
+  _cbor_diag_negint(context, value);
+}
+
+static void _cbor_diag_negint16(void* context, uint16_t value) {
+  _cbor_diag_negint(context, value);
+}
+
+static void _cbor_diag_negint32(void* context, uint32_t value) {
+  _cbor_diag_negint(context, value);
+}
+
+/**
+ * @param context The conversion context
+ * @param value The value
+ * @param single Whether \p value is a single (or half) precision float
+ */
+static void _cbor_diag_number(struct _cbor_diag_context* context,
+                              double value, bool single) {
+  if (_cbor_diag_begin_item(context)) {
+    if (isnan(value)) {
+      _CBOR_DIAG_LITERAL(context, "NaN");
+    } else if (isinf(value)) {
+      if (value > 0)
+        _CBOR_DIAG_LITERAL(context, "Infinity");
+      else
+        _CBOR_DIAG_LITERAL(context, "-Infinity");
+    } else {
+      char digits[_CBOR_FLOAT_FORMAT_SIZE];
+      _cbor_diag_raw(context, digits,
+                     _cbor_format_float(value, single, digits));
+    }
+  }
+  _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_float(void* context, float value) {
+  _cbor_diag_number(context, value, true);
+}
+
+static void _cbor_diag_double(void* context, double value) {
+  _cbor_diag_number(context, value, false);
+}
+
+/** Get the number of bytes of a (byte) string to show
+ *
+ * @param context The conversion context
+ * @param data The contents
+ * @param length Length of \p data
+ * @param text Whether \p data is UTF-8, which is only cut between code points
+ */
+static size_t _cbor_diag_shown_length(struct _cbor_diag_context* context,
+                                      cbor_data data, size_t length,
+                                      bool text) {
+  size_t limit = context->options.max_string_length;
+  if (limit == 0 || length <= limit) return length;
+  context->truncated = true;
+  if (text)
+    while (limit > 0 && (data[limit] & 0xC0) == 0x80) limit--;
+  return limit;
+}
+
+static void _cbor_diag_hex(struct _cbor_diag_context* context, cbor_data data,
+                           size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  size_t shown = _cbor_diag_shown_length(context, data, length, false);
+  char output[256];
+  _CBOR_DIAG_LITERAL(context, "h'");
+  for (size_t i = 0; i < shown && _cbor_diag_active(context);) {
+    size_t output_length = 0;
+    for (; i < shown && output_length < sizeof(output); i++) {
+      output[output_length++] = hex[data[i] >> 4];
+      output[output_length++] = hex[data[i] & 0x0F];
+    }
+    _cbor_diag_raw(context, output, output_length);
+  }
+  _CBOR_DIAG_LITERAL(context, "'");
+  if (shown < length) _CBOR_DIAG_LITERAL(context, "...");
+}
+
+static void _cbor_diag_text(struct _cbor_diag_context* context,
+                            cbor_data data, size_t length) {
+  size_t shown = _cbor_diag_shown_length(context, data, length, true);
+  _CBOR_DIAG_LITERAL(context, "\"");
+  for (size_t i = 0; i < shown && _cbor_diag_active(context);) {
+    size_t plain = _cbor_json_plain_prefix(data + i, shown - i);
+    _cbor_diag_raw(context, data + i, plain);
+    i += plain;
+    if (i == shown) break;
+    char sequence[6];
+    _cbor_diag_raw(context, sequence,
+                   _cbor_json_escape_sequence(data[i++], sequence));
+  }
+  _CBOR_DIAG_LITERAL(context, "\"");
+  if (shown < length) _CBOR_DIAG_LITERAL(context, "...");
+}
+
+/** Output a definite (byte) string, or a chunk of an indefinite one */
+static void _cbor_diag_string_item(struct _cbor_diag_context* context,
+                                   enum _cbor_diag_frame_type type,
+                                   cbor_data data, uint64_t length) {
+  struct _cbor_diag_frame* frame = _cbor_diag_top(context);
+  bool chunk = _cbor_diag_in_string(context);
+  if (chunk) {
+    if (!_cbor_diag_active(context)) return;
+    if (frame->type != type) {
+      _cbor_diag_fail(context, CBOR_DIAG_ERR_MALFORMED);
+      return;
+    }
+    if (context->elided_depth != 0) {
+      frame->items++;
+      return;
+    }
+    if (frame->items++ == 0)
+      _CBOR_DIAG_LITERAL(context, "(_ ");
+    else
+      _CBOR_DIAG_LITERAL(context, ", ");
+  } else if (!_cbor_diag_begin_item(context)) {
+    _cbor_diag_end_item(context);
+    return;
+  }
+  if (type == _CBOR_DIAG_BYTESTRING)
+    _cbor_diag_hex(context, data, length);
+  else
+    _cbor_diag_text(context, data, length);
+  if (!chunk) _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_byte_string(void* context, cbor_data data,
+                                   uint64_t length) {
+  _cbor_diag_string_item(context, _CBOR_DIAG_BYTESTRING, data, length);
+}
+
+static void _cbor_diag_string(void* context, cbor_data data,
+                              uint64_t length) {
+  _cbor_diag_string_item(context, _CBOR_DIAG_STRING, data, length);
+}
+
+static void _cbor_diag_byte_string_start(void* context) {
+  _cbor_diag_begin_item(context);
+  if (_cbor_diag_active(context))
+    _cbor_diag_push(context, _CBOR_DIAG_BYTESTRING, true, 0);
+}
+
+static void _cbor_diag_string_start(void* context) {
+  _cbor_diag_begin_item(context);
+  if (_cbor_diag_active(context))
+    _cbor_diag_push(context, _CBOR_DIAG_STRING, true, 0);
+}
+
+static void _cbor_diag_array_start(void* context, uint64_t size) {
+  _cbor_diag_open(context, _CBOR_DIAG_ARRAY, false, size, "[", 1);
+}
+
+static void _cbor_diag_indef_array_start(void* context) {
+  _cbor_diag_open(context, _CBOR_DIAG_ARRAY, true, 0, "[_ ", 3);
+}
+
+static void _cbor_diag_map_start(void* context, uint64_t size) {
+  _cbor_diag_open(context, _CBOR_DIAG_MAP, false, size, "{", 1);
+}
+
+static void _cbor_diag_indef_map_start(void* context) {
+  _cbor_diag_open(context, _CBOR_DIAG_MAP, true, 0, "{_ ", 3);
+}
+
+static void _cbor_diag_tag(void* context, uint64_t value) {
+  char digits[21];
+  char* end = digits + sizeof(digits);
+  *--end = '(';
+  char* start = _cbor_format_uint(value, end);
+  _cbor_diag_open(context, _CBOR_DIAG_TAG, false, 1, start,
+                  (size_t)(digits + sizeof(digits) - start));
+}
+
+static void _cbor_diag_literal(struct _cbor_diag_context* context,
+                               const char* literal) {
+  if (_cbor_diag_begin_item(context))
+    _cbor_diag_raw(context, literal, strlen(literal));
+  _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_null(void* context) {
+  _cbor_diag_literal(context, "null");
+}
+
+static void _cbor_diag_undefined(void* context) {
+  _cbor_diag_literal(context, "undefined");
+}
+
+static void _cbor_diag_boolean(void* context, bool value) {
+  _cbor_diag_literal(context, value ? "true" : "false");
+}
+
+static void _cbor_diag_simple(struct _cbor_diag_context* context,
+                              uint8_t value) {
+  if (_cbor_diag_begin_item(context)) {
+    char digits[11];
+    char* end = digits + sizeof(digits);
+    *--end = ')';
+    char* start = _cbor_format_uint(value, end) - 7;
+    memcpy(start, "simple(", 7);
+    _cbor_diag_raw(context, start, (size_t)(digits + sizeof(digits) - start));
+  }
+  _cbor_diag_end_item(context);
+}
+
+static void _cbor_diag_indef_break(void* context) {
+  struct _cbor_diag_context* diag = context;
+  if (!_cbor_diag_active(diag)) return;
+  struct _cbor_diag_frame* frame = _cbor_diag_top(diag);
+  if (frame == NULL || !frame->indefinite ||
+      (frame->type == _CBOR_DIAG_MAP && frame->items % 2 == 1)) {
+    // Break outside of an indefinite item, or in place of a map value
+    _cbor_diag_fail(diag, CBOR_DIAG_ERR_MALFORMED);
+    return;
+  }
+  _cbor_diag_close(diag);
+  _cbor_diag_end_item(diag);
+}
+
+static const struct cbor_callbacks _cbor_diag_callbacks = {
+    .uint8 = _cbor_diag_uint8,
+    .uint16 = _cbor_diag_uint16,
+    .uint32 = _cbor_diag_uint32,
+    .uint64 = _cbor_diag_uint,
+    .negint8 = _cbor_diag_negint8,
+    .negint16 = _cbor_diag_negint16,
+    .negint32 = _cbor_diag_negint32,
+    .negint64 = _cbor_diag_negint,
+    .byte_string_start = _cbor_diag_byte_string_start,
+    .byte_string = _cbor_diag_byte_string,
+    .string = _cbor_diag_string,
+    .string_start = _cbor_diag_string_start,
+    .indef_array_start = _cbor_diag_indef_array_start,
+    .array_start = _cbor_diag_array_start,
+    .indef_map_start = _cbor_diag_indef_map_start,
+    .map_start = _cbor_diag_map_start,
+    .tag = _cbor_diag_tag,
+    .float2 = _cbor_diag_float,
+    .float4 = _cbor_diag_float,
+    .float8 = _cbor_diag_double,
+    .undefined = _cbor_diag_undefined,
+    .null = _cbor_diag_null,
+    .boolean = _cbor_diag_boolean,
+    .indef_break = _cbor_diag_indef_break,
+};
+
+static void _cbor_diag_init(struct _cbor_diag_context* context, char* buffer,
+                            size_t buffer_size,
+                            const struct cbor_diag_options* options) {
+  *context = (struct _cbor_diag_context){
+      .options = options == NULL ? (struct cbor_diag_options){0} : *options,
+      .buffer = buffer,
+      .capacity = buffer_size == 0 ? 0 : buffer_size - 1,
+      .frames_capacity = _CBOR_DIAG_INLINE_DEPTH,
+      .allocator = cbor_thread_allocator(),
+      .error = CBOR_DIAG_ERR_NONE};
+  context->frames = context->inline_frames;
+}
+
+static struct cbor_diag_result _cbor_diag_result(
+    struct _cbor_diag_context* context, size_t buffer_size, size_t read) {
+  _cbor_diag_finish(context, buffer_size);
+  if (context->frames != context->inline_frames)
+    _CBOR_FREE(context->allocator, context->frames);
+  return (struct cbor_diag_result){.length = context->length,
+                                   .read = read,
+                                   .truncated = context->truncated,
+                                   .error = context->error};
+}
+
+static bool _cbor_diag_is_indefinite(const cbor_item_t* item) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_BYTESTRING:
+      return cbor_bytestring_is_indefinite(item);
+    case CBOR_TYPE_STRING:
+      return cbor_string_is_indefinite(item);
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_is_indefinite(item);
+    case CBOR_TYPE_MAP:
+      return cbor_map_is_indefinite(item);
+    default:
+      return false;
+  }
+}
+
+/** Convert an item, or only start it if it has children
+ *
+ * @return Whether the children of \p item are to be visited
+ */
+static bool _cbor_diag_item(struct _cbor_diag_context* context,
+                            const cbor_item_t* item) {
+  size_t depth = context->depth;
+  bool indefinite = _cbor_diag_is_indefinite(item);
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_UINT:
+      _cbor_diag_uint(context, cbor_get_int(item));
+      break;
+    case CBOR_TYPE_NEGINT:
+      _cbor_diag_negint(context, cbor_get_int(item));
+      break;
+    case CBOR_TYPE_BYTESTRING:
+      if (indefinite)
+        _cbor_diag_byte_string_start(context);
+      else
+        _cbor_diag_byte_string(context, cbor_bytestring_handle(item),
+                               cbor_bytestring_length(item));
+      break;
+    case CBOR_TYPE_STRING:
+      if (indefinite)
+        _cbor_diag_string_start(context);
+      else
+        _cbor_diag_string(context, cbor_string_handle(item),
+                          cbor_string_length(item));
+      break;
+    case CBOR_TYPE_ARRAY:
+      if (indefinite)
+        _cbor_diag_indef_array_start(context);
+      else
+        _cbor_diag_array_start(context, cbor_array_size(item));
+      break;
+    case CBOR_TYPE_MAP:
+      if (indefinite)
+        _cbor_diag_indef_map_start(context);
+      else
+        _cbor_diag_map_start(context, cbor_map_size(item));
+      break;
+    case CBOR_TYPE_TAG:
+      _cbor_diag_tag(context, cbor_tag_value(item));
+      break;
+    case CBOR_TYPE_FLOAT_CTRL:
+      if (!cbor_float_ctrl_is_ctrl(item))
+        _cbor_diag_number(context, cbor_float_get_float(item),
+                          cbor_float_get_width(item) != CBOR_FLOAT_64);
+      else if (cbor_is_bool(item))
+        _cbor_diag_boolean(context, cbor_get_bool(item));
+      else if (cbor_is_null(item))
+        _cbor_diag_null(context);
+      else if (cbor_is_undef(item))
+        _cbor_diag_undefined(context);
+      else
+        _cbor_diag_simple(context, cbor_ctrl_value(item));
+      break;
+  }
+  // Scalars and empty containers may also complete their parents
+  if (context->depth <= depth) return false;
+  if (context->elided_depth == context->depth) {
+    // The contents are not shown, so there is no need to visit them
+    _cbor_diag_close(context);
+    _cbor_diag_end_item(context);
+    return false;
+  }
+  return true;
+}
+
+struct cbor_diag_result cbor_diag(const cbor_item_t* item, char* buffer,
+                                  size_t buffer_size,
+                                  const struct cbor_diag_options* options) {
+  struct _cbor_diag_context context;
+  _cbor_diag_init(&context, buffer, buffer_size, options);
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_walk_frame* frame = NULL;
+  if (_cbor_diag_item(&context, item)) {
+    frame = _cbor_walk_push(&walk, item);
+    if (frame == NULL) _cbor_diag_fail(&context, CBOR_DIAG_ERR_MEMERROR);
+  }
+  while (frame != NULL && _cbor_diag_active(&context)) {
+    cbor_item_t* child;
+    if (_cbor_walk_next(frame, &child)) {
+      if (_cbor_diag_item(&context, child)) {
+        frame = _cbor_walk_push(&walk, child);
+        if (frame == NULL) _cbor_diag_fail(&context, CBOR_DIAG_ERR_MEMERROR);
+      }
+      continue;
+    }
+    // Definite items are closed once all their children have been converted
+    if (_cbor_diag_is_indefinite(frame->item)) _cbor_diag_indef_break(&context);
+    _cbor_walk_pop(&walk);
+    frame = walk.depth == 0 ? NULL : _cbor_walk_top(&walk);
+  }
+  _cbor_walk_free(&walk);
+  return _cbor_diag_result(&context, buffer_size, 0);
+}
+
+struct cbor_diag_result cbor_diag_bytes(
+    cbor_data source, size_t source_size, char* buffer, size_t buffer_size,
+    const struct cbor_diag_options* options) {
+  struct _cbor_diag_context context;
+  _cbor_diag_init(&context, buffer, buffer_size, options);
+  size_t read = 0;
+  while (!context.finished && _cbor_diag_active(&context)) {
+    struct cbor_decoder_result decode_result = cbor_stream_decode(
+        source + read, source_size - read, &_cbor_diag_callbacks, &context);
+    switch (decode_result.status) {
+      case CBOR_DECODER_FINISHED:
+        read += decode_result.read;
+        break;
+      case CBOR_DECODER_NEDATA:
+        _cbor_diag_fail(&context, CBOR_DIAG_ERR_NOTENOUGHDATA);
+        break;
+      case CBOR_DECODER_ERROR:
+        _cbor_diag_fail(&context, CBOR_DIAG_ERR_MALFORMED);
+        break;
+    }
+  }
+  return _cbor_diag_result(&context, buffer_size, read);
+}
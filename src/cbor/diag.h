@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_DIAG_H
+#define LIBCBOR_DIAG_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Limits of #cbor_diag. Zero-initialized options impose no limits. */
+struct cbor_diag_options {
+  /** Arrays, maps, and tags nested more than this many levels deep are shown
+   * without their contents, as `[...]`, `{...}`, and `1(...)`. Zero for no
+   * limit. */
+  size_t max_depth;
+  /** Only the first this many bytes of each (byte) string or chunk are shown,
+   * followed by `...`, e.g. `"abc"...` or `h'010203'...`. Zero for no limit.
+   */
+  size_t max_string_length;
+};
+
+typedef enum {
+  CBOR_DIAG_ERR_NONE,
+  /** The input ends in the middle of an item */
+  CBOR_DIAG_ERR_NOTENOUGHDATA,
+  /** The input is not well-formed CBOR, or contains simple values rejected by
+   * #cbor_stream_decode */
+  CBOR_DIAG_ERR_MALFORMED,
+  /** The nesting is deeper than #CBOR_MAX_STACK_SIZE, or memory for it could
+     not be allocated */
+  CBOR_DIAG_ERR_MEMERROR
+} cbor_diag_error_code;
+
+struct cbor_diag_result {
+  /** Length of the output, excluding the terminating NUL */
+  size_t length;
+  /** Input bytes consumed by #cbor_diag_bytes: the size of the item, unless
+   * the conversion stopped early because of an error or a full buffer */
+  size_t read;
+  /** Parts of the item have been left out because of the options, or because
+   * the buffer is full. In the latter case, the output ends with `...`. */
+  bool truncated;
+  cbor_diag_error_code error;
+};
+
+/** Write the diagnostic notation of an item into a buffer
+ *
+ * The output follows RFC 8949, Section 8, e.g. `{"a": [1, -2.5, h'ff']}` or
+ * `[_ 1(null), (_ "a", "b")]`. Floats are shown in the shortest form that
+ * converts back to the same value and other simple values as `simple(n)`.
+ *
+ * The output is bounded by the buffer size and the options, and no memory is
+ * allocated unless the item is nested more than 16 levels deep, so the
+ * function is suitable for logging arbitrary items. Once the buffer is full,
+ * the conversion stops and the output ends with `...`.
+ *
+ * @param item The item
+ * @param buffer The output buffer. The output is always NUL-terminated unless
+ *  \p buffer_size is zero.
+ * @param buffer_size Size of the output buffer
+ * @param options The limits. May be `NULL` for no limits.
+ * @return The result
+ */
+CBOR_EXPORT struct cbor_diag_result cbor_diag(
+    const cbor_item_t* item, char* buffer, size_t buffer_size,
+    const struct cbor_diag_options* options);
+
+/** Write the diagnostic notation of encoded CBOR into a buffer
+ *
+ * Like #cbor_diag, but the first item of \p source is decoded using
+ * #cbor_stream_decode without building a #cbor_item_t. Items left out
+ * because of #cbor_diag_options.max_depth are still decoded to find their
+ * end. If the input is malformed, the output shows the items up to the error.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param buffer The output buffer. The output is always NUL-terminated unless
+ *  \p buffer_size is zero.
+ * @param buffer_size Size of the output buffer
+ * @param options The limits. May be `NULL` for no limits.
+ * @return The result
+ */
+CBOR_EXPORT struct cbor_diag_result cbor_diag_bytes(
+    cbor_data source, size_t source_size, char* buffer, size_t buffer_size,
+    const struct cbor_diag_options* options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_DIAG_H
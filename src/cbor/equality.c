@@ -0,0 +1,593 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "equality.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "arrays.h"
+#include "bytestrings.h"
+#include "floats_ctrls.h"
+#include "internal/memory_utils.h"
+#include "internal/walker.h"
+#include "ints.h"
+#include "maps.h"
+#include "strings.h"
+#include "tags.h"
+
+/*
+ * ============================================================================
+ * String contents
+ * ============================================================================
+ */
+
+static bool _cbor_string_is_indefinite(const cbor_item_t* item) {
+  return item->type == CBOR_TYPE_BYTESTRING
+             ? cbor_bytestring_is_indefinite(item)
+             : cbor_string_is_indefinite(item);
+}
+
+/** Get the \p index-th contiguous piece of a (byte) string: the string itself
+ * if it is definite, its chunks otherwise */
+static bool _cbor_string_piece(const cbor_item_t* item, size_t index,
+                               cbor_data* data, size_t* length) {
+  if (_cbor_string_is_indefinite(item)) {
+    cbor_item_t** slot = _cbor_child_slot(item, index);
+    if (slot == NULL) return false;
+    item = *slot;
+  } else if (index > 0) {
+    return false;
+  }
+  *data = item->data;
+  *length = item->type == CBOR_TYPE_BYTESTRING
+                ? item->metadata.bytestring_metadata.length
+                : item->metadata.string_metadata.length;
+  return true;
+}
+
+/** Compare the concatenated contents of two (byte) strings */
+static bool _cbor_string_contents_equal(const cbor_item_t* a,
+                                        const cbor_item_t* b) {
+  size_t a_index = 0, b_index = 0;
+  cbor_data a_data, b_data;
+  size_t a_length = 0, b_length = 0;
+  while (true) {
+    while (a_length == 0 &&
+           _cbor_string_piece(a, a_index++, &a_data, &a_length))
+      ;
+    while (b_length == 0 &&
+           _cbor_string_piece(b, b_index++, &b_data, &b_length))
+      ;
+    if (a_length == 0 || b_length == 0) return a_length == b_length;
+    size_t common = a_length < b_length ? a_length : b_length;
+    if (memcmp(a_data, b_data, common) != 0) return false;
+    a_data += common;
+    a_length -= common;
+    b_data += common;
+    b_length -= common;
+  }
+}
+
+static bool _cbor_string_equal(const cbor_item_t* a, const cbor_item_t* b,
+                               unsigned options) {
+  if (options & CBOR_EQUAL_IGNORE_DEFINITENESS)
+    return _cbor_string_contents_equal(a, b);
+  if (_cbor_string_is_indefinite(a) != _cbor_string_is_indefinite(b))
+    return false;
+  // Compare piece by piece, so that the chunks must match too
+  cbor_data a_data, b_data;
+  size_t a_length, b_length;
+  size_t index = 0;
+  for (; _cbor_string_piece(a, index, &a_data, &a_length); index++) {
+    if (!_cbor_string_piece(b, index, &b_data, &b_length) ||
+        a_length != b_length || memcmp(a_data, b_data, a_length) != 0)
+      return false;
+  }
+  return !_cbor_string_piece(b, index, &b_data, &b_length);
+}
+
+/*
+ * ============================================================================
+ * Hashing
+ * ============================================================================
+ */
+
+#define _CBOR_HASH_K1 0x9E3779B97F4A7C15ULL
+#define _CBOR_HASH_K2 0xBF58476D1CE4E5B9ULL
+#define _CBOR_HASH_K3 0x94D049BB133111EBULL
+
+static uint64_t _cbor_hash_mix(uint64_t hash, uint64_t word) {
+  hash ^= word * _CBOR_HASH_K1;
+  hash = (hash << 31) | (hash >> 33);
+  return hash * _CBOR_HASH_K2;
+}
+
+static uint64_t _cbor_hash_finalize(uint64_t hash) {
+  hash ^= hash >> 30;
+  hash *= _CBOR_HASH_K2;
+  hash ^= hash >> 27;
+  hash *= _CBOR_HASH_K3;
+  return hash ^ (hash >> 31);
+}
+
+/** Hash of a byte sequence that is fed in pieces. The result does not depend
+ * on how the sequence is split. */
+struct _cbor_byte_hash {
+  uint64_t hash;
+  uint64_t tail;
+  size_t length;
+};
+
+static void _cbor_byte_hash_update(struct _cbor_byte_hash* state,
+                                   cbor_data data, size_t length) {
+  // Complete the word started by the previous piece
+  while (length > 0 && state->length % 8 != 0) {
+    state->tail |= (uint64_t)*data++ << (8 * (state->length++ % 8));
+    length--;
+    if (state->length % 8 == 0) {
+      state->hash = _cbor_hash_mix(state->hash, state->tail);
+      state->tail = 0;
+    }
+  }
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    state->hash = _cbor_hash_mix(state->hash, word);
+    state->length += 8;
+  }
+  while (length > 0) {
+    state->tail |= (uint64_t)*data++ << (8 * (state->length++ % 8));
+    length--;
+  }
+}
+
+static uint64_t _cbor_hash_start(const cbor_item_t* item, uint64_t seed) {
+  return _cbor_hash_mix(seed, (uint64_t)item->type + 1);
+}
+
+/** Hash of the header of an array, map, or tag. Definiteness is omitted. */
+static uint64_t _cbor_hash_header(const cbor_item_t* item, uint64_t seed) {
+  switch (item->type) {
+    case CBOR_TYPE_ARRAY:
+      return _cbor_hash_mix(_cbor_hash_start(item, seed),
+                            cbor_array_size(item));
+    case CBOR_TYPE_MAP:
+      return _cbor_hash_mix(_cbor_hash_start(item, seed), cbor_map_size(item));
+    default:
+      return _cbor_hash_mix(_cbor_hash_start(item, seed), cbor_tag_value(item));
+  }
+}
+
+static uint64_t _cbor_hash_float(const cbor_item_t* item, uint64_t seed) {
+  uint64_t hash = _cbor_hash_start(item, seed);
+  if (cbor_float_get_width(item) == CBOR_FLOAT_0)
+    return _cbor_hash_mix(hash, cbor_ctrl_value(item));
+  double value = cbor_float_get_float(item);
+  if (isnan(value)) value = NAN;
+  union _cbor_double_helper helper = {.as_double = value};
+  return _cbor_hash_mix(_cbor_hash_mix(hash, 1), helper.as_uint);
+}
+
+/** Hash of an item that is not traversed further: anything but a nested
+ * array, map, or tag, which is represented by its header */
+static uint64_t _cbor_hash_shallow(const cbor_item_t* item, uint64_t seed) {
+  if (item == NULL) return _cbor_hash_finalize(seed);
+  switch (item->type) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:
+      return _cbor_hash_finalize(
+          _cbor_hash_mix(_cbor_hash_start(item, seed), cbor_get_int(item)));
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING: {
+      struct _cbor_byte_hash state = {.hash = _cbor_hash_start(item, seed)};
+      cbor_data data;
+      size_t length;
+      for (size_t i = 0; _cbor_string_piece(item, i, &data, &length); i++)
+        _cbor_byte_hash_update(&state, data, length);
+      return _cbor_hash_finalize(_cbor_hash_mix(
+          _cbor_hash_mix(state.hash, state.tail), state.length));
+    }
+    case CBOR_TYPE_FLOAT_CTRL:
+      return _cbor_hash_finalize(_cbor_hash_float(item, seed));
+    default:
+      return _cbor_hash_finalize(_cbor_hash_header(item, seed));
+  }
+}
+
+/** Hash of a key-value pair, combined order-independently within a map */
+static uint64_t _cbor_hash_pair(uint64_t key, uint64_t value) {
+  return _cbor_hash_finalize(_cbor_hash_mix(key, value));
+}
+
+static void _cbor_hash_fold(struct _cbor_walk_frame* frame, uint64_t hash) {
+  if (frame->item->type != CBOR_TYPE_MAP) {
+    frame->state.hash.value = _cbor_hash_mix(frame->state.hash.value, hash);
+  } else if ((frame->next - 1) % 2 == 0) {
+    frame->state.hash.key = hash;
+  } else {
+    frame->state.hash.pairs += _cbor_hash_pair(frame->state.hash.key, hash);
+  }
+}
+
+static uint64_t _cbor_hash_result(const struct _cbor_walk_frame* frame) {
+  return _cbor_hash_finalize(
+      _cbor_hash_mix(frame->state.hash.value, frame->state.hash.pairs));
+}
+
+/** Hashes (with seed 0) of the arrays, maps, and tags hashed so far during
+ * one comparison, keyed by address. Maps nested in maps are compared after
+ * their ancestors have hashed them, so this keeps them from being hashed
+ * again at every level. */
+struct _cbor_hash_memo {
+  const struct cbor_allocator* allocator;
+  /** Open addressing with linear probing, `NULL` until the first insertion */
+  struct _cbor_hash_memo_entry {
+    const cbor_item_t* item;
+    uint64_t hash;
+  }* entries;
+  size_t count;
+  /** Zero or a power of two */
+  size_t capacity;
+};
+
+#define _CBOR_HASH_MEMO_INITIAL_CAPACITY 64
+
+static struct _cbor_hash_memo_entry* _cbor_hash_memo_slot(
+    const struct _cbor_hash_memo* memo, const cbor_item_t* item) {
+  size_t index = (size_t)_cbor_hash_finalize((uintptr_t)item);
+  while (true) {
+    struct _cbor_hash_memo_entry* entry =
+        &memo->entries[index & (memo->capacity - 1)];
+    if (entry->item == item || entry->item == NULL) return entry;
+    index++;
+  }
+}
+
+static bool _cbor_hash_memo_get(const struct _cbor_hash_memo* memo,
+                                const cbor_item_t* item, uint64_t* hash) {
+  if (memo->capacity == 0) return false;
+  struct _cbor_hash_memo_entry* entry = _cbor_hash_memo_slot(memo, item);
+  if (entry->item == NULL) return false;
+  *hash = entry->hash;
+  return true;
+}
+
+/** Remember the hash of \p item. Only costs time if memory runs out. */
+static void _cbor_hash_memo_put(struct _cbor_hash_memo* memo,
+                                const cbor_item_t* item, uint64_t hash) {
+  // Keep the load factor at most one half
+  if (2 * (memo->count + 1) > memo->capacity) {
+    size_t capacity = memo->capacity == 0 ? _CBOR_HASH_MEMO_INITIAL_CAPACITY
+                                          : 2 * memo->capacity;
+    if (!_cbor_safe_to_multiply(sizeof(struct _cbor_hash_memo_entry),
+                                capacity))
+      return;
+    struct _cbor_hash_memo_entry* entries =
+        _CBOR_MALLOC(memo->allocator, CBOR_ALLOC_SITE_OTHER,
+                     sizeof(struct _cbor_hash_memo_entry) * capacity);
+    if (entries == NULL) return;
+    memset(entries, 0, sizeof(struct _cbor_hash_memo_entry) * capacity);
+    struct _cbor_hash_memo grown = {.allocator = memo->allocator,
+                                    .entries = entries,
+                                    .count = memo->count,
+                                    .capacity = capacity};
+    for (size_t i = 0; i < memo->capacity; i++) {
+      if (memo->entries[i].item != NULL)
+        *_cbor_hash_memo_slot(&grown, memo->entries[i].item) =
+            memo->entries[i];
+    }
+    _CBOR_FREE(memo->allocator, memo->entries);
+    *memo = grown;
+  }
+  struct _cbor_hash_memo_entry* entry = _cbor_hash_memo_slot(memo, item);
+  if (entry->item == NULL) memo->count++;
+  *entry = (struct _cbor_hash_memo_entry){.item = item, .hash = hash};
+}
+
+/** Hash \p item, treating items deeper than \p max_depth as leaves
+ *
+ * @param memo Hashes of nesting items to reuse and to add to, or `NULL`.
+ * Requires \p seed 0 and an unlimited \p max_depth.
+ * @return false if the walk could not be allocated
+ */
+static bool _cbor_hash_walk(const cbor_item_t* item, uint64_t seed,
+                            size_t max_depth, struct _cbor_hash_memo* memo,
+                            uint64_t* result) {
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  const cbor_item_t* current = item;
+  while (true) {
+    uint64_t hash;
+    bool memoized = current != NULL && _cbor_is_nesting(current) &&
+                    memo != NULL && _cbor_hash_memo_get(memo, current, &hash);
+    if (memoized) {
+      if (walk.depth == 0) {
+        *result = hash;
+        return true;
+      }
+      _cbor_hash_fold(_cbor_walk_top(&walk), hash);
+    } else if (current != NULL && _cbor_is_nesting(current) &&
+               walk.depth < max_depth) {
+      struct _cbor_walk_frame* frame = _cbor_walk_push(&walk, current);
+      if (frame == NULL) {
+        _cbor_walk_free(&walk);
+        return false;
+      }
+      frame->state.hash.value = _cbor_hash_header(current, seed);
+      frame->state.hash.pairs = 0;
+    } else {
+      hash = _cbor_hash_shallow(current, seed);
+      if (walk.depth == 0) {
+        *result = hash;
+        return true;
+      }
+      _cbor_hash_fold(_cbor_walk_top(&walk), hash);
+    }
+
+    // Find the next item to hash, completing the finished nesting items
+    while (true) {
+      struct _cbor_walk_frame* frame = _cbor_walk_top(&walk);
+      cbor_item_t* child;
+      if (_cbor_walk_next(frame, &child)) {
+        current = child;
+        break;
+      }
+      hash = _cbor_hash_result(frame);
+      if (memo != NULL) _cbor_hash_memo_put(memo, frame->item, hash);
+      _cbor_walk_pop(&walk);
+      if (walk.depth == 0) {
+        _cbor_walk_free(&walk);
+        *result = hash;
+        return true;
+      }
+      _cbor_hash_fold(_cbor_walk_top(&walk), hash);
+    }
+  }
+}
+
+uint64_t cbor_hash(const cbor_item_t* item, uint64_t seed) {
+  uint64_t hash;
+  if (_cbor_hash_walk(item, seed, SIZE_MAX, NULL, &hash)) return hash;
+  // Hashing fewer levels is still consistent with equality, and the inline
+  // frames suffice
+  bool hashed _CBOR_UNUSED =
+      _cbor_hash_walk(item, seed, _CBOR_WALK_INLINE_DEPTH, NULL, &hash);
+  CBOR_ASSERT(hashed);
+  return hash;
+}
+
+/*
+ * ============================================================================
+ * Equality
+ * ============================================================================
+ */
+
+static bool _cbor_float_ctrl_equal(const cbor_item_t* a,
+                                   const cbor_item_t* b) {
+  if (cbor_float_get_width(a) != cbor_float_get_width(b)) return false;
+  switch (cbor_float_get_width(a)) {
+    case CBOR_FLOAT_0:
+      return cbor_ctrl_value(a) == cbor_ctrl_value(b);
+    case CBOR_FLOAT_16:
+    case CBOR_FLOAT_32: {
+      union _cbor_float_helper a_value = {.as_float = *(float*)a->data},
+                               b_value = {.as_float = *(float*)b->data};
+      if (isnan(a_value.as_float) && isnan(b_value.as_float)) return true;
+      return a_value.as_uint == b_value.as_uint;
+    }
+    default: {
+      union _cbor_double_helper a_value = {.as_double = *(double*)a->data},
+                                b_value = {.as_double = *(double*)b->data};
+      if (isnan(a_value.as_double) && isnan(b_value.as_double)) return true;
+      return a_value.as_uint == b_value.as_uint;
+    }
+  }
+}
+
+/** Compare everything but the nested items of arrays, maps, and tags */
+static bool _cbor_equal_shallow(const cbor_item_t* a, const cbor_item_t* b,
+                                unsigned options) {
+  if (a == NULL || b == NULL) return a == b;
+  if (a->type != b->type) return false;
+  bool compare_definiteness = !(options & CBOR_EQUAL_IGNORE_DEFINITENESS);
+  switch (a->type) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:
+      return cbor_int_get_width(a) == cbor_int_get_width(b) &&
+             cbor_get_int(a) == cbor_get_int(b);
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING:
+      return _cbor_string_equal(a, b, options);
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_size(a) == cbor_array_size(b) &&
+             (!compare_definiteness ||
+              cbor_array_is_definite(a) == cbor_array_is_definite(b));
+    case CBOR_TYPE_MAP:
+      return cbor_map_size(a) == cbor_map_size(b) &&
+             (!compare_definiteness ||
+              cbor_map_is_definite(a) == cbor_map_is_definite(b));
+    case CBOR_TYPE_TAG:
+      return cbor_tag_value(a) == cbor_tag_value(b);
+    case CBOR_TYPE_FLOAT_CTRL:
+      return _cbor_float_ctrl_equal(a, b);
+    default:
+      _CBOR_UNREACHABLE;
+      return false;
+  }
+}
+
+struct _cbor_pair_hash {
+  uint64_t hash;
+  size_t index;
+};
+
+static int _cbor_pair_hash_compare(const void* a, const void* b) {
+  const struct _cbor_pair_hash *first = a, *second = b;
+  if (first->hash != second->hash) return first->hash < second->hash ? -1 : 1;
+  return first->index < second->index ? -1 : first->index > second->index;
+}
+
+/** #cbor_hash with seed 0, reusing and extending \p memo */
+static uint64_t _cbor_hash_memoized(struct _cbor_hash_memo* memo,
+                                    const cbor_item_t* item) {
+  uint64_t hash;
+  if (_cbor_hash_walk(item, 0, SIZE_MAX, memo, &hash)) return hash;
+  return cbor_hash(item, 0);
+}
+
+static struct _cbor_pair_hash* _cbor_sorted_pair_hashes(
+    const struct cbor_allocator* allocator, struct _cbor_hash_memo* memo,
+    const cbor_item_t* map) {
+  size_t size = cbor_map_size(map);
+  if (!_cbor_safe_to_multiply(sizeof(struct _cbor_pair_hash), size))
+    return NULL;
+  struct _cbor_pair_hash* hashes = _CBOR_MALLOC(
+      allocator, CBOR_ALLOC_SITE_OTHER, sizeof(struct _cbor_pair_hash) * size);
+  if (hashes == NULL) return NULL;
+  struct cbor_pair* pairs = cbor_map_handle(map);
+  for (size_t i = 0; i < size; i++) {
+    hashes[i] = (struct _cbor_pair_hash){
+        .hash = _cbor_hash_pair(_cbor_hash_memoized(memo, pairs[i].key),
+                                _cbor_hash_memoized(memo, pairs[i].value)),
+        .index = i};
+  }
+  qsort(hashes, size, sizeof(struct _cbor_pair_hash), _cbor_pair_hash_compare);
+  return hashes;
+}
+
+static bool _cbor_pairs_equal(const struct cbor_pair* a,
+                              const struct cbor_pair* b, unsigned options) {
+  return cbor_equal_with_options(a->key, b->key, options) &&
+         cbor_equal_with_options(a->value, b->value, options);
+}
+
+/** Match the pairs of two maps of the same size by their hashes
+ *
+ * Pairs whose hashes are unique are matched tentatively and compared by the
+ * caller. Runs of pairs with the same hash (duplicate pairs or collisions) are
+ * matched by comparing them here.
+ *
+ * @param[out] order The index of the pair of \p b matched to each pair of
+ * \p a, to be freed using \p allocator. `NULL` if the maps differ or on
+ * allocation failure.
+ */
+static bool _cbor_match_pairs(const struct cbor_allocator* allocator,
+                              struct _cbor_hash_memo* memo,
+                              const cbor_item_t* a, const cbor_item_t* b,
+                              unsigned options, size_t** order) {
+  *order = NULL;
+  size_t size = cbor_map_size(a);
+  struct _cbor_pair_hash* a_hashes =
+      _cbor_sorted_pair_hashes(allocator, memo, a);
+  struct _cbor_pair_hash* b_hashes =
+      a_hashes == NULL ? NULL : _cbor_sorted_pair_hashes(allocator, memo, b);
+  size_t* matched = b_hashes == NULL ? NULL
+                                     : _CBOR_MALLOC(allocator,
+                                                    CBOR_ALLOC_SITE_OTHER,
+                                                    sizeof(size_t) * size);
+  bool equal = matched != NULL;
+  struct cbor_pair *a_pairs = cbor_map_handle(a), *b_pairs = cbor_map_handle(b);
+  for (size_t start = 0, end; equal && start < size; start = end) {
+    uint64_t hash = a_hashes[start].hash;
+    for (end = start + 1; end < size && a_hashes[end].hash == hash; end++)
+      ;
+    for (size_t i = start; equal && i < end; i++)
+      equal = b_hashes[i].hash == hash;
+    if (end < size && b_hashes[end].hash == hash) equal = false;
+    if (!equal || end - start == 1) continue;
+    // Move the pair of b equal to each pair of a in the run into its position
+    for (size_t i = start; equal && i < end; i++) {
+      size_t j = i;
+      while (j < end &&
+             !_cbor_pairs_equal(&a_pairs[a_hashes[i].index],
+                                &b_pairs[b_hashes[j].index], options))
+        j++;
+      equal = j < end;
+      if (!equal) break;
+      struct _cbor_pair_hash swap = b_hashes[i];
+      b_hashes[i] = b_hashes[j];
+      b_hashes[j] = swap;
+    }
+  }
+  if (equal) {
+    for (size_t i = 0; i < size; i++)
+      matched[a_hashes[i].index] = b_hashes[i].index;
+    *order = matched;
+  } else {
+    _CBOR_FREE(allocator, matched);
+  }
+  _CBOR_FREE(allocator, a_hashes);
+  _CBOR_FREE(allocator, b_hashes);
+  return equal;
+}
+
+static struct _cbor_walk_frame* _cbor_equal_push(struct _cbor_walk* walk,
+                                                 struct _cbor_hash_memo* memo,
+                                                 const cbor_item_t* a,
+                                                 const cbor_item_t* b,
+                                                 unsigned options) {
+  struct _cbor_walk_frame* frame = _cbor_walk_push(walk, a);
+  if (frame == NULL) return NULL;
+  frame->state.equal.other = b;
+  frame->state.equal.order = NULL;
+  if (a->type == CBOR_TYPE_MAP && (options & CBOR_EQUAL_IGNORE_MAP_ORDER) &&
+      cbor_map_size(a) > 1 &&
+      !_cbor_match_pairs(walk->allocator, memo, a, b, options,
+                         &frame->state.equal.order)) {
+    _cbor_walk_pop(walk);
+    return NULL;
+  }
+  return frame;
+}
+
+static void _cbor_equal_pop(struct _cbor_walk* walk) {
+  _CBOR_FREE(walk->allocator, _cbor_walk_top(walk)->state.equal.order);
+  _cbor_walk_pop(walk);
+}
+
+/** The child of the other item corresponding to child \p index of
+ * `frame->item` */
+static const cbor_item_t* _cbor_equal_counterpart(
+    const struct _cbor_walk_frame* frame, size_t index) {
+  if (frame->state.equal.order != NULL)
+    index = 2 * frame->state.equal.order[index / 2] + index % 2;
+  return *_cbor_child_slot(frame->state.equal.other, index);
+}
+
+bool cbor_equal_with_options(const cbor_item_t* a, const cbor_item_t* b,
+                             unsigned options) {
+  if (a == b) return true;
+  if (!_cbor_equal_shallow(a, b, options)) return false;
+  if (!_cbor_is_nesting(a)) return true;
+
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_hash_memo memo = {.allocator = walk.allocator};
+  bool equal = _cbor_equal_push(&walk, &memo, a, b, options) != NULL;
+  while (equal && walk.depth > 0) {
+    struct _cbor_walk_frame* frame = _cbor_walk_top(&walk);
+    cbor_item_t* child;
+    if (!_cbor_walk_next(frame, &child)) {
+      _cbor_equal_pop(&walk);
+      continue;
+    }
+    const cbor_item_t* other = _cbor_equal_counterpart(frame, frame->next - 1);
+    if (child == other) continue;
+    equal = _cbor_equal_shallow(child, other, options) &&
+            (!_cbor_is_nesting(child) ||
+             _cbor_equal_push(&walk, &memo, child, other, options) != NULL);
+  }
+  while (walk.depth > 0) _cbor_equal_pop(&walk);
+  _cbor_walk_free(&walk);
+  _CBOR_FREE(memo.allocator, memo.entries);
+  return equal;
+}
+
+bool cbor_equal(const cbor_item_t* a, const cbor_item_t* b) {
+  return cbor_equal_with_options(a, b, CBOR_EQUAL_STRICT);
+}
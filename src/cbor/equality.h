@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_EQUALITY_H
+#define LIBCBOR_EQUALITY_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Comparison and hashing
+ * ============================================================================
+ */
+
+/** Relaxations of #cbor_equal_with_options, combined using `|` */
+typedef enum {
+  /** Items must have the same structure and encoding (see #cbor_equal) */
+  CBOR_EQUAL_STRICT = 0,
+  /** Definite and indefinite arrays and maps with equal items are equal, and
+   * so are definite and indefinite (byte) strings with equal contents,
+   * regardless of how they are split into chunks */
+  CBOR_EQUAL_IGNORE_DEFINITENESS = 1 << 0,
+  /** Maps with the same key-value pairs in a different order are equal */
+  CBOR_EQUAL_IGNORE_MAP_ORDER = 1 << 1,
+} cbor_equal_options;
+
+/** Check whether two items are structurally equal
+ *
+ * Items are equal if they have the same type, width, definiteness, (byte)
+ * string chunks, and values, and their nested items are equal in the same
+ * order. All NaNs of the same width are equal. In other words, equal items
+ * have the same serialization. Reference counts, allocators, and memoized
+ * sizes are ignored.
+ *
+ * Identical nested items are not compared, so comparing trees that share
+ * subtrees (e.g. a tree and its older version with one item replaced) only
+ * visits the items that differ. The comparison stops at the first difference.
+ *
+ * @param a An item
+ * @param b An item
+ * @return `true` if the items are equal. `false` if they differ, or if
+ * nesting deeper than 16 levels requires memory that cannot be allocated.
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT bool cbor_equal(const cbor_item_t* a, const cbor_item_t* b);
+
+/** Check whether two items are equal, ignoring some differences
+ *
+ * @param a An item
+ * @param b An item
+ * @param options Combination of #cbor_equal_options. With
+ * #CBOR_EQUAL_IGNORE_MAP_ORDER, the pairs of maps are matched by their hashes,
+ * which are computed once per comparison for all the nested items. Comparing
+ * items with `n` nested items then takes `O(n log n)` time and `O(n)` memory,
+ * unless maps contain many equal pairs or pairs whose hashes collide.
+ * @return `true` if the items are equal. `false` if they differ, or if memory
+ * needed for the comparison cannot be allocated.
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT bool cbor_equal_with_options(const cbor_item_t* a,
+                                         const cbor_item_t* b,
+                                         unsigned options);
+
+/** Compute a hash of an item
+ *
+ * The hash is consistent with #cbor_equal_with_options under any options: items
+ * that are equal have the same hash. It is meant for hash tables and
+ * deduplication, not for cryptographic purposes, and may change between
+ * versions and platforms.
+ *
+ * The time is proportional to the number of nested items and the size of
+ * (byte) strings. Nesting deeper than 16 levels requires memory; if it cannot
+ * be allocated, the hash only takes the first 16 levels into account.
+ *
+ * @param item An item
+ * @param seed Varies the hash, e.g. to make collisions harder to predict
+ * @return The hash
+ */
+_CBOR_NODISCARD
+CBOR_EXPORT uint64_t cbor_hash(const cbor_item_t* item, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_EQUALITY_H
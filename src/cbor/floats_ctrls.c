@@ -8,6 +8,9 @@
 #include "floats_ctrls.h"
 #include <math.h>
 #include "assert.h"
+#include "internal/item_pool.h"
+#include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 cbor_float_width cbor_float_get_width(const cbor_item_t* item) {
   CBOR_ASSERT(cbor_isa_float_ctrl(item));
@@ -66,80 +69,94 @@ bool cbor_get_bool(const cbor_item_t* item) {
 }
 
 void cbor_set_float2(cbor_item_t* item, float value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_float(item));
   CBOR_ASSERT(cbor_float_get_width(item) == CBOR_FLOAT_16);
   *((float*)item->data) = value;
 }
 
 void cbor_set_float4(cbor_item_t* item, float value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_float(item));
   CBOR_ASSERT(cbor_float_get_width(item) == CBOR_FLOAT_32);
   *((float*)item->data) = value;
 }
 
 void cbor_set_float8(cbor_item_t* item, double value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_float(item));
   CBOR_ASSERT(cbor_float_get_width(item) == CBOR_FLOAT_64);
   *((double*)item->data) = value;
 }
 
 void cbor_set_ctrl(cbor_item_t* item, uint8_t value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_isa_float_ctrl(item));
   CBOR_ASSERT(cbor_float_get_width(item) == CBOR_FLOAT_0);
   item->metadata.float_ctrl_metadata.ctrl = value;
+  _cbor_size_cache_invalidate(item);
 }
 
 void cbor_set_bool(cbor_item_t* item, bool value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_bool(item));
   item->metadata.float_ctrl_metadata.ctrl =
       value ? CBOR_CTRL_TRUE : CBOR_CTRL_FALSE;
 }
 
 cbor_item_t* cbor_new_ctrl(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .type = CBOR_TYPE_FLOAT_CTRL,
       .data = NULL,
       .refcount = 1,
+      .allocator = allocator,
       .metadata = {.float_ctrl_metadata = {.width = CBOR_FLOAT_0,
                                            .ctrl = CBOR_CTRL_NONE}}};
   return item;
 }
 
 cbor_item_t* cbor_new_float2(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 4);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 4);
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .type = CBOR_TYPE_FLOAT_CTRL,
       .data = (unsigned char*)item + sizeof(cbor_item_t),
       .refcount = 1,
+      .allocator = allocator,
       .metadata = {.float_ctrl_metadata = {.width = CBOR_FLOAT_16}}};
   return item;
 }
 
 cbor_item_t* cbor_new_float4(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 4);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 4);
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .type = CBOR_TYPE_FLOAT_CTRL,
       .data = (unsigned char*)item + sizeof(cbor_item_t),
       .refcount = 1,
+      .allocator = allocator,
       .metadata = {.float_ctrl_metadata = {.width = CBOR_FLOAT_32}}};
   return item;
 }
 
 cbor_item_t* cbor_new_float8(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 8);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 8);
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .type = CBOR_TYPE_FLOAT_CTRL,
       .data = (unsigned char*)item + sizeof(cbor_item_t),
       .refcount = 1,
+      .allocator = allocator,
       .metadata = {.float_ctrl_metadata = {.width = CBOR_FLOAT_64}}};
   return item;
 }
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_ATOMICS_H
+#define LIBCBOR_ATOMICS_H
+
+#include "cbor/common.h"
+
+/*
+ * Primitives for state shared by all threads using the library, such as the
+ * item pool. They are atomic regardless of CBOR_ATOMIC_REFCOUNT.
+ * _CBOR_HAS_ATOMICS is 0 if the compiler provides neither GCC-compatible
+ * atomic builtins nor the MSVC Interlocked intrinsics; the features that
+ * depend on these primitives refuse to build then.
+ */
+
+#if defined(__GNUC__)
+
+#define _CBOR_HAS_ATOMICS 1
+
+/* Relaxed. On failure, _CBOR_ATOMIC_CAS* store the current value in
+ * `expected`. */
+#define _CBOR_ATOMIC_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define _CBOR_ATOMIC_STORE(field, value) \
+  __atomic_store_n(&(field), value, __ATOMIC_RELAXED)
+#define _CBOR_ATOMIC_ADD(field, value) \
+  ((void)__atomic_fetch_add(&(field), value, __ATOMIC_RELAXED))
+#define _CBOR_ATOMIC_CAS(field, expected, desired)                 \
+  __atomic_compare_exchange_n(&(field), &(expected), desired, false, \
+                              __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define _CBOR_ATOMIC_LOAD_POINTER(field) _CBOR_ATOMIC_LOAD(field)
+#define _CBOR_ATOMIC_CAS_POINTER(field, expected, desired) \
+  _CBOR_ATOMIC_CAS(field, expected, desired)
+/* uint64_t fields, which are wider than size_t on 32-bit targets */
+#define _CBOR_ATOMIC64_LOAD(field) _CBOR_ATOMIC_LOAD(field)
+#define _CBOR_ATOMIC64_STORE(field, value) _CBOR_ATOMIC_STORE(field, value)
+#define _CBOR_ATOMIC64_ADD(field, value) _CBOR_ATOMIC_ADD(field, value)
+#define _CBOR_ATOMIC64_CAS(field, expected, desired) \
+  _CBOR_ATOMIC_CAS(field, expected, desired)
+
+/** Spin lock for short critical sections, zero when unlocked */
+typedef long _cbor_spin_lock_t;
+
+static inline void _cbor_spin_lock(_cbor_spin_lock_t* lock) {
+  while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+  }
+}
+
+static inline void _cbor_spin_unlock(_cbor_spin_lock_t* lock) {
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define _CBOR_HAS_ATOMICS 1
+
+/* Interlocked operations on size_t fields. They are full barriers. */
+#ifdef _WIN64
+#define _CBOR_INTERLOCKED(operation, field) \
+  ((size_t)_Interlocked##operation##64((volatile __int64*)&(field)))
+#define _CBOR_INTERLOCKED_EXCHANGE(field, value) \
+  ((void)_InterlockedExchange64((volatile __int64*)&(field), (__int64)(value)))
+#define _CBOR_INTERLOCKED_READ(field) \
+  ((size_t)_InterlockedCompareExchange64((volatile __int64*)&(field), 0, 0))
+#define _CBOR_INTERLOCKED_ADD(field, value)                    \
+  ((void)_InterlockedExchangeAdd64((volatile __int64*)&(field), \
+                                   (__int64)(value)))
+#else
+#define _CBOR_INTERLOCKED(operation, field) \
+  ((size_t)_Interlocked##operation((volatile long*)&(field)))
+#define _CBOR_INTERLOCKED_EXCHANGE(field, value) \
+  ((void)_InterlockedExchange((volatile long*)&(field), (long)(value)))
+#define _CBOR_INTERLOCKED_READ(field) \
+  ((size_t)_InterlockedCompareExchange((volatile long*)&(field), 0, 0))
+#define _CBOR_INTERLOCKED_ADD(field, value) \
+  ((void)_InterlockedExchangeAdd((volatile long*)&(field), (long)(value)))
+#endif
+
+static inline bool _cbor_interlocked_cas(volatile size_t* field,
+                                         size_t* expected, size_t desired) {
+#ifdef _WIN64
+  size_t previous = (size_t)_InterlockedCompareExchange64(
+      (volatile __int64*)field, (__int64)desired, (__int64)*expected);
+#else
+  size_t previous = (size_t)_InterlockedCompareExchange(
+      (volatile long*)field, (long)desired, (long)*expected);
+#endif
+  if (previous == *expected) return true;
+  *expected = previous;
+  return false;
+}
+
+static inline bool _cbor_interlocked_cas_pointer(void* volatile* field,
+                                                 void** expected,
+                                                 void* desired) {
+  void* previous =
+      _InterlockedCompareExchangePointer(field, desired, *expected);
+  if (previous == *expected) return true;
+  *expected = previous;
+  return false;
+}
+
+/* 64-bit operations built on the compare-exchange, which unlike the other
+ * 64-bit intrinsics is also available on 32-bit x86 */
+static inline bool _cbor_interlocked_cas64(volatile uint64_t* field,
+                                           uint64_t* expected,
+                                           uint64_t desired) {
+  uint64_t previous = (uint64_t)_InterlockedCompareExchange64(
+      (volatile __int64*)field, (__int64)desired, (__int64)*expected);
+  if (previous == *expected) return true;
+  *expected = previous;
+  return false;
+}
+
+static inline uint64_t _cbor_interlocked_read64(volatile uint64_t* field) {
+  return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)field, 0,
+                                                 0);
+}
+
+static inline void _cbor_interlocked_store64(volatile uint64_t* field,
+                                             uint64_t value) {
+  uint64_t current = _cbor_interlocked_read64(field);
+  while (!_cbor_interlocked_cas64(field, &current, value)) {
+  }
+}
+
+static inline void _cbor_interlocked_add64(volatile uint64_t* field,
+                                           uint64_t value) {
+  uint64_t current = _cbor_interlocked_read64(field);
+  while (!_cbor_interlocked_cas64(field, &current, current + value)) {
+  }
+}
+
+#define _CBOR_ATOMIC_LOAD(field) _CBOR_INTERLOCKED_READ(field)
+#define _CBOR_ATOMIC_STORE(field, value) \
+  _CBOR_INTERLOCKED_EXCHANGE(field, value)
+#define _CBOR_ATOMIC_ADD(field, value) _CBOR_INTERLOCKED_ADD(field, value)
+#define _CBOR_ATOMIC_CAS(field, expected, desired) \
+  _cbor_interlocked_cas(&(field), &(expected), desired)
+#define _CBOR_ATOMIC64_LOAD(field) _cbor_interlocked_read64(&(field))
+#define _CBOR_ATOMIC64_STORE(field, value) \
+  _cbor_interlocked_store64(&(field), value)
+#define _CBOR_ATOMIC64_ADD(field, value) \
+  _cbor_interlocked_add64(&(field), value)
+#define _CBOR_ATOMIC64_CAS(field, expected, desired) \
+  _cbor_interlocked_cas64(&(field), &(expected), desired)
+#define _CBOR_ATOMIC_LOAD_POINTER(field) \
+  _InterlockedCompareExchangePointer((void* volatile*)&(field), NULL, NULL)
+#define _CBOR_ATOMIC_CAS_POINTER(field, expected, desired)           \
+  _cbor_interlocked_cas_pointer((void* volatile*)&(field),           \
+                                (void**)&(expected), (void*)(desired))
+
+/** Spin lock for short critical sections, zero when unlocked */
+typedef long _cbor_spin_lock_t;
+
+static inline void _cbor_spin_lock(_cbor_spin_lock_t* lock) {
+  while (_InterlockedExchange((volatile long*)lock, 1)) {
+  }
+}
+
+static inline void _cbor_spin_unlock(_cbor_spin_lock_t* lock) {
+  (void)_InterlockedExchange((volatile long*)lock, 0);
+}
+
+#else
+
+#define _CBOR_HAS_ATOMICS 0
+
+/* Only correct if the state is not used concurrently */
+#define _CBOR_ATOMIC_LOAD(field) (field)
+#define _CBOR_ATOMIC_STORE(field, value) ((field) = (value))
+#define _CBOR_ATOMIC_ADD(field, value) ((void)((field) += (value)))
+#define _CBOR_ATOMIC_CAS(field, expected, desired) \
+  ((field) == (expected) ? ((field) = (desired), true) \
+                         : ((expected) = (field), false))
+#define _CBOR_ATOMIC_LOAD_POINTER(field) _CBOR_ATOMIC_LOAD(field)
+#define _CBOR_ATOMIC_CAS_POINTER(field, expected, desired) \
+  _CBOR_ATOMIC_CAS(field, expected, desired)
+#define _CBOR_ATOMIC64_LOAD(field) _CBOR_ATOMIC_LOAD(field)
+#define _CBOR_ATOMIC64_STORE(field, value) _CBOR_ATOMIC_STORE(field, value)
+#define _CBOR_ATOMIC64_ADD(field, value) _CBOR_ATOMIC_ADD(field, value)
+#define _CBOR_ATOMIC64_CAS(field, expected, desired) \
+  _CBOR_ATOMIC_CAS(field, expected, desired)
+
+#endif
+
+/*
+ * Accessors for item fields that may be touched by several threads sharing an
+ * item: the reference count and the memoized serialized size. With
+ * CBOR_ATOMIC_REFCOUNT, they are atomic operations on the plain size_t fields
+ * (so that the layout of cbor_item_t does not depend on the option). Otherwise,
+ * they are ordinary loads and stores.
+ */
+
+#if CBOR_ATOMIC_REFCOUNT
+
+#if defined(__GNUC__)
+
+#define _CBOR_REFCOUNT_INCREMENT(counter) \
+  ((void)__atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED))
+/* Releases the writes of this thread, and acquires the writes of all other
+ * owners before the item is destroyed. Evaluates to the new count. */
+#define _CBOR_REFCOUNT_DECREMENT(counter) \
+  __atomic_sub_fetch(&(counter), 1, __ATOMIC_ACQ_REL)
+#define _CBOR_SHARED_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define _CBOR_SHARED_STORE(field, value) \
+  __atomic_store_n(&(field), value, __ATOMIC_RELAXED)
+#define _CBOR_SHARED_LOAD_ACQUIRE(field) \
+  __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define _CBOR_SHARED_STORE_RELEASE(field, value) \
+  __atomic_store_n(&(field), value, __ATOMIC_RELEASE)
+
+#elif defined(_MSC_VER)
+
+#define _CBOR_REFCOUNT_INCREMENT(counter) \
+  ((void)_CBOR_INTERLOCKED(Increment, counter))
+#define _CBOR_REFCOUNT_DECREMENT(counter) _CBOR_INTERLOCKED(Decrement, counter)
+#define _CBOR_SHARED_LOAD(field) _CBOR_INTERLOCKED_READ(field)
+#define _CBOR_SHARED_STORE(field, value) \
+  _CBOR_INTERLOCKED_EXCHANGE(field, value)
+#define _CBOR_SHARED_LOAD_ACQUIRE(field) _CBOR_INTERLOCKED_READ(field)
+#define _CBOR_SHARED_STORE_RELEASE(field, value) \
+  _CBOR_INTERLOCKED_EXCHANGE(field, value)
+
+#else
+#error "CBOR_ATOMIC_REFCOUNT requires GCC-compatible atomic builtins or MSVC"
+#endif
+
+#else  // CBOR_ATOMIC_REFCOUNT
+
+#define _CBOR_REFCOUNT_INCREMENT(counter) ((void)(counter)++)
+#define _CBOR_REFCOUNT_DECREMENT(counter) (--(counter))
+#define _CBOR_SHARED_LOAD(field) (field)
+#define _CBOR_SHARED_STORE(field, value) ((field) = (value))
+#define _CBOR_SHARED_LOAD_ACQUIRE(field) (field)
+#define _CBOR_SHARED_STORE_RELEASE(field, value) ((field) = (value))
+
+#endif  // CBOR_ATOMIC_REFCOUNT
+
+/* Pointer fields, e.g. the link from an item to its container. Relaxed. */
+#if CBOR_ATOMIC_REFCOUNT
+#define _CBOR_SHARED_LOAD_POINTER(field) _CBOR_ATOMIC_LOAD_POINTER(field)
+#define _CBOR_SHARED_CAS_POINTER(field, expected, desired) \
+  _CBOR_ATOMIC_CAS_POINTER(field, expected, desired)
+#else
+#define _CBOR_SHARED_LOAD_POINTER(field) (field)
+#define _CBOR_SHARED_CAS_POINTER(field, expected, desired) \
+  ((field) = (desired), true)
+#endif
+
+#endif  // LIBCBOR_ATOMICS_H
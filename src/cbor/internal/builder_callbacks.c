@@ -17,99 +17,103 @@
 #include "../maps.h"
 #include "../strings.h"
 #include "../tags.h"
+#include "memory_utils.h"
 #include "unicode.h"
 
 // `_cbor_builder_append` takes ownership of `item`. If adding the item to
 // parent container fails, `item` will be deallocated to prevent memory.
 void _cbor_builder_append(cbor_item_t* item,
                           struct _cbor_decoder_context* ctx) {
-  if (ctx->stack->size == 0) {
-    /* Top level item */
-    ctx->root = item;
-    return;
-  }
-  /* Part of a bigger structure */
-  switch (ctx->stack->top->item->type) {
-    // Handle Arrays and Maps since they can contain subitems of any type.
-    // Byte/string construction from chunks is handled in the respective chunk
-    // handlers.
-    case CBOR_TYPE_ARRAY: {
-      if (cbor_array_is_definite(ctx->stack->top->item)) {
-        // We don't need an explicit check for whether the item still belongs
-        // into this array because if there are extra items, they will cause a
-        // syntax error when decoded.
-        CBOR_ASSERT(ctx->stack->top->subitems > 0);
-        // This should never happen since the definite array should be
-        // preallocated for the expected number of items.
-        if (!cbor_array_push(ctx->stack->top->item, item)) {
-          ctx->creation_failed = true;
+  // Completing an item may complete its parent as well, in which case the
+  // parent is appended to the grandparent in the next iteration
+  while (item != NULL) {
+    if (ctx->stack->size == 0) {
+      /* Top level item */
+      ctx->root = item;
+      return;
+    }
+    cbor_item_t* completed = NULL;
+    /* Part of a bigger structure */
+    switch (ctx->stack->top->item->type) {
+      // Handle Arrays and Maps since they can contain subitems of any type.
+      // Byte/string construction from chunks is handled in the respective
+      // chunk handlers.
+      case CBOR_TYPE_ARRAY: {
+        if (cbor_array_is_definite(ctx->stack->top->item)) {
+          // We don't need an explicit check for whether the item still
+          // belongs into this array because if there are extra items, they
+          // will cause a syntax error when decoded.
+          CBOR_ASSERT(ctx->stack->top->subitems > 0);
+          // This should never happen since the definite array should be
+          // preallocated for the expected number of items.
+          if (!cbor_array_push(ctx->stack->top->item, item)) {
+            ctx->creation_failed = true;
+            cbor_decref(&item);
+            break;
+          }
+          cbor_decref(&item);
+          ctx->stack->top->subitems--;
+          if (ctx->stack->top->subitems == 0) {
+            completed = ctx->stack->top->item;
+            _cbor_stack_pop(ctx->stack);
+          }
+        } else {
+          /* Indefinite array, don't bother with subitems */
+          if (!cbor_array_push(ctx->stack->top->item, item)) {
+            ctx->creation_failed = true;
+          }
           cbor_decref(&item);
-          break;
-        }
-        cbor_decref(&item);
-        ctx->stack->top->subitems--;
-        if (ctx->stack->top->subitems == 0) {
-          cbor_item_t* stack_item = ctx->stack->top->item;
-          _cbor_stack_pop(ctx->stack);
-          _cbor_builder_append(stack_item, ctx);
         }
-      } else {
-        /* Indefinite array, don't bother with subitems */
-        if (!cbor_array_push(ctx->stack->top->item, item)) {
-          ctx->creation_failed = true;
+        break;
+      }
+      case CBOR_TYPE_MAP: {
+        // Handle both definite and indefinite maps the same initially.
+        // Note: We use 0 and 1 subitems to distinguish between keys and values
+        // in indefinite items
+        if (ctx->stack->top->subitems % 2) {
+          // Odd record, this is a value.
+          ctx->creation_failed =
+              !_cbor_map_add_value(ctx->stack->top->item, item);
+          // Adding a value never fails since the memory is allocated when the
+          // key is added
+          CBOR_ASSERT(!ctx->creation_failed);
+        } else {
+          // Even record, this is a key.
+          if (!_cbor_map_add_key(ctx->stack->top->item, item)) {
+            ctx->creation_failed = true;
+            cbor_decref(&item);
+            break;
+          }
         }
         cbor_decref(&item);
-      }
-      break;
-    }
-    case CBOR_TYPE_MAP: {
-      // Handle both definite and indefinite maps the same initially.
-      // Note: We use 0 and 1 subitems to distinguish between keys and values in
-      // indefinite items
-      if (ctx->stack->top->subitems % 2) {
-        // Odd record, this is a value.
-        ctx->creation_failed =
-            !_cbor_map_add_value(ctx->stack->top->item, item);
-        // Adding a value never fails since the memory is allocated when the
-        // key is added
-        CBOR_ASSERT(!ctx->creation_failed);
-      } else {
-        // Even record, this is a key.
-        if (!_cbor_map_add_key(ctx->stack->top->item, item)) {
-          ctx->creation_failed = true;
-          cbor_decref(&item);
-          break;
+        if (cbor_map_is_definite(ctx->stack->top->item)) {
+          CBOR_ASSERT(ctx->stack->top->subitems > 0);
+          ctx->stack->top->subitems--;
+          if (ctx->stack->top->subitems == 0) {
+            completed = ctx->stack->top->item;
+            _cbor_stack_pop(ctx->stack);
+          }
+        } else {
+          ctx->stack->top->subitems ^=
+              1; /* Flip the indicator for indefinite items */
         }
+        break;
       }
-      cbor_decref(&item);
-      if (cbor_map_is_definite(ctx->stack->top->item)) {
-        CBOR_ASSERT(ctx->stack->top->subitems > 0);
-        ctx->stack->top->subitems--;
-        if (ctx->stack->top->subitems == 0) {
-          cbor_item_t* map_entry = ctx->stack->top->item;
-          _cbor_stack_pop(ctx->stack);
-          _cbor_builder_append(map_entry, ctx);
-        }
-      } else {
-        ctx->stack->top->subitems ^=
-            1; /* Flip the indicator for indefinite items */
+      case CBOR_TYPE_TAG: {
+        CBOR_ASSERT(ctx->stack->top->subitems == 1);
+        cbor_tag_set_item(ctx->stack->top->item, item);
+        cbor_decref(&item); /* Give up on our reference */
+        completed = ctx->stack->top->item;
+        _cbor_stack_pop(ctx->stack);
+        break;
+      }
+      // We have an item to append but nothing to append it to.
+      default: {
+        cbor_decref(&item);
+        ctx->syntax_error = true;
       }
-      break;
-    }
-    case CBOR_TYPE_TAG: {
-      CBOR_ASSERT(ctx->stack->top->subitems == 1);
-      cbor_tag_set_item(ctx->stack->top->item, item);
-      cbor_decref(&item); /* Give up on our reference */
-      cbor_item_t* tagged_item = ctx->stack->top->item;
-      _cbor_stack_pop(ctx->stack);
-      _cbor_builder_append(tagged_item, ctx);
-      break;
-    }
-    // We have an item to append but nothing to append it to.
-    default: {
-      cbor_decref(&item);
-      ctx->syntax_error = true;
     }
+    item = completed;
   }
 }
 
@@ -215,7 +219,9 @@ void cbor_builder_byte_string_callback(void* context, cbor_data data,
                                        uint64_t length) {
   struct _cbor_decoder_context* ctx = context;
   CHECK_LENGTH(ctx, length);
-  unsigned char* new_handle = _cbor_malloc(length);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  unsigned char* new_handle =
+      _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_STRING_DATA, length);
   if (new_handle == NULL) {
     ctx->creation_failed = true;
     return;
@@ -225,7 +231,7 @@ void cbor_builder_byte_string_callback(void* context, cbor_data data,
   cbor_item_t* new_chunk = cbor_new_definite_bytestring();
 
   if (new_chunk == NULL) {
-    _cbor_free(new_handle);
+    _CBOR_FREE(allocator, new_handle);
     ctx->creation_failed = true;
     return;
   }
@@ -257,7 +263,9 @@ void cbor_builder_string_callback(void* context, cbor_data data,
   struct _cbor_decoder_context* ctx = context;
   CHECK_LENGTH(ctx, length);
 
-  unsigned char* new_handle = _cbor_malloc(length);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  unsigned char* new_handle =
+      _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_STRING_DATA, length);
   if (new_handle == NULL) {
     ctx->creation_failed = true;
     return;
@@ -266,7 +274,7 @@ void cbor_builder_string_callback(void* context, cbor_data data,
   memcpy(new_handle, data, length);
   cbor_item_t* new_chunk = cbor_new_definite_string();
   if (new_chunk == NULL) {
-    _cbor_free(new_handle);
+    _CBOR_FREE(allocator, new_handle);
     ctx->creation_failed = true;
     return;
   }
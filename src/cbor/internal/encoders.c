@@ -7,7 +7,10 @@
 
 #include "encoders.h"
 
-#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "uint_kernels.h"
 
 size_t _cbor_encode_uint8(uint8_t value, unsigned char* buffer,
                           size_t buffer_size, uint8_t offset) {
@@ -32,14 +35,7 @@ size_t _cbor_encode_uint16(uint16_t value, unsigned char* buffer,
     return 0;
   }
   buffer[0] = 0x19 + offset;
-
-#ifdef IS_BIG_ENDIAN
-  memcpy(buffer + 1, &value, 2);
-#else
-  buffer[1] = (unsigned char)(value >> 8);
-  buffer[2] = (unsigned char)value;
-#endif
-
+  _cbor_store_be16(buffer + 1, value);
   return 3;
 }
 
@@ -49,51 +45,51 @@ size_t _cbor_encode_uint32(uint32_t value, unsigned char* buffer,
     return 0;
   }
   buffer[0] = 0x1A + offset;
-
-#ifdef IS_BIG_ENDIAN
-  memcpy(buffer + 1, &value, 4);
-#else
-  buffer[1] = (unsigned char)(value >> 24);
-  buffer[2] = (unsigned char)(value >> 16);
-  buffer[3] = (unsigned char)(value >> 8);
-  buffer[4] = (unsigned char)value;
-#endif
-
+  _cbor_store_be32(buffer + 1, value);
   return 5;
 }
 
 size_t _cbor_encode_uint64(uint64_t value, unsigned char* buffer,
                            size_t buffer_size, uint8_t offset) {
-  if (buffer_size >= 9) {
-    buffer[0] = 0x1B + offset;
-
-#ifdef IS_BIG_ENDIAN
-    memcpy(buffer + 1, &value, 8);
-#else
-    buffer[1] = (unsigned char)(value >> 56);
-    buffer[2] = (unsigned char)(value >> 48);
-    buffer[3] = (unsigned char)(value >> 40);
-    buffer[4] = (unsigned char)(value >> 32);
-    buffer[5] = (unsigned char)(value >> 24);
-    buffer[6] = (unsigned char)(value >> 16);
-    buffer[7] = (unsigned char)(value >> 8);
-    buffer[8] = (unsigned char)value;
-#endif
-
-    return 9;
-  } else
+  if (buffer_size < 9) {
     return 0;
+  }
+  buffer[0] = 0x1B + offset;
+  _cbor_store_be64(buffer + 1, value);
+  return 9;
 }
 
 size_t _cbor_encode_uint(uint64_t value, unsigned char* buffer,
                          size_t buffer_size, uint8_t offset) {
-  if (value <= UINT16_MAX)
-    if (value <= UINT8_MAX)
+  switch (_cbor_uint_width_log2(value)) {
+    case 0:
       return _cbor_encode_uint8((uint8_t)value, buffer, buffer_size, offset);
-    else
+    case 1:
       return _cbor_encode_uint16((uint16_t)value, buffer, buffer_size, offset);
-  else if (value <= UINT32_MAX)
-    return _cbor_encode_uint32((uint32_t)value, buffer, buffer_size, offset);
-  else
-    return _cbor_encode_uint64((uint64_t)value, buffer, buffer_size, offset);
+    case 2:
+      return _cbor_encode_uint32((uint32_t)value, buffer, buffer_size, offset);
+    default:
+      return _cbor_encode_uint64(value, buffer, buffer_size, offset);
+  }
+}
+
+/** Can \p value be converted to a half-precision float without loss? */
+static bool _cbor_is_half_exact(double value) {
+  double magnitude = fabs(value);
+  if (magnitude == 0.0) return true;
+  if (magnitude > 65504.0 || magnitude < 0x1p-24) return false;
+  // Halves have 11 significant bits, subnormal ones are multiples of 2^-24
+  int exponent;
+  frexp(magnitude, &exponent);
+  int lowest_bit = exponent - 11 < -24 ? -24 : exponent - 11;
+  double significand = ldexp(magnitude, -lowest_bit);
+  return significand == (double)(uint32_t)significand;
+}
+
+cbor_float_width _cbor_narrowest_float_width(double value) {
+  if (isnan(value) || isinf(value) || _cbor_is_half_exact(value))
+    return CBOR_FLOAT_16;
+  if (fabs(value) <= FLT_MAX && (double)(float)value == value)
+    return CBOR_FLOAT_32;
+  return CBOR_FLOAT_64;
 }
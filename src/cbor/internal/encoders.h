@@ -34,6 +34,11 @@ _CBOR_NODISCARD
 size_t _cbor_encode_uint(uint64_t value, unsigned char* buffer,
                          size_t buffer_size, uint8_t offset);
 
+/** Narrowest float width that represents \p value exactly. NaNs and
+ * infinities fit into half precision. */
+_CBOR_NODISCARD
+cbor_float_width _cbor_narrowest_float_width(double value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// open, fstat, mmap, posix_madvise
+#define _POSIX_C_SOURCE 200809L
+
+#include "file_input.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "memory_utils.h"
+
+/** Initial buffer size when the input size is not known upfront */
+#define _CBOR_FILE_READ_CHUNK 65536
+
+static cbor_error_code _cbor_file_input_read(FILE* file,
+                                             struct _cbor_file_input* input) {
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  unsigned char* buffer = NULL;
+  size_t length = 0, allocated = 0;
+  while (true) {
+    if (length == allocated) {
+      if (!_cbor_safe_to_multiply(CBOR_BUFFER_GROWTH, allocated)) {
+        _CBOR_FREE(allocator, buffer);
+        return CBOR_ERR_MEMERROR;
+      }
+      size_t new_allocation = allocated == 0 ? _CBOR_FILE_READ_CHUNK
+                                             : CBOR_BUFFER_GROWTH * allocated;
+      unsigned char* new_buffer =
+          _CBOR_REALLOC(allocator, CBOR_ALLOC_SITE_OTHER, buffer,
+                        new_allocation);
+      if (new_buffer == NULL) {
+        _CBOR_FREE(allocator, buffer);
+        return CBOR_ERR_MEMERROR;
+      }
+      buffer = new_buffer;
+      allocated = new_allocation;
+    }
+    size_t read = fread(buffer + length, 1, allocated - length, file);
+    length += read;
+    if (read == 0) break;
+  }
+  if (ferror(file)) {
+    _CBOR_FREE(allocator, buffer);
+    return CBOR_ERR_IO;
+  }
+  *input = (struct _cbor_file_input){.data = buffer,
+                                     .length = length,
+                                     .mapped = false,
+                                     .allocator = allocator};
+  return CBOR_ERR_NONE;
+}
+
+#ifndef _WIN32
+/** @return false if the file cannot be mapped, but may still be readable */
+static bool _cbor_file_input_map(int fd, struct _cbor_file_input* input) {
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) return false;
+  if ((uintmax_t)file_stat.st_size > SIZE_MAX) return false;
+  size_t length = (size_t)file_stat.st_size;
+  if (length == 0) {
+    // Zero-length mappings are not allowed
+    *input = (struct _cbor_file_input){
+        .data = NULL, .length = 0, .mapped = false};
+    return true;
+  }
+  void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) return false;
+  // The decoder touches every byte exactly once, front to back. This is only
+  // a hint, failures are harmless.
+  (void)posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+  *input = (struct _cbor_file_input){
+      .data = mapping, .length = length, .mapped = true};
+  return true;
+}
+#endif
+
+cbor_error_code _cbor_file_input_open(const char* path, bool allow_mmap,
+                                      struct _cbor_file_input* input) {
+#ifndef _WIN32
+  if (allow_mmap) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return CBOR_ERR_IO;
+    bool mapped = _cbor_file_input_map(fd, input);
+    // The mapping remains valid after the descriptor is closed
+    close(fd);
+    if (mapped) return CBOR_ERR_NONE;
+  }
+#else
+  (void)allow_mmap;
+#endif
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) return CBOR_ERR_IO;
+  cbor_error_code result = _cbor_file_input_read(file, input);
+  fclose(file);
+  return result;
+}
+
+void _cbor_file_input_close(struct _cbor_file_input* input) {
+#ifndef _WIN32
+  if (input->mapped) {
+    munmap((void*)input->data, input->length);
+    return;
+  }
+#endif
+  _CBOR_FREE(input->allocator, (void*)input->data);
+}
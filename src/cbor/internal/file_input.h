@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_FILE_INPUT_H
+#define LIBCBOR_FILE_INPUT_H
+
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Contents of an input file, either mapped or read into the heap */
+struct _cbor_file_input {
+  const unsigned char* data;
+  size_t length;
+  bool mapped;
+  /** Owner of #data unless it is mapped */
+  const struct cbor_allocator* allocator;
+};
+
+/** Make the contents of the file at `path` available in memory
+ *
+ * Regular files are mapped read-only with a sequential access hint unless
+ * `allow_mmap` is false. Everything else (pipes, platforms without `mmap`) is
+ * read into a heap buffer.
+ *
+ * @return #CBOR_ERR_NONE, #CBOR_ERR_IO, or #CBOR_ERR_MEMERROR
+ */
+_CBOR_NODISCARD
+cbor_error_code _cbor_file_input_open(const char* path, bool allow_mmap,
+                                      struct _cbor_file_input* input);
+
+void _cbor_file_input_close(struct _cbor_file_input* input);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_FILE_INPUT_H
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "formatting.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+char* _cbor_format_uint(uint64_t value, char* end) {
+  do {
+    *--end = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  return end;
+}
+
+size_t _cbor_format_float(double value, bool single, char* buffer) {
+  // Enough digits to represent any float (double) exactly
+  const int max_precision = single ? 9 : 17;
+  int length;
+  for (int precision = single ? 6 : 15;; precision++) {
+    length = snprintf(buffer, _CBOR_FLOAT_FORMAT_SIZE - 2, "%.*g", precision,
+                      value);
+    if (precision == max_precision) break;
+    if (single ? strtof(buffer, NULL) == (float)value
+               : strtod(buffer, NULL) == value)
+      break;
+  }
+  bool integral = true;
+  for (int i = 0; i < length; i++) {
+    // The decimal separator depends on the locale
+    if (buffer[i] == ',') buffer[i] = '.';
+    if (buffer[i] == '.' || buffer[i] == 'e') integral = false;
+  }
+  if (integral) {
+    buffer[length++] = '.';
+    buffer[length++] = '0';
+  }
+  return (size_t)length;
+}
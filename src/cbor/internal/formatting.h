@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_FORMATTING_H
+#define LIBCBOR_FORMATTING_H
+
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Size of a buffer that fits any output of #_cbor_format_float */
+#define _CBOR_FLOAT_FORMAT_SIZE 32
+
+/** Format \p value in decimal, ending at \p end
+ *
+ * @param value The value
+ * @param end End of a buffer of at least 20 characters
+ * @return The first digit
+ */
+_CBOR_NODISCARD
+char* _cbor_format_uint(uint64_t value, char* end);
+
+/** Format the shortest decimal representation that converts back to \p value
+ *
+ * The output always contains a fraction or an exponent, so that it can be
+ * told apart from an integer, and uses `.` regardless of the locale.
+ *
+ * @param value A finite value
+ * @param single Whether \p value is a single (or half) precision float
+ * @param buffer Buffer of #_CBOR_FLOAT_FORMAT_SIZE characters. The output is
+ *  not NUL-terminated.
+ * @return The length of the output
+ */
+_CBOR_NODISCARD
+size_t _cbor_format_float(double value, bool single, char* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_FORMATTING_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_INSTRUMENTATION_H
+#define LIBCBOR_INSTRUMENTATION_H
+
+#include "cbor/common.h"
+#include "cbor/decoder_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Probes for cbor_decoder_stats. They expand to nothing unless
+ * CBOR_DECODER_STATS is enabled, so the decode path is unchanged by default.
+ */
+
+#if CBOR_DECODER_STATS
+/** Record a decoded item header starting with `initial_byte` */
+void _cbor_decoder_stats_item(uint8_t initial_byte, size_t read);
+
+/** Monotonic timestamp for measuring cbor_load */
+uint64_t _cbor_decoder_stats_now_ns(void);
+
+/** Record a completed cbor_load call */
+void _cbor_decoder_stats_load(bool failed, size_t max_depth,
+                              uint64_t start_ns);
+
+#define _CBOR_DECODER_STATS_ITEM(initial_byte, read) \
+  _cbor_decoder_stats_item(initial_byte, read)
+#else
+#define _CBOR_DECODER_STATS_ITEM(initial_byte, read) \
+  do {                                               \
+  } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_INSTRUMENTATION_H
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "item_pool.h"
+#include "atomics.h"
+
+#if _CBOR_ITEM_POOL_ENABLED
+
+#if !_CBOR_HAS_ATOMICS
+#error "CBOR_ITEM_POOL requires GCC-compatible atomic builtins or MSVC"
+#endif
+
+#ifdef CBOR_POOL_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Free slots are kept in batches of _CBOR_POOL_BATCH slots, linked through
+ * their first word. Each thread caches up to two batches: the one it takes
+ * slots from and returns them to, and a full spare. Only whole batches are
+ * exchanged with the global list, so the lock is taken once per
+ * _CBOR_POOL_BATCH allocations or frees at most, and alternating between the
+ * two never bounces a batch back and forth.
+ *
+ * Slabs are never released, the pool stays as large as the peak number of
+ * live items plus the caches of running threads. With CBOR_POOL_PTHREADS, a
+ * thread returns its cache to the global list when it exits, including a
+ * partial batch. Otherwise, the slots cached by a thread are lost when it
+ * exits.
+ */
+
+#define _CBOR_POOL_BATCH 256
+
+/** Multiple of 16 bytes to keep the alignment malloc would provide */
+#define _CBOR_POOL_SLOT_SIZE ((_CBOR_ITEM_POOL_MAX_SIZE + 15) & ~(size_t)15)
+
+struct _cbor_pool_slot {
+  struct _cbor_pool_slot* next;
+  /** Next batch in the global list. Only used in the first slot of a batch. */
+  struct _cbor_pool_slot* next_batch;
+  /** Number of slots in the batch. Only used in the first slot of a batch. */
+  size_t count;
+};
+
+struct _cbor_pool_cache {
+  /** Current batch, `count` slots */
+  struct _cbor_pool_slot* head;
+  size_t count;
+  /** A full batch, or NULL */
+  struct _cbor_pool_slot* spare;
+  /** Whether the cache is returned when the thread exits */
+  bool watched;
+};
+
+static _CBOR_THREAD_LOCAL struct _cbor_pool_cache _cbor_pool_cache;
+
+/** Full batches not cached by any thread */
+static struct _cbor_pool_slot* _cbor_pool_batches;
+
+static _cbor_spin_lock_t _cbor_pool_lock;
+
+/** Get a batch from the global list or a full one from a new slab
+ *
+ * @param[out] count The number of slots in the batch
+ */
+static struct _cbor_pool_slot* _cbor_pool_take_batch(size_t* count) {
+  _cbor_spin_lock(&_cbor_pool_lock);
+  struct _cbor_pool_slot* batch = _cbor_pool_batches;
+  if (batch != NULL) _cbor_pool_batches = batch->next_batch;
+  _cbor_spin_unlock(&_cbor_pool_lock);
+  if (batch != NULL) {
+    *count = batch->count;
+    return batch;
+  }
+
+  unsigned char* slab = _cbor_malloc(_CBOR_POOL_BATCH * _CBOR_POOL_SLOT_SIZE);
+  if (slab == NULL) return NULL;
+  struct _cbor_pool_slot* next = NULL;
+  for (size_t i = _CBOR_POOL_BATCH; i > 0; i--) {
+    struct _cbor_pool_slot* slot =
+        (struct _cbor_pool_slot*)(slab + (i - 1) * _CBOR_POOL_SLOT_SIZE);
+    slot->next = next;
+    next = slot;
+  }
+  *count = _CBOR_POOL_BATCH;
+  return (struct _cbor_pool_slot*)slab;
+}
+
+static void _cbor_pool_give_batch(struct _cbor_pool_slot* batch,
+                                  size_t count) {
+  batch->count = count;
+  _cbor_spin_lock(&_cbor_pool_lock);
+  batch->next_batch = _cbor_pool_batches;
+  _cbor_pool_batches = batch;
+  _cbor_spin_unlock(&_cbor_pool_lock);
+}
+
+#ifdef CBOR_POOL_PTHREADS
+/** Set in threads that cache slots, to return them when the thread exits */
+static pthread_key_t _cbor_pool_key;
+static bool _cbor_pool_key_created;
+static pthread_once_t _cbor_pool_key_once = PTHREAD_ONCE_INIT;
+
+/** Destructor of #_cbor_pool_key */
+static void _cbor_pool_flush(void* pointer) {
+  struct _cbor_pool_cache* cache = pointer;
+  if (cache->count > 0) _cbor_pool_give_batch(cache->head, cache->count);
+  if (cache->spare != NULL)
+    _cbor_pool_give_batch(cache->spare, _CBOR_POOL_BATCH);
+  *cache = (struct _cbor_pool_cache){NULL, 0, NULL, false};
+}
+
+static void _cbor_pool_create_key(void) {
+  _cbor_pool_key_created =
+      pthread_key_create(&_cbor_pool_key, _cbor_pool_flush) == 0;
+}
+#endif
+
+/** Make sure the slots in \p cache are returned when the thread exits. Items
+ * may still be created and freed while the thread is exiting, in which case
+ * the cache is watched again. */
+static void _cbor_pool_watch(struct _cbor_pool_cache* cache) {
+#ifdef CBOR_POOL_PTHREADS
+  pthread_once(&_cbor_pool_key_once, _cbor_pool_create_key);
+  if (_cbor_pool_key_created) pthread_setspecific(_cbor_pool_key, cache);
+#endif
+  cache->watched = true;
+}
+
+void* _cbor_item_pool_get(void) {
+  struct _cbor_pool_cache* cache = &_cbor_pool_cache;
+  if (cache->count == 0) {
+    if (cache->spare != NULL) {
+      cache->head = cache->spare;
+      cache->spare = NULL;
+      cache->count = _CBOR_POOL_BATCH;
+    } else {
+      cache->head = _cbor_pool_take_batch(&cache->count);
+      if (cache->head == NULL) return NULL;
+      if (!cache->watched) _cbor_pool_watch(cache);
+    }
+  }
+  struct _cbor_pool_slot* slot = cache->head;
+  cache->head = slot->next;
+  cache->count--;
+  return slot;
+}
+
+void _cbor_item_pool_put(void* pointer) {
+  struct _cbor_pool_cache* cache = &_cbor_pool_cache;
+  if (cache->count == _CBOR_POOL_BATCH) {
+    if (cache->spare != NULL)
+      _cbor_pool_give_batch(cache->spare, _CBOR_POOL_BATCH);
+    cache->spare = cache->head;
+    cache->head = NULL;
+    cache->count = 0;
+  } else if (!cache->watched) {
+    _cbor_pool_watch(cache);
+  }
+  struct _cbor_pool_slot* slot = pointer;
+  slot->next = cache->head;
+  cache->head = slot;
+  cache->count++;
+}
+
+#endif  // _CBOR_ITEM_POOL_ENABLED
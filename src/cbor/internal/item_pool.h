@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_ITEM_POOL_H
+#define LIBCBOR_ITEM_POOL_H
+
+#include "cbor/common.h"
+#include "memory_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every item is an allocation of (nearly) the same size, so with
+ * CBOR_ITEM_POOL, items are carved out of slabs instead and recycled through
+ * per-thread free lists. The pool only serves items that would otherwise come
+ * from the default global hooks: items of a #cbor_allocator, or created while
+ * custom hooks are installed, are allocated as usual. Allocation statistics
+ * need to see every allocation, so CBOR_ALLOC_STATS disables the pool.
+ */
+#if CBOR_ITEM_POOL && !CBOR_ALLOC_STATS
+#define _CBOR_ITEM_POOL_ENABLED 1
+#else
+#define _CBOR_ITEM_POOL_ENABLED 0
+#endif
+
+/** Largest item allocation: an item with 8 bytes of inline data */
+#define _CBOR_ITEM_POOL_MAX_SIZE (sizeof(cbor_item_t) + 8)
+
+/** Take a slot of at least #_CBOR_ITEM_POOL_MAX_SIZE bytes
+ *
+ * @return The slot, or NULL if a new slab could not be allocated
+ */
+_CBOR_NODISCARD
+void* _cbor_item_pool_get(void);
+
+/** Return a slot obtained from #_cbor_item_pool_get */
+void _cbor_item_pool_put(void* slot);
+
+/** Do items of \p allocator come from the pool? Must give the same answer
+ * when the item is allocated and when it is freed, which holds since the hooks
+ * must not be changed while items exist. */
+static inline bool _cbor_item_pool_serves(
+    const struct cbor_allocator* allocator) {
+  return allocator == NULL && _cbor_malloc == malloc;
+}
+
+/** Allocate an item with \p size - `sizeof(cbor_item_t)` bytes of inline data
+ */
+static inline void* _cbor_item_malloc(const struct cbor_allocator* allocator,
+                                      size_t size) {
+#if _CBOR_ITEM_POOL_ENABLED
+  CBOR_ASSERT(size <= _CBOR_ITEM_POOL_MAX_SIZE);
+  if (_cbor_item_pool_serves(allocator)) return _cbor_item_pool_get();
+#endif
+  return _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_ITEMS, size);
+}
+
+/** Free an item allocated by #_cbor_item_malloc */
+static inline void _cbor_item_free(const struct cbor_allocator* allocator,
+                                   cbor_item_t* item) {
+#if _CBOR_ITEM_POOL_ENABLED
+  if (_cbor_item_pool_serves(allocator)) {
+    _cbor_item_pool_put(item);
+    return;
+  }
+#endif
+  _CBOR_FREE(allocator, item);
+}
+
+// _CBOR_DEPENDENT_NOTNULL for items allocated by _cbor_item_malloc
+#define _CBOR_ITEM_DEPENDENT_NOTNULL(allocator, item, pointer) \
+  do {                                                         \
+    if (pointer == NULL) {                                     \
+      _cbor_item_free(allocator, item);                        \
+      return NULL;                                             \
+    }                                                          \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_ITEM_POOL_H
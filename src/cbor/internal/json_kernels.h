@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_JSON_KERNELS_H
+#define LIBCBOR_JSON_KERNELS_H
+
+#include <string.h>
+
+#include "cbor/common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define _CBOR_JSON_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * String scanning kernels for the JSON conversion and the diagnostic notation,
+ * which share the JSON string syntax. Most string contents do not need
+ * escaping, so the hot loop looks for the next quote, backslash, or control
+ * character 16 bytes at a time using SSE2 where available, and 8 bytes
+ * at a time using word-sized arithmetic (SWAR) otherwise. The SWAR test only
+ * tells whether a word contains such a byte; the exact position is found
+ * bytewise, which keeps the fallback independent of the byte order.
+ */
+
+static inline bool _cbor_json_needs_escape(unsigned char byte) {
+  return byte < 0x20 || byte == '"' || byte == '\\';
+}
+
+#ifdef _CBOR_JSON_SSE2
+static inline unsigned _cbor_json_ctz(unsigned mask) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (unsigned)index;
+#else
+  unsigned index = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    index++;
+  }
+  return index;
+#endif
+}
+#else
+/** Bytes of \p word that are zero have the top bit set. Exact as long as only
+ * the presence of such bytes is of interest. */
+#define _CBOR_JSON_SWAR_ZERO(word) \
+  (((word) - 0x0101010101010101ULL) & ~(word) & 0x8080808080808080ULL)
+#endif
+
+/** Get the length of the prefix of \p data that can be copied to a JSON
+ * string without escaping */
+static inline size_t _cbor_json_plain_prefix(const unsigned char* data,
+                                             size_t length) {
+  size_t i = 0;
+#ifdef _CBOR_JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                     _mm_cmpeq_epi8(chunk, backslash)),
+        // Unsigned chunk <= 0x1F
+        _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+    unsigned mask = (unsigned)_mm_movemask_epi8(special);
+    if (mask != 0) return i + _cbor_json_ctz(mask);
+  }
+#else
+  for (; i + 8 <= length; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    uint64_t special =
+        _CBOR_JSON_SWAR_ZERO(word ^ 0x2222222222222222ULL) |
+        _CBOR_JSON_SWAR_ZERO(word ^ 0x5C5C5C5C5C5C5C5CULL) |
+        // Bytes less than 0x20
+        ((word - 0x2020202020202020ULL) & ~word & 0x8080808080808080ULL);
+    if (special != 0) break;
+  }
+#endif
+  while (i < length && !_cbor_json_needs_escape(data[i])) i++;
+  return i;
+}
+
+/** Get the escape sequence for a byte that cannot appear in a JSON string
+ *
+ * @param byte A byte for which #_cbor_json_needs_escape holds
+ * @param sequence Buffer of at least 6 characters
+ * @return The length of the sequence
+ */
+static inline size_t _cbor_json_escape_sequence(unsigned char byte,
+                                                char* sequence) {
+  static const char hex[] = "0123456789abcdef";
+  sequence[0] = '\\';
+  switch (byte) {
+    case '"':
+    case '\\':
+      sequence[1] = (char)byte;
+      return 2;
+    case '\b':
+      sequence[1] = 'b';
+      return 2;
+    case '\f':
+      sequence[1] = 'f';
+      return 2;
+    case '\n':
+      sequence[1] = 'n';
+      return 2;
+    case '\r':
+      sequence[1] = 'r';
+      return 2;
+    case '\t':
+      sequence[1] = 't';
+      return 2;
+    default:
+      memcpy(sequence + 1, "u00", 3);
+      sequence[4] = hex[byte >> 4];
+      sequence[5] = hex[byte & 0x0F];
+      return 6;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_JSON_KERNELS_H
@@ -9,45 +9,7 @@
 #include <math.h>
 #include <string.h>
 
-uint8_t _cbor_load_uint8(cbor_data source) { return (uint8_t)*source; }
-
-uint16_t _cbor_load_uint16(const unsigned char* source) {
-#ifdef IS_BIG_ENDIAN
-  uint16_t result;
-  memcpy(&result, source, 2);
-  return result;
-#else
-  return ((uint16_t) * (source + 0) << 8) + (uint8_t) * (source + 1);
-#endif
-}
-
-uint32_t _cbor_load_uint32(const unsigned char* source) {
-#ifdef IS_BIG_ENDIAN
-  uint32_t result;
-  memcpy(&result, source, 4);
-  return result;
-#else
-  return ((uint32_t) * (source + 0) << 0x18) +
-         ((uint32_t) * (source + 1) << 0x10) +
-         ((uint16_t) * (source + 2) << 0x08) + (uint8_t) * (source + 3);
-#endif
-}
-
-uint64_t _cbor_load_uint64(const unsigned char* source) {
-#ifdef IS_BIG_ENDIAN
-  uint64_t result;
-  memcpy(&result, source, 8);
-  return result;
-#else
-  return ((uint64_t) * (source + 0) << 0x38) +
-         ((uint64_t) * (source + 1) << 0x30) +
-         ((uint64_t) * (source + 2) << 0x28) +
-         ((uint64_t) * (source + 3) << 0x20) +
-         ((uint32_t) * (source + 4) << 0x18) +
-         ((uint32_t) * (source + 5) << 0x10) +
-         ((uint16_t) * (source + 6) << 0x08) + (uint8_t) * (source + 7);
-#endif
-}
+#include "cbor/big_endian.h"
 
 /* As per https://www.rfc-editor.org/rfc/rfc8949.html#name-half-precision */
 float _cbor_decode_half(unsigned char* halfp) {
@@ -71,6 +33,8 @@ float _cbor_load_half(cbor_data source) {
   return _cbor_decode_half((unsigned char*)source);
 }
 
+float cbor_load_half(cbor_data source) { return _cbor_load_half(source); }
+
 float _cbor_load_float(cbor_data source) {
   // TODO: Broken if we are not on IEEE 754
   // (https://github.com/PJK/libcbor/issues/336)
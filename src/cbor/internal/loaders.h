@@ -9,23 +9,28 @@
 #define LIBCBOR_LOADERS_H
 
 #include "cbor/common.h"
+#include "uint_kernels.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Read the given uint from the given location, no questions asked */
-_CBOR_NODISCARD
-uint8_t _cbor_load_uint8(const unsigned char* source);
+static inline uint8_t _cbor_load_uint8(const unsigned char* source) {
+  return *source;
+}
 
-_CBOR_NODISCARD
-uint16_t _cbor_load_uint16(const unsigned char* source);
+static inline uint16_t _cbor_load_uint16(const unsigned char* source) {
+  return _cbor_load_be16(source);
+}
 
-_CBOR_NODISCARD
-uint32_t _cbor_load_uint32(const unsigned char* source);
+static inline uint32_t _cbor_load_uint32(const unsigned char* source) {
+  return _cbor_load_be32(source);
+}
 
-_CBOR_NODISCARD
-uint64_t _cbor_load_uint64(const unsigned char* source);
+static inline uint64_t _cbor_load_uint64(const unsigned char* source) {
+  return _cbor_load_be64(source);
+}
 
 _CBOR_NODISCARD
 float _cbor_load_half(cbor_data source);
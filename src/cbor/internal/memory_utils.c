@@ -39,18 +39,22 @@ size_t _cbor_safe_signaling_add(size_t a, size_t b) {
   return 0;
 }
 
-void* _cbor_alloc_multiple(size_t item_size, size_t item_count) {
+void* _cbor_alloc_multiple(const struct cbor_allocator* allocator,
+                           size_t item_size, size_t item_count) {
   if (_cbor_safe_to_multiply(item_size, item_count)) {
-    return _cbor_malloc(item_size * item_count);
+    return _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_CONTAINERS,
+                        item_size * item_count);
   } else {
     return NULL;
   }
 }
 
-void* _cbor_realloc_multiple(void* pointer, size_t item_size,
+void* _cbor_realloc_multiple(const struct cbor_allocator* allocator,
+                             void* pointer, size_t item_size,
                              size_t item_count) {
   if (_cbor_safe_to_multiply(item_size, item_count)) {
-    return _cbor_realloc(pointer, item_size * item_count);
+    return _CBOR_REALLOC(allocator, CBOR_ALLOC_SITE_CONTAINERS, pointer,
+                         item_size * item_count);
   } else {
     return NULL;
   }
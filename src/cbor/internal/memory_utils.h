@@ -11,8 +11,21 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "cbor/alloc_stats.h"
 #include "cbor/common.h"
 
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_THREADS__)
+#define _CBOR_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define _CBOR_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define _CBOR_THREAD_LOCAL __declspec(thread)
+#else
+// No thread-local storage; the state is shared by all threads
+#define _CBOR_THREAD_LOCAL
+#endif
+
 /** Can `a` and `b` be multiplied without overflowing size_t? */
 _CBOR_NODISCARD
 bool _cbor_safe_to_multiply(size_t a, size_t b);
@@ -25,26 +38,86 @@ bool _cbor_safe_to_add(size_t a, size_t b);
 _CBOR_NODISCARD
 size_t _cbor_safe_signaling_add(size_t a, size_t b);
 
+/** Allocate using `allocator`, or the global hooks if it is `NULL` */
+static inline void* _cbor_allocator_malloc(
+    const struct cbor_allocator* allocator, size_t size) {
+  if (allocator == NULL) return _cbor_malloc(size);
+  return allocator->allocate(allocator->context, size);
+}
+
+/** Reallocate using `allocator`, or the global hooks if it is `NULL` */
+static inline void* _cbor_allocator_realloc(
+    const struct cbor_allocator* allocator, void* pointer, size_t size) {
+  if (allocator == NULL) return _cbor_realloc(pointer, size);
+  return allocator->reallocate(allocator->context, pointer, size);
+}
+
+/** Free using `allocator`, or the global hooks if it is `NULL` */
+static inline void _cbor_allocator_free(const struct cbor_allocator* allocator,
+                                        void* pointer) {
+  if (allocator == NULL) {
+    _cbor_free(pointer);
+  } else {
+    allocator->deallocate(allocator->context, pointer);
+  }
+}
+
+#if CBOR_ALLOC_STATS
+/* Allocator wrappers that record cbor_alloc_stats, see alloc_stats.c */
+void* _cbor_tracked_malloc(const struct cbor_allocator* allocator,
+                           cbor_alloc_site site, size_t size);
+void* _cbor_tracked_realloc(const struct cbor_allocator* allocator,
+                            cbor_alloc_site site, void* pointer, size_t size);
+void _cbor_tracked_free(const struct cbor_allocator* allocator, void* pointer);
+
+#define _CBOR_MALLOC(allocator, site, size) \
+  _cbor_tracked_malloc(allocator, site, size)
+#define _CBOR_REALLOC(allocator, site, pointer, size) \
+  _cbor_tracked_realloc(allocator, site, pointer, size)
+#define _CBOR_FREE(allocator, pointer) _cbor_tracked_free(allocator, pointer)
+#else
+/* Allocation through a cbor_allocator (NULL for the global hooks), attributed
+ * to a cbor_alloc_site when statistics are enabled */
+#define _CBOR_MALLOC(allocator, site, size) \
+  _cbor_allocator_malloc(allocator, size)
+#define _CBOR_REALLOC(allocator, site, pointer, size) \
+  _cbor_allocator_realloc(allocator, pointer, size)
+#define _CBOR_FREE(allocator, pointer) _cbor_allocator_free(allocator, pointer)
+#endif
+
+// Macro to short-circuit builders when memory allocation of nested data fails
+#define _CBOR_DEPENDENT_NOTNULL(allocator, object, pointer) \
+  do {                                                      \
+    if (pointer == NULL) {                                  \
+      _CBOR_FREE(allocator, object);                        \
+      return NULL;                                          \
+    }                                                       \
+  } while (0)
+
 /** Overflow-proof contiguous array allocation
  *
+ * @param allocator Allocator to use, `NULL` for the global hooks
  * @param item_size
  * @param item_count
  * @return Region of item_size * item_count bytes, or NULL if the total size
  * overflows size_t or the underlying allocator failed
  */
-void* _cbor_alloc_multiple(size_t item_size, size_t item_count);
+void* _cbor_alloc_multiple(const struct cbor_allocator* allocator,
+                           size_t item_size, size_t item_count);
 
 /** Overflow-proof contiguous array reallocation
  *
  * This implements the OpenBSD `reallocarray` functionality.
  *
+ * @param allocator Allocator to use, `NULL` for the global hooks
  * @param pointer
  * @param item_size
  * @param item_count
  * @return Realloc'd of item_size * item_count bytes, or NULL if the total size
  * overflows size_t or the underlying allocator failed
  */
-void* _cbor_realloc_multiple(void* pointer, size_t item_size,
+void* _cbor_realloc_multiple(const struct cbor_allocator* allocator,
+                             void* pointer, size_t item_size,
                              size_t item_count);
 
 #endif  // LIBCBOR_MEMORY_UTILS_H
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "size_cache.h"
+#include "atomics.h"
+
+// The generation lives in the upper bits, the lowest bit records whether the
+// current generation has been observed. Keeping both in one word lets a
+// mutator decide whether to bump with a single atomic operation, so a size
+// cached by one thread is never missed by a mutation in the same thread.
+static size_t _cbor_size_cache_state = 2;
+
+size_t _cbor_size_cache_generation(void) {
+  size_t state = _CBOR_ATOMIC_LOAD(_cbor_size_cache_state);
+  while (!(state & 1)) {
+    if (_CBOR_ATOMIC_CAS(_cbor_size_cache_state, state, state | 1)) break;
+  }
+  return state >> 1;
+}
+
+static void _cbor_size_cache_advance(void) {
+  size_t state = _CBOR_ATOMIC_LOAD(_cbor_size_cache_state);
+  while (state & 1) {
+    // Skip 0 on overflow, it denotes "never cached"
+    size_t next = (state + 1) == 0 ? 2 : state + 1;
+    if (_CBOR_ATOMIC_CAS(_cbor_size_cache_state, state, next)) break;
+  }
+}
+
+// Links are only written by the thread modifying the container, but with
+// CBOR_ATOMIC_REFCOUNT, the child may be shared with other threads that add
+// it to or release it from their own containers.
+#define _CBOR_PARENT_LOAD(item) _CBOR_SHARED_LOAD_POINTER((item)->parent)
+#define _CBOR_PARENT_CAS(item, expected, desired) \
+  _CBOR_SHARED_CAS_POINTER((item)->parent, expected, desired)
+
+void _cbor_size_cache_invalidate(cbor_item_t* item) {
+  while (item != NULL) {
+    struct _cbor_size_cache* cache = _cbor_size_cache_of(item);
+    if (cache != NULL) {
+      // Memoizing a size memoizes the sizes of all nested items, so if this one
+      // is not memoized, neither are those of the ancestors
+      if (_CBOR_SHARED_LOAD(cache->generation) == 0) return;
+      _CBOR_SHARED_STORE(cache->generation, 0);
+    }
+    cbor_item_t* parent = _CBOR_PARENT_LOAD(item);
+    if (parent == item) {
+      _cbor_size_cache_advance();
+      return;
+    }
+    item = parent;
+  }
+}
+
+void _cbor_size_cache_link(cbor_item_t* parent, cbor_item_t* child) {
+  if (cbor_is_frozen(child)) return;
+  cbor_item_t* expected = _CBOR_PARENT_LOAD(child);
+  while (true) {
+    cbor_item_t* desired =
+        expected == NULL || expected == parent ? parent : child;
+    if (desired == expected || _CBOR_PARENT_CAS(child, expected, desired))
+      return;
+  }
+}
+
+void _cbor_size_cache_unlink(const cbor_item_t* parent, cbor_item_t* child) {
+  if (cbor_is_frozen(child)) return;
+  cbor_item_t* expected = (cbor_item_t*)parent;
+  // Items with several containers stay marked even if only one remains
+  if (_CBOR_PARENT_LOAD(child) == expected)
+    (void)_CBOR_PARENT_CAS(child, expected, NULL);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_SIZE_CACHE_H
+#define LIBCBOR_SIZE_CACHE_H
+
+#include "cbor/common.h"
+#include "walker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Containers and tags memoize their #cbor_serialized_size. A size-changing
+ * mutation has to invalidate the memoized sizes of all ancestors of the
+ * modified item, so every item records the container it has been added to in
+ * cbor_item_t#parent, and mutators clear the sizes along that chain.
+ *
+ * Items are reference counted and may be added to several containers, whose
+ * ancestors cannot all be found. Such items point to themselves, and modifying
+ * them starts a new process-wide generation instead: every memoized size is
+ * stamped with the generation it was computed in and is only valid within it.
+ * The generation only advances if a size has been memoized since the last
+ * bump.
+ *
+ * Frozen items are never modified, they are not linked to their containers.
+ */
+
+/** Get the current generation and mark it as observed.
+ *
+ * @return Generation number to stamp cached sizes with. Never 0.
+ */
+_CBOR_NODISCARD
+size_t _cbor_size_cache_generation(void);
+
+/** Memoized size of \p item, or NULL if it does not have one */
+static inline struct _cbor_size_cache* _cbor_size_cache_of(cbor_item_t* item) {
+  switch (item->type) {
+    case CBOR_TYPE_ARRAY:
+      return &item->metadata.array_metadata.size_cache;
+    case CBOR_TYPE_MAP:
+      return &item->metadata.map_metadata.size_cache;
+    case CBOR_TYPE_TAG:
+      return &item->metadata.tag_metadata.size_cache;
+    default:
+      return NULL;
+  }
+}
+
+/** Invalidate the memoized sizes of \p item and its ancestors. Called by
+ * every size-changing mutator. */
+void _cbor_size_cache_invalidate(cbor_item_t* item);
+
+/** Record that \p child has been added to \p parent */
+void _cbor_size_cache_link(cbor_item_t* parent, cbor_item_t* child);
+
+/** Record that \p child has been removed from \p parent */
+void _cbor_size_cache_unlink(const cbor_item_t* parent, cbor_item_t* child);
+
+/** #cbor_serialized_size using the given (empty) walk
+ *
+ * @return The size, 0 if it overflows `size_t` or the walk could not be
+ *  extended. The walk is left empty.
+ */
+_CBOR_NODISCARD
+size_t _cbor_serialized_size_walk(struct _cbor_walk* walk,
+                                  const cbor_item_t* item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_SIZE_CACHE_H
@@ -6,15 +6,17 @@
  */
 
 #include "stack.h"
+#include "memory_utils.h"
 
 struct _cbor_stack _cbor_stack_init(void) {
-  return (struct _cbor_stack){.top = NULL, .size = 0};
+  return (struct _cbor_stack){
+      .top = NULL, .size = 0, .allocator = cbor_thread_allocator()};
 }
 
 void _cbor_stack_pop(struct _cbor_stack* stack) {
   struct _cbor_stack_record* top = stack->top;
   stack->top = stack->top->lower;
-  _cbor_free(top);
+  _CBOR_FREE(stack->allocator, top);
   stack->size--;
 }
 
@@ -23,7 +25,8 @@ struct _cbor_stack_record* _cbor_stack_push(struct _cbor_stack* stack,
                                             size_t subitems) {
   if (stack->size == CBOR_MAX_STACK_SIZE) return NULL;
   struct _cbor_stack_record* new_top =
-      _cbor_malloc(sizeof(struct _cbor_stack_record));
+      _CBOR_MALLOC(stack->allocator, CBOR_ALLOC_SITE_STACK,
+                   sizeof(struct _cbor_stack_record));
   if (new_top == NULL) return NULL;
 
   *new_top = (struct _cbor_stack_record){stack->top, item, subitems};
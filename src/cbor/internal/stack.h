@@ -35,6 +35,8 @@ struct _cbor_stack_record {
 struct _cbor_stack {
   struct _cbor_stack_record* top;
   size_t size;
+  /** Allocator for the records */
+  const struct cbor_allocator* allocator;
 };
 
 _CBOR_NODISCARD
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_UINT_KERNELS_H
+#define LIBCBOR_UINT_KERNELS_H
+
+#include <string.h>
+
+#include "cbor/common.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <stdlib.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Big-endian integer kernels shared by the encoder, the decoder, and the size
+ * computation. These run for every item header, so they are inlined and use
+ * byte swap and count leading zeros intrinsics where available. The portable
+ * fallbacks are patterns that most compilers recognize as well.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define _CBOR_BSWAP16(x) __builtin_bswap16(x)
+#define _CBOR_BSWAP32(x) __builtin_bswap32(x)
+#define _CBOR_BSWAP64(x) __builtin_bswap64(x)
+#elif defined(_MSC_VER)
+#define _CBOR_BSWAP16(x) _byteswap_ushort(x)
+#define _CBOR_BSWAP32(x) _byteswap_ulong(x)
+#define _CBOR_BSWAP64(x) _byteswap_uint64(x)
+#endif
+
+static inline uint16_t _cbor_bswap16(uint16_t value) {
+#ifdef _CBOR_BSWAP16
+  return _CBOR_BSWAP16(value);
+#else
+  return (uint16_t)((value << 8) | (value >> 8));
+#endif
+}
+
+static inline uint32_t _cbor_bswap32(uint32_t value) {
+#ifdef _CBOR_BSWAP32
+  return _CBOR_BSWAP32(value);
+#else
+  return ((value & 0x000000FFu) << 24) | ((value & 0x0000FF00u) << 8) |
+         ((value & 0x00FF0000u) >> 8) | ((value & 0xFF000000u) >> 24);
+#endif
+}
+
+static inline uint64_t _cbor_bswap64(uint64_t value) {
+#ifdef _CBOR_BSWAP64
+  return _CBOR_BSWAP64(value);
+#else
+  return ((uint64_t)_cbor_bswap32((uint32_t)value) << 32) |
+         _cbor_bswap32((uint32_t)(value >> 32));
+#endif
+}
+
+/* Unaligned big-endian loads. memcpy compiles to a single load. */
+
+static inline uint16_t _cbor_load_be16(const unsigned char* source) {
+  uint16_t result;
+  memcpy(&result, source, sizeof(result));
+#ifdef IS_BIG_ENDIAN
+  return result;
+#else
+  return _cbor_bswap16(result);
+#endif
+}
+
+static inline uint32_t _cbor_load_be32(const unsigned char* source) {
+  uint32_t result;
+  memcpy(&result, source, sizeof(result));
+#ifdef IS_BIG_ENDIAN
+  return result;
+#else
+  return _cbor_bswap32(result);
+#endif
+}
+
+static inline uint64_t _cbor_load_be64(const unsigned char* source) {
+  uint64_t result;
+  memcpy(&result, source, sizeof(result));
+#ifdef IS_BIG_ENDIAN
+  return result;
+#else
+  return _cbor_bswap64(result);
+#endif
+}
+
+/* Unaligned big-endian stores */
+
+static inline void _cbor_store_be16(unsigned char* target, uint16_t value) {
+#ifndef IS_BIG_ENDIAN
+  value = _cbor_bswap16(value);
+#endif
+  memcpy(target, &value, sizeof(value));
+}
+
+static inline void _cbor_store_be32(unsigned char* target, uint32_t value) {
+#ifndef IS_BIG_ENDIAN
+  value = _cbor_bswap32(value);
+#endif
+  memcpy(target, &value, sizeof(value));
+}
+
+static inline void _cbor_store_be64(unsigned char* target, uint64_t value) {
+#ifndef IS_BIG_ENDIAN
+  value = _cbor_bswap64(value);
+#endif
+  memcpy(target, &value, sizeof(value));
+}
+
+/** Number of leading zero bits. `value` must not be zero. */
+static inline unsigned _cbor_clz64(uint64_t value) {
+  CBOR_ASSERT(value != 0);
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_clzll(value);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - (unsigned)index;
+#else
+  unsigned count = 0;
+  for (unsigned shift = 32; shift > 0; shift /= 2) {
+    if ((value >> (64 - shift)) == 0) {
+      count += shift;
+      value <<= shift;
+    }
+  }
+  return count;
+#endif
+}
+
+/** Width class of the shortest encoding of `value` as a power of two: 0 for
+ * uint8, 1 for uint16, 2 for uint32, and 3 for uint64 */
+static inline unsigned _cbor_uint_width_log2(uint64_t value) {
+  // Indexed by the number of significant bytes
+  static const unsigned char width_log2[9] = {0, 0, 1, 2, 2, 3, 3, 3, 3};
+  return width_log2[(71 - _cbor_clz64(value | 1)) >> 3];
+}
+
+/** Size of the shortest header encoding `value` */
+static inline size_t _cbor_uint_header_size(uint64_t value) {
+  if (value <= 23) return 1;
+  return 1 + ((size_t)1 << _cbor_uint_width_log2(value));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_UINT_KERNELS_H
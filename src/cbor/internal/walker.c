@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "walker.h"
+
+#include <string.h>
+
+#include "../bytestrings.h"
+#include "../strings.h"
+#include "memory_utils.h"
+
+cbor_item_t** _cbor_child_slot(const cbor_item_t* item, size_t index) {
+  switch (item->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING: {
+      bool indefinite = item->type == CBOR_TYPE_BYTESTRING
+                            ? cbor_bytestring_is_indefinite(item)
+                            : cbor_string_is_indefinite(item);
+      if (!indefinite) return NULL;
+      struct cbor_indefinite_string_data* data =
+          (struct cbor_indefinite_string_data*)item->data;
+      return index < data->chunk_count ? &data->chunks[index] : NULL;
+    }
+    case CBOR_TYPE_ARRAY:
+      if (index >= item->metadata.array_metadata.end_ptr) return NULL;
+      return &((cbor_item_t**)item->data)[index];
+    case CBOR_TYPE_MAP: {
+      if (index / 2 >= item->metadata.map_metadata.end_ptr) return NULL;
+      struct cbor_pair* pair = &((struct cbor_pair*)item->data)[index / 2];
+      return index % 2 == 0 ? &pair->key : &pair->value;
+    }
+    case CBOR_TYPE_TAG:
+      if (index > 0) return NULL;
+      return (cbor_item_t**)&item->metadata.tag_metadata.tagged_item;
+    default:
+      return NULL;
+  }
+}
+
+bool _cbor_is_nesting(const cbor_item_t* item) {
+  return item->type == CBOR_TYPE_ARRAY || item->type == CBOR_TYPE_MAP ||
+         item->type == CBOR_TYPE_TAG;
+}
+
+void _cbor_walk_init(struct _cbor_walk* walk) {
+  walk->frames = walk->inline_frames;
+  walk->depth = 0;
+  walk->capacity = _CBOR_WALK_INLINE_DEPTH;
+  walk->allocator = cbor_thread_allocator();
+}
+
+struct _cbor_walk_frame* _cbor_walk_push(struct _cbor_walk* walk,
+                                         const cbor_item_t* item) {
+  if (walk->depth == walk->capacity) {
+    if (!_cbor_safe_to_multiply(CBOR_BUFFER_GROWTH, walk->capacity) ||
+        !_cbor_safe_to_multiply(sizeof(struct _cbor_walk_frame),
+                                CBOR_BUFFER_GROWTH * walk->capacity))
+      return NULL;
+    size_t new_capacity = CBOR_BUFFER_GROWTH * walk->capacity;
+    size_t new_size = sizeof(struct _cbor_walk_frame) * new_capacity;
+    struct _cbor_walk_frame* new_frames;
+    if (walk->frames == walk->inline_frames) {
+      new_frames =
+          _CBOR_MALLOC(walk->allocator, CBOR_ALLOC_SITE_STACK, new_size);
+      if (new_frames == NULL) return NULL;
+      memcpy(new_frames, walk->inline_frames, sizeof(walk->inline_frames));
+    } else {
+      new_frames = _CBOR_REALLOC(walk->allocator, CBOR_ALLOC_SITE_STACK,
+                                 walk->frames, new_size);
+      if (new_frames == NULL) return NULL;
+    }
+    walk->frames = new_frames;
+    walk->capacity = new_capacity;
+  }
+  struct _cbor_walk_frame* frame = &walk->frames[walk->depth++];
+  *frame = (struct _cbor_walk_frame){.item = item, .next = 0};
+  return frame;
+}
+
+struct _cbor_walk_frame* _cbor_walk_top(struct _cbor_walk* walk) {
+  CBOR_ASSERT(walk->depth > 0);
+  return &walk->frames[walk->depth - 1];
+}
+
+void _cbor_walk_pop(struct _cbor_walk* walk) {
+  CBOR_ASSERT(walk->depth > 0);
+  walk->depth--;
+}
+
+void _cbor_walk_clear(struct _cbor_walk* walk) { walk->depth = 0; }
+
+bool _cbor_walk_next(struct _cbor_walk_frame* frame, cbor_item_t** child) {
+  cbor_item_t** slot = _cbor_child_slot(frame->item, frame->next);
+  if (slot == NULL) return false;
+  frame->next++;
+  *child = *slot;
+  return true;
+}
+
+void _cbor_walk_free(struct _cbor_walk* walk) {
+  if (walk->frames != walk->inline_frames)
+    _CBOR_FREE(walk->allocator, walk->frames);
+  _cbor_walk_init(walk);
+}
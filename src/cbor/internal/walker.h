@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_WALKER_H
+#define LIBCBOR_WALKER_H
+
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Explicit-stack traversal of item trees. Walking a tree takes heap memory
+ * proportional to its depth instead of C stack, so that arbitrarily nested
+ * items can be processed on threads with small stacks.
+ *
+ * The children of an item are numbered from zero: the chunks of an indefinite
+ * (byte) string, the items of an array, the keys and values of a map
+ * (interleaved, so that even indices are keys), and the tagged item.
+ */
+
+/** Number of frames that do not require a heap allocation */
+#define _CBOR_WALK_INLINE_DEPTH 16
+
+/** An item whose children are being visited */
+struct _cbor_walk_frame {
+  const cbor_item_t* item;
+  /** Index of the next child to visit */
+  size_t next;
+  /** Partial result for #item, owned by the algorithm */
+  union {
+    size_t size;
+    struct {
+      cbor_item_t* item;
+      /** Copy of a map key until the value has been copied */
+      cbor_item_t* key;
+    } copy;
+    struct {
+      /** Item compared with #item */
+      const cbor_item_t* other;
+      /** Pair of `other` matched to each pair of a map, `NULL` if in order */
+      size_t* order;
+    } equal;
+    struct {
+      uint64_t value;
+      /** Order-independent combination of the hashes of map pairs */
+      uint64_t pairs;
+      uint64_t key;
+    } hash;
+  } state;
+};
+
+/** Path from the root of a walk to the item being visited */
+struct _cbor_walk {
+  /** Either #inline_frames, or a heap allocation once they run out */
+  struct _cbor_walk_frame* frames;
+  size_t depth;
+  size_t capacity;
+  const struct cbor_allocator* allocator;
+  struct _cbor_walk_frame inline_frames[_CBOR_WALK_INLINE_DEPTH];
+};
+
+/** Get the slot holding a child of an item
+ *
+ * @param item Any item
+ * @param index Index of the child
+ * @return Pointer to the child slot, `NULL` if \p item has no such child. The
+ *  slot itself is `NULL` for items under construction.
+ */
+_CBOR_NODISCARD
+cbor_item_t** _cbor_child_slot(const cbor_item_t* item, size_t index);
+
+/** Is \p item an array, a map, or a tag, i.e. can its children be arbitrary
+ * items? Other children are always definite strings. */
+_CBOR_NODISCARD
+bool _cbor_is_nesting(const cbor_item_t* item);
+
+/** Initialize an empty walk. The walk must not be moved afterwards. */
+void _cbor_walk_init(struct _cbor_walk* walk);
+
+/** Start visiting the children of \p item
+ *
+ * Never fails if the walk has been at least as deep before.
+ *
+ * @return The new top frame, `NULL` on allocation failure. Pointers to the
+ *  other frames are invalidated.
+ */
+_CBOR_NODISCARD
+struct _cbor_walk_frame* _cbor_walk_push(struct _cbor_walk* walk,
+                                         const cbor_item_t* item);
+
+/** The frame of the item whose children are being visited */
+_CBOR_NODISCARD
+struct _cbor_walk_frame* _cbor_walk_top(struct _cbor_walk* walk);
+
+void _cbor_walk_pop(struct _cbor_walk* walk);
+
+/** Pop all frames, keeping the memory for reuse */
+void _cbor_walk_clear(struct _cbor_walk* walk);
+
+/** Advance to the next child of the item in \p frame
+ *
+ * @param frame The frame
+ * @param[out] child The child, may be `NULL` for items under construction
+ * @return false if all children have been visited
+ */
+_CBOR_NODISCARD
+bool _cbor_walk_next(struct _cbor_walk_frame* frame, cbor_item_t** child);
+
+/** Release the memory of the walk */
+void _cbor_walk_free(struct _cbor_walk* walk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_WALKER_H
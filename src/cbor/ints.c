@@ -6,6 +6,9 @@
  */
 
 #include "ints.h"
+#include "internal/item_pool.h"
+#include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 cbor_int_width cbor_int_get_width(const cbor_item_t* item) {
   CBOR_ASSERT(cbor_is_int(item));
@@ -55,74 +58,89 @@ uint64_t cbor_get_int(const cbor_item_t* item) {
 }
 
 void cbor_set_uint8(cbor_item_t* item, uint8_t value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   CBOR_ASSERT(cbor_int_get_width(item) == CBOR_INT_8);
   *item->data = value;
+  _cbor_size_cache_invalidate(item);
 }
 
 void cbor_set_uint16(cbor_item_t* item, uint16_t value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   CBOR_ASSERT(cbor_int_get_width(item) == CBOR_INT_16);
   *(uint16_t*)item->data = value;
 }
 
 void cbor_set_uint32(cbor_item_t* item, uint32_t value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   CBOR_ASSERT(cbor_int_get_width(item) == CBOR_INT_32);
   *(uint32_t*)item->data = value;
 }
 
 void cbor_set_uint64(cbor_item_t* item, uint64_t value) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   CBOR_ASSERT(cbor_int_get_width(item) == CBOR_INT_64);
   *(uint64_t*)item->data = value;
 }
 
 void cbor_mark_uint(cbor_item_t* item) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   item->type = CBOR_TYPE_UINT;
 }
 
 void cbor_mark_negint(cbor_item_t* item) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_is_int(item));
   item->type = CBOR_TYPE_NEGINT;
 }
 
 cbor_item_t* cbor_new_int8(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 1);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 1);
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){.data = (unsigned char*)item + sizeof(cbor_item_t),
                         .refcount = 1,
+                        .allocator = allocator,
                         .metadata = {.int_metadata = {.width = CBOR_INT_8}},
                         .type = CBOR_TYPE_UINT};
   return item;
 }
 
 cbor_item_t* cbor_new_int16(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 2);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 2);
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){.data = (unsigned char*)item + sizeof(cbor_item_t),
                         .refcount = 1,
+                        .allocator = allocator,
                         .metadata = {.int_metadata = {.width = CBOR_INT_16}},
                         .type = CBOR_TYPE_UINT};
   return item;
 }
 
 cbor_item_t* cbor_new_int32(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 4);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 4);
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){.data = (unsigned char*)item + sizeof(cbor_item_t),
                         .refcount = 1,
+                        .allocator = allocator,
                         .metadata = {.int_metadata = {.width = CBOR_INT_32}},
                         .type = CBOR_TYPE_UINT};
   return item;
 }
 
 cbor_item_t* cbor_new_int64(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t) + 8);
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t) + 8);
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){.data = (unsigned char*)item + sizeof(cbor_item_t),
                         .refcount = 1,
+                        .allocator = allocator,
                         .metadata = {.int_metadata = {.width = CBOR_INT_64}},
                         .type = CBOR_TYPE_UINT};
   return item;
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_ITEM_HPP
+#define LIBCBOR_ITEM_HPP
+
+#if __cplusplus < 201703L && (!defined(_MSVC_LANG) || _MSVC_LANG < 201703L)
+#error "cbor/item.hpp requires C++17"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+#include "cbor.h"
+
+namespace cbor {
+
+#if defined(__cpp_lib_span)
+/** Contents of a byte string */
+using byte_view = std::span<const unsigned char>;
+#else
+/** Contents of a byte string, the subset of `std::span<const unsigned char>`
+ * available before C++20 */
+class byte_view {
+ public:
+  constexpr byte_view() noexcept = default;
+  constexpr byte_view(const unsigned char* data, std::size_t size) noexcept
+      : data_(data), size_(size) {}
+
+  constexpr const unsigned char* data() const noexcept { return data_; }
+  constexpr std::size_t size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+  constexpr const unsigned char* begin() const noexcept { return data_; }
+  constexpr const unsigned char* end() const noexcept { return data_ + size_; }
+  constexpr const unsigned char& operator[](std::size_t index) const noexcept {
+    return data_[index];
+  }
+
+ private:
+  const unsigned char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+#endif
+
+class item;
+class item_view;
+
+namespace detail {
+
+/** Random access range over an array of item pointers, yielding views */
+class item_range {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = item_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = item_view;
+
+    iterator() noexcept = default;
+    explicit iterator(cbor_item_t* const* position) noexcept
+        : position_(position) {}
+
+    item_view operator*() const noexcept;
+    item_view operator[](difference_type offset) const noexcept;
+    iterator& operator++() noexcept {
+      ++position_;
+      return *this;
+    }
+    iterator operator++(int) noexcept { return iterator(position_++); }
+    iterator& operator--() noexcept {
+      --position_;
+      return *this;
+    }
+    iterator operator--(int) noexcept { return iterator(position_--); }
+    iterator& operator+=(difference_type offset) noexcept {
+      position_ += offset;
+      return *this;
+    }
+    iterator& operator-=(difference_type offset) noexcept {
+      position_ -= offset;
+      return *this;
+    }
+    friend iterator operator+(iterator it, difference_type offset) noexcept {
+      return it += offset;
+    }
+    friend iterator operator+(difference_type offset, iterator it) noexcept {
+      return it += offset;
+    }
+    friend iterator operator-(iterator it, difference_type offset) noexcept {
+      return it -= offset;
+    }
+    friend difference_type operator-(iterator a, iterator b) noexcept {
+      return a.position_ - b.position_;
+    }
+    friend bool operator==(iterator a, iterator b) noexcept {
+      return a.position_ == b.position_;
+    }
+    friend bool operator!=(iterator a, iterator b) noexcept {
+      return a.position_ != b.position_;
+    }
+    friend bool operator<(iterator a, iterator b) noexcept {
+      return a.position_ < b.position_;
+    }
+    friend bool operator>(iterator a, iterator b) noexcept {
+      return a.position_ > b.position_;
+    }
+    friend bool operator<=(iterator a, iterator b) noexcept {
+      return a.position_ <= b.position_;
+    }
+    friend bool operator>=(iterator a, iterator b) noexcept {
+      return a.position_ >= b.position_;
+    }
+
+   private:
+    cbor_item_t* const* position_ = nullptr;
+  };
+
+  item_range(cbor_item_t* const* items, std::size_t size) noexcept
+      : items_(items), size_(size) {}
+
+  iterator begin() const noexcept { return iterator(items_); }
+  iterator end() const noexcept { return iterator(items_ + size_); }
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  item_view operator[](std::size_t index) const noexcept;
+
+ private:
+  cbor_item_t* const* items_;
+  std::size_t size_;
+};
+
+/** Random access range over map entries, yielding pairs of views */
+class pair_range {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::pair<item_view, item_view>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::pair<item_view, item_view>;
+
+    iterator() noexcept = default;
+    explicit iterator(const struct cbor_pair* position) noexcept
+        : position_(position) {}
+
+    std::pair<item_view, item_view> operator*() const noexcept;
+    std::pair<item_view, item_view> operator[](
+        difference_type offset) const noexcept;
+    iterator& operator++() noexcept {
+      ++position_;
+      return *this;
+    }
+    iterator operator++(int) noexcept { return iterator(position_++); }
+    iterator& operator--() noexcept {
+      --position_;
+      return *this;
+    }
+    iterator operator--(int) noexcept { return iterator(position_--); }
+    iterator& operator+=(difference_type offset) noexcept {
+      position_ += offset;
+      return *this;
+    }
+    iterator& operator-=(difference_type offset) noexcept {
+      position_ -= offset;
+      return *this;
+    }
+    friend iterator operator+(iterator it, difference_type offset) noexcept {
+      return it += offset;
+    }
+    friend iterator operator+(difference_type offset, iterator it) noexcept {
+      return it += offset;
+    }
+    friend iterator operator-(iterator it, difference_type offset) noexcept {
+      return it -= offset;
+    }
+    friend difference_type operator-(iterator a, iterator b) noexcept {
+      return a.position_ - b.position_;
+    }
+    friend bool operator==(iterator a, iterator b) noexcept {
+      return a.position_ == b.position_;
+    }
+    friend bool operator!=(iterator a, iterator b) noexcept {
+      return a.position_ != b.position_;
+    }
+    friend bool operator<(iterator a, iterator b) noexcept {
+      return a.position_ < b.position_;
+    }
+    friend bool operator>(iterator a, iterator b) noexcept {
+      return a.position_ > b.position_;
+    }
+    friend bool operator<=(iterator a, iterator b) noexcept {
+      return a.position_ <= b.position_;
+    }
+    friend bool operator>=(iterator a, iterator b) noexcept {
+      return a.position_ >= b.position_;
+    }
+
+   private:
+    const struct cbor_pair* position_ = nullptr;
+  };
+
+  pair_range(const struct cbor_pair* pairs, std::size_t size) noexcept
+      : pairs_(pairs), size_(size) {}
+
+  iterator begin() const noexcept { return iterator(pairs_); }
+  iterator end() const noexcept { return iterator(pairs_ + size_); }
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  std::pair<item_view, item_view> operator[](std::size_t index) const noexcept;
+
+ private:
+  const struct cbor_pair* pairs_;
+  std::size_t size_;
+};
+
+/** Accessors shared by #cbor::item and #cbor::item_view. None of them
+ * changes reference counts, except for #share and #tagged, which return new
+ * references. */
+template <class Derived>
+class item_accessors {
+ public:
+  cbor_type type() const noexcept { return cbor_typeof(handle()); }
+
+  /** Contents of a definite text string. The view is valid as long as the
+   * item. */
+  std::string_view string() const noexcept {
+    CBOR_ASSERT(cbor_isa_string(handle()));
+    CBOR_ASSERT(cbor_string_is_definite(handle()));
+    return std::string_view(
+        reinterpret_cast<const char*>(cbor_string_handle(handle())),
+        cbor_string_length(handle()));
+  }
+
+  /** Contents of a definite byte string. The view is valid as long as the
+   * item. */
+  byte_view bytes() const noexcept {
+    CBOR_ASSERT(cbor_isa_bytestring(handle()));
+    CBOR_ASSERT(cbor_bytestring_is_definite(handle()));
+    return byte_view(cbor_bytestring_handle(handle()),
+                     cbor_bytestring_length(handle()));
+  }
+
+  /** Chunks of an indefinite text or byte string */
+  item_range chunks() const noexcept {
+    if (cbor_isa_string(handle())) {
+      CBOR_ASSERT(cbor_string_is_indefinite(handle()));
+      return item_range(cbor_string_chunks_handle(handle()),
+                        cbor_string_chunk_count(handle()));
+    }
+    CBOR_ASSERT(cbor_isa_bytestring(handle()));
+    CBOR_ASSERT(cbor_bytestring_is_indefinite(handle()));
+    return item_range(cbor_bytestring_chunks_handle(handle()),
+                      cbor_bytestring_chunk_count(handle()));
+  }
+
+  /** Items of an array, e.g. `for (cbor::item_view item : array.array())` */
+  item_range array() const noexcept {
+    CBOR_ASSERT(cbor_isa_array(handle()));
+    return item_range(cbor_array_handle(handle()), cbor_array_size(handle()));
+  }
+
+  /** Entries of a map, e.g. `for (auto [key, value] : map.map())` */
+  pair_range map() const noexcept {
+    CBOR_ASSERT(cbor_isa_map(handle()));
+    return pair_range(cbor_map_handle(handle()), cbor_map_size(handle()));
+  }
+
+  /** Value of an unsigned integer, or the argument of a negative integer
+   * (`-1 - value`) */
+  std::uint64_t uint() const noexcept { return cbor_get_int(handle()); }
+
+  double floating() const noexcept { return cbor_float_get_float(handle()); }
+
+  bool boolean() const noexcept { return cbor_get_bool(handle()); }
+
+  std::uint64_t tag() const noexcept { return cbor_tag_value(handle()); }
+
+  /** The item a tag applies to */
+  item tagged() const noexcept;
+
+  /** A new reference to the item */
+  item share() const noexcept;
+
+ private:
+  cbor_item_t* handle() const noexcept {
+    cbor_item_t* handle = static_cast<const Derived*>(this)->get();
+    CBOR_ASSERT(handle != nullptr);
+    return handle;
+  }
+};
+
+}  // namespace detail
+
+/** Owning handle of an item
+ *
+ * Holds one reference, which is released by the destructor. Handles can be
+ * moved, which does not touch the reference count, but not copied: use
+ * #share to get another reference, or pass an #item_view to code that does
+ * not need to keep the item.
+ *
+ * \code
+ * cbor::item array(cbor_new_definite_array(2));
+ * cbor_array_push(array.get(), cbor::item(cbor_build_uint8(1)).get());
+ * for (cbor::item_view value : array.array()) ...
+ * \endcode
+ */
+class item : public detail::item_accessors<item> {
+ public:
+  item() noexcept = default;
+
+  /** Take over a reference, e.g. one returned by `cbor_build_*` or
+   * #cbor_load. `NULL` gives an empty handle. */
+  explicit item(cbor_item_t* handle) noexcept : handle_(handle) {}
+
+  item(item&& other) noexcept : handle_(other.release()) {}
+
+  item& operator=(item&& other) noexcept {
+    item(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  item(const item&) = delete;
+  item& operator=(const item&) = delete;
+
+  ~item() {
+    if (handle_ != nullptr) cbor_decref(&handle_);
+  }
+
+  cbor_item_t* get() const noexcept { return handle_; }
+
+  /** Give up the reference without releasing it, e.g. to pass it to C code
+   * that takes ownership */
+  _CBOR_NODISCARD cbor_item_t* release() noexcept {
+    return std::exchange(handle_, nullptr);
+  }
+
+  /** Release the reference and take over \p handle */
+  void reset(cbor_item_t* handle = nullptr) noexcept {
+    item(handle).swap(*this);
+  }
+
+  void swap(item& other) noexcept { std::swap(handle_, other.handle_); }
+
+  explicit operator bool() const noexcept { return handle_ != nullptr; }
+
+ private:
+  cbor_item_t* handle_ = nullptr;
+};
+
+/** Non-owning handle of an item
+ *
+ * Valid as long as some #item or other reference keeps the item alive.
+ * Iterating over arrays and maps yields views, so no reference counts are
+ * touched.
+ */
+class item_view : public detail::item_accessors<item_view> {
+ public:
+  item_view() noexcept = default;
+  explicit item_view(cbor_item_t* handle) noexcept : handle_(handle) {}
+  item_view(const item& owner) noexcept : handle_(owner.get()) {}
+  /** A view of a temporary would dangle */
+  item_view(const item&&) = delete;
+
+  cbor_item_t* get() const noexcept { return handle_; }
+
+  explicit operator bool() const noexcept { return handle_ != nullptr; }
+
+ private:
+  cbor_item_t* handle_ = nullptr;
+};
+
+/** Decode the first item in a buffer, see #cbor_load
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param[out] result Result indicator. May be `NULL`.
+ * @return The item, empty on failure
+ */
+inline item load(cbor_data source, std::size_t source_size,
+                 struct cbor_load_result* result = nullptr) noexcept {
+  struct cbor_load_result local_result;
+  return item(cbor_load(source, source_size,
+                        result != nullptr ? result : &local_result));
+}
+
+namespace detail {
+
+inline item_view item_range::iterator::operator*() const noexcept {
+  return item_view(*position_);
+}
+
+inline item_view item_range::iterator::operator[](
+    difference_type offset) const noexcept {
+  return item_view(position_[offset]);
+}
+
+inline item_view item_range::operator[](std::size_t index) const noexcept {
+  CBOR_ASSERT(index < size_);
+  return item_view(items_[index]);
+}
+
+inline std::pair<item_view, item_view> pair_range::iterator::operator*()
+    const noexcept {
+  return {item_view(position_->key), item_view(position_->value)};
+}
+
+inline std::pair<item_view, item_view> pair_range::iterator::operator[](
+    difference_type offset) const noexcept {
+  return {item_view(position_[offset].key), item_view(position_[offset].value)};
+}
+
+inline std::pair<item_view, item_view> pair_range::operator[](
+    std::size_t index) const noexcept {
+  CBOR_ASSERT(index < size_);
+  return {item_view(pairs_[index].key), item_view(pairs_[index].value)};
+}
+
+template <class Derived>
+item item_accessors<Derived>::tagged() const noexcept {
+  return item(cbor_tag_item(handle()));
+}
+
+template <class Derived>
+item item_accessors<Derived>::share() const noexcept {
+  return item(cbor_incref(handle()));
+}
+
+}  // namespace detail
+
+}  // namespace cbor
+
+#endif  // LIBCBOR_ITEM_HPP
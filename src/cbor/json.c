@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "json.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "callbacks.h"
+#include "internal/formatting.h"
+#include "internal/json_kernels.h"
+#include "internal/memory_utils.h"
+#include "streaming.h"
+
+/** Size of the output buffer of #cbor_to_json */
+#define _CBOR_JSON_BUFFER_SIZE 1024
+
+/** Number of frames that do not require a heap allocation */
+#define _CBOR_JSON_INLINE_DEPTH 16
+
+enum _cbor_json_frame_type {
+  _CBOR_JSON_ARRAY,
+  _CBOR_JSON_INDEF_ARRAY,
+  _CBOR_JSON_MAP,
+  _CBOR_JSON_INDEF_MAP,
+  /** Tag wrapped in an object, see #CBOR_JSON_TAGS_WRAP */
+  _CBOR_JSON_TAG,
+  _CBOR_JSON_INDEF_BYTESTRING,
+  _CBOR_JSON_INDEF_STRING
+};
+
+/** An open item */
+struct _cbor_json_frame {
+  enum _cbor_json_frame_type type;
+  /** Number of items (pairs for maps) of definite containers */
+  uint64_t size;
+  /** Number of items (pairs for maps) converted so far */
+  uint64_t items;
+  /** A map key has been converted and the value is expected next */
+  bool value_expected;
+};
+
+struct _cbor_json_context {
+  struct cbor_json_options options;
+  /** `NULL` if the output goes directly to #buffer */
+  cbor_writer_sink sink;
+  void* sink_context;
+  unsigned char* buffer;
+  size_t buffer_size;
+  /** Number of bytes in #buffer not yet passed to the sink */
+  size_t buffered;
+  /** Number of bytes passed to the sink */
+  size_t written;
+  /** Stack of open items, innermost last. Either #inline_frames, or a heap
+   * allocation once they run out. */
+  struct _cbor_json_frame* frames;
+  size_t depth;
+  size_t capacity;
+  const struct cbor_allocator* allocator;
+  /** Depth of the map whose non-string key is being converted to a string,
+   * zero if none. All output is escaped in the meantime. */
+  size_t key_depth;
+  /** Bytes of an indefinite byte string that do not form a base64 group yet */
+  unsigned char pending[3];
+  size_t pending_length;
+  /** The top-level item has been converted */
+  bool finished;
+  cbor_json_error_code error;
+  struct _cbor_json_frame inline_frames[_CBOR_JSON_INLINE_DEPTH];
+};
+
+static void _cbor_json_fail(struct _cbor_json_context* context,
+                            cbor_json_error_code error) {
+  if (context->error == CBOR_JSON_ERR_NONE) context->error = error;
+}
+
+static bool _cbor_json_flush(struct _cbor_json_context* context) {
+  if (context->buffered == 0) return true;
+  if (context->sink == NULL ||
+      !context->sink(context->sink_context, context->buffer,
+                     context->buffered)) {
+    _cbor_json_fail(context, CBOR_JSON_ERR_SINK);
+    return false;
+  }
+  context->written += context->buffered;
+  context->buffered = 0;
+  return true;
+}
+
+/** Output bytes as they are */
+static void _cbor_json_raw(struct _cbor_json_context* context,
+                           const void* data, size_t length) {
+  if (context->error != CBOR_JSON_ERR_NONE) return;
+  const unsigned char* bytes = data;
+  if (context->sink != NULL && length >= context->buffer_size) {
+    // Large payloads are not worth copying into the buffer
+    if (!_cbor_json_flush(context)) return;
+    if (!context->sink(context->sink_context, bytes, length)) {
+      _cbor_json_fail(context, CBOR_JSON_ERR_SINK);
+      return;
+    }
+    context->written += length;
+    return;
+  }
+  while (length > 0) {
+    if (context->buffered == context->buffer_size &&
+        !_cbor_json_flush(context))
+      return;
+    size_t chunk = context->buffer_size - context->buffered;
+    if (chunk > length) chunk = length;
+    memcpy(context->buffer + context->buffered, bytes, chunk);
+    context->buffered += chunk;
+    bytes += chunk;
+    length -= chunk;
+  }
+}
+
+/** Output bytes escaped as the contents of a JSON string */
+static void _cbor_json_escaped(struct _cbor_json_context* context,
+                               const unsigned char* data, size_t length) {
+  while (length > 0) {
+    size_t plain = _cbor_json_plain_prefix(data, length);
+    _cbor_json_raw(context, data, plain);
+    if (plain == length) return;
+    char sequence[6];
+    _cbor_json_raw(context, sequence,
+                   _cbor_json_escape_sequence(data[plain], sequence));
+    data += plain + 1;
+    length -= plain + 1;
+  }
+}
+
+/** Output JSON text, escaped if it is a part of a stringified key */
+static void _cbor_json_text(struct _cbor_json_context* context,
+                            const char* text, size_t length) {
+  if (context->key_depth != 0)
+    _cbor_json_escaped(context, (const unsigned char*)text, length);
+  else
+    _cbor_json_raw(context, text, length);
+}
+
+#define _CBOR_JSON_LITERAL(context, literal) \
+  _cbor_json_text(context, literal, sizeof(literal) - 1)
+
+/** Output the contents of a JSON string */
+static void _cbor_json_string_contents(struct _cbor_json_context* context,
+                                       const unsigned char* data,
+                                       size_t length) {
+  if (context->key_depth == 0) {
+    _cbor_json_escaped(context, data, length);
+    return;
+  }
+  // Inside a stringified key, the escaped contents are escaped once more
+  while (length > 0) {
+    size_t plain = _cbor_json_plain_prefix(data, length);
+    _cbor_json_raw(context, data, plain);
+    if (plain == length) return;
+    char sequence[6];
+    _cbor_json_text(context, sequence,
+                    _cbor_json_escape_sequence(data[plain], sequence));
+    data += plain + 1;
+    length -= plain + 1;
+  }
+}
+
+static const char _cbor_base64url_alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/** Encode up to three bytes, without padding */
+static size_t _cbor_base64url_group(const unsigned char* data, size_t length,
+                                    char* output) {
+  uint32_t group = (uint32_t)data[0] << 16;
+  if (length > 1) group |= (uint32_t)data[1] << 8;
+  if (length > 2) group |= data[2];
+  for (size_t i = 0; i < 4; i++)
+    output[i] = _cbor_base64url_alphabet[(group >> (18 - 6 * i)) & 0x3F];
+  return length + 1;
+}
+
+/** Output base64url, keeping the trailing bytes that do not form a group in
+ * #_cbor_json_context.pending */
+static void _cbor_json_base64url(struct _cbor_json_context* context,
+                                 const unsigned char* data, size_t length) {
+  char output[256];
+  size_t output_length = 0;
+  while (context->pending_length > 0 && context->pending_length < 3 &&
+         length > 0) {
+    context->pending[context->pending_length++] = *data++;
+    length--;
+  }
+  if (context->pending_length == 3) {
+    output_length += _cbor_base64url_group(context->pending, 3, output);
+    context->pending_length = 0;
+  }
+  for (; length >= 3; data += 3, length -= 3) {
+    if (output_length + 4 > sizeof(output)) {
+      _cbor_json_text(context, output, output_length);
+      output_length = 0;
+    }
+    output_length +=
+        _cbor_base64url_group(data, 3, output + output_length);
+  }
+  _cbor_json_text(context, output, output_length);
+  memcpy(context->pending + context->pending_length, data, length);
+  context->pending_length += length;
+}
+
+static void _cbor_json_base64url_finish(struct _cbor_json_context* context) {
+  if (context->pending_length == 0) return;
+  char output[4];
+  _cbor_json_text(context, output,
+                  _cbor_base64url_group(context->pending,
+                                        context->pending_length, output));
+  context->pending_length = 0;
+}
+
+static struct _cbor_json_frame* _cbor_json_top(
+    struct _cbor_json_context* context) {
+  return context->depth == 0 ? NULL : &context->frames[context->depth - 1];
+}
+
+static bool _cbor_json_in_string(struct _cbor_json_context* context) {
+  struct _cbor_json_frame* frame = _cbor_json_top(context);
+  return frame != NULL && (frame->type == _CBOR_JSON_INDEF_BYTESTRING ||
+                           frame->type == _CBOR_JSON_INDEF_STRING);
+}
+
+static void _cbor_json_push(struct _cbor_json_context* context,
+                            enum _cbor_json_frame_type type, uint64_t size) {
+  if (context->depth == context->capacity) {
+    if (context->capacity >= CBOR_MAX_STACK_SIZE) {
+      _cbor_json_fail(context, CBOR_JSON_ERR_MEMERROR);
+      return;
+    }
+    size_t capacity = context->capacity * 2;
+    if (capacity > CBOR_MAX_STACK_SIZE) capacity = CBOR_MAX_STACK_SIZE;
+    struct _cbor_json_frame* frames;
+    if (context->frames == context->inline_frames) {
+      frames = _CBOR_MALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                            capacity * sizeof(struct _cbor_json_frame));
+      if (frames != NULL)
+        memcpy(frames, context->frames,
+               context->depth * sizeof(struct _cbor_json_frame));
+    } else {
+      frames = _CBOR_REALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                             context->frames,
+                             capacity * sizeof(struct _cbor_json_frame));
+    }
+    if (frames == NULL) {
+      _cbor_json_fail(context, CBOR_JSON_ERR_MEMERROR);
+      return;
+    }
+    context->frames = frames;
+    context->capacity = capacity;
+  }
+  context->frames[context->depth++] = (struct _cbor_json_frame){
+      .type = type, .size = size, .items = 0, .value_expected = false};
+}
+
+/** Output the separator preceding an item
+ *
+ * @param context The conversion context
+ * @param string Whether the item is a (byte) string, i.e. a valid key
+ * @return `false` on error
+ */
+static bool _cbor_json_begin_item(struct _cbor_json_context* context,
+                                  bool string) {
+  if (context->error != CBOR_JSON_ERR_NONE) return false;
+  struct _cbor_json_frame* frame = _cbor_json_top(context);
+  if (frame == NULL) return true;
+  switch (frame->type) {
+    case _CBOR_JSON_ARRAY:
+    case _CBOR_JSON_INDEF_ARRAY:
+      if (frame->items > 0) _CBOR_JSON_LITERAL(context, ",");
+      break;
+    case _CBOR_JSON_MAP:
+    case _CBOR_JSON_INDEF_MAP:
+      if (frame->value_expected) break;
+      if (frame->items > 0) _CBOR_JSON_LITERAL(context, ",");
+      if (string) break;
+      if (context->options.keys == CBOR_JSON_KEYS_REJECT ||
+          context->key_depth != 0) {
+        _cbor_json_fail(context, CBOR_JSON_ERR_KEY);
+        return false;
+      }
+      _cbor_json_raw(context, "\"", 1);
+      context->key_depth = context->depth;
+      break;
+    case _CBOR_JSON_TAG:
+      break;
+    case _CBOR_JSON_INDEF_BYTESTRING:
+    case _CBOR_JSON_INDEF_STRING:
+      // Only chunks of the same type may appear in an indefinite string
+      _cbor_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return false;
+  }
+  return context->error == CBOR_JSON_ERR_NONE;
+}
+
+/** Account for a converted item, closing the containers it completes */
+static void _cbor_json_end_item(struct _cbor_json_context* context) {
+  while (context->error == CBOR_JSON_ERR_NONE) {
+    struct _cbor_json_frame* frame = _cbor_json_top(context);
+    if (frame == NULL) {
+      context->finished = true;
+      return;
+    }
+    switch (frame->type) {
+      case _CBOR_JSON_ARRAY:
+        if (++frame->items < frame->size) return;
+        _CBOR_JSON_LITERAL(context, "]");
+        break;
+      case _CBOR_JSON_INDEF_ARRAY:
+        frame->items++;
+        return;
+      case _CBOR_JSON_MAP:
+      case _CBOR_JSON_INDEF_MAP:
+        if (!frame->value_expected) {
+          if (context->key_depth == context->depth) {
+            context->key_depth = 0;
+            _cbor_json_raw(context, "\"", 1);
+          }
+          _CBOR_JSON_LITERAL(context, ":");
+          frame->value_expected = true;
+          return;
+        }
+        frame->value_expected = false;
+        if (++frame->items < frame->size ||
+            frame->type == _CBOR_JSON_INDEF_MAP)
+          return;
+        _CBOR_JSON_LITERAL(context, "}");
+        break;
+      case _CBOR_JSON_TAG:
+        _CBOR_JSON_LITERAL(context, "}");
+        break;
+      default:
+        // Strings are closed by #_cbor_json_indef_break
+        _CBOR_UNREACHABLE;
+    }
+    context->depth--;
+  }
+}
+
+static void _cbor_json_uint(void* context, uint64_t value) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  char digits[20];
+  char* end = digits + sizeof(digits);
+  char* start = _cbor_format_uint(value, end);
+  _cbor_json_text(context, start, (size_t)(end - start));
+  _cbor_json_end_item(context);
+}
+
+static void _cbor_json_negint(void* context, uint64_t value) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  if (value == UINT64_MAX) {
+    _CBOR_JSON_LITERAL(context, "-18446744073709551616");
+  } else {
+    char digits[21];
+    char* end = digits + sizeof(digits);
+    char* start = _cbor_format_uint(value + 1, end);
+    *--start = '-';
+    _cbor_json_text(context, start, (size_t)(end - start));
+  }
+  _cbor_json_end_item(context);
+}
+
+static void _cbor_json_uint8(void* context, uint8_t value) {
+  _cbor_json_uint(context, value);
+}
+
+static void _cbor_json_uint16(void* context, uint16_t value) {
+  _cbor_json_uint(context, value);
+}
+
+static void _cbor_json_uint32(void* context, uint32_t value) {
+  _cbor_json_uint(context, value);
+}
+
+static void _cbor_json_negint8(void* context, uint8_t value) {
+  _cbor_json_negint(context, value);
+}
+
+static void _cbor_json_negint16(void* context, uint16_t value) {
+  _cbor_json_negint(context, value);
+}
+
+static void _cbor_json_negint32(void* context, uint32_t value) {
+  _cbor_json_negint(context, value);
+}
+
+/** Output a float that converts back to \p value
+ *
+ * @param context The conversion context
+ * @param value The value
+ * @param single Whether \p value is a single (or half) precision float
+ */
+static void _cbor_json_number(struct _cbor_json_context* context,
+                              double value, bool single) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  if (isnan(value) || isinf(value)) {
+    _CBOR_JSON_LITERAL(context, "null");
+    _cbor_json_end_item(context);
+    return;
+  }
+  char digits[_CBOR_FLOAT_FORMAT_SIZE];
+  _cbor_json_text(context, digits, _cbor_format_float(value, single, digits));
+  _cbor_json_end_item(context);
+}
+
+static void _cbor_json_float(void* context, float value) {
+  _cbor_json_number(context, value, true);
+}
+
+static void _cbor_json_double(void* context, double value) {
+  _cbor_json_number(context, value, false);
+}
+
+static void _cbor_json_byte_string(void* context, cbor_data data,
+                                   uint64_t length) {
+  struct _cbor_json_context* json = context;
+  struct _cbor_json_frame* frame = _cbor_json_top(json);
+  if (frame != NULL && frame->type == _CBOR_JSON_INDEF_BYTESTRING) {
+    if (json->error == CBOR_JSON_ERR_NONE)
+      _cbor_json_base64url(json, data, length);
+    return;
+  }
+  if (!_cbor_json_begin_item(json, true)) return;
+  _CBOR_JSON_LITERAL(json, "\"");
+  _cbor_json_base64url(json, data, length);
+  _cbor_json_base64url_finish(json);
+  _CBOR_JSON_LITERAL(json, "\"");
+  _cbor_json_end_item(json);
+}
+
+static void _cbor_json_byte_string_start(void* context) {
+  if (!_cbor_json_begin_item(context, true)) return;
+  _CBOR_JSON_LITERAL(context, "\"");
+  _cbor_json_push(context, _CBOR_JSON_INDEF_BYTESTRING, 0);
+}
+
+static void _cbor_json_string(void* context, cbor_data data,
+                              uint64_t length) {
+  struct _cbor_json_context* json = context;
+  struct _cbor_json_frame* frame = _cbor_json_top(json);
+  if (frame != NULL && frame->type == _CBOR_JSON_INDEF_STRING) {
+    if (json->error == CBOR_JSON_ERR_NONE)
+      _cbor_json_string_contents(json, data, length);
+    return;
+  }
+  if (!_cbor_json_begin_item(json, true)) return;
+  _CBOR_JSON_LITERAL(json, "\"");
+  _cbor_json_string_contents(json, data, length);
+  _CBOR_JSON_LITERAL(json, "\"");
+  _cbor_json_end_item(json);
+}
+
+static void _cbor_json_string_start(void* context) {
+  if (!_cbor_json_begin_item(context, true)) return;
+  _CBOR_JSON_LITERAL(context, "\"");
+  _cbor_json_push(context, _CBOR_JSON_INDEF_STRING, 0);
+}
+
+static void _cbor_json_array_start(void* context, uint64_t size) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  if (size == 0) {
+    _CBOR_JSON_LITERAL(context, "[]");
+    _cbor_json_end_item(context);
+    return;
+  }
+  _CBOR_JSON_LITERAL(context, "[");
+  _cbor_json_push(context, _CBOR_JSON_ARRAY, size);
+}
+
+static void _cbor_json_indef_array_start(void* context) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  _CBOR_JSON_LITERAL(context, "[");
+  _cbor_json_push(context, _CBOR_JSON_INDEF_ARRAY, 0);
+}
+
+static void _cbor_json_map_start(void* context, uint64_t size) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  if (size == 0) {
+    _CBOR_JSON_LITERAL(context, "{}");
+    _cbor_json_end_item(context);
+    return;
+  }
+  _CBOR_JSON_LITERAL(context, "{");
+  _cbor_json_push(context, _CBOR_JSON_MAP, size);
+}
+
+static void _cbor_json_indef_map_start(void* context) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  _CBOR_JSON_LITERAL(context, "{");
+  _cbor_json_push(context, _CBOR_JSON_INDEF_MAP, 0);
+}
+
+static void _cbor_json_tag(void* context, uint64_t value) {
+  struct _cbor_json_context* json = context;
+  if (json->error != CBOR_JSON_ERR_NONE) return;
+  if (_cbor_json_in_string(json)) {
+    _cbor_json_fail(json, CBOR_JSON_ERR_MALFORMED);
+    return;
+  }
+  switch (json->options.tags) {
+    case CBOR_JSON_TAGS_IGNORE:
+      return;
+    case CBOR_JSON_TAGS_WRAP: {
+      if (!_cbor_json_begin_item(json, false)) return;
+      _CBOR_JSON_LITERAL(json, "{\"tag\":");
+      char digits[20];
+      char* end = digits + sizeof(digits);
+      char* start = _cbor_format_uint(value, end);
+      _cbor_json_text(json, start, (size_t)(end - start));
+      _CBOR_JSON_LITERAL(json, ",\"value\":");
+      _cbor_json_push(json, _CBOR_JSON_TAG, 1);
+      return;
+    }
+    default:
+      _cbor_json_fail(json, CBOR_JSON_ERR_TAG);
+  }
+}
+
+static void _cbor_json_null(void* context) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  _CBOR_JSON_LITERAL(context, "null");
+  _cbor_json_end_item(context);
+}
+
+static void _cbor_json_boolean(void* context, bool value) {
+  if (!_cbor_json_begin_item(context, false)) return;
+  if (value)
+    _CBOR_JSON_LITERAL(context, "true");
+  else
+    _CBOR_JSON_LITERAL(context, "false");
+  _cbor_json_end_item(context);
+}
+
+static void _cbor_json_indef_break(void* context) {
+  struct _cbor_json_context* json = context;
+  if (json->error != CBOR_JSON_ERR_NONE) return;
+  struct _cbor_json_frame* frame = _cbor_json_top(json);
+  if (frame == NULL) {
+    _cbor_json_fail(json, CBOR_JSON_ERR_MALFORMED);
+    return;
+  }
+  switch (frame->type) {
+    case _CBOR_JSON_INDEF_ARRAY:
+      _CBOR_JSON_LITERAL(json, "]");
+      break;
+    case _CBOR_JSON_INDEF_MAP:
+      if (frame->value_expected) {
+        _cbor_json_fail(json, CBOR_JSON_ERR_MALFORMED);
+        return;
+      }
+      _CBOR_JSON_LITERAL(json, "}");
+      break;
+    case _CBOR_JSON_INDEF_BYTESTRING:
+      _cbor_json_base64url_finish(json);
+      _CBOR_JSON_LITERAL(json, "\"");
+      break;
+    case _CBOR_JSON_INDEF_STRING:
+      _CBOR_JSON_LITERAL(json, "\"");
+      break;
+    default:
+      // Break in a definite item
+      _cbor_json_fail(json, CBOR_JSON_ERR_MALFORMED);
+      return;
+  }
+  json->depth--;
+  _cbor_json_end_item(json);
+}
+
+static const struct cbor_callbacks _cbor_json_callbacks = {
+    .uint8 = _cbor_json_uint8,
+    .uint16 = _cbor_json_uint16,
+    .uint32 = _cbor_json_uint32,
+    .uint64 = _cbor_json_uint,
+    .negint8 = _cbor_json_negint8,
+    .negint16 = _cbor_json_negint16,
+    .negint32 = _cbor_json_negint32,
+    .negint64 = _cbor_json_negint,
+    .byte_string_start = _cbor_json_byte_string_start,
+    .byte_string = _cbor_json_byte_string,
+    .string = _cbor_json_string,
+    .string_start = _cbor_json_string_start,
+    .indef_array_start = _cbor_json_indef_array_start,
+    .array_start = _cbor_json_array_start,
+    .indef_map_start = _cbor_json_indef_map_start,
+    .map_start = _cbor_json_map_start,
+    .tag = _cbor_json_tag,
+    .float2 = _cbor_json_float,
+    .float4 = _cbor_json_float,
+    .float8 = _cbor_json_double,
+    .undefined = _cbor_json_null,
+    .null = _cbor_json_null,
+    .boolean = _cbor_json_boolean,
+    .indef_break = _cbor_json_indef_break,
+};
+
+static struct cbor_json_result _cbor_json_convert(
+    struct _cbor_json_context* context, cbor_data source,
+    size_t source_size) {
+  context->frames = context->inline_frames;
+  context->capacity = _CBOR_JSON_INLINE_DEPTH;
+  context->allocator = cbor_thread_allocator();
+  size_t read = 0;
+  while (!context->finished && context->error == CBOR_JSON_ERR_NONE) {
+    struct cbor_decoder_result decode_result = cbor_stream_decode(
+        source + read, source_size - read, &_cbor_json_callbacks, context);
+    switch (decode_result.status) {
+      case CBOR_DECODER_FINISHED:
+        read += decode_result.read;
+        break;
+      case CBOR_DECODER_NEDATA:
+        _cbor_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+        break;
+      case CBOR_DECODER_ERROR:
+        _cbor_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+        break;
+    }
+  }
+  if (context->error == CBOR_JSON_ERR_NONE && context->sink != NULL)
+    _cbor_json_flush(context);
+  if (context->frames != context->inline_frames)
+    _CBOR_FREE(context->allocator, context->frames);
+  return (struct cbor_json_result){
+      .read = read,
+      .written = context->sink == NULL ? context->buffered : context->written,
+      .error = context->error};
+}
+
+struct cbor_json_result cbor_to_json(cbor_data source, size_t source_size,
+                                     const struct cbor_json_options* options,
+                                     cbor_writer_sink sink,
+                                     void* sink_context) {
+  unsigned char buffer[_CBOR_JSON_BUFFER_SIZE];
+  struct _cbor_json_context context = {
+      .options = options == NULL ? (struct cbor_json_options){0} : *options,
+      .sink = sink,
+      .sink_context = sink_context,
+      .buffer = buffer,
+      .buffer_size = sizeof(buffer),
+      .error = CBOR_JSON_ERR_NONE};
+  return _cbor_json_convert(&context, source, source_size);
+}
+
+struct cbor_json_result cbor_to_json_buffer(
+    cbor_data source, size_t source_size,
+    const struct cbor_json_options* options, unsigned char* buffer,
+    size_t buffer_size) {
+  struct _cbor_json_context context = {
+      .options = options == NULL ? (struct cbor_json_options){0} : *options,
+      .buffer = buffer,
+      .buffer_size = buffer_size,
+      .error = CBOR_JSON_ERR_NONE};
+  return _cbor_json_convert(&context, source, source_size);
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_JSON_H
+#define LIBCBOR_JSON_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+#include "cbor/writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Conversion to JSON
+ * ============================================================================
+ */
+
+/** Conversion of map keys that are not (byte) strings */
+typedef enum {
+  /** Use the JSON text of the key as a string, e.g. `{"1": ...}` or
+   * `{"[1,\"a\"]": ...}`. Such keys may not contain other such keys. */
+  CBOR_JSON_KEYS_STRINGIFY,
+  /** Fail with #CBOR_JSON_ERR_KEY */
+  CBOR_JSON_KEYS_REJECT
+} cbor_json_key_mode;
+
+/** Conversion of tags */
+typedef enum {
+  /** Convert the tagged item as if it was not tagged */
+  CBOR_JSON_TAGS_IGNORE,
+  /** Wrap the tagged item in an object: `{"tag": 1, "value": ...}` */
+  CBOR_JSON_TAGS_WRAP,
+  /** Fail with #CBOR_JSON_ERR_TAG */
+  CBOR_JSON_TAGS_REJECT
+} cbor_json_tag_mode;
+
+/** Options for #cbor_to_json. Zero-initialized options are the defaults. */
+struct cbor_json_options {
+  cbor_json_key_mode keys;
+  cbor_json_tag_mode tags;
+};
+
+typedef enum {
+  CBOR_JSON_ERR_NONE,
+  /** The input ends in the middle of an item (value) */
+  CBOR_JSON_ERR_NOTENOUGHDATA,
+  /** The input is not well-formed CBOR (valid JSON for #cbor_from_json) */
+  CBOR_JSON_ERR_MALFORMED,
+  /** A map key was rejected according to #cbor_json_key_mode */
+  CBOR_JSON_ERR_KEY,
+  /** A tag was rejected according to #cbor_json_tag_mode */
+  CBOR_JSON_ERR_TAG,
+  /** The nesting is deeper than #CBOR_MAX_STACK_SIZE, or memory for it could
+     not be allocated */
+  CBOR_JSON_ERR_MEMERROR,
+  /** The sink has failed, or the output does not fit into the buffer */
+  CBOR_JSON_ERR_SINK
+} cbor_json_error_code;
+
+struct cbor_json_result {
+  /** Input bytes consumed if the conversion succeeded: the size of the CBOR
+   * item, or of the JSON value including the surrounding whitespace */
+  size_t read;
+  /** Output bytes produced, including those before an error */
+  size_t written;
+  cbor_json_error_code error;
+};
+
+/** Convert a CBOR item to JSON
+ *
+ * The first item of \p source is decoded using #cbor_stream_decode and the
+ * corresponding JSON text is written to \p sink in chunks of a fixed size, so
+ * no #cbor_item_t is built and the memory usage only depends on the nesting
+ * depth. The conversion is as follows:
+ *
+ *  - Integers become numbers. Floats become numbers with the shortest
+ *    representation that converts back to the same value, always containing
+ *    a fraction or an exponent. NaNs and infinities become `null`.
+ *  - Strings become JSON strings. The contents are not validated to be UTF-8.
+ *  - Byte strings become base64url strings without padding (RFC 8949,
+ *    Section 6.1).
+ *  - Arrays become arrays, maps become objects, indefinite items are converted
+ *    like the definite ones. Duplicate keys are preserved.
+ *  - `true`, `false` and `null` are preserved, `undefined` becomes `null`.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param options Conversion options. May be `NULL` for the defaults.
+ * @param sink The output sink
+ * @param sink_context Passed to every \p sink call
+ * @return The result. If there was an error, the output is incomplete.
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_json_result cbor_to_json(
+    cbor_data source, size_t source_size,
+    const struct cbor_json_options* options, cbor_writer_sink sink,
+    void* sink_context);
+
+/** Convert a CBOR item to JSON in a buffer
+ *
+ * Like #cbor_to_json, but the output is written directly into \p buffer. The
+ * output is not NUL-terminated.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param options Conversion options. May be `NULL` for the defaults.
+ * @param buffer The output buffer
+ * @param buffer_size Size of the output buffer
+ * @return The result. #CBOR_JSON_ERR_SINK if the output does not fit.
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_json_result cbor_to_json_buffer(
+    cbor_data source, size_t source_size,
+    const struct cbor_json_options* options, unsigned char* buffer,
+    size_t buffer_size);
+
+/*
+ * ============================================================================
+ * Conversion from JSON
+ * ============================================================================
+ */
+
+/** Options for #cbor_from_json, combined using `|` */
+typedef enum {
+  CBOR_FROM_JSON_DEFAULT = 0,
+  /** Encode arrays and objects as indefinite items. The input is converted in
+   * a single pass and the memory usage only depends on the nesting depth. See
+   * also #cbor_from_json_partial. */
+  CBOR_FROM_JSON_INDEFINITE = 1 << 0,
+} cbor_from_json_options;
+
+/** Convert a JSON value to CBOR
+ *
+ * The first value of \p json is parsed and the corresponding CBOR is encoded
+ * directly to \p sink in chunks of a fixed size, without building any
+ * #cbor_item_t. The conversion is as follows:
+ *
+ *  - Numbers without a fraction or an exponent that fit into the CBOR integer
+ *    range become integers with the shortest encoding. Other numbers become
+ *    floats of the narrowest width that represents the nearest double exactly
+ *    (numbers too large for a double become infinities).
+ *  - Strings become definite strings. Escape sequences are decoded and the
+ *    contents are validated to be UTF-8.
+ *  - Arrays become arrays and objects become maps with string keys. By
+ *    default, they are definite: the number of items of each array and
+ *    object is counted in a quick first pass over the input, which takes
+ *    memory proportional to the number of arrays and objects. See
+ *    #CBOR_FROM_JSON_INDEFINITE.
+ *  - `true`, `false`, and `null` are preserved.
+ *
+ * Leading and trailing whitespace is skipped. The input after the first value
+ * is not examined, so a sequence of values can be converted by calling the
+ * function repeatedly.
+ *
+ * @param json The input buffer
+ * @param length Length of the input buffer
+ * @param options Combination of #cbor_from_json_options
+ * @param sink The output sink
+ * @param sink_context Passed to every \p sink call
+ * @return The result. If there was an error, the output is incomplete.
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_json_result cbor_from_json(
+    const char* json, size_t length, unsigned options, cbor_writer_sink sink,
+    void* sink_context);
+
+/** State of #cbor_from_json_partial kept between calls
+ *
+ * Must be zero-initialized before the first call.
+ */
+struct cbor_from_json_state {
+  /** The next token expected */
+  uint8_t expect;
+  /** Number of open arrays and objects */
+  size_t depth;
+  /** Which of the open containers are objects, one bit each, outermost first
+   */
+  unsigned char objects[(CBOR_MAX_STACK_SIZE + 7) / 8];
+};
+
+/** Convert a JSON value that arrives in parts to CBOR
+ *
+ * Works like #cbor_from_json with #CBOR_FROM_JSON_INDEFINITE, except that
+ * \p json may end in the middle of the value. In that case, all the tokens
+ * (strings, numbers, literals, and punctuation) that are complete are
+ * converted, the position is remembered in the \p state, and the result is
+ * #CBOR_JSON_ERR_NOTENOUGHDATA with cbor_json_result#read set to the number of
+ * bytes converted. The next call has to be passed the rest of \p json followed
+ * by more input. The memory usage only depends on the nesting depth and on
+ * the longest string or number, which has to be passed as a whole.
+ *
+ * Once the value is complete, the result is #CBOR_JSON_ERR_NONE and the
+ * \p state is ready for the next value.
+ *
+ * @param json The input buffer
+ * @param length Length of the input buffer
+ * @param end_of_input Whether \p json extends to the end of the input. If
+ *  not, a number at the end of \p json is not converted, as it may continue.
+ * @param state The state. Undefined after an error other than
+ *  #CBOR_JSON_ERR_NOTENOUGHDATA.
+ * @param sink The output sink
+ * @param sink_context Passed to every \p sink call
+ * @return The result. cbor_json_result#written only counts the output of this
+ *  call.
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_json_result cbor_from_json_partial(
+    const char* json, size_t length, bool end_of_input,
+    struct cbor_from_json_state* state, cbor_writer_sink sink,
+    void* sink_context);
+
+/** Convert a JSON value to CBOR in a buffer
+ *
+ * Like #cbor_from_json, but the output is written directly into \p buffer.
+ *
+ * @param json The input buffer
+ * @param length Length of the input buffer
+ * @param options Combination of #cbor_from_json_options
+ * @param buffer The output buffer
+ * @param buffer_size Size of the output buffer
+ * @return The result. #CBOR_JSON_ERR_SINK if the output does not fit.
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_json_result cbor_from_json_buffer(
+    const char* json, size_t length, unsigned options, unsigned char* buffer,
+    size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_JSON_H
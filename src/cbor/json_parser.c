@@ -0,0 +1,823 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "encoding.h"
+#include "internal/encoders.h"
+#include "internal/json_kernels.h"
+#include "internal/memory_utils.h"
+#include "internal/unicode.h"
+#include "json.h"
+
+/** Size of the output buffer of #cbor_from_json */
+#define _CBOR_FROM_JSON_BUFFER_SIZE 1024
+
+/** Number of open containers while counting, and of container sizes counted
+ * in advance, that do not require a heap allocation */
+#define _CBOR_FROM_JSON_INLINE_SIZE 16
+
+/** Longest number that is converted without a heap allocation */
+#define _CBOR_FROM_JSON_NUMBER_SIZE 64
+
+/** Largest item header: MTB + 8 bytes of value */
+#define _CBOR_MAX_HEADER_SIZE 9
+
+/** What the conversion expects next, see #cbor_from_json_state */
+enum _cbor_from_json_expect {
+  /** A value, at the top level, after a colon, or after a comma in an array.
+   * Zero, so that a zero-initialized state expects a value. */
+  _CBOR_FROM_JSON_VALUE = 0,
+  /** A value or the end of an empty array */
+  _CBOR_FROM_JSON_FIRST_VALUE,
+  /** A key or the end of an empty object */
+  _CBOR_FROM_JSON_FIRST_KEY,
+  /** A key after a comma */
+  _CBOR_FROM_JSON_KEY,
+  /** The colon after a key */
+  _CBOR_FROM_JSON_COLON,
+  /** A comma or the end of the innermost container, or nothing if the value
+   * is complete */
+  _CBOR_FROM_JSON_NEXT
+};
+
+struct _cbor_from_json_context {
+  unsigned options;
+  /** `NULL` if the output goes directly to #buffer */
+  cbor_writer_sink sink;
+  void* sink_context;
+  unsigned char* buffer;
+  size_t buffer_size;
+  /** Number of bytes in #buffer not yet passed to the sink */
+  size_t buffered;
+  /** Number of bytes passed to the sink */
+  size_t written;
+  const struct cbor_allocator* allocator;
+  /** Sizes of the containers in the order in which they are opened, see
+   * #_cbor_from_json_count */
+  size_t* sizes;
+  size_t sizes_count;
+  size_t sizes_capacity;
+  /** Index of the size of the next container */
+  size_t next_size;
+  /** Open containers and the expected token */
+  struct cbor_from_json_state* state;
+  cbor_json_error_code error;
+  /** Scratch space for item headers */
+  unsigned char header[_CBOR_MAX_HEADER_SIZE];
+  size_t inline_sizes[_CBOR_FROM_JSON_INLINE_SIZE];
+};
+
+static void _cbor_from_json_fail(struct _cbor_from_json_context* context,
+                                 cbor_json_error_code error) {
+  if (context->error == CBOR_JSON_ERR_NONE) context->error = error;
+}
+
+/** Make room for one more element of an array that starts out in
+ * \p inline_array
+ *
+ * @return `false` if the array cannot grow
+ */
+static bool _cbor_from_json_grow(struct _cbor_from_json_context* context,
+                                 void** array, size_t* capacity,
+                                 size_t element_size, void* inline_array) {
+  if (!_cbor_safe_to_multiply(*capacity, 2 * element_size)) return false;
+  size_t new_capacity = *capacity * 2;
+  void* new_array;
+  if (*array == inline_array) {
+    new_array = _CBOR_MALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                             new_capacity * element_size);
+    if (new_array != NULL)
+      memcpy(new_array, inline_array, *capacity * element_size);
+  } else {
+    new_array = _CBOR_REALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                              *array, new_capacity * element_size);
+  }
+  if (new_array == NULL) return false;
+  *array = new_array;
+  *capacity = new_capacity;
+  return true;
+}
+
+static bool _cbor_from_json_flush(struct _cbor_from_json_context* context) {
+  if (context->buffered == 0) return true;
+  if (context->sink == NULL ||
+      !context->sink(context->sink_context, context->buffer,
+                     context->buffered)) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_SINK);
+    return false;
+  }
+  context->written += context->buffered;
+  context->buffered = 0;
+  return true;
+}
+
+static void _cbor_from_json_raw(struct _cbor_from_json_context* context,
+                                const void* data, size_t length) {
+  if (context->error != CBOR_JSON_ERR_NONE) return;
+  const unsigned char* bytes = data;
+  if (context->sink != NULL && length >= context->buffer_size) {
+    // Large payloads are not worth copying into the buffer
+    if (!_cbor_from_json_flush(context)) return;
+    if (!context->sink(context->sink_context, bytes, length)) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_SINK);
+      return;
+    }
+    context->written += length;
+    return;
+  }
+  while (length > 0) {
+    if (context->buffered == context->buffer_size &&
+        !_cbor_from_json_flush(context))
+      return;
+    size_t chunk = context->buffer_size - context->buffered;
+    if (chunk > length) chunk = length;
+    memcpy(context->buffer + context->buffered, bytes, chunk);
+    context->buffered += chunk;
+    bytes += chunk;
+    length -= chunk;
+  }
+}
+
+/** Output \p length bytes of #_cbor_from_json_context.header */
+static void _cbor_from_json_header(struct _cbor_from_json_context* context,
+                                   size_t length) {
+  _cbor_from_json_raw(context, context->header, length);
+}
+
+static const unsigned char* _cbor_from_json_skip_whitespace(
+    const unsigned char* cursor, const unsigned char* end) {
+  while (cursor < end && (*cursor == ' ' || *cursor == '\n' ||
+                          *cursor == '\r' || *cursor == '\t'))
+    cursor++;
+  return cursor;
+}
+
+/** Count the items of all arrays and objects of a JSON value
+ *
+ * The sizes are stored in the order in which the containers are opened. The
+ * scan only tracks strings and nesting, the input is validated during the
+ * conversion. If it is not valid, the sizes may be incomplete, but they are
+ * correct up to the point where the conversion fails.
+ */
+static void _cbor_from_json_count(struct _cbor_from_json_context* context,
+                                  const unsigned char* cursor,
+                                  const unsigned char* end) {
+  size_t open_inline[_CBOR_FROM_JSON_INLINE_SIZE];
+  size_t* open = open_inline;
+  size_t depth = 0, open_capacity = _CBOR_FROM_JSON_INLINE_SIZE;
+  // Whether the innermost container has no items so far
+  bool empty = false;
+  while (cursor < end) {
+    unsigned char byte = *cursor++;
+    if (byte == ' ' || byte == '\n' || byte == '\r' || byte == '\t') continue;
+    if (empty && byte != ']' && byte != '}') {
+      context->sizes[open[depth - 1]] = 1;
+      empty = false;
+    }
+    switch (byte) {
+      case '"':
+        while (cursor < end) {
+          cursor += _cbor_json_plain_prefix(cursor, (size_t)(end - cursor));
+          if (cursor == end) break;
+          if (*cursor == '"') {
+            cursor++;
+            break;
+          }
+          // Skip the escaped character (or an invalid control character)
+          cursor += *cursor == '\\' && end - cursor > 1 ? 2 : 1;
+        }
+        break;
+      case '[':
+      case '{':
+        if (depth == CBOR_MAX_STACK_SIZE) goto done;
+        if ((context->sizes_count == context->sizes_capacity &&
+             !_cbor_from_json_grow(context, (void**)&context->sizes,
+                                   &context->sizes_capacity, sizeof(size_t),
+                                   context->inline_sizes)) ||
+            (depth == open_capacity &&
+             !_cbor_from_json_grow(context, (void**)&open, &open_capacity,
+                                   sizeof(size_t), open_inline))) {
+          _cbor_from_json_fail(context, CBOR_JSON_ERR_MEMERROR);
+          goto done;
+        }
+        context->sizes[context->sizes_count] = 0;
+        open[depth++] = context->sizes_count++;
+        empty = true;
+        break;
+      case ']':
+      case '}':
+        empty = false;
+        if (depth == 0 || --depth == 0) goto done;
+        break;
+      case ',':
+        if (depth > 0) context->sizes[open[depth - 1]]++;
+        break;
+      default:
+        break;
+    }
+  }
+done:
+  if (open != open_inline) _CBOR_FREE(context->allocator, open);
+}
+
+/** Is the innermost open container an object? */
+static bool _cbor_from_json_in_object(
+    const struct cbor_from_json_state* state) {
+  size_t index = state->depth - 1;
+  return state->objects[index / 8] & (1u << (index % 8));
+}
+
+static void _cbor_from_json_open(struct _cbor_from_json_context* context,
+                                 bool object) {
+  struct cbor_from_json_state* state = context->state;
+  if (state->depth == CBOR_MAX_STACK_SIZE) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_MEMERROR);
+    return;
+  }
+  if (context->options & CBOR_FROM_JSON_INDEFINITE) {
+    if (object)
+      _cbor_from_json_header(
+          context,
+          cbor_encode_indef_map_start(context->header, _CBOR_MAX_HEADER_SIZE));
+    else
+      _cbor_from_json_header(
+          context, cbor_encode_indef_array_start(context->header,
+                                                 _CBOR_MAX_HEADER_SIZE));
+  } else {
+    // The sizes are complete unless the input is invalid before this point
+    CBOR_ASSERT(context->next_size < context->sizes_count);
+    size_t size = context->sizes[context->next_size++];
+    if (object)
+      _cbor_from_json_header(
+          context,
+          cbor_encode_map_start(size, context->header, _CBOR_MAX_HEADER_SIZE));
+    else
+      _cbor_from_json_header(
+          context, cbor_encode_array_start(size, context->header,
+                                           _CBOR_MAX_HEADER_SIZE));
+  }
+  size_t index = state->depth++;
+  unsigned char bit = (unsigned char)(1u << (index % 8));
+  if (object)
+    state->objects[index / 8] |= bit;
+  else
+    state->objects[index / 8] &= (unsigned char)~bit;
+}
+
+static void _cbor_from_json_close(struct _cbor_from_json_context* context) {
+  context->state->depth--;
+  if (context->options & CBOR_FROM_JSON_INDEFINITE)
+    _cbor_from_json_header(
+        context, cbor_encode_break(context->header, _CBOR_MAX_HEADER_SIZE));
+}
+
+static int _cbor_from_json_hex_digit(unsigned char byte) {
+  if (byte >= '0' && byte <= '9') return byte - '0';
+  if (byte >= 'a' && byte <= 'f') return byte - 'a' + 10;
+  if (byte >= 'A' && byte <= 'F') return byte - 'A' + 10;
+  return -1;
+}
+
+/** Parse the four hexadecimal digits of a `\u` escape
+ *
+ * @return The code unit, or -1 on error
+ */
+static long _cbor_from_json_code_unit(struct _cbor_from_json_context* context,
+                                      const unsigned char* cursor,
+                                      const unsigned char* end) {
+  long unit = 0;
+  for (int i = 0; i < 4; i++) {
+    if (cursor + i == end) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+      return -1;
+    }
+    int digit = _cbor_from_json_hex_digit(cursor[i]);
+    if (digit < 0) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return -1;
+    }
+    unit = unit * 16 + digit;
+  }
+  return unit;
+}
+
+/** Decode an escape sequence
+ *
+ * @param context The conversion context
+ * @param cursor[in, out] Position after the backslash, advanced past the
+ *  sequence
+ * @param end End of the input
+ * @param output Buffer for the UTF-8 encoding of the escaped character
+ * @return The length of the UTF-8 encoding, zero on error
+ */
+static size_t _cbor_from_json_escape(struct _cbor_from_json_context* context,
+                                     const unsigned char** cursor,
+                                     const unsigned char* end,
+                                     unsigned char output[4]) {
+  const unsigned char* position = *cursor;
+  if (position == end) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+    return 0;
+  }
+  *cursor = position + 1;
+  switch (*position) {
+    case '"':
+    case '\\':
+    case '/':
+      output[0] = *position;
+      return 1;
+    case 'b':
+      output[0] = '\b';
+      return 1;
+    case 'f':
+      output[0] = '\f';
+      return 1;
+    case 'n':
+      output[0] = '\n';
+      return 1;
+    case 'r':
+      output[0] = '\r';
+      return 1;
+    case 't':
+      output[0] = '\t';
+      return 1;
+    case 'u':
+      break;
+    default:
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return 0;
+  }
+  long code_point = _cbor_from_json_code_unit(context, position + 1, end);
+  if (code_point < 0) return 0;
+  *cursor = position + 5;
+  if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+    // A high surrogate must be followed by an escaped low surrogate
+    if (end - *cursor < 2) {
+      _cbor_from_json_fail(context, end - *cursor == 1 && **cursor != '\\'
+                                        ? CBOR_JSON_ERR_MALFORMED
+                                        : CBOR_JSON_ERR_NOTENOUGHDATA);
+      return 0;
+    }
+    if ((*cursor)[0] != '\\' || (*cursor)[1] != 'u') {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return 0;
+    }
+    long low = _cbor_from_json_code_unit(context, *cursor + 2, end);
+    if (low < 0) return 0;
+    if (low < 0xDC00 || low > 0xDFFF) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return 0;
+    }
+    *cursor += 6;
+    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+  } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+    return 0;
+  }
+  if (code_point < 0x80) {
+    output[0] = (unsigned char)code_point;
+    return 1;
+  }
+  if (code_point < 0x800) {
+    output[0] = (unsigned char)(0xC0 | (code_point >> 6));
+    output[1] = (unsigned char)(0x80 | (code_point & 0x3F));
+    return 2;
+  }
+  if (code_point < 0x10000) {
+    output[0] = (unsigned char)(0xE0 | (code_point >> 12));
+    output[1] = (unsigned char)(0x80 | ((code_point >> 6) & 0x3F));
+    output[2] = (unsigned char)(0x80 | (code_point & 0x3F));
+    return 3;
+  }
+  output[0] = (unsigned char)(0xF0 | (code_point >> 18));
+  output[1] = (unsigned char)(0x80 | ((code_point >> 12) & 0x3F));
+  output[2] = (unsigned char)(0x80 | ((code_point >> 6) & 0x3F));
+  output[3] = (unsigned char)(0x80 | (code_point & 0x3F));
+  return 4;
+}
+
+/** Scan the contents of a JSON string
+ *
+ * @param context The conversion context
+ * @param start Position after the opening quote
+ * @param end End of the input
+ * @param emit Whether to output the decoded contents. Otherwise, the contents
+ *  are validated.
+ * @param[out] length The length of the decoded contents
+ * @param[out] escaped Whether the string contains escape sequences
+ * @return Position after the closing quote, `NULL` on error
+ */
+static const unsigned char* _cbor_from_json_string_contents(
+    struct _cbor_from_json_context* context, const unsigned char* start,
+    const unsigned char* end, bool emit, size_t* length, bool* escaped) {
+  const unsigned char* cursor = start;
+  *length = 0;
+  *escaped = false;
+  while (true) {
+    size_t plain = _cbor_json_plain_prefix(cursor, (size_t)(end - cursor));
+    if (emit) {
+      _cbor_from_json_raw(context, cursor, plain);
+    } else {
+      struct _cbor_unicode_status status;
+      size_t codepoints _CBOR_UNUSED =
+          _cbor_unicode_codepoint_count(cursor, plain, &status);
+      if (status.status != _CBOR_UNICODE_OK) {
+        // The string is incomplete if it extends to the end of the input
+        _cbor_from_json_fail(context, cursor + plain == end
+                                          ? CBOR_JSON_ERR_NOTENOUGHDATA
+                                          : CBOR_JSON_ERR_MALFORMED);
+        return NULL;
+      }
+    }
+    cursor += plain;
+    *length += plain;
+    if (cursor == end) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+      return NULL;
+    }
+    if (*cursor == '"') return cursor + 1;
+    if (*cursor != '\\') {
+      // Unescaped control character
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return NULL;
+    }
+    cursor++;
+    unsigned char character[4];
+    size_t character_length =
+        _cbor_from_json_escape(context, &cursor, end, character);
+    if (character_length == 0) return NULL;
+    if (emit) _cbor_from_json_raw(context, character, character_length);
+    *length += character_length;
+    *escaped = true;
+  }
+}
+
+/** Convert a JSON string to a definite string
+ *
+ * @return Position after the closing quote, `NULL` on error
+ */
+static const unsigned char* _cbor_from_json_string(
+    struct _cbor_from_json_context* context, const unsigned char* start,
+    const unsigned char* end) {
+  size_t length;
+  bool escaped;
+  const unsigned char* cursor = _cbor_from_json_string_contents(
+      context, start, end, false, &length, &escaped);
+  if (cursor == NULL) return NULL;
+  _cbor_from_json_header(
+      context,
+      cbor_encode_string_start(length, context->header, _CBOR_MAX_HEADER_SIZE));
+  if (escaped)
+    _cbor_from_json_string_contents(context, start, end, true, &length,
+                                    &escaped);
+  else
+    _cbor_from_json_raw(context, start, length);
+  return cursor;
+}
+
+static const unsigned char* _cbor_from_json_literal(
+    struct _cbor_from_json_context* context, const unsigned char* cursor,
+    const unsigned char* end, const char* literal, size_t literal_length) {
+  size_t available = (size_t)(end - cursor);
+  if (memcmp(cursor, literal,
+             available < literal_length ? available : literal_length) != 0) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+    return NULL;
+  }
+  if (available < literal_length) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+    return NULL;
+  }
+  return cursor + literal_length;
+}
+
+static bool _cbor_from_json_is_digit(const unsigned char* cursor,
+                                     const unsigned char* end) {
+  return cursor < end && *cursor >= '0' && *cursor <= '9';
+}
+
+/** Convert a number that is not an integer in the CBOR range to the
+ * narrowest float that represents the parsed value exactly */
+static void _cbor_from_json_float(struct _cbor_from_json_context* context,
+                                  const unsigned char* start, size_t length) {
+  char number_inline[_CBOR_FROM_JSON_NUMBER_SIZE];
+  char* number = number_inline;
+  if (length >= sizeof(number_inline)) {
+    number = _CBOR_MALLOC(context->allocator, CBOR_ALLOC_SITE_OTHER,
+                          length + 1);
+    if (number == NULL) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MEMERROR);
+      return;
+    }
+  }
+  memcpy(number, start, length);
+  number[length] = '\0';
+  // strtod expects the decimal separator of the current locale
+  char* separator = memchr(number, '.', length);
+  if (separator != NULL) *separator = localeconv()->decimal_point[0];
+  double value = strtod(number, NULL);
+  if (number != number_inline) _CBOR_FREE(context->allocator, number);
+
+  switch (_cbor_narrowest_float_width(value)) {
+    case CBOR_FLOAT_16:
+      _cbor_from_json_header(
+          context, cbor_encode_half((float)value, context->header,
+                                    _CBOR_MAX_HEADER_SIZE));
+      break;
+    case CBOR_FLOAT_32:
+      _cbor_from_json_header(
+          context, cbor_encode_single((float)value, context->header,
+                                      _CBOR_MAX_HEADER_SIZE));
+      break;
+    default:
+      _cbor_from_json_header(
+          context,
+          cbor_encode_double(value, context->header, _CBOR_MAX_HEADER_SIZE));
+  }
+}
+
+/** Convert a number to the shortest integer or float encoding
+ *
+ * @param complete Whether the input ends at \p end. Otherwise, a number that
+ *  extends to \p end may continue and is not converted.
+ * @return Position after the number, `NULL` on error
+ */
+static const unsigned char* _cbor_from_json_number(
+    struct _cbor_from_json_context* context, const unsigned char* start,
+    const unsigned char* end, bool complete) {
+  const unsigned char* cursor = start;
+  bool negative = *cursor == '-';
+  if (negative) cursor++;
+  if (cursor == end) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+    return NULL;
+  }
+  const unsigned char* digits = cursor;
+  uint64_t value = 0;
+  bool overflow = false;
+  if (*cursor == '0') {
+    cursor++;
+  } else if (_cbor_from_json_is_digit(cursor, end)) {
+    for (; _cbor_from_json_is_digit(cursor, end); cursor++) {
+      unsigned digit = *cursor - '0';
+      if (value > (UINT64_MAX - digit) / 10) overflow = true;
+      value = value * 10 + digit;
+    }
+  } else {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+    return NULL;
+  }
+  size_t digits_length = (size_t)(cursor - digits);
+  bool integral = true;
+  if (cursor < end && *cursor == '.') {
+    integral = false;
+    if (!_cbor_from_json_is_digit(++cursor, end)) goto invalid;
+    while (_cbor_from_json_is_digit(cursor, end)) cursor++;
+  }
+  if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+    integral = false;
+    cursor++;
+    if (cursor < end && (*cursor == '+' || *cursor == '-')) cursor++;
+    if (!_cbor_from_json_is_digit(cursor, end)) goto invalid;
+    while (_cbor_from_json_is_digit(cursor, end)) cursor++;
+  }
+  if (cursor == end && !complete) {
+    _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+    return NULL;
+  }
+
+  if (integral && !overflow && !negative) {
+    _cbor_from_json_header(
+        context,
+        cbor_encode_uint(value, context->header, _CBOR_MAX_HEADER_SIZE));
+  } else if (integral && !overflow && value > 0) {
+    _cbor_from_json_header(
+        context,
+        cbor_encode_negint(value - 1, context->header, _CBOR_MAX_HEADER_SIZE));
+  } else if (integral && negative && digits_length == 20 &&
+             memcmp(digits, "18446744073709551616", 20) == 0) {
+    // -2^64, the smallest negative integer
+    _cbor_from_json_header(
+        context,
+        cbor_encode_negint(UINT64_MAX, context->header, _CBOR_MAX_HEADER_SIZE));
+  } else {
+    // Fractions, exponents, integers out of range, and -0
+    _cbor_from_json_float(context, start, (size_t)(cursor - start));
+  }
+  return cursor;
+
+invalid:
+  _cbor_from_json_fail(context, cursor == end ? CBOR_JSON_ERR_NOTENOUGHDATA
+                                              : CBOR_JSON_ERR_MALFORMED);
+  return NULL;
+}
+
+/** Convert a scalar value
+ *
+ * @param complete See #_cbor_from_json_number
+ * @return Position after the value, `NULL` on error
+ */
+static const unsigned char* _cbor_from_json_scalar(
+    struct _cbor_from_json_context* context, const unsigned char* cursor,
+    const unsigned char* end, bool complete) {
+  switch (*cursor) {
+    case '"':
+      return _cbor_from_json_string(context, cursor + 1, end);
+    case 't':
+      cursor = _cbor_from_json_literal(context, cursor, end, "true", 4);
+      _cbor_from_json_header(
+          context,
+          cbor_encode_bool(true, context->header, _CBOR_MAX_HEADER_SIZE));
+      return cursor;
+    case 'f':
+      cursor = _cbor_from_json_literal(context, cursor, end, "false", 5);
+      _cbor_from_json_header(
+          context,
+          cbor_encode_bool(false, context->header, _CBOR_MAX_HEADER_SIZE));
+      return cursor;
+    case 'n':
+      cursor = _cbor_from_json_literal(context, cursor, end, "null", 4);
+      _cbor_from_json_header(
+          context, cbor_encode_null(context->header, _CBOR_MAX_HEADER_SIZE));
+      return cursor;
+    default:
+      if (*cursor == '-' || _cbor_from_json_is_digit(cursor, end))
+        return _cbor_from_json_number(context, cursor, end, complete);
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+      return NULL;
+  }
+}
+
+/** Convert the tokens of a JSON value until it is complete
+ *
+ * @param complete Whether the input ends at \p end. Otherwise, a token that
+ *  extends to \p end is left for the next call.
+ * @return Position after the last converted token, and after the whitespace
+ *  following the value if it is complete. If it is not, the error is
+ *  #CBOR_JSON_ERR_NOTENOUGHDATA.
+ */
+static const unsigned char* _cbor_from_json_tokens(
+    struct _cbor_from_json_context* context, const unsigned char* cursor,
+    const unsigned char* end, bool complete) {
+  struct cbor_from_json_state* state = context->state;
+  while (true) {
+    cursor = _cbor_from_json_skip_whitespace(cursor, end);
+    if (state->depth == 0 && state->expect == _CBOR_FROM_JSON_NEXT)
+      return cursor;
+    if (cursor == end) {
+      _cbor_from_json_fail(context, CBOR_JSON_ERR_NOTENOUGHDATA);
+      return cursor;
+    }
+
+    const unsigned char* next = cursor + 1;
+    enum _cbor_from_json_expect expect = _CBOR_FROM_JSON_NEXT;
+    switch ((enum _cbor_from_json_expect)state->expect) {
+      case _CBOR_FROM_JSON_FIRST_VALUE:
+        if (*cursor == ']') {
+          _cbor_from_json_close(context);
+          break;
+        }
+        // Fall through
+      case _CBOR_FROM_JSON_VALUE:
+        if (*cursor == '[' || *cursor == '{') {
+          bool object = *cursor == '{';
+          _cbor_from_json_open(context, object);
+          expect =
+              object ? _CBOR_FROM_JSON_FIRST_KEY : _CBOR_FROM_JSON_FIRST_VALUE;
+          break;
+        }
+        next = _cbor_from_json_scalar(context, cursor, end, complete);
+        break;
+      case _CBOR_FROM_JSON_FIRST_KEY:
+        if (*cursor == '}') {
+          _cbor_from_json_close(context);
+          break;
+        }
+        // Fall through
+      case _CBOR_FROM_JSON_KEY:
+        if (*cursor != '"') {
+          _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+          break;
+        }
+        next = _cbor_from_json_string(context, cursor + 1, end);
+        expect = _CBOR_FROM_JSON_COLON;
+        break;
+      case _CBOR_FROM_JSON_COLON:
+        if (*cursor != ':')
+          _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+        expect = _CBOR_FROM_JSON_VALUE;
+        break;
+      case _CBOR_FROM_JSON_NEXT: {
+        bool object = _cbor_from_json_in_object(state);
+        if (*cursor == ',') {
+          expect = object ? _CBOR_FROM_JSON_KEY : _CBOR_FROM_JSON_VALUE;
+        } else if (*cursor == (object ? '}' : ']')) {
+          _cbor_from_json_close(context);
+        } else {
+          _cbor_from_json_fail(context, CBOR_JSON_ERR_MALFORMED);
+        }
+        break;
+      }
+    }
+    // Tokens are only output once they are complete, so the conversion can
+    // resume at the start of a token that extends past the input
+    if (context->error != CBOR_JSON_ERR_NONE) return cursor;
+    state->expect = (uint8_t)expect;
+    cursor = next;
+  }
+}
+
+/**
+ * @param complete Whether the input ends after \p length bytes, see
+ *  #_cbor_from_json_tokens
+ */
+static struct cbor_json_result _cbor_from_json_convert(
+    struct _cbor_from_json_context* context, const char* json, size_t length,
+    bool complete) {
+  const unsigned char* start = (const unsigned char*)json;
+  const unsigned char* end = start + length;
+  context->allocator = cbor_thread_allocator();
+  context->sizes = context->inline_sizes;
+  context->sizes_capacity = _CBOR_FROM_JSON_INLINE_SIZE;
+
+  const unsigned char* cursor = _cbor_from_json_skip_whitespace(start, end);
+  if (!(context->options & CBOR_FROM_JSON_INDEFINITE) && cursor < end &&
+      (*cursor == '[' || *cursor == '{'))
+    _cbor_from_json_count(context, cursor, end);
+  if (context->error == CBOR_JSON_ERR_NONE)
+    cursor = _cbor_from_json_tokens(context, cursor, end, complete);
+  // The tokens converted before the input ended are complete
+  bool resumable = context->error == CBOR_JSON_ERR_NOTENOUGHDATA && !complete;
+  if (context->sink != NULL &&
+      (context->error == CBOR_JSON_ERR_NONE || resumable)) {
+    cbor_json_error_code error = context->error;
+    context->error = CBOR_JSON_ERR_NONE;
+    if (_cbor_from_json_flush(context)) context->error = error;
+  }
+
+  if (context->sizes != context->inline_sizes)
+    _CBOR_FREE(context->allocator, context->sizes);
+  return (struct cbor_json_result){
+      .read = context->error == CBOR_JSON_ERR_NONE || resumable
+                  ? (size_t)(cursor - start)
+                  : 0,
+      .written = context->sink == NULL ? context->buffered : context->written,
+      .error = context->error};
+}
+
+struct cbor_json_result cbor_from_json(const char* json, size_t length,
+                                       unsigned options,
+                                       cbor_writer_sink sink,
+                                       void* sink_context) {
+  unsigned char buffer[_CBOR_FROM_JSON_BUFFER_SIZE];
+  struct cbor_from_json_state state = {0};
+  struct _cbor_from_json_context context = {
+      .options = options,
+      .sink = sink,
+      .sink_context = sink_context,
+      .buffer = buffer,
+      .buffer_size = sizeof(buffer),
+      .state = &state,
+      .error = CBOR_JSON_ERR_NONE};
+  return _cbor_from_json_convert(&context, json, length, true);
+}
+
+struct cbor_json_result cbor_from_json_buffer(const char* json, size_t length,
+                                              unsigned options,
+                                              unsigned char* buffer,
+                                              size_t buffer_size) {
+  struct cbor_from_json_state state = {0};
+  struct _cbor_from_json_context context = {.options = options,
+                                            .buffer = buffer,
+                                            .buffer_size = buffer_size,
+                                            .state = &state,
+                                            .error = CBOR_JSON_ERR_NONE};
+  return _cbor_from_json_convert(&context, json, length, true);
+}
+
+struct cbor_json_result cbor_from_json_partial(
+    const char* json, size_t length, bool end_of_input,
+    struct cbor_from_json_state* state, cbor_writer_sink sink,
+    void* sink_context) {
+  unsigned char buffer[_CBOR_FROM_JSON_BUFFER_SIZE];
+  struct _cbor_from_json_context context = {
+      .options = CBOR_FROM_JSON_INDEFINITE,
+      .sink = sink,
+      .sink_context = sink_context,
+      .buffer = buffer,
+      .buffer_size = sizeof(buffer),
+      .state = state,
+      .error = CBOR_JSON_ERR_NONE};
+  struct cbor_json_result result =
+      _cbor_from_json_convert(&context, json, length, end_of_input);
+  // The next call starts a new value
+  if (result.error == CBOR_JSON_ERR_NONE) state->expect = _CBOR_FROM_JSON_VALUE;
+  return result;
+}
@@ -6,7 +6,9 @@
  */
 
 #include "maps.h"
+#include "internal/item_pool.h"
 #include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 size_t cbor_map_size(const cbor_item_t* item) {
   CBOR_ASSERT(cbor_isa_map(item));
@@ -19,27 +21,31 @@ size_t cbor_map_allocated(const cbor_item_t* item) {
 }
 
 cbor_item_t* cbor_new_definite_map(size_t size) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_MAP,
       .metadata = {.map_metadata = {.allocated = size,
                                     .type = _CBOR_METADATA_DEFINITE,
                                     .end_ptr = 0}},
-      .data = _cbor_alloc_multiple(sizeof(struct cbor_pair), size)};
-  _CBOR_DEPENDENT_NOTNULL(item, item->data);
+      .data = _cbor_alloc_multiple(allocator, sizeof(struct cbor_pair), size)};
+  _CBOR_ITEM_DEPENDENT_NOTNULL(allocator, item, item->data);
 
   return item;
 }
 
 cbor_item_t* cbor_new_indefinite_map(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_MAP,
       .metadata = {.map_metadata = {.allocated = 0,
                                     .type = _CBOR_METADATA_INDEFINITE,
@@ -74,8 +80,9 @@ bool _cbor_map_add_key(cbor_item_t* item, cbor_item_t* key) {
                                   ? 1
                                   : CBOR_BUFFER_GROWTH * metadata->allocated;
 
-      unsigned char* new_data = _cbor_realloc_multiple(
-          item->data, sizeof(struct cbor_pair), new_allocation);
+      unsigned char* new_data =
+          _cbor_realloc_multiple(item->allocator, item->data,
+                                 sizeof(struct cbor_pair), new_allocation);
 
       if (new_data == NULL) {
         return false;
@@ -89,6 +96,8 @@ bool _cbor_map_add_key(cbor_item_t* item, cbor_item_t* key) {
     data[metadata->end_ptr++].value = NULL;
   }
   cbor_incref(key);
+  _cbor_size_cache_link(item, key);
+  _cbor_size_cache_invalidate(item);
   return true;
 }
 
@@ -100,12 +109,15 @@ bool _cbor_map_add_value(cbor_item_t* item, cbor_item_t* value) {
        * was the previous operation on this object */
       item->metadata.map_metadata.end_ptr - 1]
       .value = value;
+  _cbor_size_cache_link(item, value);
+  _cbor_size_cache_invalidate(item);
   return true;
 }
 
 // TODO: Add a more convenient API like add(item, key, val)
 bool cbor_map_add(cbor_item_t* item, struct cbor_pair pair) {
   CBOR_ASSERT(cbor_isa_map(item));
+  if (cbor_is_frozen(item)) return false;
   if (!_cbor_map_add_key(item, pair.key)) return false;
   return _cbor_map_add_value(item, pair.value);
 }
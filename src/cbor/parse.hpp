@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_PARSE_HPP
+#define LIBCBOR_PARSE_HPP
+
+#if __cplusplus < 201703L && (!defined(_MSVC_LANG) || _MSVC_LANG < 201703L)
+#error "cbor/parse.hpp requires C++17"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "cbor/common.h"
+#include "cbor/big_endian.h"
+
+namespace cbor {
+
+namespace detail {
+
+template <class Handler, template <class> class Member, class = void>
+struct has_member : std::false_type {};
+
+template <class Handler, template <class> class Member>
+struct has_member<Handler, Member, std::void_t<Member<Handler>>>
+    : std::true_type {};
+
+#define _CBOR_PARSE_MEMBER(name, arguments) \
+  template <class Handler>                 \
+  using name##_member = decltype(std::declval<Handler&>().name arguments);
+
+_CBOR_PARSE_MEMBER(uint8, (std::uint8_t{}))
+_CBOR_PARSE_MEMBER(uint16, (std::uint16_t{}))
+_CBOR_PARSE_MEMBER(uint32, (std::uint32_t{}))
+_CBOR_PARSE_MEMBER(uint64, (std::uint64_t{}))
+_CBOR_PARSE_MEMBER(negint8, (std::uint8_t{}))
+_CBOR_PARSE_MEMBER(negint16, (std::uint16_t{}))
+_CBOR_PARSE_MEMBER(negint32, (std::uint32_t{}))
+_CBOR_PARSE_MEMBER(negint64, (std::uint64_t{}))
+_CBOR_PARSE_MEMBER(byte_string, (cbor_data{}, std::uint64_t{}))
+_CBOR_PARSE_MEMBER(byte_string_start, ())
+_CBOR_PARSE_MEMBER(string, (cbor_data{}, std::uint64_t{}))
+_CBOR_PARSE_MEMBER(string_start, ())
+_CBOR_PARSE_MEMBER(array_start, (std::uint64_t{}))
+_CBOR_PARSE_MEMBER(indef_array_start, ())
+_CBOR_PARSE_MEMBER(map_start, (std::uint64_t{}))
+_CBOR_PARSE_MEMBER(indef_map_start, ())
+_CBOR_PARSE_MEMBER(tag, (std::uint64_t{}))
+_CBOR_PARSE_MEMBER(float2, (float{}))
+_CBOR_PARSE_MEMBER(float4, (float{}))
+_CBOR_PARSE_MEMBER(float8, (double{}))
+_CBOR_PARSE_MEMBER(undefined, ())
+_CBOR_PARSE_MEMBER(null, ())
+_CBOR_PARSE_MEMBER(boolean, (bool{}))
+_CBOR_PARSE_MEMBER(indef_break, ())
+
+#undef _CBOR_PARSE_MEMBER
+
+#define _CBOR_HANDLES(name) has_member<Handler, name##_member>::value
+
+/** Head of a data item: the initial byte and the argument */
+struct event_head {
+  std::uint8_t major;
+  /** Additional information, the low five bits of the initial byte */
+  std::uint8_t info;
+  /** Length of the argument in bytes */
+  std::uint8_t size;
+  std::uint64_t argument;
+};
+
+/** Marks initial bytes that #cbor_stream_decode rejects */
+constexpr std::uint8_t invalid_head = 0xFF;
+
+/** Length of the argument that follows each initial byte */
+constexpr std::array<std::uint8_t, 256> make_argument_sizes() {
+  std::array<std::uint8_t, 256> sizes{};
+  for (std::size_t initial = 0; initial < 256; initial++) {
+    const std::size_t major = initial >> 5, info = initial & 0x1F;
+    if (info < 24 || info == 31)
+      sizes[initial] = 0;
+    else if (info < 28)
+      sizes[initial] = static_cast<std::uint8_t>(1 << (info - 24));
+    else
+      sizes[initial] = invalid_head;
+    // No indefinite integers or tags, and only the simple values understood
+    // by the callbacks
+    if ((info == 31 && (major <= 1 || major == 6)) ||
+        (major == 7 && (info < 20 || info == 24)))
+      sizes[initial] = invalid_head;
+  }
+  return sizes;
+}
+
+constexpr std::array<std::uint8_t, 256> argument_sizes = make_argument_sizes();
+
+/** Read the head at \p source, with the same checks as #cbor_stream_decode */
+inline cbor_decoder_status read_head(cbor_data source, std::size_t source_size,
+                                     event_head& head) noexcept {
+  const std::uint8_t initial = *source;
+  head.major = initial >> 5;
+  head.info = initial & 0x1F;
+  head.size = argument_sizes[initial];
+  if (head.size == invalid_head) return CBOR_DECODER_ERROR;
+  if (source_size - 1 < head.size) return CBOR_DECODER_NEDATA;
+  if (source_size > 8) {
+    // Load the widest argument and drop the excess bytes, which avoids a
+    // poorly predictable branch on the width
+    const std::uint64_t widest = cbor_load_uint64(source + 1);
+    head.argument = head.size == 0 ? head.info
+                                   : widest >> (64 - 8 * head.size);
+    return CBOR_DECODER_FINISHED;
+  }
+  switch (head.size) {
+    case 0:
+      head.argument = head.info;
+      break;
+    case 1:
+      head.argument = source[1];
+      break;
+    case 2:
+      head.argument = cbor_load_uint16(source + 1);
+      break;
+    case 4:
+      head.argument = cbor_load_uint32(source + 1);
+      break;
+    default:
+      head.argument = cbor_load_uint64(source + 1);
+  }
+  return CBOR_DECODER_FINISHED;
+}
+
+/** Report an unsigned integer to the narrowest handler that can hold it */
+template <class Handler>
+void unsigned_event(Handler& handler, const event_head& head) {
+  switch (head.size) {
+    case 0:
+    case 1:
+      if constexpr (_CBOR_HANDLES(uint8)) {
+        handler.uint8(static_cast<std::uint8_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    case 2:
+      if constexpr (_CBOR_HANDLES(uint16)) {
+        handler.uint16(static_cast<std::uint16_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    case 4:
+      if constexpr (_CBOR_HANDLES(uint32)) {
+        handler.uint32(static_cast<std::uint32_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    default:
+      if constexpr (_CBOR_HANDLES(uint64)) handler.uint64(head.argument);
+  }
+}
+
+template <class Handler>
+void negative_event(Handler& handler, const event_head& head) {
+  switch (head.size) {
+    case 0:
+    case 1:
+      if constexpr (_CBOR_HANDLES(negint8)) {
+        handler.negint8(static_cast<std::uint8_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    case 2:
+      if constexpr (_CBOR_HANDLES(negint16)) {
+        handler.negint16(static_cast<std::uint16_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    case 4:
+      if constexpr (_CBOR_HANDLES(negint32)) {
+        handler.negint32(static_cast<std::uint32_t>(head.argument));
+        return;
+      }
+      [[fallthrough]];
+    default:
+      if constexpr (_CBOR_HANDLES(negint64)) handler.negint64(head.argument);
+  }
+}
+
+template <class Handler>
+void float_event(Handler& handler, cbor_data source, const event_head& head) {
+  switch (head.size) {
+    case 2:
+      if constexpr (_CBOR_HANDLES(float2)) {
+        handler.float2(cbor_load_half(source + 1));
+      } else if constexpr (_CBOR_HANDLES(float4)) {
+        handler.float4(cbor_load_half(source + 1));
+      } else if constexpr (_CBOR_HANDLES(float8)) {
+        handler.float8(static_cast<double>(cbor_load_half(source + 1)));
+      }
+      return;
+    case 4:
+      if constexpr (_CBOR_HANDLES(float4)) {
+        handler.float4(cbor_load_float(source + 1));
+      } else if constexpr (_CBOR_HANDLES(float8)) {
+        handler.float8(static_cast<double>(cbor_load_float(source + 1)));
+      }
+      return;
+    default:
+      if constexpr (_CBOR_HANDLES(float8))
+        handler.float8(cbor_load_double(source + 1));
+  }
+}
+
+/** Report a definite string whose contents start at \p data */
+template <class Handler>
+void string_event(Handler& handler, const event_head& head, cbor_data data) {
+  if (head.major == 2) {
+    if constexpr (_CBOR_HANDLES(byte_string))
+      handler.byte_string(data, head.argument);
+  } else if constexpr (_CBOR_HANDLES(string)) {
+    handler.string(data, head.argument);
+  }
+}
+
+/** Report the start of a container, an indefinite string, or a tag */
+template <class Handler>
+void start_event(Handler& handler, const event_head& head) {
+  const bool indefinite = head.info == 31;
+  switch (head.major) {
+    case 2:
+      if constexpr (_CBOR_HANDLES(byte_string_start))
+        handler.byte_string_start();
+      return;
+    case 3:
+      if constexpr (_CBOR_HANDLES(string_start)) handler.string_start();
+      return;
+    case 4:
+      if (indefinite) {
+        if constexpr (_CBOR_HANDLES(indef_array_start))
+          handler.indef_array_start();
+      } else if constexpr (_CBOR_HANDLES(array_start)) {
+        handler.array_start(head.argument);
+      }
+      return;
+    case 5:
+      if (indefinite) {
+        if constexpr (_CBOR_HANDLES(indef_map_start)) handler.indef_map_start();
+      } else if constexpr (_CBOR_HANDLES(map_start)) {
+        handler.map_start(head.argument);
+      }
+      return;
+    default:
+      if constexpr (_CBOR_HANDLES(tag)) handler.tag(head.argument);
+  }
+}
+
+/** Report a simple value, a float, or a break */
+template <class Handler>
+void simple_event(Handler& handler, cbor_data source, const event_head& head) {
+  switch (head.info) {
+    case 20:
+    case 21:
+      if constexpr (_CBOR_HANDLES(boolean)) handler.boolean(head.info == 21);
+      return;
+    case 22:
+      if constexpr (_CBOR_HANDLES(null)) handler.null();
+      return;
+    case 23:
+      if constexpr (_CBOR_HANDLES(undefined)) handler.undefined();
+      return;
+    case 31:
+      if constexpr (_CBOR_HANDLES(indef_break)) handler.indef_break();
+      return;
+    default:
+      float_event(handler, source, head);
+  }
+}
+
+#undef _CBOR_HANDLES
+
+/** What an open item accepts */
+enum parse_frame_kind : std::uint32_t {
+  /** A definite container or a tag */
+  definite_frame,
+  indefinite_array_frame,
+  indefinite_map_frame,
+  /** Chunks of an indefinite byte string */
+  byte_chunks_frame,
+  /** Chunks of an indefinite text string */
+  text_chunks_frame,
+};
+
+/** An open container, indefinite string, or tag */
+struct parse_frame {
+  /** Items still expected by a definite frame, or the number of items read
+   * by an indefinite one */
+  std::uint64_t count;
+  parse_frame_kind kind;
+};
+
+/** Move the stack of open items to a larger heap allocation
+ *
+ * @return The new stack, or `nullptr` if the allocation failed
+ */
+inline parse_frame* grow_stack(const parse_frame* frames, std::size_t size,
+                               std::size_t capacity,
+                               std::unique_ptr<parse_frame[]>& heap) noexcept {
+  std::unique_ptr<parse_frame[]> grown(new (std::nothrow)
+                                           parse_frame[capacity]);
+  if (grown == nullptr) return nullptr;
+  std::copy(frames, frames + size, grown.get());
+  heap = std::move(grown);
+  return heap.get();
+}
+
+}  // namespace detail
+
+/** Decode one data item, invoking \p handler for each event
+ *
+ * The compile-time counterpart of driving #cbor_stream_decode with a
+ * #cbor_callbacks table: the events and their arguments are the same, but
+ * they are delivered by calling member functions of \p handler directly, so
+ * they can be inlined into the decoding loop. A handler only declares the
+ * events it needs, e.g.
+ *
+ * \code
+ * struct sum {
+ *   uint64_t total = 0;
+ *   void uint64(uint64_t value) { total += value; }
+ * };
+ * \endcode
+ *
+ * Undeclared events are skipped. Unsigned and negative integers, as well as
+ * floats, are reported to the narrowest declared member that can hold them,
+ * so the `uint64` member above receives all unsigned integers.
+ *
+ * The whole item is validated like by #cbor_load, and the handler only sees
+ * well-formed event sequences: on syntax errors, decoding stops before the
+ * offending event. No memory is allocated unless the nesting is deeper than
+ * 16 levels.
+ *
+ * @param source The input buffer
+ * @param source_size Length of the input buffer
+ * @param handler Receives the events
+ * @return Result indicator. #cbor_load_result.read is the length of the
+ * item on success.
+ */
+template <class Handler>
+struct cbor_load_result parse(cbor_data source, std::size_t source_size,
+                              Handler& handler) {
+  struct cbor_load_result result = {{0, CBOR_ERR_NONE}, 0};
+  if (source_size == 0) {
+    result.error.code = CBOR_ERR_NODATA;
+    return result;
+  }
+
+  // The innermost open item is kept out of the stack. Initially, it is a
+  // placeholder expecting the single top-level item.
+  detail::parse_frame current = {1, detail::definite_frame};
+  // The enclosing ones are kept inline for shallow documents
+  detail::parse_frame inline_frames[16];
+  detail::parse_frame* frames = inline_frames;
+  std::unique_ptr<detail::parse_frame[]> heap_frames;
+  std::size_t depth = 0, capacity = 16;
+
+  cbor_data cursor = source;
+  const cbor_data end = source + source_size;
+  while (true) {
+    detail::event_head head;
+    const cbor_decoder_status status =
+        cursor == end ? CBOR_DECODER_NEDATA
+                      : detail::read_head(
+                            cursor, static_cast<std::size_t>(end - cursor),
+                            head);
+    if (status != CBOR_DECODER_FINISHED) {
+      result.error.code = status == CBOR_DECODER_NEDATA ? CBOR_ERR_NOTENOUGHDATA
+                                                        : CBOR_ERR_MALFORMATED;
+      break;
+    }
+    cbor_data next = cursor + 1 + head.size;
+    const std::size_t available = static_cast<std::size_t>(end - next);
+    const bool indefinite = head.info == 31;
+
+    // Indefinite strings consist of definite strings of the same type
+    if (current.kind >= detail::byte_chunks_frame &&
+        !(head.major == 7 && indefinite) &&
+        (head.major != current.kind - detail::byte_chunks_frame + 2 ||
+         indefinite)) {
+      result.error.code = CBOR_ERR_SYNTAXERROR;
+      break;
+    }
+
+    // Items that do not open a frame are reported right away
+    detail::parse_frame opened = {0, detail::definite_frame};
+    bool is_break = false;
+    switch (head.major) {
+      case 0:
+        detail::unsigned_event(handler, head);
+        break;
+      case 1:
+        detail::negative_event(handler, head);
+        break;
+      case 2:
+      case 3:
+        if (indefinite) {
+          opened.kind = head.major == 2 ? detail::byte_chunks_frame
+                                        : detail::text_chunks_frame;
+        } else if (head.argument > available) {
+          result.error.code = CBOR_ERR_NOTENOUGHDATA;
+        } else {
+          detail::string_event(handler, head, next);
+          next += head.argument;
+        }
+        break;
+      case 4:
+      case 5:
+        if (indefinite) {
+          opened.kind = head.major == 4 ? detail::indefinite_array_frame
+                                        : detail::indefinite_map_frame;
+        } else if (head.argument >
+                   (head.major == 4 ? available : available / 2)) {
+          // Every item takes at least a byte, so the container cannot be
+          // complete
+          result.error.code = CBOR_ERR_NOTENOUGHDATA;
+        } else {
+          opened.count = head.major == 4 ? head.argument : head.argument * 2;
+          if (opened.count == 0) detail::start_event(handler, head);
+        }
+        break;
+      case 6:
+        opened.count = 1;
+        break;
+      default:
+        // Indefinite maps must have a value for every key
+        if (indefinite && (current.kind == detail::definite_frame ||
+                           (current.kind == detail::indefinite_map_frame &&
+                            current.count % 2 != 0))) {
+          result.error.code = CBOR_ERR_SYNTAXERROR;
+          break;
+        }
+        is_break = indefinite;
+        detail::simple_event(handler, cursor, head);
+    }
+    if (result.error.code != CBOR_ERR_NONE) break;
+
+    if (opened.count > 0 || opened.kind != detail::definite_frame) {
+      if (depth == capacity) {
+        frames = capacity < CBOR_MAX_STACK_SIZE
+                     ? detail::grow_stack(
+                           frames, depth,
+                           std::min<std::size_t>(capacity * 2,
+                                                 CBOR_MAX_STACK_SIZE),
+                           heap_frames)
+                     : nullptr;
+        if (frames == nullptr) {
+          result.error.code = CBOR_ERR_MEMERROR;
+          break;
+        }
+        capacity = std::min<std::size_t>(capacity * 2, CBOR_MAX_STACK_SIZE);
+      }
+      frames[depth++] = current;
+      current = opened;
+      detail::start_event(handler, head);
+      cursor = next;
+      continue;
+    }
+
+    cursor = next;
+    if (is_break) current = frames[--depth];
+    // An item is complete, and so may be the items it closes
+    while (current.kind == detail::definite_frame && --current.count == 0) {
+      if (depth == 0) {
+        result.read = static_cast<std::size_t>(cursor - source);
+        return result;
+      }
+      current = frames[--depth];
+    }
+    if (current.kind != detail::definite_frame) current.count++;
+  }
+  result.error.position = static_cast<std::size_t>(cursor - source);
+  return result;
+}
+
+}  // namespace cbor
+
+#endif  // LIBCBOR_PARSE_HPP
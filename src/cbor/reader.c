@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "reader.h"
+
+#include "internal/loaders.h"
+
+enum _cbor_reader_frame_type {
+  _CBOR_READER_TOP_LEVEL,
+  /** Definite arrays, maps, tags, and indefinite containers after the break */
+  _CBOR_READER_DEFINITE,
+  _CBOR_READER_INDEF_ARRAY,
+  _CBOR_READER_INDEF_MAP,
+  _CBOR_READER_BYTESTRING_CHUNKS,
+  _CBOR_READER_STRING_CHUNKS
+};
+
+enum _cbor_reader_item_state {
+  _CBOR_READER_NO_ITEM,
+  /** The whole item has been read */
+  _CBOR_READER_ITEM,
+  /** The item is a container whose contents have not been read yet */
+  _CBOR_READER_ITEM_UNREAD
+};
+
+void cbor_reader_init(struct cbor_reader* reader, cbor_data source,
+                      size_t source_size) {
+  reader->source = source;
+  reader->source_size = source_size;
+  reader->position = 0;
+  reader->item_position = 0;
+  reader->item_argument = 0;
+  reader->item_head = 0;
+  reader->item_state = _CBOR_READER_NO_ITEM;
+  reader->error = (struct cbor_error){0, CBOR_ERR_NONE};
+  reader->depth = 0;
+  reader->frames[0] = (struct _cbor_reader_frame){
+      .remaining = 0, .type = _CBOR_READER_TOP_LEVEL};
+}
+
+static bool _cbor_reader_fail(struct cbor_reader* reader,
+                              cbor_error_code code) {
+  reader->error = (struct cbor_error){reader->item_position, code};
+  reader->item_state = _CBOR_READER_NO_ITEM;
+  return false;
+}
+
+static bool _cbor_reader_is_indefinite(uint8_t head) {
+  return (head & 0x1F) == 31;
+}
+
+/** Number of nested items of a definite array, map, or tag */
+static uint64_t _cbor_reader_subitems(uint8_t head, uint64_t argument) {
+  switch (head >> 5) {
+    case 4:
+      return argument;
+    case 5:
+      return 2 * argument;
+    default:
+      return 1;
+  }
+}
+
+/** Bitmasks of the additional information values that are not well-formed,
+ * by major type: reserved values, indefinite integers and tags, and
+ * unassigned simple values */
+static const uint32_t _cbor_reader_malformed_info[8] = {
+    0xF0000000, 0xF0000000, 0x70000000, 0x70000000,
+    0x70000000, 0x70000000, 0xF0000000, 0x710FFFFF};
+
+/** Decode the header at the current position and move past it (and past the
+ * data of definite strings) */
+static bool _cbor_reader_read_header(struct cbor_reader* reader) {
+  size_t available = reader->source_size - reader->position;
+  reader->item_position = reader->position;
+  if (available == 0) return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+
+  cbor_data header = reader->source + reader->position;
+  uint8_t major = *header >> 5, info = *header & 0x1F;
+  uint64_t argument = info;
+  size_t header_size = 1;
+  if (_cbor_reader_malformed_info[major] >> info & 1)
+    return _cbor_reader_fail(reader, CBOR_ERR_MALFORMATED);
+  if (info >= 24 && info <= 27) {
+    header_size += (size_t)1 << (info - 24);
+    if (available < header_size)
+      return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+    switch (info) {
+      case 24:
+        argument = _cbor_load_uint8(header + 1);
+        break;
+      case 25:
+        argument = _cbor_load_uint16(header + 1);
+        break;
+      case 26:
+        argument = _cbor_load_uint32(header + 1);
+        break;
+      default:
+        argument = _cbor_load_uint64(header + 1);
+    }
+  }
+
+  /* Every nested item takes at least one byte, so sizes that cannot fit are
+   * rejected before anything is read from the container */
+  available -= header_size;
+  if (info != 31) {
+    switch (major) {
+      case 2:
+      case 3:
+        if (argument > available)
+          return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+        header_size += (size_t)argument;
+        break;
+      case 4:
+        if (argument > available)
+          return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+        break;
+      case 5:
+        if (argument > available / 2)
+          return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+        break;
+      default:
+        break;
+    }
+  }
+
+  reader->item_head = *header;
+  reader->item_argument = argument;
+  reader->position += header_size;
+  return true;
+}
+
+/** Read the next item of the innermost container. The contents of the
+ * previous item must have been read. */
+static bool _cbor_reader_read(struct cbor_reader* reader) {
+  struct _cbor_reader_frame* frame = &reader->frames[reader->depth];
+  reader->item_state = _CBOR_READER_NO_ITEM;
+  if (frame->type == _CBOR_READER_DEFINITE) {
+    if (frame->remaining == 0) return false;
+  } else if (frame->type == _CBOR_READER_TOP_LEVEL &&
+             reader->position == reader->source_size) {
+    return false;
+  }
+  if (!_cbor_reader_read_header(reader)) return false;
+
+  uint8_t major = reader->item_head >> 5;
+  bool indefinite = _cbor_reader_is_indefinite(reader->item_head);
+  if (reader->item_head == 0xFF) {
+    if (frame->type == _CBOR_READER_TOP_LEVEL ||
+        frame->type == _CBOR_READER_DEFINITE ||
+        (frame->type == _CBOR_READER_INDEF_MAP && frame->remaining % 2 == 1))
+      return _cbor_reader_fail(reader, CBOR_ERR_SYNTAXERROR);
+    /* Nothing else can be read from the container */
+    *frame = (struct _cbor_reader_frame){.remaining = 0,
+                                         .type = _CBOR_READER_DEFINITE};
+    return false;
+  }
+
+  switch (frame->type) {
+    case _CBOR_READER_DEFINITE:
+      frame->remaining--;
+      break;
+    case _CBOR_READER_INDEF_MAP:
+      frame->remaining++;
+      break;
+    case _CBOR_READER_BYTESTRING_CHUNKS:
+    case _CBOR_READER_STRING_CHUNKS:
+      if (indefinite ||
+          major != (frame->type == _CBOR_READER_BYTESTRING_CHUNKS ? 2 : 3))
+        return _cbor_reader_fail(reader, CBOR_ERR_SYNTAXERROR);
+      break;
+    default:
+      break;
+  }
+  reader->item_state = (major >= 4 && major <= 6) || (indefinite && major < 4)
+                           ? _CBOR_READER_ITEM_UNREAD
+                           : _CBOR_READER_ITEM;
+  return true;
+}
+
+/** Make the current item the innermost container, unless that would exceed
+ * \p max_depth */
+static bool _cbor_reader_push(struct cbor_reader* reader, size_t max_depth) {
+  if (reader->depth >= max_depth)
+    return _cbor_reader_fail(reader, CBOR_ERR_MEMERROR);
+  struct _cbor_reader_frame frame = {.remaining = 0};
+  if (!_cbor_reader_is_indefinite(reader->item_head)) {
+    frame.type = _CBOR_READER_DEFINITE;
+    frame.remaining =
+        _cbor_reader_subitems(reader->item_head, reader->item_argument);
+  } else {
+    switch (reader->item_head >> 5) {
+      case 2:
+        frame.type = _CBOR_READER_BYTESTRING_CHUNKS;
+        break;
+      case 3:
+        frame.type = _CBOR_READER_STRING_CHUNKS;
+        break;
+      case 4:
+        frame.type = _CBOR_READER_INDEF_ARRAY;
+        break;
+      default:
+        frame.type = _CBOR_READER_INDEF_MAP;
+    }
+  }
+  reader->frames[++reader->depth] = frame;
+  reader->item_state = _CBOR_READER_ITEM;
+  return true;
+}
+
+/** Read and discard items until the reader is at most \p depth containers
+ * deep.
+ *
+ * Definite containers nested in definite containers are not entered, their
+ * items are added to the enclosing container's count instead, so only
+ * indefinite containers take up frames. */
+static bool _cbor_reader_drain(struct cbor_reader* reader, size_t depth) {
+  while (reader->depth > depth) {
+    if (!_cbor_reader_read(reader)) {
+      if (reader->error.code != CBOR_ERR_NONE) return false;
+      reader->depth--;
+      continue;
+    }
+    if (reader->item_state != _CBOR_READER_ITEM_UNREAD) continue;
+
+    struct _cbor_reader_frame* frame = &reader->frames[reader->depth];
+    if (frame->type == _CBOR_READER_DEFINITE &&
+        !_cbor_reader_is_indefinite(reader->item_head)) {
+      /* Each outstanding item takes at least one byte */
+      size_t available = reader->source_size - reader->position;
+      uint64_t subitems =
+          _cbor_reader_subitems(reader->item_head, reader->item_argument);
+      if (frame->remaining > available ||
+          subitems > available - frame->remaining)
+        return _cbor_reader_fail(reader, CBOR_ERR_NOTENOUGHDATA);
+      frame->remaining += subitems;
+      reader->item_state = _CBOR_READER_ITEM;
+    } else if (!_cbor_reader_push(reader, CBOR_READER_MAX_DEPTH)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Read the contents of the current item, keeping it current */
+static bool _cbor_reader_skip_contents(struct cbor_reader* reader) {
+  size_t item_position = reader->item_position;
+  uint64_t item_argument = reader->item_argument;
+  uint8_t item_head = reader->item_head;
+  size_t depth = reader->depth;
+  /* The spare frame lets definite containers be skipped even at the maximum
+   * depth */
+  if (!_cbor_reader_push(reader, CBOR_READER_MAX_DEPTH + 1) ||
+      !_cbor_reader_drain(reader, depth))
+    return false;
+  reader->item_position = item_position;
+  reader->item_argument = item_argument;
+  reader->item_head = item_head;
+  reader->item_state = _CBOR_READER_ITEM;
+  return true;
+}
+
+bool cbor_reader_next(struct cbor_reader* reader) {
+  if (reader->error.code != CBOR_ERR_NONE) return false;
+  if (reader->item_state == _CBOR_READER_ITEM_UNREAD &&
+      !_cbor_reader_skip_contents(reader))
+    return false;
+  return _cbor_reader_read(reader);
+}
+
+bool cbor_reader_enter(struct cbor_reader* reader) {
+  if (reader->error.code != CBOR_ERR_NONE ||
+      reader->item_state != _CBOR_READER_ITEM_UNREAD)
+    return false;
+  return _cbor_reader_push(reader, CBOR_READER_MAX_DEPTH);
+}
+
+bool cbor_reader_leave(struct cbor_reader* reader) {
+  if (reader->error.code != CBOR_ERR_NONE || reader->depth == 0) return false;
+  if (reader->item_state == _CBOR_READER_ITEM_UNREAD &&
+      !_cbor_reader_skip_contents(reader))
+    return false;
+  if (!_cbor_reader_drain(reader, reader->depth - 1)) return false;
+  reader->item_state = _CBOR_READER_NO_ITEM;
+  return true;
+}
+
+bool cbor_reader_skip(struct cbor_reader* reader) {
+  if (reader->error.code != CBOR_ERR_NONE ||
+      reader->item_state == _CBOR_READER_NO_ITEM)
+    return false;
+  if (reader->item_state == _CBOR_READER_ITEM_UNREAD)
+    return _cbor_reader_skip_contents(reader);
+  return true;
+}
+
+struct cbor_error cbor_reader_error(const struct cbor_reader* reader) {
+  return reader->error;
+}
+
+size_t cbor_reader_depth(const struct cbor_reader* reader) {
+  return reader->depth;
+}
+
+size_t cbor_reader_position(const struct cbor_reader* reader) {
+  return reader->position;
+}
+
+size_t cbor_reader_item_position(const struct cbor_reader* reader) {
+  return reader->item_position;
+}
+
+bool cbor_reader_has_item(const struct cbor_reader* reader) {
+  return reader->item_state != _CBOR_READER_NO_ITEM;
+}
+
+cbor_type cbor_reader_type(const struct cbor_reader* reader) {
+  CBOR_ASSERT(cbor_reader_has_item(reader));
+  return (cbor_type)(reader->item_head >> 5);
+}
+
+bool cbor_reader_is_indefinite(const struct cbor_reader* reader) {
+  return cbor_reader_has_item(reader) &&
+         _cbor_reader_is_indefinite(reader->item_head);
+}
+
+/** Is the current item of the given major type and definite? */
+static bool _cbor_reader_is_definite(const struct cbor_reader* reader,
+                                     uint8_t major) {
+  return cbor_reader_has_item(reader) && reader->item_head >> 5 == major &&
+         !_cbor_reader_is_indefinite(reader->item_head);
+}
+
+bool cbor_reader_uint(const struct cbor_reader* reader, uint64_t* value) {
+  if (!_cbor_reader_is_definite(reader, 0)) return false;
+  *value = reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_negint(const struct cbor_reader* reader, uint64_t* value) {
+  if (!_cbor_reader_is_definite(reader, 1)) return false;
+  *value = reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_int(const struct cbor_reader* reader, int64_t* value) {
+  if (reader->item_argument > INT64_MAX) return false;
+  if (_cbor_reader_is_definite(reader, 0)) {
+    *value = (int64_t)reader->item_argument;
+    return true;
+  }
+  if (_cbor_reader_is_definite(reader, 1)) {
+    *value = -1 - (int64_t)reader->item_argument;
+    return true;
+  }
+  return false;
+}
+
+/** Get the data of a definite string */
+static bool _cbor_reader_string_data(const struct cbor_reader* reader,
+                                     uint8_t major, cbor_data* data,
+                                     size_t* length) {
+  if (!_cbor_reader_is_definite(reader, major)) return false;
+  uint8_t info = reader->item_head & 0x1F;
+  size_t header_size = info < 24 ? 1 : 1 + ((size_t)1 << (info - 24));
+  *data = reader->source + reader->item_position + header_size;
+  *length = (size_t)reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_bytestring(const struct cbor_reader* reader, cbor_data* data,
+                            size_t* length) {
+  return _cbor_reader_string_data(reader, 2, data, length);
+}
+
+bool cbor_reader_string(const struct cbor_reader* reader, cbor_data* data,
+                        size_t* length) {
+  return _cbor_reader_string_data(reader, 3, data, length);
+}
+
+bool cbor_reader_array_size(const struct cbor_reader* reader, size_t* size) {
+  if (!_cbor_reader_is_definite(reader, 4)) return false;
+  *size = (size_t)reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_map_size(const struct cbor_reader* reader, size_t* size) {
+  if (!_cbor_reader_is_definite(reader, 5)) return false;
+  *size = (size_t)reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_tag(const struct cbor_reader* reader, uint64_t* value) {
+  if (!_cbor_reader_is_definite(reader, 6)) return false;
+  *value = reader->item_argument;
+  return true;
+}
+
+bool cbor_reader_float(const struct cbor_reader* reader, double* value) {
+  if (!cbor_reader_has_item(reader)) return false;
+  cbor_data payload = reader->source + reader->item_position + 1;
+  switch (reader->item_head) {
+    case 0xF9:
+      *value = _cbor_load_half(payload);
+      return true;
+    case 0xFA:
+      *value = _cbor_load_float(payload);
+      return true;
+    case 0xFB:
+      *value = _cbor_load_double(payload);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool cbor_reader_bool(const struct cbor_reader* reader, bool* value) {
+  if (!cbor_reader_has_item(reader) ||
+      (reader->item_head != 0xF4 && reader->item_head != 0xF5))
+    return false;
+  *value = reader->item_head == 0xF5;
+  return true;
+}
+
+bool cbor_reader_is_null(const struct cbor_reader* reader) {
+  return cbor_reader_has_item(reader) && reader->item_head == 0xF6;
+}
+
+bool cbor_reader_is_undef(const struct cbor_reader* reader) {
+  return cbor_reader_has_item(reader) && reader->item_head == 0xF7;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_READER_H
+#define LIBCBOR_READER_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Pull reader
+ * ============================================================================
+ */
+
+/** Maximum number of containers a #cbor_reader can be inside of at once
+ *
+ * This also limits the nesting of indefinite items passed over by
+ * #cbor_reader_skip. Definite items can be skipped regardless of their depth.
+ */
+#define CBOR_READER_MAX_DEPTH 32
+
+/** A container the reader is inside of. Private. */
+struct _cbor_reader_frame {
+  /** Outstanding items for definite containers. For indefinite maps, the
+   * number of items read so far (only the parity matters). */
+  uint64_t remaining;
+  uint8_t type;
+};
+
+/** Cursor over an encoded buffer
+ *
+ * The reader decodes one item at a time, on request, without allocating
+ * memory or copying the data: strings are returned as pointers into the
+ * buffer. It keeps track of the nesting and validates the input like
+ * #cbor_load, so a consumer only has to check the types it expects.
+ *
+ * The structure is meant to be allocated by the caller (e.g. on the stack)
+ * and initialized by #cbor_reader_init. All the fields are private.
+ */
+struct cbor_reader {
+  cbor_data source;
+  size_t source_size;
+  /** Offset of the first byte that has not been read */
+  size_t position;
+  /** Offset of the current item's header */
+  size_t item_position;
+  /** Value, length, or size from the current item's header */
+  uint64_t item_argument;
+  /** Initial byte of the current item */
+  uint8_t item_head;
+  uint8_t item_state;
+  struct cbor_error error;
+  /** Number of containers entered. frames[0] is the top level, the last frame
+   * is only used for skipping. */
+  size_t depth;
+  struct _cbor_reader_frame frames[CBOR_READER_MAX_DEPTH + 2];
+};
+
+/** Start reading a buffer
+ *
+ * The top level of the buffer is read as a sequence of items (RFC 8742), so
+ * #cbor_reader_next can be called repeatedly until the input is exhausted.
+ *
+ * @param reader The reader to initialize
+ * @param source The encoded data. Must stay valid while the reader is used.
+ * @param source_size Length of \p source
+ */
+CBOR_EXPORT void cbor_reader_init(struct cbor_reader* reader, cbor_data source,
+                                  size_t source_size);
+
+/** Advance to the next item of the current container
+ *
+ * If the previous item was a container that has not been entered, its
+ * contents are skipped first (see #cbor_reader_skip).
+ *
+ * @param reader The reader
+ * @return `true` if there is a new current item
+ * @return `false` at the end of the current container, at the end of the
+ * input on the top level, or if an error has occurred. Use
+ * #cbor_reader_error to tell them apart.
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_next(struct cbor_reader* reader);
+
+/** Descend into the current item
+ *
+ * Arrays, maps, tags, and indefinite strings can be entered. Subsequent
+ * #cbor_reader_next calls then return the array items, the map keys and
+ * values (alternating), the tagged item, or the string chunks.
+ *
+ * @param reader The reader
+ * @return `true` on success
+ * @return `false` if the current item cannot be entered, has already been
+ * skipped, or if #CBOR_READER_MAX_DEPTH would be exceeded. The last case
+ * puts the reader in the #CBOR_ERR_MEMERROR error state.
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_enter(struct cbor_reader* reader);
+
+/** Skip the rest of the current container and ascend to its parent
+ *
+ * The next #cbor_reader_next returns the item following the container.
+ *
+ * @param reader The reader
+ * @return `true` on success
+ * @return `false` on the top level or if an error has occurred
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_leave(struct cbor_reader* reader);
+
+/** Skip the contents of the current item
+ *
+ * Strings and scalars are skipped by #cbor_reader_next. For containers, the
+ * nested items are validated, but not reported. Definite containers are
+ * counted instead of entered, so they can be skipped without limits on their
+ * depth. The current item stays available.
+ *
+ * Afterwards, #cbor_reader_position is the offset just past the current item,
+ * which together with #cbor_reader_item_position delimits its encoding.
+ *
+ * @param reader The reader
+ * @return `true` on success
+ * @return `false` if there is no current item or if an error has occurred
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_skip(struct cbor_reader* reader);
+
+/** Get the error state
+ *
+ * Errors are sticky, all the operations fail once an error has occurred.
+ *
+ * @param reader The reader
+ * @return The error, with #CBOR_ERR_NONE code if there was none, and the
+ * offset of the item that caused it
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_error cbor_reader_error(
+    const struct cbor_reader* reader);
+
+/** Get the number of containers the reader is inside of
+ *
+ * @param reader The reader
+ * @return Number of successful #cbor_reader_enter calls not matched by
+ * #cbor_reader_leave
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t
+cbor_reader_depth(const struct cbor_reader* reader);
+
+/** Get the offset of the first byte that has not been read
+ *
+ * @param reader The reader
+ * @return Offset into the source buffer
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t
+cbor_reader_position(const struct cbor_reader* reader);
+
+/** Get the offset of the current item
+ *
+ * @param reader The reader. Must have a current item.
+ * @return Offset of the current item's header in the source buffer
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t
+cbor_reader_item_position(const struct cbor_reader* reader);
+
+/*
+ * Accessors of the current item. They are valid after #cbor_reader_next has
+ * returned `true`, until the next call to #cbor_reader_next or
+ * #cbor_reader_leave.
+ */
+
+/** Check whether there is a current item
+ *
+ * @param reader The reader
+ * @return `true` if #cbor_reader_next has returned an item that can be
+ * accessed
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_has_item(
+    const struct cbor_reader* reader);
+
+/** Get the type of the current item
+ *
+ * @param reader The reader. Must have a current item.
+ * @return The major type
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_type
+cbor_reader_type(const struct cbor_reader* reader);
+
+/** Is the current item an indefinite string, array, or map?
+ *
+ * @param reader The reader
+ * @return `true` if the current item is indefinite, `false` otherwise
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_is_indefinite(
+    const struct cbor_reader* reader);
+
+/*
+ * The typed getters below return `false` and leave the output unchanged if
+ * there is no current item or if it is of a different kind.
+ */
+
+/** Get an unsigned integer */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_uint(
+    const struct cbor_reader* reader, uint64_t* value);
+
+/** Get a negative integer, represented as `-1 - value` */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_negint(
+    const struct cbor_reader* reader, uint64_t* value);
+
+/** Get an unsigned or a negative integer that fits into `int64_t` */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_int(
+    const struct cbor_reader* reader, int64_t* value);
+
+/** Get a definite byte string (possibly a chunk)
+ *
+ * \p data points into the source buffer.
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_bytestring(
+    const struct cbor_reader* reader, cbor_data* data, size_t* length);
+
+/** Get a definite string (possibly a chunk)
+ *
+ * \p data points into the source buffer. The data is not validated to be
+ * UTF-8.
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_string(
+    const struct cbor_reader* reader, cbor_data* data, size_t* length);
+
+/** Get the size of a definite array */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_array_size(
+    const struct cbor_reader* reader, size_t* size);
+
+/** Get the number of pairs in a definite map */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_map_size(
+    const struct cbor_reader* reader, size_t* size);
+
+/** Get the value of a tag */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_tag(
+    const struct cbor_reader* reader, uint64_t* value);
+
+/** Get a half, single, or double precision float */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_float(
+    const struct cbor_reader* reader, double* value);
+
+/** Get a boolean */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_bool(
+    const struct cbor_reader* reader, bool* value);
+
+/** Is the current item null? */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_is_null(
+    const struct cbor_reader* reader);
+
+/** Is the current item undefined? */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_reader_is_undef(
+    const struct cbor_reader* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_READER_H
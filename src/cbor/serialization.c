@@ -5,8 +5,17 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+// ftruncate
+#define _POSIX_C_SOURCE 200809L
+
 #include "serialization.h"
 #include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "cbor/arrays.h"
 #include "cbor/bytestrings.h"
 #include "cbor/floats_ctrls.h"
@@ -14,28 +23,75 @@
 #include "cbor/maps.h"
 #include "cbor/strings.h"
 #include "cbor/tags.h"
+#include "cbor/writer.h"
 #include "encoding.h"
+#include "internal/atomics.h"
+#include "internal/encoders.h"
 #include "internal/memory_utils.h"
+#include "internal/size_cache.h"
+#include "internal/uint_kernels.h"
+#include "internal/walker.h"
+
+static size_t _cbor_serialize_nesting(const cbor_item_t* item,
+                                      unsigned char* buffer, size_t buffer_size,
+                                      unsigned options);
+
+/** Narrowest width that represents the value of a float exactly, but no wider
+ * than its own width */
+static cbor_float_width _cbor_preferred_float_width(const cbor_item_t* item) {
+  cbor_float_width width = cbor_float_get_width(item);
+  cbor_float_width narrowest =
+      _cbor_narrowest_float_width(cbor_float_get_float(item));
+  return narrowest < width ? narrowest : width;
+}
+
+static size_t _cbor_serialize_preferred_float_ctrl(const cbor_item_t* item,
+                                                   unsigned char* buffer,
+                                                   size_t buffer_size) {
+  if (cbor_float_get_width(item) == CBOR_FLOAT_0)
+    return cbor_serialize_float_ctrl(item, buffer, buffer_size);
+  double value = cbor_float_get_float(item);
+  switch (_cbor_preferred_float_width(item)) {
+    case CBOR_FLOAT_16:
+      return cbor_encode_half((float)value, buffer, buffer_size);
+    case CBOR_FLOAT_32:
+      return cbor_encode_single((float)value, buffer, buffer_size);
+    default:
+      return cbor_encode_double(value, buffer, buffer_size);
+  }
+}
 
 size_t cbor_serialize(const cbor_item_t* item, unsigned char* buffer,
                       size_t buffer_size) {
+  return cbor_serialize_with_options(item, buffer, buffer_size,
+                                     CBOR_SERIALIZE_DEFAULT);
+}
+
+size_t cbor_serialize_with_options(const cbor_item_t* item,
+                                   unsigned char* buffer, size_t buffer_size,
+                                   unsigned options) {
+  bool preferred = options & CBOR_SERIALIZE_PREFERRED;
   switch (cbor_typeof(item)) {
     case CBOR_TYPE_UINT:
-      return cbor_serialize_uint(item, buffer, buffer_size);
+      return preferred
+                 ? cbor_encode_uint(cbor_get_int(item), buffer, buffer_size)
+                 : cbor_serialize_uint(item, buffer, buffer_size);
     case CBOR_TYPE_NEGINT:
-      return cbor_serialize_negint(item, buffer, buffer_size);
+      return preferred
+                 ? cbor_encode_negint(cbor_get_int(item), buffer, buffer_size)
+                 : cbor_serialize_negint(item, buffer, buffer_size);
     case CBOR_TYPE_BYTESTRING:
       return cbor_serialize_bytestring(item, buffer, buffer_size);
     case CBOR_TYPE_STRING:
       return cbor_serialize_string(item, buffer, buffer_size);
     case CBOR_TYPE_ARRAY:
-      return cbor_serialize_array(item, buffer, buffer_size);
     case CBOR_TYPE_MAP:
-      return cbor_serialize_map(item, buffer, buffer_size);
     case CBOR_TYPE_TAG:
-      return cbor_serialize_tag(item, buffer, buffer_size);
+      return _cbor_serialize_nesting(item, buffer, buffer_size, options);
     case CBOR_TYPE_FLOAT_CTRL:
-      return cbor_serialize_float_ctrl(item, buffer, buffer_size);
+      return preferred ? _cbor_serialize_preferred_float_ctrl(item, buffer,
+                                                              buffer_size)
+                       : cbor_serialize_float_ctrl(item, buffer, buffer_size);
     default:
       _CBOR_UNREACHABLE;
       return 0;
@@ -48,35 +104,89 @@ const uint64_t kMaxEmbeddedInt = 23;
 /** How many bytes will a tag for a nested item of a given `size` take when
  * encoded.*/
 size_t _cbor_encoded_header_size(uint64_t size) {
-  if (size <= kMaxEmbeddedInt)
-    return 1;
-  else if (size <= UINT8_MAX)
-    return 2;
-  else if (size <= UINT16_MAX)
-    return 3;
-  else if (size <= UINT32_MAX)
-    return 5;
-  else
-    return 9;
+  return _cbor_uint_header_size(size);
 }
 
-size_t cbor_serialized_size(const cbor_item_t* item) {
+/** Serialized size of a nesting item without its children */
+static size_t _cbor_nesting_header_size(const cbor_item_t* item) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_is_definite(item)
+                 ? _cbor_encoded_header_size(cbor_array_size(item))
+                 : 2;  // Leading byte + break
+    case CBOR_TYPE_MAP:
+      return cbor_map_is_definite(item)
+                 ? _cbor_encoded_header_size(cbor_map_size(item))
+                 : 2;  // Leading byte + break
+    case CBOR_TYPE_TAG:
+      return _cbor_encoded_header_size(cbor_tag_value(item));
+    default:
+      _CBOR_UNREACHABLE;
+      return 0;
+  }
+}
+
+/** Size of a nesting item if it has been memoized and none of its nested
+ * items has been modified since it was computed
+ *
+ * @return false if the size needs to be computed
+ */
+static bool _cbor_cached_serialized_size(const cbor_item_t* item,
+                                         size_t generation, size_t* size) {
+  // The cache is not a part of the item's value, discarding const is fine
+  struct _cbor_size_cache* cache = _cbor_size_cache_of((cbor_item_t*)item);
+  // Frozen items cannot change, their size was cached by cbor_freeze
+  if (cbor_is_frozen(item)) {
+    *size = cache->size;
+    return true;
+  }
+  // Threads sharing the item may fill the cache concurrently. They store the
+  // same size, and the generation is published after it.
+  if (_CBOR_SHARED_LOAD_ACQUIRE(cache->generation) != generation) return false;
+  *size = _CBOR_SHARED_LOAD(cache->size);
+  return true;
+}
+
+static void _cbor_cache_serialized_size(const cbor_item_t* item,
+                                        size_t generation, size_t size) {
+  if (cbor_is_frozen(item)) return;
+  struct _cbor_size_cache* cache = _cbor_size_cache_of((cbor_item_t*)item);
+  _CBOR_SHARED_STORE(cache->size, size);
+  _CBOR_SHARED_STORE_RELEASE(cache->generation, generation);
+}
+
+/** Size of an item that can be determined without a walk, i.e. of items that
+ * can only contain definite strings, and of nesting items with a cached size
+ *
+ * @return false if \p item needs to be walked
+ */
+static bool _cbor_shallow_serialized_size(const cbor_item_t* item,
+                                          size_t generation, unsigned options,
+                                          size_t* size) {
+  bool preferred = options & CBOR_SERIALIZE_PREFERRED;
   switch (cbor_typeof(item)) {
     case CBOR_TYPE_UINT:
     case CBOR_TYPE_NEGINT:
+      if (preferred) {
+        *size = _cbor_encoded_header_size(cbor_get_int(item));
+        return true;
+      }
       switch (cbor_int_get_width(item)) {
         case CBOR_INT_8:
-          if (cbor_get_uint8(item) <= kMaxEmbeddedInt) return 1;
-          return 2;
+          *size = cbor_get_uint8(item) <= kMaxEmbeddedInt ? 1 : 2;
+          return true;
         case CBOR_INT_16:
-          return 3;
+          *size = 3;
+          return true;
         case CBOR_INT_32:
-          return 5;
+          *size = 5;
+          return true;
         case CBOR_INT_64:
-          return 9;
+          *size = 9;
+          return true;
         default:
           _CBOR_UNREACHABLE;
-          return 0;
+          return false;
       }
     // Note: We do not _cbor_safe_signaling_add zero-length definite strings,
     // they would cause zeroes to propagate. All other items are at least one
@@ -85,91 +195,153 @@ size_t cbor_serialized_size(const cbor_item_t* item) {
       if (cbor_bytestring_is_definite(item)) {
         size_t header_size =
             _cbor_encoded_header_size(cbor_bytestring_length(item));
-        if (cbor_bytestring_length(item) == 0) return header_size;
-        return _cbor_safe_signaling_add(header_size,
-                                        cbor_bytestring_length(item));
+        *size = cbor_bytestring_length(item) == 0
+                    ? header_size
+                    : _cbor_safe_signaling_add(header_size,
+                                               cbor_bytestring_length(item));
+        return true;
       }
       size_t indef_bytestring_size = 2;  // Leading byte + break
       cbor_item_t** chunks = cbor_bytestring_chunks_handle(item);
       for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
-        indef_bytestring_size = _cbor_safe_signaling_add(
-            indef_bytestring_size, cbor_serialized_size(chunks[i]));
+        size_t chunk_size;
+        _cbor_shallow_serialized_size(chunks[i], generation, options,
+                                      &chunk_size);
+        indef_bytestring_size =
+            _cbor_safe_signaling_add(indef_bytestring_size, chunk_size);
       }
-      return indef_bytestring_size;
+      *size = indef_bytestring_size;
+      return true;
     }
     case CBOR_TYPE_STRING: {
       if (cbor_string_is_definite(item)) {
         size_t header_size =
             _cbor_encoded_header_size(cbor_string_length(item));
-        if (cbor_string_length(item) == 0) return header_size;
-        return _cbor_safe_signaling_add(header_size, cbor_string_length(item));
+        *size = cbor_string_length(item) == 0
+                    ? header_size
+                    : _cbor_safe_signaling_add(header_size,
+                                               cbor_string_length(item));
+        return true;
       }
       size_t indef_string_size = 2;  // Leading byte + break
       cbor_item_t** chunks = cbor_string_chunks_handle(item);
       for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
-        indef_string_size = _cbor_safe_signaling_add(
-            indef_string_size, cbor_serialized_size(chunks[i]));
-      }
-      return indef_string_size;
-    }
-    case CBOR_TYPE_ARRAY: {
-      size_t array_size = cbor_array_is_definite(item)
-                              ? _cbor_encoded_header_size(cbor_array_size(item))
-                              : 2;  // Leading byte + break
-      cbor_item_t** items = cbor_array_handle(item);
-      for (size_t i = 0; i < cbor_array_size(item); i++) {
-        array_size = _cbor_safe_signaling_add(array_size,
-                                              cbor_serialized_size(items[i]));
-      }
-      return array_size;
-    }
-    case CBOR_TYPE_MAP: {
-      size_t map_size = cbor_map_is_definite(item)
-                            ? _cbor_encoded_header_size(cbor_map_size(item))
-                            : 2;  // Leading byte + break
-      struct cbor_pair* items = cbor_map_handle(item);
-      for (size_t i = 0; i < cbor_map_size(item); i++) {
-        map_size = _cbor_safe_signaling_add(
-            map_size,
-            _cbor_safe_signaling_add(cbor_serialized_size(items[i].key),
-                                     cbor_serialized_size(items[i].value)));
+        size_t chunk_size;
+        _cbor_shallow_serialized_size(chunks[i], generation, options,
+                                      &chunk_size);
+        indef_string_size =
+            _cbor_safe_signaling_add(indef_string_size, chunk_size);
       }
-      return map_size;
-    }
-    case CBOR_TYPE_TAG: {
-      return _cbor_safe_signaling_add(
-          _cbor_encoded_header_size(cbor_tag_value(item)),
-          cbor_serialized_size(cbor_move(cbor_tag_item(item))));
+      *size = indef_string_size;
+      return true;
     }
+    case CBOR_TYPE_ARRAY:
+    case CBOR_TYPE_MAP:
+    case CBOR_TYPE_TAG:
+      // Only the default size is memoized
+      return options == CBOR_SERIALIZE_DEFAULT &&
+             _cbor_cached_serialized_size(item, generation, size);
     case CBOR_TYPE_FLOAT_CTRL:
-      switch (cbor_float_get_width(item)) {
+      switch (preferred && cbor_float_get_width(item) != CBOR_FLOAT_0
+                  ? _cbor_preferred_float_width(item)
+                  : cbor_float_get_width(item)) {
         case CBOR_FLOAT_0:
-          return _cbor_encoded_header_size(cbor_ctrl_value(item));
+          *size = _cbor_encoded_header_size(cbor_ctrl_value(item));
+          return true;
         case CBOR_FLOAT_16:
-          return 3;
+          *size = 3;
+          return true;
         case CBOR_FLOAT_32:
-          return 5;
+          *size = 5;
+          return true;
         case CBOR_FLOAT_64:
-          return 9;
+          *size = 9;
+          return true;
         default:
           _CBOR_UNREACHABLE;
-          return 0;
+          return false;
       }
     default:
       _CBOR_UNREACHABLE;
-      return 0;
+      return false;
+  }
+}
+
+static size_t _cbor_serialized_size_with_options(struct _cbor_walk* walk,
+                                                 const cbor_item_t* item,
+                                                 unsigned options) {
+  size_t generation = _cbor_size_cache_generation();
+  size_t size;
+  if (_cbor_shallow_serialized_size(item, generation, options, &size))
+    return size;
+
+  // Every frame accumulates the size of its item, which is memoized and added
+  // to the parent once all children have been visited
+  struct _cbor_walk_frame* frame = _cbor_walk_push(walk, item);
+  if (frame == NULL) return 0;
+  frame->state.size = _cbor_nesting_header_size(item);
+  while (true) {
+    cbor_item_t* child;
+    if (_cbor_walk_next(frame, &child)) {
+      if (_cbor_shallow_serialized_size(child, generation, options, &size)) {
+        frame->state.size = _cbor_safe_signaling_add(frame->state.size, size);
+        continue;
+      }
+      frame = _cbor_walk_push(walk, child);
+      if (frame == NULL) {
+        _cbor_walk_clear(walk);
+        return 0;
+      }
+      frame->state.size = _cbor_nesting_header_size(child);
+      continue;
+    }
+
+    size = frame->state.size;
+    if (options == CBOR_SERIALIZE_DEFAULT)
+      _cbor_cache_serialized_size(frame->item, generation, size);
+    _cbor_walk_pop(walk);
+    if (walk->depth == 0) return size;
+    frame = _cbor_walk_top(walk);
+    frame->state.size = _cbor_safe_signaling_add(frame->state.size, size);
   }
 }
 
+size_t _cbor_serialized_size_walk(struct _cbor_walk* walk,
+                                  const cbor_item_t* item) {
+  return _cbor_serialized_size_with_options(walk, item,
+                                            CBOR_SERIALIZE_DEFAULT);
+}
+
+size_t cbor_serialized_size_with_options(const cbor_item_t* item,
+                                         unsigned options) {
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  size_t size = _cbor_serialized_size_with_options(&walk, item, options);
+  _cbor_walk_free(&walk);
+  return size;
+}
+
+size_t cbor_serialized_size(const cbor_item_t* item) {
+  return cbor_serialized_size_with_options(item, CBOR_SERIALIZE_DEFAULT);
+}
+
 size_t cbor_serialize_alloc(const cbor_item_t* item, unsigned char** buffer,
                             size_t* buffer_size) {
+  return cbor_serialize_alloc_with_allocator(item, buffer, buffer_size,
+                                             /*allocator=*/NULL);
+}
+
+size_t cbor_serialize_alloc_with_allocator(
+    const cbor_item_t* item, unsigned char** buffer, size_t* buffer_size,
+    const struct cbor_allocator* allocator) {
   *buffer = NULL;
   size_t serialized_size = cbor_serialized_size(item);
   if (serialized_size == 0) {
     if (buffer_size != NULL) *buffer_size = 0;
     return 0;
   }
-  *buffer = _cbor_malloc(serialized_size);
+  // The buffer belongs to the client, so it is not counted in the statistics
+  *buffer = _cbor_allocator_malloc(allocator, serialized_size);
   if (*buffer == NULL) {
     if (buffer_size != NULL) *buffer_size = 0;
     return 0;
@@ -181,6 +353,247 @@ size_t cbor_serialize_alloc(const cbor_item_t* item, unsigned char** buffer,
   return written;
 }
 
+/** Size of the buffer used by #cbor_serialize_fd and #cbor_serialize_file */
+#define _CBOR_SERIALIZE_BUFFER_SIZE 65536
+
+static size_t _cbor_serialize_to_sink(const cbor_item_t* item,
+                                      cbor_writer_sink sink, void* context) {
+  size_t serialized_size = cbor_serialized_size(item);
+  if (serialized_size == 0) return 0;
+  // Small items do not need the whole buffer
+  size_t buffer_size = serialized_size < _CBOR_SERIALIZE_BUFFER_SIZE
+                           ? serialized_size
+                           : _CBOR_SERIALIZE_BUFFER_SIZE;
+  struct cbor_writer* writer = cbor_writer_new(
+      buffer_size < 9 ? 9 : buffer_size, sink, context);
+  if (writer == NULL) return 0;
+  bool success = cbor_writer_item(writer, item) && cbor_writer_finish(writer);
+  cbor_writer_free(writer);
+  return success ? serialized_size : 0;
+}
+
+#ifndef _WIN32
+static size_t _cbor_serialize_mmap(const cbor_item_t* item, int fd) {
+  size_t serialized_size = cbor_serialized_size(item);
+  if (serialized_size == 0) return 0;
+  off_t file_size = (off_t)serialized_size;
+  if (file_size < 0 || (size_t)file_size != serialized_size) return 0;
+  if (ftruncate(fd, file_size) != 0) return 0;
+  void* mapping =
+      mmap(NULL, serialized_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) return 0;
+  size_t written = cbor_serialize(item, mapping, serialized_size);
+  CBOR_ASSERT(written == serialized_size);
+  if (munmap(mapping, serialized_size) != 0) return 0;
+  return written;
+}
+#endif
+
+size_t cbor_serialize_fd(const cbor_item_t* item, int fd,
+                         cbor_serialize_fd_mode mode) {
+  switch (mode) {
+    case CBOR_SERIALIZE_FD_STREAM:
+      return _cbor_serialize_to_sink(item, cbor_writer_fd_sink, &fd);
+    case CBOR_SERIALIZE_FD_MMAP:
+#ifndef _WIN32
+      return _cbor_serialize_mmap(item, fd);
+#else
+      return 0;
+#endif
+    default:
+      return 0;
+  }
+}
+
+size_t cbor_serialize_file(const cbor_item_t* item, FILE* file) {
+  return _cbor_serialize_to_sink(item, cbor_writer_file_sink, file);
+}
+
+/** Serialize the header of a nesting item, without its children */
+static size_t _cbor_serialize_nesting_header(const cbor_item_t* item,
+                                             unsigned char* buffer,
+                                             size_t buffer_size) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_is_definite(item)
+                 ? cbor_encode_array_start(cbor_array_size(item), buffer,
+                                           buffer_size)
+                 : cbor_encode_indef_array_start(buffer, buffer_size);
+    case CBOR_TYPE_MAP:
+      return cbor_map_is_definite(item)
+                 ? cbor_encode_map_start(cbor_map_size(item), buffer,
+                                         buffer_size)
+                 : cbor_encode_indef_map_start(buffer, buffer_size);
+    case CBOR_TYPE_TAG:
+      return cbor_encode_tag(cbor_tag_value(item), buffer, buffer_size);
+    default:
+      _CBOR_UNREACHABLE;
+      return 0;
+  }
+}
+
+static bool _cbor_is_indefinite_nesting(const cbor_item_t* item) {
+  return (cbor_isa_array(item) && cbor_array_is_indefinite(item)) ||
+         (cbor_isa_map(item) && cbor_map_is_indefinite(item));
+}
+
+/** Payloads shorter than this are copied to the scratch buffer, a separate
+ * iovec entry would cost more than the copy. */
+#define _CBOR_IOV_INLINE_THRESHOLD 64
+
+struct _cbor_iov_state {
+  cbor_iovec* iov;
+  size_t max_iov;
+  size_t iov_count;
+  unsigned char* scratch;
+  size_t scratch_size;
+  size_t scratch_used;
+};
+
+static unsigned char* _cbor_iov_cursor(struct _cbor_iov_state* state) {
+  return state->scratch + state->scratch_used;
+}
+
+static size_t _cbor_iov_available(struct _cbor_iov_state* state) {
+  return state->scratch_size - state->scratch_used;
+}
+
+/** Account for `written` bytes placed at the scratch cursor */
+static bool _cbor_iov_commit(struct _cbor_iov_state* state, size_t written) {
+  if (written == 0) return false;
+  cbor_iovec* last =
+      state->iov_count > 0 ? &state->iov[state->iov_count - 1] : NULL;
+  if (last != NULL && (unsigned char*)last->iov_base + last->iov_len ==
+                          _cbor_iov_cursor(state)) {
+    last->iov_len += written;
+  } else {
+    if (state->iov_count == state->max_iov) return false;
+    state->iov[state->iov_count++] =
+        (cbor_iovec){.iov_base = _cbor_iov_cursor(state), .iov_len = written};
+  }
+  state->scratch_used += written;
+  return true;
+}
+
+static bool _cbor_iov_payload(struct _cbor_iov_state* state,
+                              const unsigned char* data, size_t length) {
+  if (length == 0) return true;
+  if (length < _CBOR_IOV_INLINE_THRESHOLD) {
+    if (_cbor_iov_available(state) < length) return false;
+    memcpy(_cbor_iov_cursor(state), data, length);
+    return _cbor_iov_commit(state, length);
+  }
+  if (state->iov_count == state->max_iov) return false;
+  state->iov[state->iov_count++] =
+      (cbor_iovec){.iov_base = (void*)data, .iov_len = length};
+  return true;
+}
+
+/** Serialize an item that cannot contain arbitrary items */
+static bool _cbor_serialize_iov_leaf(const cbor_item_t* item,
+                                     struct _cbor_iov_state* state) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:
+    case CBOR_TYPE_FLOAT_CTRL:
+      return _cbor_iov_commit(
+          state, cbor_serialize(item, _cbor_iov_cursor(state),
+                                _cbor_iov_available(state)));
+    case CBOR_TYPE_BYTESTRING:
+      if (cbor_bytestring_is_definite(item)) {
+        size_t length = cbor_bytestring_length(item);
+        return _cbor_iov_commit(state, cbor_encode_bytestring_start(
+                                           length, _cbor_iov_cursor(state),
+                                           _cbor_iov_available(state))) &&
+               _cbor_iov_payload(state, cbor_bytestring_handle(item), length);
+      } else {
+        if (!_cbor_iov_commit(state, cbor_encode_indef_bytestring_start(
+                                         _cbor_iov_cursor(state),
+                                         _cbor_iov_available(state))))
+          return false;
+        cbor_item_t** chunks = cbor_bytestring_chunks_handle(item);
+        for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
+          if (!_cbor_serialize_iov_leaf(chunks[i], state)) return false;
+        }
+        break;
+      }
+    case CBOR_TYPE_STRING:
+      if (cbor_string_is_definite(item)) {
+        size_t length = cbor_string_length(item);
+        return _cbor_iov_commit(state, cbor_encode_string_start(
+                                           length, _cbor_iov_cursor(state),
+                                           _cbor_iov_available(state))) &&
+               _cbor_iov_payload(state, cbor_string_handle(item), length);
+      } else {
+        if (!_cbor_iov_commit(state, cbor_encode_indef_string_start(
+                                         _cbor_iov_cursor(state),
+                                         _cbor_iov_available(state))))
+          return false;
+        cbor_item_t** chunks = cbor_string_chunks_handle(item);
+        for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
+          if (!_cbor_serialize_iov_leaf(chunks[i], state)) return false;
+        }
+        break;
+      }
+    default:
+      _CBOR_UNREACHABLE;
+      return false;
+  }
+  // Terminate the indefinite string
+  return _cbor_iov_commit(state, cbor_encode_break(_cbor_iov_cursor(state),
+                                                   _cbor_iov_available(state)));
+}
+
+static bool _cbor_serialize_iov(const cbor_item_t* item,
+                                struct _cbor_iov_state* state) {
+  if (!_cbor_is_nesting(item)) return _cbor_serialize_iov_leaf(item, state);
+  if (!_cbor_iov_commit(state, _cbor_serialize_nesting_header(
+                                   item, _cbor_iov_cursor(state),
+                                   _cbor_iov_available(state))))
+    return false;
+
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_walk_frame* frame = _cbor_walk_push(&walk, item);
+  bool success = frame != NULL;
+  while (success && walk.depth > 0) {
+    cbor_item_t* child;
+    if (_cbor_walk_next(frame, &child)) {
+      if (_cbor_is_nesting(child)) {
+        // The children of `child` follow its header
+        success = _cbor_iov_commit(state, _cbor_serialize_nesting_header(
+                                              child, _cbor_iov_cursor(state),
+                                              _cbor_iov_available(state))) &&
+                  (frame = _cbor_walk_push(&walk, child)) != NULL;
+      } else {
+        success = _cbor_serialize_iov_leaf(child, state);
+      }
+    } else {
+      if (_cbor_is_indefinite_nesting(frame->item)) {
+        // Terminate the indefinite item
+        success = _cbor_iov_commit(
+            state, cbor_encode_break(_cbor_iov_cursor(state),
+                                     _cbor_iov_available(state)));
+      }
+      _cbor_walk_pop(&walk);
+      if (walk.depth > 0) frame = _cbor_walk_top(&walk);
+    }
+  }
+  _cbor_walk_free(&walk);
+  return success;
+}
+
+size_t cbor_serialize_iov(const cbor_item_t* item, cbor_iovec* iov,
+                          size_t max_iov, unsigned char* header_scratch,
+                          size_t scratch_size) {
+  struct _cbor_iov_state state = {.iov = iov,
+                                  .max_iov = max_iov,
+                                  .scratch = header_scratch,
+                                  .scratch_size = scratch_size};
+  if (!_cbor_serialize_iov(item, &state)) return 0;
+  return state.iov_count;
+}
+
 size_t cbor_serialize_uint(const cbor_item_t* item, unsigned char* buffer,
                            size_t buffer_size) {
   CBOR_ASSERT(cbor_isa_uint(item));
@@ -283,85 +696,67 @@ size_t cbor_serialize_string(const cbor_item_t* item, unsigned char* buffer,
   }
 }
 
-size_t cbor_serialize_array(const cbor_item_t* item, unsigned char* buffer,
-                            size_t buffer_size) {
-  CBOR_ASSERT(cbor_isa_array(item));
-  size_t size = cbor_array_size(item), written = 0;
-  cbor_item_t** handle = cbor_array_handle(item);
-  if (cbor_array_is_definite(item)) {
-    written = cbor_encode_array_start(size, buffer, buffer_size);
-  } else {
-    CBOR_ASSERT(cbor_array_is_indefinite(item));
-    written = cbor_encode_indef_array_start(buffer, buffer_size);
-  }
+static size_t _cbor_serialize_nesting(const cbor_item_t* item,
+                                      unsigned char* buffer, size_t buffer_size,
+                                      unsigned options) {
+  size_t written = _cbor_serialize_nesting_header(item, buffer, buffer_size);
   if (written == 0) return 0;
 
-  for (size_t i = 0; i < size; i++) {
-    size_t item_written =
-        cbor_serialize(*(handle++), buffer + written, buffer_size - written);
-    if (item_written == 0) return 0;
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_walk_frame* frame = _cbor_walk_push(&walk, item);
+  bool success = frame != NULL;
+  while (success && walk.depth > 0) {
+    cbor_item_t* child;
+    size_t item_written = 0;
+    if (_cbor_walk_next(frame, &child)) {
+      if (_cbor_is_nesting(child)) {
+        // The children of `child` follow its header
+        item_written = _cbor_serialize_nesting_header(
+            child, buffer + written, buffer_size - written);
+        if (item_written > 0 &&
+            (frame = _cbor_walk_push(&walk, child)) == NULL)
+          item_written = 0;
+      } else {
+        item_written = cbor_serialize_with_options(
+            child, buffer + written, buffer_size - written, options);
+      }
+      success = item_written > 0;
+    } else {
+      if (_cbor_is_indefinite_nesting(frame->item)) {
+        // Terminate the indefinite item
+        item_written =
+            cbor_encode_break(buffer + written, buffer_size - written);
+        success = item_written > 0;
+      }
+      _cbor_walk_pop(&walk);
+      if (walk.depth > 0) frame = _cbor_walk_top(&walk);
+    }
     written += item_written;
   }
+  _cbor_walk_free(&walk);
+  return success ? written : 0;
+}
 
-  if (cbor_array_is_definite(item)) {
-    return written;
-  } else {
-    CBOR_ASSERT(cbor_array_is_indefinite(item));
-    size_t break_written =
-        cbor_encode_break(buffer + written, buffer_size - written);
-    if (break_written == 0) return 0;
-    return written + break_written;
-  }
+size_t cbor_serialize_array(const cbor_item_t* item, unsigned char* buffer,
+                            size_t buffer_size) {
+  CBOR_ASSERT(cbor_isa_array(item));
+  return _cbor_serialize_nesting(item, buffer, buffer_size,
+                                 CBOR_SERIALIZE_DEFAULT);
 }
 
 size_t cbor_serialize_map(const cbor_item_t* item, unsigned char* buffer,
                           size_t buffer_size) {
   CBOR_ASSERT(cbor_isa_map(item));
-  size_t size = cbor_map_size(item), written = 0;
-  struct cbor_pair* handle = cbor_map_handle(item);
-
-  if (cbor_map_is_definite(item)) {
-    written = cbor_encode_map_start(size, buffer, buffer_size);
-  } else {
-    CBOR_ASSERT(cbor_map_is_indefinite(item));
-    written = cbor_encode_indef_map_start(buffer, buffer_size);
-  }
-  if (written == 0) return 0;
-
-  for (size_t i = 0; i < size; i++) {
-    size_t item_written =
-        cbor_serialize(handle->key, buffer + written, buffer_size - written);
-    if (item_written == 0) {
-      return 0;
-    }
-    written += item_written;
-    item_written = cbor_serialize((handle++)->value, buffer + written,
-                                  buffer_size - written);
-    if (item_written == 0) return 0;
-    written += item_written;
-  }
-
-  if (cbor_map_is_definite(item)) {
-    return written;
-  } else {
-    CBOR_ASSERT(cbor_map_is_indefinite(item));
-    size_t break_written =
-        cbor_encode_break(buffer + written, buffer_size - written);
-    if (break_written == 0) return 0;
-    return written + break_written;
-  }
+  return _cbor_serialize_nesting(item, buffer, buffer_size,
+                                 CBOR_SERIALIZE_DEFAULT);
 }
 
 size_t cbor_serialize_tag(const cbor_item_t* item, unsigned char* buffer,
                           size_t buffer_size) {
   CBOR_ASSERT(cbor_isa_tag(item));
-  size_t written = cbor_encode_tag(cbor_tag_value(item), buffer, buffer_size);
-  if (written == 0) return 0;
-
-  size_t item_written = cbor_serialize(cbor_move(cbor_tag_item(item)),
-                                       buffer + written, buffer_size - written);
-  if (item_written == 0) return 0;
-  return written + item_written;
+  return _cbor_serialize_nesting(item, buffer, buffer_size,
+                                 CBOR_SERIALIZE_DEFAULT);
 }
 
 size_t cbor_serialize_float_ctrl(const cbor_item_t* item, unsigned char* buffer,
@@ -11,6 +11,12 @@
 #include "cbor/cbor_export.h"
 #include "cbor/common.h"
 
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,7 +32,8 @@ extern "C" {
  * @param item A data item
  * @param buffer Buffer to serialize to
  * @param buffer_size Size of the \p buffer
- * @return Length of the result. 0 on failure.
+ * @return Length of the result. 0 on failure, including failure to allocate
+ * the traversal stack for items nested more than 16 levels deep.
  */
 _CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize(const cbor_item_t* item,
                                                   cbor_mutable_data buffer,
@@ -35,15 +42,66 @@ _CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize(const cbor_item_t* item,
 /** Compute the length (in bytes) of the item when serialized using
  * `cbor_serialize`.
  *
- * Time complexity is proportional to the number of nested items.
+ * Time complexity is proportional to the number of nested items. Sizes of
+ * arrays, maps, and tags are memoized, so repeated calls on a tree that has not
+ * been modified in the meantime take constant time. A size-changing
+ * modification made through the libcbor API invalidates the memoized sizes of
+ * the modified item's ancestors. Modifying an item that has been added to
+ * more than one container invalidates all memoized sizes.
+ *
+ * \rst
+ * .. warning:: Replacing items directly through :func:`cbor_array_handle` or
+ *  :func:`cbor_map_handle` is not tracked and may leave stale memoized sizes
+ *  behind.
+ * \endrst
  *
  * @param item A data item
  * @return Length (>= 1) of the item when serialized. 0 if the length overflows
- * `size_t`.
+ * `size_t` or if memory for traversing deeply nested items cannot be
+ * allocated.
  */
 _CBOR_NODISCARD CBOR_EXPORT size_t
 cbor_serialized_size(const cbor_item_t* item);
 
+/** Variants of #cbor_serialize_with_options, combined using `|` */
+typedef enum {
+  /** Same as #cbor_serialize */
+  CBOR_SERIALIZE_DEFAULT = 0,
+  /** Encode integers and floats in the shortest form that preserves their
+   * value, regardless of the width they were built with (preferred
+   * serialization, RFC 8949 Section 4.1). A float is never encoded in a wider
+   * form than its own width, and NaNs are encoded as a half-precision quiet
+   * NaN. The items are not modified. */
+  CBOR_SERIALIZE_PREFERRED = 1 << 0,
+} cbor_serialize_options;
+
+/** Serialize the given item using the given options
+ *
+ * @param item A data item
+ * @param buffer Buffer to serialize to
+ * @param buffer_size Size of the \p buffer
+ * @param options Combination of #cbor_serialize_options
+ * @return Length of the result. 0 on failure, see #cbor_serialize.
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize_with_options(
+    const cbor_item_t* item, cbor_mutable_data buffer, size_t buffer_size,
+    unsigned options);
+
+/** Compute the length (in bytes) of the item when serialized using
+ * #cbor_serialize_with_options
+ *
+ * Unlike #cbor_serialized_size, the size is not memoized if \p options differ
+ * from #CBOR_SERIALIZE_DEFAULT, so the time is always proportional to the
+ * number of nested items.
+ *
+ * @param item A data item
+ * @param options Combination of #cbor_serialize_options
+ * @return Length (>= 1) of the item when serialized. 0 on failure, see
+ * #cbor_serialized_size.
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t
+cbor_serialized_size_with_options(const cbor_item_t* item, unsigned options);
+
 /** Serialize the given item, allocating buffers as needed
  *
  * Since libcbor v0.10, the return value is always the same as `buffer_size` (if
@@ -66,6 +124,104 @@ CBOR_EXPORT size_t cbor_serialize_alloc(const cbor_item_t* item,
                                         unsigned char** buffer,
                                         size_t* buffer_size);
 
+/** Serialize the given item into a buffer allocated by \p allocator
+ *
+ * Same as #cbor_serialize_alloc, except that the buffer is allocated using
+ * \p allocator and must be released using its `deallocate` routine.
+ *
+ * @param item A data item
+ * @param[out] buffer Buffer containing the result
+ * @param[out] buffer_size Size of the \p buffer, or 0 on memory allocation
+ * failure.
+ * @param allocator The allocator to use, `NULL` for the global memory
+ * management routines (see #cbor_set_allocs)
+ * @return Length of the result in bytes
+ * @return 0 on memory allocation failure, in which case \p buffer is `NULL`.
+ */
+CBOR_EXPORT size_t cbor_serialize_alloc_with_allocator(
+    const cbor_item_t* item, unsigned char** buffer, size_t* buffer_size,
+    const struct cbor_allocator* allocator);
+
+#ifdef _WIN32
+/** Scatter/gather buffer descriptor, mirrors the POSIX `struct iovec` */
+typedef struct {
+  void* iov_base;
+  size_t iov_len;
+} cbor_iovec;
+#else
+/** Scatter/gather buffer descriptor, can be passed to `writev` directly */
+typedef struct iovec cbor_iovec;
+#endif
+
+/** Serialize the given item into a scatter/gather list
+ *
+ * Item headers and payloads shorter than 64 bytes are encoded into the
+ * \p header_scratch buffer. Longer string and byte string payloads are not
+ * copied, the corresponding entries of \p iov point directly into the item
+ * storage. Adjacent scratch data is coalesced into a single entry.
+ *
+ * The resulting entries are only valid as long as neither the \p item nor
+ * the \p header_scratch are modified or released.
+ *
+ * \rst
+ * .. note:: The scratch space required is at most 9 bytes per item plus the
+ *  total length of the inlined short payloads, so
+ *  :func:`cbor_serialized_size` of the item is always sufficient.
+ * \endrst
+ *
+ * @param item A data item
+ * @param[out] iov Array of entries to fill
+ * @param max_iov Size of the \p iov array
+ * @param header_scratch Buffer for the headers and short payloads
+ * @param scratch_size Size of the \p header_scratch
+ * @return Number of \p iov entries used (>= 1)
+ * @return 0 if \p max_iov or \p scratch_size is insufficient. The \p iov
+ * and the \p header_scratch may still be modified
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize_iov(
+    const cbor_item_t* item, cbor_iovec* iov, size_t max_iov,
+    unsigned char* header_scratch, size_t scratch_size);
+
+/** Output strategy for #cbor_serialize_fd */
+typedef enum {
+  /** Write through a fixed-size buffer using `write` */
+  CBOR_SERIALIZE_FD_STREAM,
+  /** Resize the file to the serialized size, `mmap` it, and serialize into
+     the mapping. Only supported for regular files on POSIX systems. */
+  CBOR_SERIALIZE_FD_MMAP
+} cbor_serialize_fd_mode;
+
+/** Serialize the given item to a file descriptor
+ *
+ * In the #CBOR_SERIALIZE_FD_STREAM mode, the output is produced through a
+ * fixed-size buffer, so the memory usage does not depend on the size of the
+ * item. Output starts at the current file offset.
+ *
+ * In the #CBOR_SERIALIZE_FD_MMAP mode, \p fd must be a regular file opened for
+ * both reading and writing. Its contents are replaced by the serialized item.
+ *
+ * @param item A data item
+ * @param fd The output file descriptor
+ * @param mode Output strategy
+ * @return Length of the result in bytes
+ * @return 0 on failure, in which case partial output may have been written
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize_fd(
+    const cbor_item_t* item, int fd, cbor_serialize_fd_mode mode);
+
+/** Serialize the given item to a file
+ *
+ * The output is produced through a fixed-size buffer, so the memory usage does
+ * not depend on the size of the item.
+ *
+ * @param item A data item
+ * @param file The output file
+ * @return Length of the result in bytes
+ * @return 0 on failure, in which case partial output may have been written
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t cbor_serialize_file(const cbor_item_t* item,
+                                                       FILE* file);
+
 /** Serialize an uint
  *
  * @param item A uint
@@ -6,6 +6,7 @@
  */
 
 #include "streaming.h"
+#include "internal/instrumentation.h"
 #include "internal/loaders.h"
 
 static bool claim_bytes(size_t required, size_t provided,
@@ -40,7 +41,7 @@ static bool claim_bytes(size_t required, size_t provided,
     return result;                                                    \
   } while (0)
 
-struct cbor_decoder_result cbor_stream_decode(
+static struct cbor_decoder_result _cbor_stream_decode(
     cbor_data source, size_t source_size,
     const struct cbor_callbacks* callbacks, void* context) {
   // Attempt to claim the initial MTB byte
@@ -599,3 +600,85 @@ struct cbor_decoder_result cbor_stream_decode(
       return result;
   }
 }
+
+struct cbor_decoder_result cbor_stream_decode(
+    cbor_data source, size_t source_size,
+    const struct cbor_callbacks* callbacks, void* context) {
+  struct cbor_decoder_result result =
+      _cbor_stream_decode(source, source_size, callbacks, context);
+  if (result.status == CBOR_DECODER_FINISHED)
+    _CBOR_DECODER_STATS_ITEM(*source, result.read);
+  return result;
+}
+
+static void _cbor_stream_deliver_chunk(const struct cbor_callbacks* callbacks,
+                                       void* context,
+                                       struct cbor_stream_state* state,
+                                       cbor_data data, size_t length) {
+  if (state->string_is_text) {
+    callbacks->string_chunk(context, data, length, state->string_remaining);
+  } else {
+    callbacks->byte_string_chunk(context, data, length,
+                                 state->string_remaining);
+  }
+}
+
+struct cbor_decoder_result cbor_stream_decode_partial(
+    cbor_data source, size_t source_size,
+    const struct cbor_callbacks* callbacks, void* context,
+    struct cbor_stream_state* state) {
+  if (state->string_remaining > 0) {
+    /* Continue the current string */
+    if (source_size == 0) {
+      return (struct cbor_decoder_result){
+          .status = CBOR_DECODER_NEDATA, .required = 1};
+    }
+    size_t length = state->string_remaining < source_size
+                        ? (size_t)state->string_remaining
+                        : source_size;
+    state->string_remaining -= length;
+    _cbor_stream_deliver_chunk(callbacks, context, state, source, length);
+    return (struct cbor_decoder_result){.read = length,
+                                        .status = CBOR_DECODER_FINISHED};
+  }
+
+  struct cbor_decoder_result result =
+      cbor_stream_decode(source, source_size, callbacks, context);
+  if (result.status != CBOR_DECODER_NEDATA || source_size == 0) return result;
+
+  /* Only definite strings with a complete header are delivered in parts */
+  uint8_t major = *source >> 5, info = *source & 0x1F;
+  if ((major != 2 && major != 3) || info > 27) return result;
+  /* Without a handler for the parts, the whole string is required */
+  if ((major == 2 ? callbacks->byte_string_chunk : callbacks->string_chunk) ==
+      NULL)
+    return result;
+  size_t header_size = info < 24 ? 1 : 1 + ((size_t)1 << (info - 24));
+  if (source_size < header_size) return result;
+
+  uint64_t length;
+  switch (info) {
+    case 24:
+      length = _cbor_load_uint8(source + 1);
+      break;
+    case 25:
+      length = _cbor_load_uint16(source + 1);
+      break;
+    case 26:
+      length = _cbor_load_uint32(source + 1);
+      break;
+    case 27:
+      length = _cbor_load_uint64(source + 1);
+      break;
+    default:
+      length = info;
+  }
+  /* The data is incomplete, otherwise the string would have been decoded */
+  size_t available = source_size - header_size;
+  state->string_remaining = length - available;
+  state->string_is_text = major == 3;
+  _cbor_stream_deliver_chunk(callbacks, context, state, source + header_size,
+                             available);
+  return (struct cbor_decoder_result){.read = source_size,
+                                      .status = CBOR_DECODER_FINISHED};
+}
@@ -30,6 +30,47 @@ _CBOR_NODISCARD CBOR_EXPORT struct cbor_decoder_result cbor_stream_decode(
     cbor_data source, size_t source_size,
     const struct cbor_callbacks* callbacks, void* context);
 
+/** State of #cbor_stream_decode_partial kept between calls
+ *
+ * Must be zero-initialized before the first call.
+ */
+struct cbor_stream_state {
+  /** Bytes of the current definite string that have not been delivered */
+  uint64_t string_remaining;
+  /** Whether the current definite string is a text string */
+  bool string_is_text;
+};
+
+/** Decoder that delivers definite strings as they arrive
+ *
+ * Works like #cbor_stream_decode, except when the \p source ends within the
+ * data of a definite byte string or string. Instead of requesting the whole
+ * string, the decoder passes the data available so far to
+ * #cbor_callbacks.byte_string_chunk (or #cbor_callbacks.string_chunk),
+ * remembers the rest of the string in the \p state, and reports the whole
+ * \p source as read. The following calls deliver the rest of the string, in
+ * as many parts as it arrives in, before decoding the next item. This allows
+ * large strings to be processed in bounded memory.
+ *
+ * Strings that are available as a whole are passed to
+ * #cbor_callbacks.byte_string or #cbor_callbacks.string as usual. The first
+ * part of a string may be empty if \p source ends right after its header.
+ *
+ * If the chunk callback for the type of the string is NULL, e.g. in callbacks
+ * that predate it, the string is not split: like #cbor_stream_decode, the
+ * decoder returns #CBOR_DECODER_NEDATA with the size of the whole string.
+ *
+ * @param source Input buffer
+ * @param source_size Length of the buffer
+ * @param callbacks The callback bundle
+ * @param context An arbitrary pointer to allow for maintaining context.
+ * @param state Decoder state, shared by all the calls decoding one input
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_decoder_result
+cbor_stream_decode_partial(cbor_data source, size_t source_size,
+                           const struct cbor_callbacks* callbacks,
+                           void* context, struct cbor_stream_state* state);
+
 #ifdef __cplusplus
 }
 #endif
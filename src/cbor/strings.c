@@ -7,14 +7,18 @@
 
 #include "strings.h"
 #include <string.h>
+#include "internal/item_pool.h"
 #include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 #include "internal/unicode.h"
 
 cbor_item_t* cbor_new_definite_string(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_STRING,
       .metadata = {.string_metadata = {.type = _CBOR_METADATA_DEFINITE,
                                        .codepoint_count = 0,
@@ -23,15 +27,18 @@ cbor_item_t* cbor_new_definite_string(void) {
 }
 
 cbor_item_t* cbor_new_indefinite_string(void) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_STRING,
       .metadata = {.string_metadata = {.type = _CBOR_METADATA_INDEFINITE,
                                        .length = 0}},
-      .data = _cbor_malloc(sizeof(struct cbor_indefinite_string_data))};
-  _CBOR_DEPENDENT_NOTNULL(item, item->data);
+      .data = _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_CONTAINERS,
+                           sizeof(struct cbor_indefinite_string_data))};
+  _CBOR_ITEM_DEPENDENT_NOTNULL(allocator, item, item->data);
   *((struct cbor_indefinite_string_data*)item->data) =
       (struct cbor_indefinite_string_data){
           .chunk_count = 0,
@@ -45,8 +52,9 @@ cbor_item_t* cbor_build_string(const char* val) {
   cbor_item_t* item = cbor_new_definite_string();
   _CBOR_NOTNULL(item);
   size_t len = strlen(val);
-  unsigned char* handle = _cbor_malloc(len);
-  _CBOR_DEPENDENT_NOTNULL(item, handle);
+  unsigned char* handle =
+      _CBOR_MALLOC(item->allocator, CBOR_ALLOC_SITE_STRING_DATA, len);
+  _CBOR_ITEM_DEPENDENT_NOTNULL(item->allocator, item, handle);
   memcpy(handle, val, len);
   cbor_string_set_handle(item, handle, len);
   return item;
@@ -55,8 +63,9 @@ cbor_item_t* cbor_build_string(const char* val) {
 cbor_item_t* cbor_build_stringn(const char* val, size_t length) {
   cbor_item_t* item = cbor_new_definite_string();
   _CBOR_NOTNULL(item);
-  unsigned char* handle = _cbor_malloc(length);
-  _CBOR_DEPENDENT_NOTNULL(item, handle);
+  unsigned char* handle =
+      _CBOR_MALLOC(item->allocator, CBOR_ALLOC_SITE_STRING_DATA, length);
+  _CBOR_ITEM_DEPENDENT_NOTNULL(item->allocator, item, handle);
   memcpy(handle, val, length);
   cbor_string_set_handle(item, handle, length);
   return item;
@@ -65,10 +74,12 @@ cbor_item_t* cbor_build_stringn(const char* val, size_t length) {
 void cbor_string_set_handle(cbor_item_t* item,
                             cbor_mutable_data CBOR_RESTRICT_POINTER data,
                             size_t length) {
+  CBOR_ASSERT(!cbor_is_frozen(item));
   CBOR_ASSERT(cbor_isa_string(item));
   CBOR_ASSERT(cbor_string_is_definite(item));
   item->data = data;
   item->metadata.string_metadata.length = length;
+  _cbor_size_cache_invalidate(item);
   struct _cbor_unicode_status unicode_status;
   size_t codepoint_count =
       _cbor_unicode_codepoint_count(data, length, &unicode_status);
@@ -95,6 +106,7 @@ size_t cbor_string_chunk_count(const cbor_item_t* item) {
 bool cbor_string_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
   CBOR_ASSERT(cbor_isa_string(item));
   CBOR_ASSERT(cbor_string_is_indefinite(item));
+  if (cbor_is_frozen(item)) return false;
   struct cbor_indefinite_string_data* data =
       (struct cbor_indefinite_string_data*)item->data;
   if (data->chunk_count == data->chunk_capacity) {
@@ -105,8 +117,9 @@ bool cbor_string_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
     size_t new_chunk_capacity =
         data->chunk_capacity == 0 ? 1
                                   : CBOR_BUFFER_GROWTH * (data->chunk_capacity);
-    cbor_item_t** new_chunks_data = _cbor_realloc_multiple(
-        data->chunks, sizeof(cbor_item_t*), new_chunk_capacity);
+    cbor_item_t** new_chunks_data =
+        _cbor_realloc_multiple(item->allocator, data->chunks,
+                               sizeof(cbor_item_t*), new_chunk_capacity);
 
     if (new_chunks_data == NULL) {
       return false;
@@ -116,6 +129,8 @@ bool cbor_string_add_chunk(cbor_item_t* item, cbor_item_t* chunk) {
     data->chunks = new_chunks_data;
   }
   data->chunks[data->chunk_count++] = cbor_incref(chunk);
+  _cbor_size_cache_link(item, chunk);
+  _cbor_size_cache_invalidate(item);
   return true;
 }
 
@@ -83,7 +83,9 @@ cbor_string_handle(const cbor_item_t* item);
  *
  * @param item A definite string
  * @param data The memory block. The caller gives up the ownership of the block.
- * libcbor will deallocate it when appropriate using its free function
+ * libcbor will deallocate it when appropriate, so it must be allocated using
+ * the allocator of \p item (see #cbor_item_allocator), or using the routines
+ * configured by #cbor_set_allocs if the item has none
  * @param length Length of the data block
  */
 CBOR_EXPORT void cbor_string_set_handle(
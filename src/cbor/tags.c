@@ -6,13 +6,18 @@
  */
 
 #include "tags.h"
+#include "internal/item_pool.h"
+#include "internal/memory_utils.h"
+#include "internal/size_cache.h"
 
 cbor_item_t* cbor_new_tag(uint64_t value) {
-  cbor_item_t* item = _cbor_malloc(sizeof(cbor_item_t));
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  cbor_item_t* item = _cbor_item_malloc(allocator, sizeof(cbor_item_t));
   _CBOR_NOTNULL(item);
 
   *item = (cbor_item_t){
       .refcount = 1,
+      .allocator = allocator,
       .type = CBOR_TYPE_TAG,
       .metadata = {.tag_metadata = {.value = value, .tagged_item = NULL}},
       .data = NULL /* Never used */
@@ -31,9 +36,14 @@ uint64_t cbor_tag_value(const cbor_item_t* tag) {
 }
 
 void cbor_tag_set_item(cbor_item_t* tag, cbor_item_t* tagged_item) {
+  CBOR_ASSERT(!cbor_is_frozen(tag));
   CBOR_ASSERT(cbor_isa_tag(tag));
+  if (tag->metadata.tag_metadata.tagged_item != NULL)
+    _cbor_size_cache_unlink(tag, tag->metadata.tag_metadata.tagged_item);
   cbor_incref(tagged_item);
   tag->metadata.tag_metadata.tagged_item = tagged_item;
+  _cbor_size_cache_link(tag, tagged_item);
+  _cbor_size_cache_invalidate(tag);
 }
 
 cbor_item_t* cbor_build_tag(uint64_t value, cbor_item_t* item) {
@@ -0,0 +1,512 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "writer.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "cbor/arrays.h"
+#include "cbor/bytestrings.h"
+#include "cbor/maps.h"
+#include "cbor/strings.h"
+#include "cbor/tags.h"
+#include "encoding.h"
+#include "internal/memory_utils.h"
+#include "internal/walker.h"
+#include "serialization.h"
+
+/** Largest item header: MTB + 8 bytes of value */
+#define _CBOR_MAX_HEADER_SIZE 9
+
+enum _cbor_writer_frame_type {
+  _CBOR_WRITER_ARRAY,
+  _CBOR_WRITER_INDEF_ARRAY,
+  _CBOR_WRITER_MAP,
+  _CBOR_WRITER_INDEF_MAP,
+  _CBOR_WRITER_INDEF_BYTESTRING,
+  _CBOR_WRITER_INDEF_STRING
+};
+
+/** An open container */
+struct _cbor_writer_frame {
+  enum _cbor_writer_frame_type type;
+  /**
+   * Outstanding subitems for definite containers. For indefinite maps, the
+   * number of subitems written so far (only the parity matters).
+   */
+  uint64_t subitems;
+};
+
+struct cbor_writer {
+  cbor_writer_sink sink;
+  void* sink_context;
+  unsigned char* buffer;
+  size_t buffer_size;
+  /** Number of bytes in #buffer not yet passed to the sink */
+  size_t buffered;
+  /** Stack of open containers, innermost last */
+  struct _cbor_writer_frame* frames;
+  size_t depth;
+  size_t frames_allocated;
+  /** A tag has been written and the tagged item is expected next */
+  bool tag_pending;
+  cbor_writer_error_code error;
+  /** Thread allocator at the time the writer was created */
+  const struct cbor_allocator* allocator;
+};
+
+/** Kinds of items as far as nesting validation is concerned */
+enum _cbor_writer_item_kind {
+  _CBOR_WRITER_ITEM_OTHER,
+  _CBOR_WRITER_ITEM_BYTESTRING,
+  _CBOR_WRITER_ITEM_STRING,
+  _CBOR_WRITER_ITEM_TAG
+};
+
+struct cbor_writer* cbor_writer_new(size_t buffer_size, cbor_writer_sink sink,
+                                    void* sink_context) {
+  if (buffer_size < _CBOR_MAX_HEADER_SIZE) return NULL;
+  const struct cbor_allocator* allocator = cbor_thread_allocator();
+  struct cbor_writer* writer = _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_OTHER,
+                                            sizeof(struct cbor_writer));
+  _CBOR_NOTNULL(writer);
+  *writer = (struct cbor_writer){
+      .sink = sink,
+      .sink_context = sink_context,
+      .buffer = _CBOR_MALLOC(allocator, CBOR_ALLOC_SITE_OTHER, buffer_size),
+      .buffer_size = buffer_size,
+      .error = CBOR_WRITER_ERR_NONE,
+      .allocator = allocator};
+  _CBOR_DEPENDENT_NOTNULL(allocator, writer, writer->buffer);
+  return writer;
+}
+
+void cbor_writer_free(struct cbor_writer* writer) {
+  if (writer == NULL) return;
+  const struct cbor_allocator* allocator = writer->allocator;
+  _CBOR_FREE(allocator, writer->frames);
+  _CBOR_FREE(allocator, writer->buffer);
+  _CBOR_FREE(allocator, writer);
+}
+
+static bool _cbor_writer_fail(struct cbor_writer* writer,
+                              cbor_writer_error_code error) {
+  writer->error = error;
+  return false;
+}
+
+static bool _cbor_writer_drain(struct cbor_writer* writer) {
+  if (writer->buffered == 0) return true;
+  if (!writer->sink(writer->sink_context, writer->buffer, writer->buffered))
+    return _cbor_writer_fail(writer, CBOR_WRITER_ERR_SINK);
+  writer->buffered = 0;
+  return true;
+}
+
+bool cbor_writer_flush(struct cbor_writer* writer) {
+  if (writer->error != CBOR_WRITER_ERR_NONE) return false;
+  return _cbor_writer_drain(writer);
+}
+
+bool cbor_writer_finish(struct cbor_writer* writer) {
+  if (writer->error != CBOR_WRITER_ERR_NONE) return false;
+  if (writer->depth > 0 || writer->tag_pending)
+    return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+  return _cbor_writer_drain(writer);
+}
+
+cbor_writer_error_code cbor_writer_error(const struct cbor_writer* writer) {
+  return writer->error;
+}
+
+size_t cbor_writer_depth(const struct cbor_writer* writer) {
+  return writer->depth;
+}
+
+/** Check that an item of the given kind may be written next and account for
+ * it in the enclosing container. */
+static bool _cbor_writer_claim(struct cbor_writer* writer,
+                               enum _cbor_writer_item_kind kind) {
+  if (writer->error != CBOR_WRITER_ERR_NONE) return false;
+  if (writer->tag_pending) {
+    // The tagged item has already been accounted for together with the tag
+    writer->tag_pending = kind == _CBOR_WRITER_ITEM_TAG;
+    return true;
+  }
+  if (writer->depth == 0) {
+    writer->tag_pending = kind == _CBOR_WRITER_ITEM_TAG;
+    return true;
+  }
+
+  struct _cbor_writer_frame* frame = &writer->frames[writer->depth - 1];
+  switch (frame->type) {
+    case _CBOR_WRITER_ARRAY:
+    case _CBOR_WRITER_MAP:
+      if (frame->subitems == 0)
+        return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+      frame->subitems--;
+      break;
+    case _CBOR_WRITER_INDEF_MAP:
+      frame->subitems ^= 1;
+      break;
+    case _CBOR_WRITER_INDEF_ARRAY:
+      break;
+    // Indefinite strings may only contain definite chunks of the same type.
+    // Definite strings never open a frame, so the chunk kind suffices.
+    case _CBOR_WRITER_INDEF_BYTESTRING:
+      if (kind != _CBOR_WRITER_ITEM_BYTESTRING)
+        return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+      break;
+    case _CBOR_WRITER_INDEF_STRING:
+      if (kind != _CBOR_WRITER_ITEM_STRING)
+        return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+      break;
+  }
+  writer->tag_pending = kind == _CBOR_WRITER_ITEM_TAG;
+  return true;
+}
+
+static bool _cbor_writer_push_frame(struct cbor_writer* writer,
+                                    enum _cbor_writer_frame_type type,
+                                    uint64_t subitems) {
+  if (writer->depth == writer->frames_allocated) {
+    if (!_cbor_safe_to_multiply(CBOR_BUFFER_GROWTH, writer->frames_allocated))
+      return _cbor_writer_fail(writer, CBOR_WRITER_ERR_MEMERROR);
+    size_t new_allocation = writer->frames_allocated == 0
+                                ? 4
+                                : CBOR_BUFFER_GROWTH * writer->frames_allocated;
+    struct _cbor_writer_frame* new_frames = _cbor_realloc_multiple(
+        writer->allocator, writer->frames, sizeof(struct _cbor_writer_frame),
+        new_allocation);
+    if (new_frames == NULL)
+      return _cbor_writer_fail(writer, CBOR_WRITER_ERR_MEMERROR);
+    writer->frames = new_frames;
+    writer->frames_allocated = new_allocation;
+  }
+  writer->frames[writer->depth++] =
+      (struct _cbor_writer_frame){.type = type, .subitems = subitems};
+  return true;
+}
+
+/** Make sure the buffer has space for an item header */
+static bool _cbor_writer_reserve_header(struct cbor_writer* writer) {
+  if (writer->buffer_size - writer->buffered >= _CBOR_MAX_HEADER_SIZE)
+    return true;
+  return _cbor_writer_drain(writer);
+}
+
+#define _CBOR_WRITER_ENCODE(writer, encoder_call)                   \
+  do {                                                              \
+    if (!_cbor_writer_reserve_header(writer)) return false;         \
+    unsigned char* _target = (writer)->buffer + (writer)->buffered; \
+    size_t _available = (writer)->buffer_size - (writer)->buffered; \
+    size_t _written = encoder_call;                                 \
+    CBOR_ASSERT(_written > 0);                                      \
+    (writer)->buffered += _written;                                 \
+  } while (0)
+
+/** Append raw bytes. Payloads that do not fit the buffer are passed to the
+ * sink directly. */
+static bool _cbor_writer_write(struct cbor_writer* writer, cbor_data data,
+                               size_t length) {
+  if (length <= writer->buffer_size - writer->buffered) {
+    if (length > 0) memcpy(writer->buffer + writer->buffered, data, length);
+    writer->buffered += length;
+    return true;
+  }
+  if (!_cbor_writer_drain(writer)) return false;
+  if (length >= writer->buffer_size) {
+    if (!writer->sink(writer->sink_context, data, length))
+      return _cbor_writer_fail(writer, CBOR_WRITER_ERR_SINK);
+    return true;
+  }
+  memcpy(writer->buffer, data, length);
+  writer->buffered = length;
+  return true;
+}
+
+bool cbor_writer_uint(struct cbor_writer* writer, uint64_t value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_uint(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_negint(struct cbor_writer* writer, uint64_t value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_negint(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_bytestring(struct cbor_writer* writer, cbor_data data,
+                            size_t length) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_BYTESTRING)) return false;
+  _CBOR_WRITER_ENCODE(
+      writer, cbor_encode_bytestring_start(length, _target, _available));
+  return _cbor_writer_write(writer, data, length);
+}
+
+bool cbor_writer_string(struct cbor_writer* writer, const char* data,
+                        size_t length) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_STRING)) return false;
+  _CBOR_WRITER_ENCODE(writer,
+                      cbor_encode_string_start(length, _target, _available));
+  return _cbor_writer_write(writer, (cbor_data)data, length);
+}
+
+bool cbor_writer_indef_bytestring_begin(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer,
+                      cbor_encode_indef_bytestring_start(_target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_INDEF_BYTESTRING, 0);
+}
+
+bool cbor_writer_indef_string_begin(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer,
+                      cbor_encode_indef_string_start(_target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_INDEF_STRING, 0);
+}
+
+bool cbor_writer_array_begin(struct cbor_writer* writer, size_t size) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer,
+                      cbor_encode_array_start(size, _target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_ARRAY, size);
+}
+
+bool cbor_writer_indef_array_begin(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer,
+                      cbor_encode_indef_array_start(_target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_INDEF_ARRAY, 0);
+}
+
+bool cbor_writer_map_begin(struct cbor_writer* writer, size_t size) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  // The subitem count cannot overflow, size_t is at most 64 bits
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_map_start(size, _target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_MAP,
+                                 (uint64_t)size * 2);
+}
+
+bool cbor_writer_indef_map_begin(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_indef_map_start(_target, _available));
+  return _cbor_writer_push_frame(writer, _CBOR_WRITER_INDEF_MAP, 0);
+}
+
+bool cbor_writer_end(struct cbor_writer* writer) {
+  if (writer->error != CBOR_WRITER_ERR_NONE) return false;
+  if (writer->depth == 0 || writer->tag_pending)
+    return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+
+  struct _cbor_writer_frame* frame = &writer->frames[writer->depth - 1];
+  switch (frame->type) {
+    case _CBOR_WRITER_ARRAY:
+    case _CBOR_WRITER_MAP:
+      if (frame->subitems != 0)
+        return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+      break;
+    case _CBOR_WRITER_INDEF_MAP:
+      // A key without a value
+      if (frame->subitems != 0)
+        return _cbor_writer_fail(writer, CBOR_WRITER_ERR_NESTING);
+      _CBOR_WRITER_ENCODE(writer, cbor_encode_break(_target, _available));
+      break;
+    case _CBOR_WRITER_INDEF_ARRAY:
+    case _CBOR_WRITER_INDEF_BYTESTRING:
+    case _CBOR_WRITER_INDEF_STRING:
+      _CBOR_WRITER_ENCODE(writer, cbor_encode_break(_target, _available));
+      break;
+  }
+  writer->depth--;
+  return true;
+}
+
+bool cbor_writer_tag(struct cbor_writer* writer, uint64_t value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_TAG)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_tag(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_bool(struct cbor_writer* writer, bool value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_bool(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_null(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_null(_target, _available));
+  return true;
+}
+
+bool cbor_writer_undef(struct cbor_writer* writer) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_undef(_target, _available));
+  return true;
+}
+
+bool cbor_writer_half(struct cbor_writer* writer, float value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_half(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_single(struct cbor_writer* writer, float value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_single(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_double(struct cbor_writer* writer, double value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_double(value, _target, _available));
+  return true;
+}
+
+bool cbor_writer_ctrl(struct cbor_writer* writer, uint8_t value) {
+  if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+  _CBOR_WRITER_ENCODE(writer, cbor_encode_ctrl(value, _target, _available));
+  return true;
+}
+
+/** Write an item that cannot contain arbitrary items */
+static bool _cbor_writer_leaf(struct cbor_writer* writer,
+                              const cbor_item_t* item) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:
+    case CBOR_TYPE_FLOAT_CTRL:
+      // Preserve the integer and float widths, unlike the typed methods
+      if (!_cbor_writer_claim(writer, _CBOR_WRITER_ITEM_OTHER)) return false;
+      _CBOR_WRITER_ENCODE(writer, cbor_serialize(item, _target, _available));
+      return true;
+    case CBOR_TYPE_BYTESTRING:
+      if (cbor_bytestring_is_definite(item))
+        return cbor_writer_bytestring(writer, cbor_bytestring_handle(item),
+                                      cbor_bytestring_length(item));
+      if (!cbor_writer_indef_bytestring_begin(writer)) return false;
+      // The chunks are definite
+      for (size_t i = 0; i < cbor_bytestring_chunk_count(item); i++) {
+        if (!_cbor_writer_leaf(writer, cbor_bytestring_chunks_handle(item)[i]))
+          return false;
+      }
+      return cbor_writer_end(writer);
+    case CBOR_TYPE_STRING:
+      if (cbor_string_is_definite(item))
+        return cbor_writer_string(writer, (const char*)cbor_string_handle(item),
+                                  cbor_string_length(item));
+      if (!cbor_writer_indef_string_begin(writer)) return false;
+      for (size_t i = 0; i < cbor_string_chunk_count(item); i++) {
+        if (!_cbor_writer_leaf(writer, cbor_string_chunks_handle(item)[i]))
+          return false;
+      }
+      return cbor_writer_end(writer);
+    default:
+      _CBOR_UNREACHABLE;
+      return false;
+  }
+}
+
+/** Write the header of an array, a map, or a tag */
+static bool _cbor_writer_nesting_begin(struct cbor_writer* writer,
+                                       const cbor_item_t* item) {
+  switch (cbor_typeof(item)) {
+    case CBOR_TYPE_ARRAY:
+      return cbor_array_is_definite(item)
+                 ? cbor_writer_array_begin(writer, cbor_array_size(item))
+                 : cbor_writer_indef_array_begin(writer);
+    case CBOR_TYPE_MAP:
+      return cbor_map_is_definite(item)
+                 ? cbor_writer_map_begin(writer, cbor_map_size(item))
+                 : cbor_writer_indef_map_begin(writer);
+    case CBOR_TYPE_TAG:
+      return cbor_writer_tag(writer, cbor_tag_value(item));
+    default:
+      _CBOR_UNREACHABLE;
+      return false;
+  }
+}
+
+bool cbor_writer_item(struct cbor_writer* writer, const cbor_item_t* item) {
+  if (!_cbor_is_nesting(item)) return _cbor_writer_leaf(writer, item);
+  if (!_cbor_writer_nesting_begin(writer, item)) return false;
+
+  struct _cbor_walk walk;
+  _cbor_walk_init(&walk);
+  struct _cbor_walk_frame* frame = _cbor_walk_push(&walk, item);
+  bool success = frame != NULL;
+  while (success && walk.depth > 0) {
+    cbor_item_t* child;
+    if (_cbor_walk_next(frame, &child)) {
+      if (_cbor_is_nesting(child)) {
+        success = _cbor_writer_nesting_begin(writer, child) &&
+                  (frame = _cbor_walk_push(&walk, child)) != NULL;
+      } else {
+        success = _cbor_writer_leaf(writer, child);
+      }
+    } else {
+      // Tags do not open a writer frame
+      if (!cbor_isa_tag(frame->item)) success = cbor_writer_end(writer);
+      _cbor_walk_pop(&walk);
+      if (walk.depth > 0) frame = _cbor_walk_top(&walk);
+    }
+  }
+  _cbor_walk_free(&walk);
+  if (!success && writer->error == CBOR_WRITER_ERR_NONE)
+    _cbor_writer_fail(writer, CBOR_WRITER_ERR_MEMERROR);
+  return success;
+}
+
+bool cbor_writer_fd_sink(void* fd, cbor_data data, size_t length) {
+  while (length > 0) {
+#ifdef _WIN32
+    unsigned chunk = length > INT_MAX ? INT_MAX : (unsigned)length;
+    int written = _write(*(int*)fd, data, chunk);
+#else
+    ssize_t written = write(*(int*)fd, data, length);
+#endif
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    length -= (size_t)written;
+  }
+  return true;
+}
+
+bool cbor_writer_file_sink(void* file, cbor_data data, size_t length) {
+  return fwrite(data, 1, length, (FILE*)file) == length;
+}
+
+bool cbor_writer_memory_sink(void* memory, cbor_data data, size_t length) {
+  struct cbor_writer_memory* target = memory;
+  if (!_cbor_safe_to_add(target->length, length)) return false;
+  if (target->length + length > target->allocated) {
+    size_t new_allocation = target->length + length;
+    if (_cbor_safe_to_multiply(CBOR_BUFFER_GROWTH, new_allocation))
+      new_allocation *= CBOR_BUFFER_GROWTH;
+    unsigned char* new_data = _cbor_realloc(target->data, new_allocation);
+    if (new_data == NULL) return false;
+    target->data = new_data;
+    target->allocated = new_allocation;
+  }
+  memcpy(target->data + target->length, data, length);
+  target->length += length;
+  return true;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#ifndef LIBCBOR_WRITER_H
+#define LIBCBOR_WRITER_H
+
+#include "cbor/cbor_export.h"
+#include "cbor/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ============================================================================
+ * Buffered streaming writer
+ * ============================================================================
+ */
+
+/** Output sink prototype
+ *
+ * Must consume all \p length bytes of \p data.
+ *
+ * @param context The `sink_context` passed to #cbor_writer_new
+ * @param data Bytes to write
+ * @param length Number of bytes to write
+ * @return `true` on success, `false` on failure
+ */
+typedef bool (*cbor_writer_sink)(void* context, cbor_data data, size_t length);
+
+/** Writer error state. Errors are sticky. */
+typedef enum {
+  CBOR_WRITER_ERR_NONE,
+  /** The sink has failed */
+  CBOR_WRITER_ERR_SINK,
+  /** The item does not fit into the current nesting, e.g. a definite array
+     has too many or too few members, or a container was not closed */
+  CBOR_WRITER_ERR_NESTING,
+  /** Allocation of the nesting state failed */
+  CBOR_WRITER_ERR_MEMERROR
+} cbor_writer_error_code;
+
+/** Buffered encoder writing to a #cbor_writer_sink
+ *
+ * Encoded bytes are collected in an internal buffer which is passed to the
+ * sink only once it fills up (or when #cbor_writer_flush is called), so the
+ * memory usage is constant regardless of the output size. The writer tracks
+ * nesting of the containers to ensure the output is well-formed.
+ */
+struct cbor_writer;
+
+/** Create a new writer
+ *
+ * @param buffer_size Size of the internal buffer. Must be at least 9 bytes to
+ * fit the largest item header.
+ * @param sink The output sink
+ * @param sink_context Passed to every \p sink call
+ * @return The new writer. Must be released using #cbor_writer_free.
+ * @return `NULL` if memory allocation fails or \p buffer_size is too small
+ */
+_CBOR_NODISCARD CBOR_EXPORT struct cbor_writer* cbor_writer_new(
+    size_t buffer_size, cbor_writer_sink sink, void* sink_context);
+
+/** Release the writer
+ *
+ * Buffered data is discarded, use #cbor_writer_finish or #cbor_writer_flush
+ * first.
+ *
+ * @param writer The writer. May be `NULL`.
+ */
+CBOR_EXPORT void cbor_writer_free(struct cbor_writer* writer);
+
+/** Pass all the buffered data to the sink
+ *
+ * @param writer The writer
+ * @return `true` on success, `false` if the writer is in an error state
+ */
+CBOR_EXPORT bool cbor_writer_flush(struct cbor_writer* writer);
+
+/** Check that all containers have been closed and flush the buffered data
+ *
+ * @param writer The writer
+ * @return `true` on success, `false` if the writer is in an error state
+ */
+_CBOR_NODISCARD CBOR_EXPORT bool cbor_writer_finish(struct cbor_writer* writer);
+
+/** Get the error state
+ *
+ * @param writer The writer
+ * @return The first error encountered, #CBOR_WRITER_ERR_NONE if none
+ */
+_CBOR_NODISCARD CBOR_EXPORT cbor_writer_error_code
+cbor_writer_error(const struct cbor_writer* writer);
+
+/** Get the current nesting depth
+ *
+ * @param writer The writer
+ * @return Number of containers that have not been closed yet
+ */
+_CBOR_NODISCARD CBOR_EXPORT size_t
+cbor_writer_depth(const struct cbor_writer* writer);
+
+/*
+ * All cbor_writer_* item methods return `true` on success and `false` if the
+ * writer is (or has just entered) an error state. Errors are sticky, so every
+ * later call fails too. A failing method may have written part of its item
+ * (e.g. the header of a string) and updated the nesting state, so the output
+ * is unspecified after an error and should be discarded.
+ */
+
+/** Write an unsigned integer using the shortest encoding */
+CBOR_EXPORT bool cbor_writer_uint(struct cbor_writer* writer, uint64_t value);
+
+/** Write a negative integer `-1 - value` using the shortest encoding */
+CBOR_EXPORT bool cbor_writer_negint(struct cbor_writer* writer,
+                                    uint64_t value);
+
+/** Write a definite byte string */
+CBOR_EXPORT bool cbor_writer_bytestring(struct cbor_writer* writer,
+                                        cbor_data data, size_t length);
+
+/** Write a definite string
+ *
+ * The data is not validated to be UTF-8.
+ */
+CBOR_EXPORT bool cbor_writer_string(struct cbor_writer* writer,
+                                    const char* data, size_t length);
+
+/** Start an indefinite byte string
+ *
+ * Only definite byte string chunks may be written until #cbor_writer_end.
+ */
+CBOR_EXPORT bool cbor_writer_indef_bytestring_begin(struct cbor_writer* writer);
+
+/** Start an indefinite string
+ *
+ * Only definite string chunks may be written until #cbor_writer_end.
+ */
+CBOR_EXPORT bool cbor_writer_indef_string_begin(struct cbor_writer* writer);
+
+/** Start a definite array
+ *
+ * Exactly \p size items must be written before the matching #cbor_writer_end.
+ */
+CBOR_EXPORT bool cbor_writer_array_begin(struct cbor_writer* writer,
+                                         size_t size);
+
+/** Start an indefinite array */
+CBOR_EXPORT bool cbor_writer_indef_array_begin(struct cbor_writer* writer);
+
+/** Start a definite map
+ *
+ * Exactly \p size key-value pairs (2 * \p size items) must be written before
+ * the matching #cbor_writer_end.
+ */
+CBOR_EXPORT bool cbor_writer_map_begin(struct cbor_writer* writer,
+                                       size_t size);
+
+/** Start an indefinite map */
+CBOR_EXPORT bool cbor_writer_indef_map_begin(struct cbor_writer* writer);
+
+/** Close the innermost container
+ *
+ * Checks that the definite containers are complete and writes the break for
+ * indefinite ones.
+ */
+CBOR_EXPORT bool cbor_writer_end(struct cbor_writer* writer);
+
+/** Write a tag. Must be followed by the tagged item. */
+CBOR_EXPORT bool cbor_writer_tag(struct cbor_writer* writer, uint64_t value);
+
+/** Write a boolean */
+CBOR_EXPORT bool cbor_writer_bool(struct cbor_writer* writer, bool value);
+
+/** Write a null */
+CBOR_EXPORT bool cbor_writer_null(struct cbor_writer* writer);
+
+/** Write an undefined */
+CBOR_EXPORT bool cbor_writer_undef(struct cbor_writer* writer);
+
+/** Write a half precision float */
+CBOR_EXPORT bool cbor_writer_half(struct cbor_writer* writer, float value);
+
+/** Write a single precision float */
+CBOR_EXPORT bool cbor_writer_single(struct cbor_writer* writer, float value);
+
+/** Write a double precision float */
+CBOR_EXPORT bool cbor_writer_double(struct cbor_writer* writer, double value);
+
+/** Write a simple value */
+CBOR_EXPORT bool cbor_writer_ctrl(struct cbor_writer* writer, uint8_t value);
+
+/** Write a complete data item
+ *
+ * The output is identical to #cbor_serialize, but large payloads are passed to
+ * the sink without being copied to the buffer.
+ *
+ * @param writer The writer
+ * @param item The item to write, including all of its subitems
+ */
+CBOR_EXPORT bool cbor_writer_item(struct cbor_writer* writer,
+                                  const cbor_item_t* item);
+
+/*
+ * ============================================================================
+ * Sinks
+ * ============================================================================
+ */
+
+/** Sink writing to a file descriptor
+ *
+ * Retries on partial writes and interrupts.
+ *
+ * @param fd `int*` pointing to the file descriptor
+ */
+CBOR_EXPORT bool cbor_writer_fd_sink(void* fd, cbor_data data, size_t length);
+
+/** Sink writing to a `FILE*`
+ *
+ * @param file The `FILE*`
+ */
+CBOR_EXPORT bool cbor_writer_file_sink(void* file, cbor_data data,
+                                       size_t length);
+
+/** Growable in-memory output for #cbor_writer_memory_sink */
+struct cbor_writer_memory {
+  /** Output data. Allocated using the libcbor allocator, the caller is
+   * responsible for freeing it. Initialize to `NULL`. */
+  unsigned char* data;
+  /** Number of bytes written */
+  size_t length;
+  /** Size of the #data allocation */
+  size_t allocated;
+};
+
+/** Sink appending to a heap buffer
+ *
+ * @param memory `struct cbor_writer_memory*`
+ */
+CBOR_EXPORT bool cbor_writer_memory_sink(void* memory, cbor_data data,
+                                         size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBCBOR_WRITER_H
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+static void test_disabled(void** _state _CBOR_UNUSED) {
+#if !CBOR_ALLOC_STATS
+  struct cbor_alloc_stats stats;
+  memset(&stats, 0xFF, sizeof(stats));
+  assert_false(cbor_alloc_stats_get(&stats));
+  assert_size_equal(stats.live_bytes, 0);
+  assert_size_equal(stats.allocations, 0);
+  cbor_alloc_stats_reset();
+#endif
+}
+
+#if CBOR_ALLOC_STATS
+
+static struct cbor_alloc_stats stats_now(void) {
+  struct cbor_alloc_stats stats;
+  assert_true(cbor_alloc_stats_get(&stats));
+  return stats;
+}
+
+static void test_items_are_attributed(void** _state _CBOR_UNUSED) {
+  cbor_alloc_stats_reset();
+  struct cbor_alloc_stats before = stats_now();
+
+  cbor_item_t* item = cbor_build_uint8(42);
+  struct cbor_alloc_stats after = stats_now();
+  assert_size_equal(after.allocations - before.allocations, 1);
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_ITEMS].allocations, 1);
+  assert_size_equal(after.live_bytes - before.live_bytes,
+                    sizeof(cbor_item_t) + 1);
+
+  cbor_decref(&item);
+  after = stats_now();
+  assert_size_equal(after.frees, 1);
+  assert_size_equal(after.live_bytes, before.live_bytes);
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_ITEMS].live_bytes,
+                    before.sites[CBOR_ALLOC_SITE_ITEMS].live_bytes);
+}
+
+static void test_sites(void** _state _CBOR_UNUSED) {
+  cbor_alloc_stats_reset();
+  struct cbor_alloc_stats before = stats_now();
+
+  cbor_item_t* string = cbor_build_string("Hello!");
+  cbor_item_t* array = cbor_new_definite_array(4);
+  assert_true(cbor_array_push(array, cbor_move(string)));
+
+  struct cbor_alloc_stats after = stats_now();
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_ITEMS].allocations, 2);
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_STRING_DATA].live_bytes -
+                        before.sites[CBOR_ALLOC_SITE_STRING_DATA].live_bytes,
+                    6);
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_CONTAINERS].live_bytes -
+                        before.sites[CBOR_ALLOC_SITE_CONTAINERS].live_bytes,
+                    4 * sizeof(cbor_item_t*));
+
+  cbor_decref(&array);
+  after = stats_now();
+  assert_size_equal(after.live_bytes, before.live_bytes);
+  assert_size_equal(after.frees, 4);
+}
+
+static void test_decoding_stack(void** _state _CBOR_UNUSED) {
+  cbor_alloc_stats_reset();
+  struct cbor_alloc_stats before = stats_now();
+
+  // [[1], {2: 3}]
+  unsigned char data[] = {0x82, 0x81, 0x01, 0xA1, 0x02, 0x03};
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(data, sizeof(data), &result);
+  assert_non_null(item);
+
+  struct cbor_alloc_stats after = stats_now();
+  assert_true(after.sites[CBOR_ALLOC_SITE_STACK].allocations > 0);
+  assert_size_equal(after.sites[CBOR_ALLOC_SITE_STACK].live_bytes,
+                    before.sites[CBOR_ALLOC_SITE_STACK].live_bytes);
+  assert_true(after.peak_bytes > after.live_bytes - before.live_bytes);
+
+  cbor_decref(&item);
+  assert_size_equal(stats_now().live_bytes, before.live_bytes);
+}
+
+static void test_realloc(void** _state _CBOR_UNUSED) {
+  cbor_alloc_stats_reset();
+  struct cbor_alloc_stats before = stats_now();
+
+  cbor_item_t* array = cbor_new_indefinite_array();
+  for (uint8_t i = 0; i < 10; i++)
+    assert_true(cbor_array_push(array, cbor_move(cbor_build_uint8(i))));
+
+  struct cbor_alloc_stats after = stats_now();
+  assert_true(after.sites[CBOR_ALLOC_SITE_CONTAINERS].reallocations > 0);
+  assert_true(after.sites[CBOR_ALLOC_SITE_CONTAINERS].live_bytes -
+                  before.sites[CBOR_ALLOC_SITE_CONTAINERS].live_bytes >=
+              10 * sizeof(cbor_item_t*));
+
+  cbor_decref(&array);
+  assert_size_equal(stats_now().live_bytes, before.live_bytes);
+}
+
+static void test_failed_realloc(void** _state _CBOR_UNUSED) {
+  struct cbor_alloc_stats before = stats_now();
+  cbor_item_t* array = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(array, cbor_move(cbor_build_uint8(1))));
+  cbor_item_t* pushee = cbor_build_uint8(2);
+  struct cbor_alloc_stats full = stats_now();
+
+  // The storage of the array stays tracked
+  WITH_MOCK_MALLOC({ assert_false(cbor_array_push(array, pushee)); }, 1,
+                   REALLOC_FAIL);
+  struct cbor_alloc_stats after = stats_now();
+  assert_size_equal(after.live_bytes, full.live_bytes);
+  assert_size_equal(after.reallocations, full.reallocations);
+
+  cbor_decref(&pushee);
+  cbor_decref(&array);
+  assert_size_equal(stats_now().live_bytes, before.live_bytes);
+}
+
+static void test_reset(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_string("Hello!");
+  cbor_alloc_stats_reset();
+
+  struct cbor_alloc_stats stats = stats_now();
+  assert_size_equal(stats.allocations, 0);
+  assert_size_equal(stats.frees, 0);
+  assert_true(stats.live_bytes >= sizeof(cbor_item_t) + 6);
+  assert_size_equal(stats.peak_bytes, stats.live_bytes);
+
+  cbor_decref(&item);
+  stats = stats_now();
+  assert_size_equal(stats.frees, 2);
+  assert_true(stats.peak_bytes > stats.live_bytes);
+}
+
+static void test_client_buffers_untracked(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_string("Hello!");
+  cbor_alloc_stats_reset();
+
+  unsigned char* buffer;
+  size_t buffer_size;
+  assert_size_equal(cbor_serialize_alloc(item, &buffer, &buffer_size), 7);
+  assert_size_equal(stats_now().allocations, 0);
+
+  free(buffer);
+  cbor_decref(&item);
+}
+
+#endif  // CBOR_ALLOC_STATS
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_disabled),
+#if CBOR_ALLOC_STATS
+      cmocka_unit_test(test_items_are_attributed),
+      cmocka_unit_test(test_sites),
+      cmocka_unit_test(test_decoding_stack),
+      cmocka_unit_test(test_realloc),
+      cmocka_unit_test(test_failed_realloc),
+      cmocka_unit_test(test_reset),
+      cmocka_unit_test(test_client_buffers_untracked),
+#endif
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
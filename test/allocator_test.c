@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+
+// Counts the outstanding allocations of one allocator instance
+struct counting_context {
+  size_t allocations;
+  size_t live;
+  bool fail;
+};
+
+static void* counting_allocate(void* context, size_t size) {
+  struct counting_context* counts = context;
+  if (counts->fail) return NULL;
+  counts->allocations++;
+  counts->live++;
+  return malloc(size);
+}
+
+static void* counting_reallocate(void* context, void* pointer, size_t size) {
+  struct counting_context* counts = context;
+  if (counts->fail) return NULL;
+  if (pointer == NULL) {
+    counts->allocations++;
+    counts->live++;
+  }
+  return realloc(pointer, size);
+}
+
+static void counting_deallocate(void* context, void* pointer) {
+  struct counting_context* counts = context;
+  if (pointer != NULL) counts->live--;
+  free(pointer);
+}
+
+static struct counting_context first_counts, second_counts;
+static const struct cbor_allocator first = {
+    .allocate = counting_allocate,
+    .reallocate = counting_reallocate,
+    .deallocate = counting_deallocate,
+    .context = &first_counts};
+static const struct cbor_allocator second = {
+    .allocate = counting_allocate,
+    .reallocate = counting_reallocate,
+    .deallocate = counting_deallocate,
+    .context = &second_counts};
+
+static int reset_counts(void** _state _CBOR_UNUSED) {
+  first_counts = (struct counting_context){0};
+  second_counts = (struct counting_context){0};
+  return 0;
+}
+
+static void test_default_is_global(void** _state _CBOR_UNUSED) {
+  assert_null(cbor_thread_allocator());
+  cbor_item_t* item = cbor_build_uint8(1);
+  assert_null(cbor_item_allocator(item));
+  cbor_decref(&item);
+}
+
+static void test_thread_allocator(void** _state _CBOR_UNUSED) {
+  assert_null(cbor_set_thread_allocator(&first));
+  assert_ptr_equal(cbor_thread_allocator(), &first);
+  cbor_item_t* item = cbor_build_string("Hello!");
+  assert_ptr_equal(cbor_set_thread_allocator(NULL), &first);
+
+  assert_ptr_equal(cbor_item_allocator(item), &first);
+  assert_size_equal(first_counts.allocations, 2);
+  assert_size_equal(first_counts.live, 2);
+
+  cbor_decref(&item);
+  assert_size_equal(first_counts.live, 0);
+}
+
+static void test_mutation_uses_item_allocator(void** _state _CBOR_UNUSED) {
+  cbor_set_thread_allocator(&first);
+  cbor_item_t* array = cbor_new_indefinite_array();
+  cbor_item_t* string = cbor_new_indefinite_string();
+  cbor_set_thread_allocator(&second);
+
+  // Storage for existing items comes from the item's allocator...
+  for (uint8_t i = 0; i < 5; i++)
+    assert_true(cbor_array_push(array, cbor_move(cbor_build_uint8(i))));
+  assert_true(cbor_string_add_chunk(string, cbor_move(cbor_build_string("a"))));
+  // ...while the new items come from the thread allocator
+  assert_size_equal(first_counts.live, 5);
+  assert_size_equal(second_counts.live, 7);
+
+  cbor_set_thread_allocator(NULL);
+  cbor_decref(&array);
+  cbor_decref(&string);
+  assert_size_equal(first_counts.live, 0);
+  assert_size_equal(second_counts.live, 0);
+}
+
+static void test_load_with_allocator(void** _state _CBOR_UNUSED) {
+  // [1, "a", {2: h'00'}, (_ "b")]
+  unsigned char data[] = {0x84, 0x01, 0x61, 0x61, 0xA1, 0x02, 0x41,
+                          0x00, 0x7F, 0x61, 0x62, 0xFF};
+  struct cbor_load_result result;
+  cbor_item_t* item =
+      cbor_load_with_allocator(data, sizeof(data), &first, &result);
+  assert_non_null(item);
+  assert_null(cbor_thread_allocator());
+  assert_ptr_equal(cbor_item_allocator(item), &first);
+  cbor_item_t* member = cbor_array_get(item, 0);
+  assert_ptr_equal(cbor_item_allocator(member), &first);
+  cbor_decref(&member);
+  assert_true(first_counts.live > 0);
+
+  cbor_decref(&item);
+  assert_size_equal(first_counts.live, 0);
+}
+
+static void test_load_failure(void** _state _CBOR_UNUSED) {
+  unsigned char data[] = {0x82, 0x61, 0x61};
+  struct cbor_load_result result;
+  assert_null(cbor_load_with_allocator(data, sizeof(data), &first, &result));
+  assert_true(result.error.code == CBOR_ERR_NOTENOUGHDATA);
+  assert_size_equal(first_counts.live, 0);
+
+  first_counts.fail = true;
+  assert_null(cbor_load_with_allocator(data, sizeof(data), &first, &result));
+  assert_true(result.error.code == CBOR_ERR_MEMERROR);
+  assert_size_equal(first_counts.live, 0);
+}
+
+static void test_copy_with_allocator(void** _state _CBOR_UNUSED) {
+  cbor_set_thread_allocator(&first);
+  cbor_item_t* item = cbor_new_indefinite_bytestring();
+  assert_true(cbor_bytestring_add_chunk(
+      item, cbor_move(cbor_build_bytestring((cbor_data) "ab", 2))));
+  cbor_set_thread_allocator(NULL);
+  size_t first_live = first_counts.live;
+
+  cbor_item_t* copy = cbor_copy_with_allocator(item, &second);
+  cbor_item_t* definite = cbor_copy_definite_with_allocator(item, &second);
+  assert_null(cbor_thread_allocator());
+  assert_ptr_equal(cbor_item_allocator(copy), &second);
+  assert_ptr_equal(cbor_item_allocator(definite), &second);
+  assert_size_equal(first_counts.live, first_live);
+
+  cbor_decref(&item);
+  assert_size_equal(first_counts.live, 0);
+  cbor_decref(&copy);
+  cbor_decref(&definite);
+  assert_size_equal(second_counts.live, 0);
+}
+
+static void test_serialize_alloc_with_allocator(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_uint8(42);
+  unsigned char* buffer;
+  size_t buffer_size;
+  assert_size_equal(
+      cbor_serialize_alloc_with_allocator(item, &buffer, &buffer_size, &first),
+      2);
+  assert_size_equal(buffer_size, 2);
+  assert_memory_equal(buffer, ((unsigned char[]){0x18, 0x2A}), 2);
+  assert_size_equal(first_counts.live, 1);
+  first.deallocate(first.context, buffer);
+
+  first_counts.fail = true;
+  assert_size_equal(
+      cbor_serialize_alloc_with_allocator(item, &buffer, &buffer_size, &first),
+      0);
+  assert_null(buffer);
+  cbor_decref(&item);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_default_is_global),
+      cmocka_unit_test_setup(test_thread_allocator, reset_counts),
+      cmocka_unit_test_setup(test_mutation_uses_item_allocator, reset_counts),
+      cmocka_unit_test_setup(test_load_with_allocator, reset_counts),
+      cmocka_unit_test_setup(test_load_failure, reset_counts),
+      cmocka_unit_test_setup(test_copy_with_allocator, reset_counts),
+      cmocka_unit_test_setup(test_serialize_alloc_with_allocator,
+                             reset_counts),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
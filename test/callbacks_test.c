@@ -356,9 +356,13 @@ static void test_append_map_failure(void** _state _CBOR_UNUSED) {
       .root = NULL,
       .stack = &stack,
   };
-  cbor_item_t* item = cbor_build_uint8(42);
-
-  WITH_MOCK_MALLOC({ _cbor_builder_append(item, &context); }, 1, REALLOC_FAIL);
+  // The failed append frees the item, so it has to come from the same hooks
+  WITH_MOCK_MALLOC(
+      {
+        cbor_item_t* item = cbor_build_uint8(42);
+        _cbor_builder_append(item, &context);
+      },
+      2, MALLOC, REALLOC_FAIL);
 
   assert_true(context.creation_failed);
   assert_false(context.syntax_error);
@@ -5,6 +5,9 @@
  * it under the terms of the MIT license. See LICENSE for details.
  */
 
+// fileno
+#define _POSIX_C_SOURCE 200809L
+
 // cbor_serialize_alloc
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 
@@ -648,6 +651,413 @@ static void test_auto_serialize_zero_len_indef_map(void** _state _CBOR_UNUSED) {
   _cbor_free(output);
 }
 
+static void test_serialized_size_cached(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_uint8(1))));
+  assert_size_equal(cbor_serialized_size(item), 3);
+  assert_size_equal(cbor_serialized_size(item), 3);
+
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_uint8(42))));
+  assert_size_equal(cbor_serialized_size(item), 5);
+  assert_true(cbor_array_set(item, 0, cbor_move(cbor_build_uint16(1))));
+  assert_size_equal(cbor_serialized_size(item), 7);
+  cbor_decref(&item);
+}
+
+static void test_serialized_size_cache_nested_mutation(
+    void** _state _CBOR_UNUSED) {
+  cbor_item_t* inner = cbor_new_indefinite_array();
+  cbor_item_t* map = cbor_new_indefinite_map();
+  assert_true(cbor_map_add(map, (struct cbor_pair){
+                                    .key = cbor_move(cbor_build_uint8(1)),
+                                    .value = inner}));
+  cbor_item_t* tag = cbor_build_tag(1, map);
+  cbor_item_t* item = cbor_new_definite_array(1);
+  assert_true(cbor_array_push(item, tag));
+  // [1(_ {1: [_ ]})]
+  assert_size_equal(cbor_serialized_size(item), 7);
+
+  // Mutations of nested items propagate to all cached ancestors
+  assert_true(cbor_array_push(inner, cbor_move(cbor_build_uint8(0))));
+  assert_size_equal(cbor_serialized_size(item), 8);
+  cbor_set_uint8(cbor_array_handle(inner)[0], 255);
+  assert_size_equal(cbor_serialized_size(item), 9);
+  assert_true(cbor_map_add(map, (struct cbor_pair){
+                                    .key = cbor_move(cbor_build_uint8(2)),
+                                    .value = cbor_move(cbor_build_bool(true))}));
+  assert_size_equal(cbor_serialized_size(item), 11);
+
+  unsigned char* output;
+  size_t output_size;
+  assert_size_equal(cbor_serialize_alloc(item, &output, &output_size), 11);
+  assert_memory_equal(output,
+                      ((unsigned char[]){0x81, 0xC1, 0xBF, 0x01, 0x9F, 0x18,
+                                         0xFF, 0xFF, 0x02, 0xF5, 0xFF}),
+                      11);
+  _cbor_free(output);
+
+  cbor_decref(&inner);
+  cbor_decref(&map);
+  cbor_decref(&tag);
+  cbor_decref(&item);
+}
+
+static void test_serialized_size_cache_per_tree(void** _state _CBOR_UNUSED) {
+  cbor_item_t* leaf = cbor_build_uint8(1);
+  cbor_item_t* inner = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(inner, leaf));
+  cbor_item_t* item = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(item, cbor_move(inner)));
+  // [_ [_ 1]]
+  assert_size_equal(cbor_serialized_size(item), 5);
+
+  // Writing the value directly is not tracked, so the memoized size is only
+  // returned as long as the tree is not walked again
+  *leaf->data = 100;
+
+  cbor_item_t* other_leaf = cbor_build_uint8(1);
+  cbor_item_t* other_inner = cbor_new_indefinite_map();
+  cbor_item_t* other = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(other, other_inner));
+  assert_size_equal(cbor_serialized_size(other), 4);
+  // Modifications of another tree, at the root and nested
+  assert_true(cbor_array_push(other, cbor_move(cbor_build_uint8(1))));
+  assert_true(cbor_map_add(other_inner,
+                           (struct cbor_pair){
+                               .key = cbor_move(cbor_build_uint8(1)),
+                               .value = other_leaf}));
+  cbor_set_uint8(other_leaf, 200);
+  // [_ {_ 1: 200}, 1]
+  assert_size_equal(cbor_serialized_size(other), 8);
+  assert_size_equal(cbor_serialized_size(item), 5);
+
+  // Modifications of the tree itself are seen
+  assert_true(cbor_array_push(inner, cbor_move(cbor_build_uint8(2))));
+  // [_ [_ 100, 2]]
+  assert_size_equal(cbor_serialized_size(item), 7);
+
+  cbor_decref(&leaf);
+  cbor_decref(&item);
+  cbor_decref(&other_leaf);
+  cbor_decref(&other_inner);
+  cbor_decref(&other);
+}
+
+static void test_serialized_size_cache_shared(void** _state _CBOR_UNUSED) {
+  cbor_item_t* shared = cbor_new_indefinite_array();
+  cbor_item_t* shared_leaf = cbor_build_uint8(1);
+  cbor_item_t* first = cbor_new_indefinite_array();
+  cbor_item_t* second = cbor_new_definite_array(2);
+  assert_true(cbor_array_push(first, shared));
+  assert_true(cbor_array_push(first, shared_leaf));
+  assert_true(cbor_array_push(second, shared));
+  assert_true(cbor_array_push(second, shared_leaf));
+  // [_ [_ ], 1], [[_ ], 1]
+  assert_size_equal(cbor_serialized_size(first), 5);
+  assert_size_equal(cbor_serialized_size(second), 4);
+
+  // Both containers see modifications of the items they share
+  assert_true(cbor_array_push(shared, cbor_move(cbor_build_uint8(1))));
+  assert_size_equal(cbor_serialized_size(first), 6);
+  assert_size_equal(cbor_serialized_size(second), 5);
+  cbor_set_uint8(shared_leaf, 100);
+  assert_size_equal(cbor_serialized_size(first), 7);
+  assert_size_equal(cbor_serialized_size(second), 6);
+
+  cbor_decref(&shared);
+  cbor_decref(&shared_leaf);
+  cbor_decref(&first);
+  cbor_decref(&second);
+}
+
+static void test_serialized_size_cache_removed(void** _state _CBOR_UNUSED) {
+  cbor_item_t* replaced = cbor_build_uint8(1);
+  cbor_item_t* untagged = cbor_build_uint8(1);
+  cbor_item_t* released = cbor_build_uint8(1);
+  cbor_item_t* array = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(array, replaced));
+  assert_true(cbor_array_push(array, released));
+  cbor_item_t* tag = cbor_build_tag(1, untagged);
+  // [_ 1, 1], 1(1)
+  assert_size_equal(cbor_serialized_size(array), 4);
+  assert_size_equal(cbor_serialized_size(tag), 2);
+
+  assert_true(cbor_array_replace(array, 0, cbor_move(cbor_build_uint8(2))));
+  cbor_tag_set_item(tag, cbor_move(cbor_build_uint8(3)));
+  // cbor_tag_set_item does not release the previous item
+  cbor_decref(&untagged);
+  assert_size_equal(cbor_serialized_size(array), 4);
+  assert_size_equal(cbor_serialized_size(tag), 2);
+  cbor_decref(&array);
+  cbor_decref(&tag);
+
+  // The items outlive their former containers, modifying them must not touch
+  // the released memory
+  cbor_set_uint8(replaced, 100);
+  cbor_set_uint8(untagged, 100);
+  cbor_set_uint8(released, 100);
+  assert_size_equal(cbor_serialized_size(released), 2);
+
+  cbor_decref(&replaced);
+  cbor_decref(&untagged);
+  cbor_decref(&released);
+}
+
+/* Concatenate the scatter/gather list into `buffer` */
+static size_t gather_iov(const cbor_iovec* iov, size_t count) {
+  size_t length = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(buffer + length, iov[i].iov_base, iov[i].iov_len);
+    length += iov[i].iov_len;
+  }
+  return length;
+}
+
+static void test_serialize_iov_small_items(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_new_definite_array(2);
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_string("abc"))));
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_uint8(1))));
+  cbor_iovec iov[4];
+  unsigned char scratch[16];
+
+  // Everything is inlined and coalesced into a single entry
+  assert_size_equal(cbor_serialize_iov(item, iov, 4, scratch, 16), 1);
+  assert_ptr_equal(iov[0].iov_base, scratch);
+  assert_size_equal(gather_iov(iov, 1), 6);
+  assert_memory_equal(
+      buffer, ((unsigned char[]){0x82, 0x63, 'a', 'b', 'c', 0x01}), 6);
+  cbor_decref(&item);
+}
+
+static void test_serialize_iov_references_payloads(void** _state
+                                                   _CBOR_UNUSED) {
+  unsigned char payload[100];
+  memset(payload, 0xAB, sizeof(payload));
+  cbor_item_t* item = cbor_new_indefinite_array();
+  assert_true(
+      cbor_array_push(item, cbor_move(cbor_build_bytestring(payload, 100))));
+  assert_true(
+      cbor_array_push(item, cbor_move(cbor_build_bytestring(payload, 100))));
+  cbor_iovec iov[8];
+  unsigned char scratch[16];
+
+  // Header, payload, header, payload, break
+  assert_size_equal(cbor_serialize_iov(item, iov, 8, scratch, 16), 5);
+  cbor_item_t** handle = cbor_array_handle(item);
+  assert_ptr_equal(iov[1].iov_base, cbor_bytestring_handle(handle[0]));
+  assert_ptr_equal(iov[3].iov_base, cbor_bytestring_handle(handle[1]));
+  assert_size_equal(iov[0].iov_len, 3);
+  assert_size_equal(iov[4].iov_len, 1);
+
+  size_t length = gather_iov(iov, 5);
+  assert_size_equal(length, cbor_serialized_size(item));
+  unsigned char expected[512];
+  assert_size_equal(cbor_serialize(item, expected, 512), length);
+  assert_memory_equal(buffer, expected, length);
+  cbor_decref(&item);
+}
+
+static void test_serialize_iov_matches_serialize(void** _state _CBOR_UNUSED) {
+  unsigned char payload[80];
+  memset(payload, 'x', sizeof(payload));
+  cbor_item_t* string = cbor_new_indefinite_string();
+  assert_true(cbor_string_add_chunk(
+      string, cbor_move(cbor_build_stringn((char*)payload, 80))));
+  assert_true(cbor_string_add_chunk(string, cbor_move(cbor_build_string("y"))));
+  cbor_item_t* bytes = cbor_new_indefinite_bytestring();
+  assert_true(cbor_bytestring_add_chunk(
+      bytes, cbor_move(cbor_build_bytestring(payload, 64))));
+  cbor_item_t* item = cbor_new_indefinite_map();
+  assert_true(cbor_map_add(
+      item, (struct cbor_pair){.key = cbor_move(cbor_build_tag(
+                                   1, cbor_move(cbor_build_float8(1.5)))),
+                               .value = cbor_move(string)}));
+  assert_true(cbor_map_add(
+      item, (struct cbor_pair){.key = cbor_move(cbor_build_negint8(3)),
+                               .value = cbor_move(bytes)}));
+  cbor_iovec iov[16];
+  unsigned char scratch[64];
+
+  size_t count = cbor_serialize_iov(item, iov, 16, scratch, 64);
+  assert_true(count > 0);
+  size_t length = gather_iov(iov, count);
+  unsigned char expected[512];
+  assert_size_equal(cbor_serialize(item, expected, 512), length);
+  assert_memory_equal(buffer, expected, length);
+  cbor_decref(&item);
+}
+
+static void test_serialize_iov_insufficient(void** _state _CBOR_UNUSED) {
+  unsigned char payload[100] = {0};
+  cbor_item_t* item = cbor_new_definite_array(1);
+  assert_true(
+      cbor_array_push(item, cbor_move(cbor_build_bytestring(payload, 100))));
+  cbor_iovec iov[2];
+  unsigned char scratch[16];
+
+  assert_size_equal(cbor_serialize_iov(item, iov, 1, scratch, 16), 0);
+  assert_size_equal(cbor_serialize_iov(item, iov, 2, scratch, 2), 0);
+  assert_size_equal(cbor_serialize_iov(item, iov, 2, scratch, 3), 2);
+  cbor_decref(&item);
+}
+
+static cbor_item_t* build_large_tree(void) {
+  unsigned char payload[1000];
+  memset(payload, 0x42, sizeof(payload));
+  cbor_item_t* item = cbor_new_indefinite_array();
+  for (int i = 0; i < 100; i++) {
+    assert_true(cbor_array_push(
+        item, cbor_move(cbor_build_bytestring(payload, sizeof(payload)))));
+    assert_true(cbor_array_push(item, cbor_move(cbor_build_uint16(i))));
+  }
+  return item;
+}
+
+/* Check that the `file` contains exactly the serialization of `item` */
+static void assert_file_contents(FILE* file, const cbor_item_t* item) {
+  unsigned char* expected;
+  size_t expected_size;
+  assert_true(cbor_serialize_alloc(item, &expected, &expected_size) > 0);
+  unsigned char* actual = malloc(expected_size + 1);
+  rewind(file);
+  assert_size_equal(fread(actual, 1, expected_size + 1, file), expected_size);
+  assert_memory_equal(actual, expected, expected_size);
+  free(actual);
+  free(expected);
+}
+
+static void test_serialize_file(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_large_tree();
+  FILE* file = tmpfile();
+  assert_non_null(file);
+
+  assert_size_equal(cbor_serialize_file(item, file),
+                    cbor_serialized_size(item));
+  assert_file_contents(file, item);
+  fclose(file);
+  cbor_decref(&item);
+}
+
+static void test_serialize_file_small(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_uint8(1);
+  FILE* file = tmpfile();
+  assert_non_null(file);
+
+  assert_size_equal(cbor_serialize_file(item, file), 1);
+  assert_file_contents(file, item);
+  fclose(file);
+  cbor_decref(&item);
+}
+
+// Checks the preferred serialization and its size
+static void assert_preferred(cbor_item_t* item, const unsigned char* expected,
+                             size_t length) {
+  assert_size_equal(
+      cbor_serialize_with_options(item, buffer, 512, CBOR_SERIALIZE_PREFERRED),
+      length);
+  assert_memory_equal(buffer, expected, length);
+  assert_size_equal(
+      cbor_serialized_size_with_options(item, CBOR_SERIALIZE_PREFERRED),
+      length);
+  assert_size_equal(cbor_serialize_with_options(item, buffer, length - 1,
+                                                CBOR_SERIALIZE_PREFERRED),
+                    0);
+  cbor_decref(&item);
+}
+
+#define ASSERT_PREFERRED(item, ...)                   \
+  assert_preferred(item, (unsigned char[]){__VA_ARGS__}, \
+                   sizeof((unsigned char[]){__VA_ARGS__}))
+
+static void test_serialize_preferred_ints(void** _state _CBOR_UNUSED) {
+  ASSERT_PREFERRED(cbor_build_uint64(5), 0x05);
+  ASSERT_PREFERRED(cbor_build_uint64(500), 0x19, 0x01, 0xF4);
+  ASSERT_PREFERRED(cbor_build_uint32(100000), 0x1A, 0x00, 0x01, 0x86, 0xA0);
+  ASSERT_PREFERRED(cbor_build_uint64(UINT64_MAX), 0x1B, 0xFF, 0xFF, 0xFF, 0xFF,
+                   0xFF, 0xFF, 0xFF, 0xFF);
+  ASSERT_PREFERRED(cbor_build_negint64(24), 0x38, 0x18);
+  ASSERT_PREFERRED(cbor_build_negint16(0), 0x20);
+}
+
+static void test_serialize_preferred_floats(void** _state _CBOR_UNUSED) {
+  ASSERT_PREFERRED(cbor_build_float8(1.5), 0xF9, 0x3E, 0x00);
+  ASSERT_PREFERRED(cbor_build_float8(-0.0), 0xF9, 0x80, 0x00);
+  ASSERT_PREFERRED(cbor_build_float8(65504.0), 0xF9, 0x7B, 0xFF);
+  // Smallest half subnormal
+  ASSERT_PREFERRED(cbor_build_float8(0x1p-24), 0xF9, 0x00, 0x01);
+  ASSERT_PREFERRED(cbor_build_float8(INFINITY), 0xF9, 0x7C, 0x00);
+  ASSERT_PREFERRED(cbor_build_float8(NAN), 0xF9, 0x7E, 0x00);
+  ASSERT_PREFERRED(cbor_build_float4(NAN), 0xF9, 0x7E, 0x00);
+  // Too precise, too large, or too small for a half
+  ASSERT_PREFERRED(cbor_build_float8(1.0 + 0x1p-11), 0xFA, 0x3F, 0x80, 0x10,
+                   0x00);
+  ASSERT_PREFERRED(cbor_build_float8(65536.0), 0xFA, 0x47, 0x80, 0x00, 0x00);
+  ASSERT_PREFERRED(cbor_build_float8(0x1p-25), 0xFA, 0x33, 0x00, 0x00, 0x00);
+  ASSERT_PREFERRED(cbor_build_float8(0.1), 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99,
+                   0x99, 0x99, 0x9A);
+  ASSERT_PREFERRED(cbor_build_float8(1e300), 0xFB, 0x7E, 0x37, 0xE4, 0x3C,
+                   0x88, 0x00, 0x75, 0x9C);
+  // Never wider than the item
+  ASSERT_PREFERRED(cbor_build_float4(0.1f), 0xFA, 0x3D, 0xCC, 0xCC, 0xCD);
+  ASSERT_PREFERRED(cbor_build_float2(1.0f), 0xF9, 0x3C, 0x00);
+  ASSERT_PREFERRED(cbor_build_bool(true), 0xF5);
+}
+
+static void test_serialize_preferred_nested(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_new_definite_map(1);
+  cbor_item_t* array = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(array, cbor_move(cbor_build_float8(2.0))));
+  assert_true(cbor_array_push(
+      array, cbor_move(cbor_build_tag(1, cbor_move(cbor_build_uint64(0))))));
+  assert_true(cbor_map_add(item, (struct cbor_pair){
+                                     .key = cbor_move(cbor_build_uint32(1)),
+                                     .value = cbor_move(array)}));
+  // The memoized default size is neither used nor replaced
+  assert_size_equal(cbor_serialized_size(item), 27);
+  assert_size_equal(
+      cbor_serialized_size_with_options(item, CBOR_SERIALIZE_PREFERRED), 9);
+  assert_size_equal(cbor_serialized_size(item), 27);
+  ASSERT_PREFERRED(item, 0xA1, 0x01, 0x9F, 0xF9, 0x40, 0x00, 0xC1, 0x00, 0xFF);
+}
+
+#ifndef _WIN32
+static void test_serialize_fd(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_large_tree();
+  FILE* file = tmpfile();
+  assert_non_null(file);
+
+  assert_size_equal(
+      cbor_serialize_fd(item, fileno(file), CBOR_SERIALIZE_FD_STREAM),
+      cbor_serialized_size(item));
+  assert_file_contents(file, item);
+  fclose(file);
+  cbor_decref(&item);
+}
+
+static void test_serialize_fd_mmap(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_large_tree();
+  FILE* file = tmpfile();
+  assert_non_null(file);
+  // Existing contents are replaced
+  fputs("previous contents", file);
+  fflush(file);
+
+  assert_size_equal(
+      cbor_serialize_fd(item, fileno(file), CBOR_SERIALIZE_FD_MMAP),
+      cbor_serialized_size(item));
+  assert_file_contents(file, item);
+  fclose(file);
+  cbor_decref(&item);
+}
+
+static void test_serialize_fd_invalid(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_uint8(1);
+  assert_size_equal(cbor_serialize_fd(item, -1, CBOR_SERIALIZE_FD_STREAM), 0);
+  assert_size_equal(cbor_serialize_fd(item, -1, CBOR_SERIALIZE_FD_MMAP), 0);
+  cbor_decref(&item);
+}
+#endif
+
 int main(void) {
   const struct CMUnitTest tests[] = {
       cmocka_unit_test(test_serialize_uint8_embed),
@@ -696,6 +1106,25 @@ int main(void) {
       cmocka_unit_test(test_auto_serialize_zero_len_indef_array),
       cmocka_unit_test(test_auto_serialize_zero_len_map),
       cmocka_unit_test(test_auto_serialize_zero_len_indef_map),
+      cmocka_unit_test(test_serialized_size_cached),
+      cmocka_unit_test(test_serialized_size_cache_nested_mutation),
+      cmocka_unit_test(test_serialized_size_cache_per_tree),
+      cmocka_unit_test(test_serialized_size_cache_shared),
+      cmocka_unit_test(test_serialized_size_cache_removed),
+      cmocka_unit_test(test_serialize_iov_small_items),
+      cmocka_unit_test(test_serialize_iov_references_payloads),
+      cmocka_unit_test(test_serialize_iov_matches_serialize),
+      cmocka_unit_test(test_serialize_iov_insufficient),
+      cmocka_unit_test(test_serialize_file),
+      cmocka_unit_test(test_serialize_file_small),
+      cmocka_unit_test(test_serialize_preferred_ints),
+      cmocka_unit_test(test_serialize_preferred_floats),
+      cmocka_unit_test(test_serialize_preferred_nested),
+#ifndef _WIN32
+      cmocka_unit_test(test_serialize_fd),
+      cmocka_unit_test(test_serialize_fd_mmap),
+      cmocka_unit_test(test_serialize_fd_invalid),
+#endif
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
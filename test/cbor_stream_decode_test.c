@@ -667,6 +667,95 @@ static void test_undef_decoding(void** _state _CBOR_UNUSED) {
   assert_decoder_result(1, CBOR_DECODER_FINISHED, decode(undef_data, 1));
 }
 
+unsigned char partial_bstring_data[] = {0x45, 0x01, 0x02, 0x03,
+                                        0x04, 0x05, 0x01};
+static void test_partial_bstring_decoding(void** _state _CBOR_UNUSED) {
+  struct cbor_stream_state state = {0};
+  assert_bstring_chunk_eq(partial_bstring_data + 1, 2, 3);
+  assert_decoder_result(3, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data, 3, &state));
+  assert_true(state.string_remaining == 3);
+
+  assert_bstring_chunk_eq(partial_bstring_data + 3, 1, 2);
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data + 3, 1, &state));
+  assert_decoder_result_nedata(1, decode_partial(NULL, 0, &state));
+
+  // Only the rest of the string is consumed
+  assert_bstring_chunk_eq(partial_bstring_data + 4, 2, 0);
+  assert_decoder_result(2, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data + 4, 3, &state));
+  assert_uint8_eq(1);
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data + 6, 1, &state));
+
+  // Strings available as a whole are not split
+  assert_bstring_mem_eq(partial_bstring_data + 1, 5);
+  assert_decoder_result(6, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data, 7, &state));
+
+  // The first part is empty when only the header is available
+  assert_bstring_chunk_eq(partial_bstring_data + 1, 0, 5);
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data, 1, &state));
+  assert_bstring_chunk_eq(partial_bstring_data + 1, 5, 0);
+  assert_decoder_result(5, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_bstring_data + 1, 6, &state));
+  assert_true(state.string_remaining == 0);
+}
+
+unsigned char partial_string_data[] = {0x79, 0x00, 0x03, 'a', 'b', 'c',
+                                       0x7F, 0x62, 'x',  'y', 0xFF};
+static void test_partial_string_decoding(void** _state _CBOR_UNUSED) {
+  struct cbor_stream_state state = {0};
+  // The header is never split
+  assert_decoder_result_nedata(3,
+                               decode_partial(partial_string_data, 2, &state));
+
+  assert_string_chunk_eq(partial_string_data + 3, 1, 2);
+  assert_decoder_result(4, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data, 4, &state));
+  assert_string_chunk_eq(partial_string_data + 4, 2, 0);
+  assert_decoder_result(2, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data + 4, 7, &state));
+
+  // Chunks of indefinite strings are delivered in parts too
+  assert_string_indef_start();
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data + 6, 5, &state));
+  assert_string_chunk_eq(partial_string_data + 8, 1, 1);
+  assert_decoder_result(2, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data + 7, 2, &state));
+  assert_string_chunk_eq(partial_string_data + 9, 1, 0);
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data + 9, 2, &state));
+  assert_indef_break();
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode_partial(partial_string_data + 10, 1, &state));
+}
+
+static void test_partial_without_chunk_callbacks(
+    void** _state _CBOR_UNUSED) {
+  // E.g. callbacks initialized before the chunk callbacks were added
+  struct cbor_callbacks callbacks = asserting_callbacks;
+  callbacks.byte_string_chunk = NULL;
+  callbacks.string_chunk = NULL;
+  struct cbor_stream_state state = {0};
+
+  assert_decoder_result_nedata(
+      6, cbor_stream_decode_partial(partial_bstring_data, 3, &callbacks, NULL,
+                                    &state));
+  assert_decoder_result_nedata(
+      6, cbor_stream_decode_partial(partial_string_data, 4, &callbacks, NULL,
+                                    &state));
+  assert_true(state.string_remaining == 0);
+
+  assert_bstring_mem_eq(partial_bstring_data + 1, 5);
+  assert_decoder_result(6, CBOR_DECODER_FINISHED,
+                        cbor_stream_decode_partial(partial_bstring_data, 7,
+                                                   &callbacks, NULL, &state));
+}
+
 #define stream_test(f) cmocka_unit_test_teardown(f, clean_up_stream_assertions)
 
 int main(void) {
@@ -738,6 +827,9 @@ int main(void) {
       stream_test(test_false_decoding),
       stream_test(test_true_decoding),
       stream_test(test_null_decoding),
-      stream_test(test_undef_decoding)};
+      stream_test(test_undef_decoding),
+      stream_test(test_partial_bstring_decoding),
+      stream_test(test_partial_string_decoding),
+      stream_test(test_partial_without_chunk_callbacks)};
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
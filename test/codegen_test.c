@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/* Tests the code cbor_cddlgen generates from codegen_schema.cddl */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+#include "codegen_schema.h"
+
+static unsigned char buffer[512];
+
+#define BYTES(...) (cbor_data)(unsigned char[]){__VA_ARGS__}, \
+                   sizeof((unsigned char[]){__VA_ARGS__})
+
+#define STRING(literal) (cbor_data)(literal), sizeof(literal) - 1
+
+#define TEXT(literal) \
+  (struct cbor_cddl_string) { (cbor_data)literal, sizeof(literal) - 1 }
+
+static void assert_diag(cbor_data data, size_t length, const char* expected) {
+  char output[512];
+  struct cbor_diag_result result =
+      cbor_diag_bytes(data, length, output, sizeof(output), NULL);
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  assert_size_equal(result.read, length);
+  assert_string_equal(output, expected);
+}
+
+static void assert_text(struct cbor_cddl_string string, const char* expected) {
+  assert_size_equal(string.length, strlen(expected));
+  assert_memory_equal(string.data, expected, string.length);
+}
+
+static struct sensor_reading full_reading(void) {
+  struct sensor_reading reading = {
+      .id = 7,
+      .has_label = true,
+      .label = TEXT("temp"),
+      .value_ = 21.5,
+      .key_1 = -3,
+      .key_m2 = true,
+      .unit_key = TEXT("C"),
+      .has_location = true,
+      .location = {.latitude = 50.25, .longitude = -14.5, .altitude = -200},
+      .has_flags = true,
+      .flags = {.count = 2, .items = {true, false}},
+      .has_calibration = true,
+      .calibration = {.offset = 0.5f, .scale = 1.5f},
+  };
+  return reading;
+}
+
+static void test_encode(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading = full_reading();
+  size_t length = sensor_reading_encode(&reading, buffer, sizeof(buffer));
+  assert_diag(buffer, length,
+              "{\"id\": 7, \"label\": \"temp\", \"value\": 21.5, 1: -3, "
+              "-2: true, \"unit\": \"C\", \"location\": [50.25, -14.5, -200], "
+              "\"flags\": [true, false], "
+              "\"calibration\": {\"offset\": 0.5, \"scale\": 1.5}}");
+  // Entries are encoded in the schema order, floats in the declared width
+  assert_memory_equal(buffer, ((unsigned char[]){0xA9, 0x62, 'i', 'd', 0x07}),
+                      5);
+  assert_memory_equal(buffer + length - 14,
+                      ((unsigned char[]){0xFA, 0x3F, 0x00, 0x00, 0x00, 0x65,
+                                         's', 'c', 'a', 'l', 'e', 0xF9, 0x3E,
+                                         0x00}),
+                      14);
+
+  reading.has_label = false;
+  reading.has_location = false;
+  reading.has_flags = false;
+  reading.has_calibration = false;
+  length = sensor_reading_encode(&reading, buffer, sizeof(buffer));
+  assert_diag(buffer, length,
+              "{\"id\": 7, \"value\": 21.5, 1: -3, -2: true, \"unit\": \"C\"}");
+}
+
+static void test_encode_small_buffer(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading = full_reading();
+  size_t length = sensor_reading_encode(&reading, buffer, sizeof(buffer));
+  assert_true(length > 0);
+  for (size_t size = 0; size < length; size++)
+    assert_size_equal(sensor_reading_encode(&reading, buffer, size), 0);
+}
+
+static void test_roundtrip(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading = full_reading();
+  size_t length = sensor_reading_encode(&reading, buffer, sizeof(buffer));
+
+  struct sensor_reading decoded;
+  memset(&decoded, 0xAA, sizeof(decoded));
+  assert_size_equal(sensor_reading_decode(buffer, length, &decoded), length);
+  assert_true(decoded.id == 7);
+  assert_true(decoded.has_label);
+  assert_text(decoded.label, "temp");
+  // Strings point into the input
+  assert_ptr_equal(decoded.label.data, buffer + 12);
+  assert_true(decoded.value_ == 21.5);
+  assert_true(decoded.key_1 == -3);
+  assert_true(decoded.key_m2);
+  assert_text(decoded.unit_key, "C");
+  assert_true(decoded.has_location);
+  assert_true(decoded.location.latitude == 50.25);
+  assert_true(decoded.location.longitude == -14.5);
+  assert_true(decoded.location.altitude == -200);
+  assert_true(decoded.has_flags);
+  assert_size_equal(decoded.flags.count, 2);
+  assert_true(decoded.flags.items[0]);
+  assert_false(decoded.flags.items[1]);
+  assert_true(decoded.has_calibration);
+  assert_true(decoded.calibration.offset == 0.5f);
+  assert_true(decoded.calibration.scale == 1.5f);
+
+  // Decoding stops after the item
+  assert_size_equal(sensor_reading_decode(buffer, sizeof(buffer), &decoded),
+                    length);
+}
+
+static void test_decode_truncated(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading = full_reading();
+  size_t length = sensor_reading_encode(&reading, buffer, sizeof(buffer));
+  for (size_t size = 0; size < length; size++)
+    assert_size_equal(sensor_reading_decode(buffer, size, &reading), 0);
+}
+
+static void test_decode_any_order(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading = full_reading();
+  // Indefinite map, keys out of order, the double encoded as a half
+  const char data[] =
+      "\xBF\x64unit\x61K\x21\xF5\x01\x38\x63\x65value\xF9\x3C\x00\x62"
+      "id\x18\x2A\xFF";
+  assert_size_equal(sensor_reading_decode(STRING(data), &reading),
+                    sizeof(data) - 1);
+  assert_true(reading.id == 42);
+  assert_true(reading.value_ == 1.0);
+  assert_true(reading.key_1 == -100);
+  assert_true(reading.key_m2);
+  assert_text(reading.unit_key, "K");
+  // Optional entries are reset
+  assert_false(reading.has_label);
+  assert_false(reading.has_location);
+  assert_false(reading.has_flags);
+  assert_false(reading.has_calibration);
+}
+
+static void test_decode_invalid_map(void** _state _CBOR_UNUSED) {
+  struct sensor_reading reading;
+  // Missing entries
+  assert_size_equal(sensor_reading_decode(BYTES(0xA1, 0x62, 'i', 'd', 0x00),
+                                          &reading),
+                    0);
+  // Unknown key
+  assert_size_equal(
+      sensor_reading_decode(
+          STRING("\xBF\x64unit\x61K\x21\xF5\x01\x38\x63\x63"
+                 "foo\x00\x65value\xF9\x3C\x00\x62id\x18\x2A\xFF"),
+          &reading),
+      0);
+  // Duplicate key
+  assert_size_equal(
+      sensor_reading_decode(
+          STRING("\xBF\x64unit\x61K\x21\xF5\x01\x38\x63\x62"
+                 "id\x00\x65value\xF9\x3C\x00\x62id\x18\x2A\xFF"),
+          &reading),
+      0);
+  // Wrong value type
+  assert_size_equal(
+      sensor_reading_decode(
+          STRING("\xBF\x64unit\x61K\x21\xF5\x01\x38\x63"
+                 "\x65value\xF9\x3C\x00\x62id\x38\x2A\xFF"),
+          &reading),
+      0);
+  // Not a map
+  assert_size_equal(sensor_reading_decode(BYTES(0x80), &reading), 0);
+}
+
+static void test_decode_record(void** _state _CBOR_UNUSED) {
+  struct point point;
+  assert_size_equal(
+      point_decode(BYTES(0x83, 0xF9, 0x3C, 0x00, 0xFA, 0x40, 0x00, 0x00, 0x00,
+                         0x20),
+                   &point),
+      10);
+  assert_true(point.latitude == 1.0);
+  assert_true(point.longitude == 2.0);
+  assert_true(point.altitude == -1);
+
+  assert_size_equal(
+      point_decode(BYTES(0x9F, 0xF9, 0x3C, 0x00, 0xF9, 0x3C, 0x00, 0x20, 0xFF),
+                   &point),
+      9);
+
+  // nint does not accept 0
+  assert_size_equal(
+      point_decode(BYTES(0x83, 0xF9, 0x3C, 0x00, 0xF9, 0x3C, 0x00, 0x00),
+                   &point),
+      0);
+  // Wrong number of entries
+  assert_size_equal(point_decode(BYTES(0x82, 0xF9, 0x3C, 0x00, 0xF9, 0x3C,
+                                       0x00),
+                                 &point),
+                    0);
+  assert_size_equal(
+      point_decode(BYTES(0x9F, 0xF9, 0x3C, 0x00, 0xF9, 0x3C, 0x00, 0x20, 0x20,
+                         0xFF),
+                   &point),
+      0);
+}
+
+static void test_decode_float_width(void** _state _CBOR_UNUSED) {
+  struct sensor_reading_calibration calibration;
+  // offset: float32, scale: float16
+  const char data[] =
+      "\xA2\x66offset\xFA\x3F\x00\x00\x00\x65scale\xF9\x3C\x00";
+  assert_size_equal(
+      sensor_reading_calibration_decode(STRING(data), &calibration),
+      sizeof(data) - 1);
+  assert_true(calibration.offset == 0.5f);
+  assert_true(calibration.scale == 1.0f);
+
+  assert_size_equal(sensor_reading_calibration_decode(
+                        STRING("\xA2\x66offset\xFB\x3F\xE0\x00\x00\x00"
+                               "\x00\x00\x00\x65scale\xF9\x3C\x00"),
+                        &calibration),
+                    0);
+  assert_size_equal(
+      sensor_reading_calibration_decode(
+          STRING("\xA2\x66offset\xFA\x3F\x00\x00\x00\x65scale\xFA\x3F"
+                 "\x80\x00\x00"),
+          &calibration),
+      0);
+}
+
+static void test_vectors(void** _state _CBOR_UNUSED) {
+  struct blobs blobs;
+  cbor_data data =
+      (cbor_data)(unsigned char[]){0x82, 0x41, 0x01, 0x42, 0x02, 0x03};
+  assert_size_equal(blobs_decode(data, 6, &blobs), 6);
+  assert_size_equal(blobs.count, 2);
+  assert_ptr_equal(blobs.items[0].data, data + 2);
+  assert_size_equal(blobs.items[0].length, 1);
+  assert_ptr_equal(blobs.items[1].data, data + 4);
+  assert_size_equal(blobs.items[1].length, 2);
+
+  assert_size_equal(blobs_decode(BYTES(0x9F, 0x40, 0xFF), &blobs), 3);
+  assert_size_equal(blobs.count, 1);
+  assert_size_equal(blobs_decode(BYTES(0x80), &blobs), 1);
+  assert_size_equal(blobs.count, 0);
+
+  // Too many items
+  assert_size_equal(blobs_decode(BYTES(0x83, 0x40, 0x40, 0x40), &blobs), 0);
+  assert_size_equal(blobs_decode(BYTES(0x9F, 0x40, 0x40, 0x40, 0xFF), &blobs),
+                    0);
+  // Text strings are not byte strings
+  assert_size_equal(blobs_decode(BYTES(0x81, 0x60), &blobs), 0);
+
+  blobs.count = 2;
+  blobs.items[0] = TEXT("\x01");
+  blobs.items[1] = TEXT("");
+  size_t length = blobs_encode(&blobs, buffer, sizeof(buffer));
+  assert_diag(buffer, length, "[h'01', h'']");
+  blobs.count = 3;
+  assert_size_equal(blobs_encode(&blobs, buffer, sizeof(buffer)), 0);
+}
+
+static void test_vector_minimum(void** _state _CBOR_UNUSED) {
+  struct batch batch = {.count = 0};
+  assert_size_equal(batch_encode(&batch, buffer, sizeof(buffer)), 0);
+  assert_size_equal(batch_decode(BYTES(0x80), &batch), 0);
+
+  batch.count = 1;
+  batch.items[0] = full_reading();
+  size_t length = batch_encode(&batch, buffer, sizeof(buffer));
+  assert_true(length > 0);
+  assert_size_equal(batch_decode(buffer, length, &batch), length);
+  assert_size_equal(batch.count, 1);
+  assert_true(batch.items[0].id == 7);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_encode),
+      cmocka_unit_test(test_encode_small_buffer),
+      cmocka_unit_test(test_roundtrip),
+      cmocka_unit_test(test_decode_truncated),
+      cmocka_unit_test(test_decode_any_order),
+      cmocka_unit_test(test_decode_invalid_map),
+      cmocka_unit_test(test_decode_record),
+      cmocka_unit_test(test_decode_float_width),
+      cmocka_unit_test(test_vectors),
+      cmocka_unit_test(test_vector_minimum),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
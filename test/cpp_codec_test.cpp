@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// Headers needed by cmocka -- must be imported first
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmocka.h>
+
+#include "cbor.hpp"
+
+using bytes = std::vector<unsigned char>;
+
+template <class T>
+static void assert_encoding(const T& value, const bytes& expected) {
+  assert_true(cbor::encode(value) == expected);
+  assert_int_equal(cbor::encoded_size(value), expected.size());
+
+  // Every shorter buffer is too small
+  unsigned char buffer[256];
+  for (size_t size = 0; size < expected.size(); size++)
+    assert_int_equal(cbor::encode(value, buffer, size), 0);
+
+  T decoded{};
+  assert_int_equal(cbor::decode(expected.data(), expected.size(), decoded),
+                   expected.size());
+  assert_true(decoded == value);
+  for (size_t size = 0; size < expected.size(); size++)
+    assert_false(cbor::decode<T>(expected.data(), size).has_value());
+}
+
+template <class T>
+static std::optional<T> decode(const bytes& data) {
+  return cbor::decode<T>(data.data(), data.size());
+}
+
+static std::string diag(const bytes& data) {
+  char output[256];
+  struct cbor_diag_result result =
+      cbor_diag_bytes(data.data(), data.size(), output, sizeof(output), NULL);
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  return output;
+}
+
+static void test_integers(void** _state _CBOR_UNUSED) {
+  assert_encoding(uint8_t{23}, {0x17});
+  assert_encoding(uint8_t{255}, {0x18, 0xFF});
+  assert_encoding(uint16_t{255}, {0x18, 0xFF});
+  assert_encoding(uint16_t{256}, {0x19, 0x01, 0x00});
+  assert_encoding(uint32_t{70000}, {0x1A, 0x00, 0x01, 0x11, 0x70});
+  assert_encoding(UINT64_MAX,
+                  {0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF});
+  assert_encoding(int8_t{-1}, {0x20});
+  assert_encoding(int8_t{-128}, {0x38, 0x7F});
+  assert_encoding(int16_t{-1000}, {0x39, 0x03, 0xE7});
+  assert_encoding(int64_t{1}, {0x01});
+  assert_encoding(INT64_MIN,
+                  {0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF});
+
+  // Values out of the range of the type
+  assert_false(decode<uint8_t>({0x19, 0x01, 0x00}).has_value());
+  assert_false(decode<uint32_t>({0x20}).has_value());
+  assert_false(decode<int8_t>({0x38, 0x80}).has_value());
+  assert_false(decode<int8_t>({0x18, 0x80}).has_value());
+  assert_false(
+      decode<int64_t>({0x1B, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00})
+          .has_value());
+  // Other types
+  assert_false(decode<int>({0xF9, 0x3C, 0x00}).has_value());
+  assert_false(decode<int>({0x40}).has_value());
+  // Reserved additional information
+  assert_false(decode<int>({0x1C}).has_value());
+  // Not minimal, but valid
+  assert_true(decode<int>({0x19, 0x00, 0x01}) == 1);
+}
+
+enum class color : uint8_t { red = 1, blue = 200 };
+
+static void test_bool_and_enums(void** _state _CBOR_UNUSED) {
+  assert_encoding(true, {0xF5});
+  assert_encoding(false, {0xF4});
+  assert_false(decode<bool>({0xF6}).has_value());
+  assert_false(decode<bool>({0x01}).has_value());
+
+  assert_encoding(color::red, {0x01});
+  assert_encoding(color::blue, {0x18, 0xC8});
+  assert_false(decode<color>({0x19, 0x01, 0x00}).has_value());
+}
+
+static void test_floats(void** _state _CBOR_UNUSED) {
+  assert_encoding(1.5f, {0xFA, 0x3F, 0xC0, 0x00, 0x00});
+  assert_encoding(1.5, {0xFB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
+
+  // Narrower floats are accepted
+  assert_true(decode<double>({0xF9, 0x3C, 0x00}) == 1.0);
+  assert_true(decode<double>({0xFA, 0x3F, 0xC0, 0x00, 0x00}) == 1.5);
+  assert_true(decode<float>({0xF9, 0x3C, 0x00}) == 1.0f);
+  // Wider ones are not
+  assert_false(
+      decode<float>({0xFB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00})
+          .has_value());
+  assert_false(decode<double>({0x01}).has_value());
+  assert_false(decode<double>({0xF9, 0x3C}).has_value());
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  assert_encoding(std::string(), {0x60});
+  assert_encoding(std::string("abc"), {0x63, 'a', 'b', 'c'});
+  assert_encoding(std::vector<std::byte>{std::byte{1}, std::byte{2}},
+                  {0x42, 0x01, 0x02});
+  assert_encoding(std::array<std::byte, 1>{std::byte{0xFF}}, {0x41, 0xFF});
+
+  // Indefinite strings are concatenated
+  assert_true(decode<std::string>({0x7F, 0x61, 'a', 0x62, 'b', 'c', 0xFF}) ==
+              "abc");
+  assert_true(decode<std::vector<std::byte>>({0x5F, 0x41, 0x01, 0xFF}) ==
+              std::vector<std::byte>{std::byte{1}});
+  // Chunks must be definite strings of the same type
+  assert_false(
+      decode<std::string>({0x7F, 0x41, 'a', 0xFF}).has_value());
+  assert_false(
+      decode<std::string>({0x7F, 0x7F, 0xFF, 0xFF}).has_value());
+  assert_false(decode<std::string>({0x7F, 0x61, 'a'}).has_value());
+  assert_false(decode<std::string>({0x42, 'a', 'b'}).has_value());
+  // Fixed size byte strings must match
+  assert_false(
+      (decode<std::array<std::byte, 2>>({0x41, 0xFF}).has_value()));
+
+  // Views point into the input
+  bytes data = {0x63, 'a', 'b', 'c'};
+  std::string_view view;
+  assert_int_equal(cbor::decode(data.data(), data.size(), view), 4);
+  assert_ptr_equal(view.data(), data.data() + 1);
+  assert_int_equal(view.size(), 3);
+  assert_true(cbor::encode(view) == data);
+  assert_false(
+      decode<std::string_view>({0x7F, 0x61, 'a', 0xFF}).has_value());
+}
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  assert_encoding(std::vector<int>{}, {0x80});
+  assert_encoding(std::vector<int>{1, -2}, {0x82, 0x01, 0x21});
+  assert_encoding(std::vector<bool>{true, false}, {0x82, 0xF5, 0xF4});
+  assert_encoding(std::array<uint16_t, 2>{1, 1000},
+                  {0x82, 0x01, 0x19, 0x03, 0xE8});
+  assert_encoding(std::vector<std::vector<uint8_t>>{{}, {1}},
+                  {0x82, 0x80, 0x81, 0x01});
+  assert_encoding(std::map<std::string, int>{{"a", 1}, {"b", -1}},
+                  {0xA2, 0x61, 'a', 0x01, 0x61, 'b', 0x20});
+  assert_encoding(std::optional<int>(), {0xF6});
+  assert_encoding(std::optional<int>(1), {0x01});
+
+  // Indefinite containers
+  assert_true(decode<std::vector<int>>({0x9F, 0x01, 0x02, 0xFF}) ==
+              (std::vector<int>{1, 2}));
+  assert_true((decode<std::array<int, 2>>({0x9F, 0x01, 0x02, 0xFF}) ==
+               std::array<int, 2>{1, 2}));
+  assert_true((decode<std::map<int, int>>({0xBF, 0x01, 0x02, 0xFF}) ==
+               std::map<int, int>{{1, 2}}));
+  // Wrong number of items
+  assert_false((decode<std::array<int, 2>>({0x81, 0x01}).has_value()));
+  assert_false(
+      (decode<std::array<int, 2>>({0x9F, 0x01, 0x02, 0x03, 0xFF}).has_value()));
+  // Duplicate keys
+  assert_false(
+      (decode<std::map<int, int>>({0xA2, 0x01, 0x02, 0x01, 0x03}).has_value()));
+  // The declared size does not cause huge allocations
+  assert_false(
+      decode<std::vector<int>>({0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                0xFF, 0x01})
+          .has_value());
+}
+
+struct location {
+  double latitude;
+  double longitude;
+  CBOR_FIELDS(latitude, longitude)
+
+  bool operator==(const location& other) const {
+    return latitude == other.latitude && longitude == other.longitude;
+  }
+};
+
+struct sample {
+  std::string name;
+  std::vector<float> values;
+  std::optional<uint32_t> unit;
+  std::map<std::string, bool> flags;
+  std::optional<location> where;
+  CBOR_FIELDS(name, values, unit,
+              flags, where)
+
+  bool operator==(const sample& other) const {
+    return name == other.name && values == other.values &&
+           unit == other.unit && flags == other.flags && where == other.where;
+  }
+};
+
+static void test_structs(void** _state _CBOR_UNUSED) {
+  sample value{"t", {1.5f}, std::nullopt, {{"on", true}}, std::nullopt};
+  bytes encoded = cbor::encode(value);
+  assert_string_equal(
+      diag(encoded).c_str(),
+      "{\"name\": \"t\", \"values\": [1.5], \"flags\": {\"on\": true}}");
+  assert_encoding(value, encoded);
+
+  value.unit = 3;
+  value.where = location{50.5, 14.25};
+  encoded = cbor::encode(value);
+  assert_string_equal(
+      diag(encoded).c_str(),
+      "{\"name\": \"t\", \"values\": [1.5], \"unit\": 3, \"flags\": {\"on\": "
+      "true}, \"where\": {\"latitude\": 50.5, \"longitude\": 14.25}}");
+  assert_encoding(value, encoded);
+
+  // Members in any order, optional ones reset when missing, null for empty
+  sample decoded = value;
+  assert_true(cbor::decode(encoded.data(), encoded.size(), decoded) > 0);
+  bytes reordered = {0xBF, 0x65, 'f', 'l', 'a', 'g', 's', 0xA0, 0x64, 'n',
+                     'a',  'm',  'e', 0x60, 0x65, 'w', 'h', 'e', 'r', 'e',
+                     0xF6, 0x66, 'v', 'a', 'l', 'u', 'e', 's', 0x80, 0xFF};
+  assert_int_equal(cbor::decode(reordered.data(), reordered.size(), decoded),
+                   reordered.size());
+  assert_true(decoded == sample{});
+
+  // Missing, unknown, and duplicate members
+  assert_false(decode<location>({0xA1, 0x68, 'l', 'a', 't', 'i', 't', 'u',
+                                 'd', 'e', 0x01})
+                   .has_value());
+  assert_false(decode<location>({0xA3, 0x68, 'l', 'a', 't', 'i', 't', 'u',
+                                 'd', 'e', 0x01, 0x69, 'l', 'o', 'n', 'g',
+                                 'i', 't', 'u', 'd', 'e', 0x01, 0x61, 'x',
+                                 0x01})
+                   .has_value());
+  assert_false(decode<location>({0xA2, 0x68, 'l', 'a', 't', 'i', 't', 'u',
+                                 'd', 'e', 0x01, 0x68, 'l', 'a', 't', 'i',
+                                 't', 'u', 'd', 'e', 0x01})
+                   .has_value());
+  // Keys must be text strings
+  assert_false(decode<location>({0xA1, 0x01, 0x01}).has_value());
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_integers),
+      cmocka_unit_test(test_bool_and_enums),
+      cmocka_unit_test(test_floats),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_structs),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
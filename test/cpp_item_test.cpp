@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// Headers needed by cmocka -- must be imported first
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmocka.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "cbor.hpp"
+
+static_assert(!std::is_copy_constructible_v<cbor::item>);
+static_assert(!std::is_copy_assignable_v<cbor::item>);
+static_assert(std::is_nothrow_move_constructible_v<cbor::item>);
+static_assert(std::is_nothrow_move_assignable_v<cbor::item>);
+static_assert(sizeof(cbor::item) == sizeof(cbor_item_t*));
+static_assert(sizeof(cbor::item_view) == sizeof(cbor_item_t*));
+
+static cbor::item load(const std::vector<unsigned char>& data) {
+  struct cbor_load_result result;
+  cbor::item item = cbor::load(data.data(), data.size(), &result);
+  assert_true(result.error.code == CBOR_ERR_NONE);
+  assert_int_equal(result.read, data.size());
+  return item;
+}
+
+static void test_ownership(void** _state _CBOR_UNUSED) {
+  cbor::item item(cbor_build_uint8(1));
+  cbor_item_t* handle = item.get();
+  assert_true(static_cast<bool>(item));
+  assert_int_equal(cbor_refcount(handle), 1);
+
+  // Moves transfer the reference
+  cbor::item moved(std::move(item));
+  assert_false(static_cast<bool>(item));
+  assert_ptr_equal(moved.get(), handle);
+  assert_int_equal(cbor_refcount(handle), 1);
+
+  {
+    cbor::item shared = moved.share();
+    assert_ptr_equal(shared.get(), handle);
+    assert_int_equal(cbor_refcount(handle), 2);
+
+    // Assignment releases the previous reference
+    shared = cbor::item(cbor_build_uint8(2));
+    assert_int_equal(cbor_refcount(handle), 1);
+    assert_int_equal(shared.uint(), 2);
+
+    cbor::item_view view = moved;
+    assert_ptr_equal(view.get(), handle);
+    cbor::item from_view = view.share();
+    assert_int_equal(cbor_refcount(handle), 2);
+  }
+  assert_int_equal(cbor_refcount(handle), 1);
+
+  // Hand the reference back to C
+  cbor_item_t* released = moved.release();
+  assert_ptr_equal(released, handle);
+  assert_false(static_cast<bool>(moved));
+  moved.reset(released);
+  assert_ptr_equal(moved.get(), handle);
+
+  // Failed loads give empty handles
+  unsigned char truncated[] = {0x82, 0x01};
+  struct cbor_load_result result;
+  assert_false(static_cast<bool>(
+      cbor::load(truncated, sizeof(truncated), &result)));
+  assert_true(result.error.code == CBOR_ERR_NOTENOUGHDATA);
+  assert_false(static_cast<bool>(cbor::load(truncated, sizeof(truncated))));
+}
+
+static void test_scalars(void** _state _CBOR_UNUSED) {
+  assert_int_equal(load({0x19, 0x01, 0x00}).uint(), 256);
+  assert_true(load({0x19, 0x01, 0x00}).type() == CBOR_TYPE_UINT);
+  assert_int_equal(load({0x38, 0x63}).uint(), 99);
+  assert_true(load({0x38, 0x63}).type() == CBOR_TYPE_NEGINT);
+  assert_true(load({0xF9, 0x3E, 0x00}).floating() == 1.5);
+  assert_true(load({0xF5}).boolean());
+  assert_false(load({0xF4}).boolean());
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  cbor::item text = load({0x63, 'a', 'b', 'c'});
+  assert_true(text.string() == "abc");
+  assert_ptr_equal(text.string().data(), cbor_string_handle(text.get()));
+
+  cbor::item bytes = load({0x42, 0x01, 0xFF});
+  cbor::byte_view view = bytes.bytes();
+  assert_int_equal(view.size(), 2);
+  assert_ptr_equal(view.data(), cbor_bytestring_handle(bytes.get()));
+  assert_int_equal(view[1], 0xFF);
+  assert_true(std::equal(view.begin(), view.end(),
+                         std::vector<unsigned char>{0x01, 0xFF}.begin()));
+  assert_true(load({0x40}).bytes().empty());
+
+  cbor::item chunked = load({0x7F, 0x61, 'a', 0x62, 'b', 'c', 0xFF});
+  std::string joined;
+  for (cbor::item_view chunk : chunked.chunks()) joined += chunk.string();
+  assert_string_equal(joined.c_str(), "abc");
+
+  cbor::item byte_chunks = load({0x5F, 0x41, 0x01, 0xFF});
+  assert_int_equal(byte_chunks.chunks().size(), 1);
+  assert_int_equal(byte_chunks.chunks()[0].bytes()[0], 0x01);
+}
+
+static void test_array(void** _state _CBOR_UNUSED) {
+  cbor::item array = load({0x83, 0x01, 0x02, 0x03});
+  uint64_t sum = 0;
+  for (cbor::item_view value : array.array()) {
+    // Iteration does not take references
+    assert_int_equal(cbor_refcount(value.get()), 1);
+    sum += value.uint();
+  }
+  assert_int_equal(sum, 6);
+
+  auto items = array.array();
+  assert_int_equal(items.size(), 3);
+  assert_int_equal(std::distance(items.begin(), items.end()), 3);
+  assert_int_equal(items[2].uint(), 3);
+  assert_int_equal((*(items.end() - 1)).uint(), 3);
+  assert_true(load({0x80}).array().empty());
+
+  // Items stay alive while shared, even after the array is gone
+  cbor::item second = items[1].share();
+  array.reset();
+  assert_int_equal(cbor_refcount(second.get()), 1);
+  assert_int_equal(second.uint(), 2);
+
+  // Nested containers
+  cbor::item nested = load({0x82, 0x80, 0x81, 0x61, 'x'});
+  assert_true(nested.array()[1].array()[0].string() == "x");
+}
+
+static void test_map(void** _state _CBOR_UNUSED) {
+  cbor::item map = load({0xA2, 0x61, 'a', 0x01, 0x61, 'b', 0x02});
+  std::string keys;
+  uint64_t sum = 0;
+  for (auto [key, value] : map.map()) {
+    keys += key.string();
+    sum += value.uint();
+  }
+  assert_string_equal(keys.c_str(), "ab");
+  assert_int_equal(sum, 3);
+  assert_int_equal(map.map().size(), 2);
+  assert_int_equal(map.map()[1].second.uint(), 2);
+
+  cbor::item indefinite = load({0xBF, 0x01, 0x02, 0xFF});
+  assert_int_equal((*indefinite.map().begin()).first.uint(), 1);
+}
+
+static void test_tag(void** _state _CBOR_UNUSED) {
+  cbor::item tag = load({0xC1, 0x1A, 0x51, 0x4B, 0x67, 0xB0});
+  assert_true(tag.type() == CBOR_TYPE_TAG);
+  assert_int_equal(tag.tag(), 1);
+  cbor::item tagged = tag.tagged();
+  assert_int_equal(cbor_refcount(tagged.get()), 2);
+  assert_int_equal(tagged.uint(), 1363896240);
+  tag.reset();
+  assert_int_equal(cbor_refcount(tagged.get()), 1);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_ownership),
+      cmocka_unit_test(test_scalars),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_array),
+      cmocka_unit_test(test_map),
+      cmocka_unit_test(test_tag),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// Headers needed by cmocka -- must be imported first
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmocka.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cbor.hpp"
+
+using bytes = std::vector<unsigned char>;
+
+/* Records every event, with the same format as the C callbacks below */
+struct recorder {
+  std::string log;
+
+  void add(const char* event) { log += std::string(event) + " "; }
+  void add(const char* event, uint64_t value) {
+    log += std::string(event) + "(" + std::to_string(value) + ") ";
+  }
+
+  void uint8(uint8_t value) { add("uint8", value); }
+  void uint16(uint16_t value) { add("uint16", value); }
+  void uint32(uint32_t value) { add("uint32", value); }
+  void uint64(uint64_t value) { add("uint64", value); }
+  void negint8(uint8_t value) { add("negint8", value); }
+  void negint16(uint16_t value) { add("negint16", value); }
+  void negint32(uint32_t value) { add("negint32", value); }
+  void negint64(uint64_t value) { add("negint64", value); }
+  void byte_string(cbor_data, uint64_t length) { add("bytes", length); }
+  void byte_string_start() { add("bytes_start"); }
+  void string(cbor_data data, uint64_t length) {
+    log += "string(" + std::string(data, data + length) + ") ";
+  }
+  void string_start() { add("string_start"); }
+  void array_start(uint64_t size) { add("array", size); }
+  void indef_array_start() { add("indef_array"); }
+  void map_start(uint64_t size) { add("map", size); }
+  void indef_map_start() { add("indef_map"); }
+  void tag(uint64_t value) { add("tag", value); }
+  void float2(float value) { add("float2", static_cast<uint64_t>(value)); }
+  void float4(float value) { add("float4", static_cast<uint64_t>(value)); }
+  void float8(double value) { add("float8", static_cast<uint64_t>(value)); }
+  void undefined() { add("undefined"); }
+  void null() { add("null"); }
+  void boolean(bool value) { add("bool", value); }
+  void indef_break() { add("break"); }
+};
+
+#define RECORD(name, type, ...)                              \
+  static void record_##name(void* context, type value) {    \
+    static_cast<recorder*>(context)->name(__VA_ARGS__);      \
+  }
+
+RECORD(uint8, uint8_t, value)
+RECORD(uint16, uint16_t, value)
+RECORD(uint32, uint32_t, value)
+RECORD(uint64, uint64_t, value)
+RECORD(negint8, uint8_t, value)
+RECORD(negint16, uint16_t, value)
+RECORD(negint32, uint32_t, value)
+RECORD(negint64, uint64_t, value)
+RECORD(array_start, uint64_t, value)
+RECORD(map_start, uint64_t, value)
+RECORD(tag, uint64_t, value)
+RECORD(float2, float, value)
+RECORD(float4, float, value)
+RECORD(float8, double, value)
+RECORD(boolean, bool, value)
+
+#define RECORD_SIMPLE(name)                               \
+  static void record_##name(void* context) {              \
+    static_cast<recorder*>(context)->name();              \
+  }
+
+RECORD_SIMPLE(byte_string_start)
+RECORD_SIMPLE(string_start)
+RECORD_SIMPLE(indef_array_start)
+RECORD_SIMPLE(indef_map_start)
+RECORD_SIMPLE(undefined)
+RECORD_SIMPLE(null)
+RECORD_SIMPLE(indef_break)
+
+static void record_byte_string(void* context, cbor_data data,
+                               uint64_t length) {
+  static_cast<recorder*>(context)->byte_string(data, length);
+}
+
+static void record_string(void* context, cbor_data data, uint64_t length) {
+  static_cast<recorder*>(context)->string(data, length);
+}
+
+static struct cbor_callbacks recording_callbacks() {
+  struct cbor_callbacks callbacks = cbor_empty_callbacks;
+  callbacks.uint8 = record_uint8;
+  callbacks.uint16 = record_uint16;
+  callbacks.uint32 = record_uint32;
+  callbacks.uint64 = record_uint64;
+  callbacks.negint8 = record_negint8;
+  callbacks.negint16 = record_negint16;
+  callbacks.negint32 = record_negint32;
+  callbacks.negint64 = record_negint64;
+  callbacks.byte_string = record_byte_string;
+  callbacks.byte_string_start = record_byte_string_start;
+  callbacks.string = record_string;
+  callbacks.string_start = record_string_start;
+  callbacks.array_start = record_array_start;
+  callbacks.indef_array_start = record_indef_array_start;
+  callbacks.map_start = record_map_start;
+  callbacks.indef_map_start = record_indef_map_start;
+  callbacks.tag = record_tag;
+  callbacks.float2 = record_float2;
+  callbacks.float4 = record_float4;
+  callbacks.float8 = record_float8;
+  callbacks.undefined = record_undefined;
+  callbacks.null = record_null;
+  callbacks.boolean = record_boolean;
+  callbacks.indef_break = record_indef_break;
+  return callbacks;
+}
+
+static struct cbor_load_result parse(const bytes& data, recorder& handler) {
+  return cbor::parse(data.data(), data.size(), handler);
+}
+
+/* The events are the same as those of cbor_stream_decode */
+static void assert_same_events(const bytes& data) {
+  recorder parsed;
+  struct cbor_load_result result = parse(data, parsed);
+  assert_int_equal(result.error.code, CBOR_ERR_NONE);
+  assert_int_equal(result.read, data.size());
+
+  recorder streamed;
+  const struct cbor_callbacks callbacks = recording_callbacks();
+  for (size_t offset = 0; offset < data.size();) {
+    struct cbor_decoder_result decoded = cbor_stream_decode(
+        data.data() + offset, data.size() - offset, &callbacks, &streamed);
+    assert_int_equal(decoded.status, CBOR_DECODER_FINISHED);
+    offset += decoded.read;
+  }
+  assert_string_equal(parsed.log.c_str(), streamed.log.c_str());
+}
+
+static void test_events(void** _state _CBOR_UNUSED) {
+  assert_same_events({0x17});
+  assert_same_events({0x18, 0xFF});
+  assert_same_events({0x19, 0x01, 0x00});
+  assert_same_events({0x1A, 0x00, 0x01, 0x11, 0x70});
+  assert_same_events({0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00});
+  assert_same_events({0x20});
+  assert_same_events({0x38, 0xFF});
+  assert_same_events({0x39, 0x01, 0x00});
+  assert_same_events({0x3A, 0x00, 0x01, 0x11, 0x70});
+  assert_same_events({0x3B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00});
+  assert_same_events({0x43, 0x01, 0x02, 0x03});
+  assert_same_events({0x5F, 0x41, 0x01, 0x40, 0xFF});
+  assert_same_events({0x78, 0x02, 'h', 'i'});
+  assert_same_events({0x7F, 0x61, 'a', 0x62, 'b', 'c', 0xFF});
+  assert_same_events({0x83, 0x01, 0x80, 0x82, 0x02, 0x03});
+  assert_same_events({0x9F, 0x01, 0x9F, 0xFF, 0xFF});
+  assert_same_events({0xA2, 0x01, 0xA0, 0x61, 'k', 0xF6});
+  assert_same_events({0xBF, 0x01, 0xBF, 0xFF, 0xFF});
+  assert_same_events({0xC1, 0xD8, 0x20, 0x1A, 0x51, 0x4B, 0x67, 0xB0});
+  assert_same_events({0xF9, 0x3C, 0x00});
+  assert_same_events({0xFA, 0x47, 0xC3, 0x50, 0x00});
+  assert_same_events({0xFB, 0x40, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
+  assert_same_events({0x84, 0xF4, 0xF5, 0xF6, 0xF7});
+}
+
+/* Only unsigned integers, but of all widths */
+struct sum {
+  uint64_t total = 0;
+  void uint64(uint64_t value) { total += value; }
+};
+
+/* Narrow floats go to the narrowest declared member */
+struct floats {
+  std::vector<double> values;
+  int narrow = 0;
+  void float4(float value) {
+    values.push_back(value);
+    narrow++;
+  }
+  void float8(double value) { values.push_back(value); }
+};
+
+static void test_partial_handlers(void** _state _CBOR_UNUSED) {
+  bytes data = {0x84, 0x01, 0x18, 0xFF, 0x39, 0x01, 0x00,
+                0x1A, 0x00, 0x01, 0x00, 0x00};
+  sum total;
+  struct cbor_load_result result =
+      cbor::parse(data.data(), data.size(), total);
+  assert_int_equal(result.error.code, CBOR_ERR_NONE);
+  assert_int_equal(total.total, 1 + 255 + 65536);
+
+  data = {0x83, 0xF9, 0x3C, 0x00, 0xFA, 0x3F, 0xC0, 0x00, 0x00, 0xFB,
+          0x40, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  floats values;
+  result = cbor::parse(data.data(), data.size(), values);
+  assert_int_equal(result.error.code, CBOR_ERR_NONE);
+  assert_true(values.values == (std::vector<double>{1.0, 1.5, 3.125}));
+  assert_int_equal(values.narrow, 2);
+
+  // An empty handler only validates
+  struct {
+  } nothing;
+  result = cbor::parse(data.data(), data.size(), nothing);
+  assert_int_equal(result.read, data.size());
+}
+
+/* Decodes a map of text strings to unsigned integers */
+struct counters {
+  std::unordered_map<std::string, uint64_t> values;
+  std::string key;
+  void string(cbor_data data, uint64_t length) {
+    key.assign(reinterpret_cast<const char*>(data),
+               static_cast<size_t>(length));
+  }
+  void uint64(uint64_t value) { values[key] = value; }
+};
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  bytes data = {0xA2, 0x61, 'a', 0x01, 0x62, 'b', 'c', 0x19, 0x01, 0x00};
+  counters map;
+  assert_int_equal(cbor::parse(data.data(), data.size(), map).read,
+                   data.size());
+  assert_int_equal(map.values.size(), 2);
+  assert_int_equal(map.values["a"], 1);
+  assert_int_equal(map.values["bc"], 256);
+
+  // Only the first item is decoded
+  data = {0x81, 0x01, 0x02};
+  sum total;
+  struct cbor_load_result result =
+      cbor::parse(data.data(), data.size(), total);
+  assert_int_equal(result.read, 2);
+  assert_int_equal(total.total, 1);
+}
+
+static void assert_error(const bytes& data, cbor_error_code code,
+                         size_t position) {
+  recorder handler;
+  struct cbor_load_result result = parse(data, handler);
+  assert_int_equal(result.error.code, code);
+  assert_int_equal(result.error.position, position);
+
+  // cbor_load agrees, although it may report a later position
+  struct cbor_load_result loaded;
+  cbor_item_t* item = cbor_load(data.data(), data.size(), &loaded);
+  assert_null(item);
+  assert_int_equal(loaded.error.code, code);
+}
+
+static void test_errors(void** _state _CBOR_UNUSED) {
+  assert_error({}, CBOR_ERR_NODATA, 0);
+  assert_error({0x19, 0x01}, CBOR_ERR_NOTENOUGHDATA, 0);
+  assert_error({0x82, 0x01, 0x61}, CBOR_ERR_NOTENOUGHDATA, 2);
+  assert_error({0x9F, 0x01}, CBOR_ERR_NOTENOUGHDATA, 2);
+  assert_error({0x63, 'a', 'b'}, CBOR_ERR_NOTENOUGHDATA, 0);
+  assert_error({0x81, 0x1C}, CBOR_ERR_MALFORMATED, 1);
+  assert_error({0x81, 0xF8, 0x20}, CBOR_ERR_MALFORMATED, 1);
+  assert_error({0xFF}, CBOR_ERR_SYNTAXERROR, 0);
+  assert_error({0x81, 0xFF}, CBOR_ERR_SYNTAXERROR, 1);
+  assert_error({0xC1, 0xFF}, CBOR_ERR_SYNTAXERROR, 1);
+  assert_error({0xBF, 0x01, 0xFF}, CBOR_ERR_SYNTAXERROR, 2);
+  assert_error({0x7F, 0x41, 'a', 0xFF}, CBOR_ERR_SYNTAXERROR, 1);
+  assert_error({0x5F, 0x5F, 0xFF, 0xFF}, CBOR_ERR_SYNTAXERROR, 1);
+
+  // The handler does not see the offending event
+  recorder handler;
+  bytes data = {0x9F, 0x01, 0xA1, 0xFF, 0x01};
+  assert_int_equal(parse(data, handler).error.code, CBOR_ERR_SYNTAXERROR);
+  assert_string_equal(handler.log.c_str(), "indef_array uint8(1) map(1) ");
+
+  // Containers cannot claim more items than there are bytes
+  assert_error({0x82, 0x01}, CBOR_ERR_NOTENOUGHDATA, 0);
+  assert_error({0xA1, 0x01}, CBOR_ERR_NOTENOUGHDATA, 0);
+  data = {0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+  assert_int_equal(parse(data, handler).error.code, CBOR_ERR_NOTENOUGHDATA);
+}
+
+static void test_nesting(void** _state _CBOR_UNUSED) {
+  bytes data(CBOR_MAX_STACK_SIZE, 0x81);
+  data.push_back(0x01);
+  sum total;
+  struct cbor_load_result result =
+      cbor::parse(data.data(), data.size(), total);
+  assert_int_equal(result.error.code, CBOR_ERR_NONE);
+  assert_int_equal(result.read, data.size());
+  assert_int_equal(total.total, 1);
+
+  data.insert(data.begin(), 0x81);
+  result = cbor::parse(data.data(), data.size(), total);
+  assert_int_equal(result.error.code, CBOR_ERR_MEMERROR);
+  assert_int_equal(result.error.position, CBOR_MAX_STACK_SIZE);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_events),
+      cmocka_unit_test(test_partial_handlers),
+      cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_errors),
+      cmocka_unit_test(test_nesting),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
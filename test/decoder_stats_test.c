@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+
+static void test_disabled(void** _state _CBOR_UNUSED) {
+#if !CBOR_DECODER_STATS
+  struct cbor_decoder_stats stats;
+  memset(&stats, 0xFF, sizeof(stats));
+  assert_false(cbor_decoder_stats_get(&stats));
+  assert_size_equal(stats.bytes, 0);
+  assert_size_equal(stats.loads, 0);
+  cbor_decoder_stats_reset();
+#endif
+}
+
+#if CBOR_DECODER_STATS
+
+static struct cbor_decoder_stats stats_now(void) {
+  struct cbor_decoder_stats stats;
+  assert_true(cbor_decoder_stats_get(&stats));
+  return stats;
+}
+
+static struct cbor_decoder_result decode(cbor_data source,
+                                         size_t source_size) {
+  return cbor_stream_decode(source, source_size, &cbor_empty_callbacks, NULL);
+}
+
+static void test_stream_decode(void** _state _CBOR_UNUSED) {
+  cbor_decoder_stats_reset();
+
+  // 1000, -1, "a"
+  unsigned char data[] = {0x19, 0x03, 0xE8, 0x20, 0x61, 0x61};
+  assert_decoder_result(3, CBOR_DECODER_FINISHED,
+                        decode(data, sizeof(data)));
+  assert_decoder_result(1, CBOR_DECODER_FINISHED,
+                        decode(data + 3, sizeof(data) - 3));
+  assert_decoder_result(2, CBOR_DECODER_FINISHED,
+                        decode(data + 4, sizeof(data) - 4));
+  // Incomplete items are not counted
+  assert_decoder_result_nedata(3, decode(data, 2));
+
+  struct cbor_decoder_stats stats = stats_now();
+  assert_size_equal(stats.items[CBOR_TYPE_UINT], 1);
+  assert_size_equal(stats.items[CBOR_TYPE_NEGINT], 1);
+  assert_size_equal(stats.items[CBOR_TYPE_STRING], 1);
+  assert_size_equal(stats.bytes, 6);
+  assert_size_equal(stats.loads, 0);
+}
+
+static void test_load(void** _state _CBOR_UNUSED) {
+  cbor_decoder_stats_reset();
+
+  // [[1], {2: [3]}]
+  unsigned char data[] = {0x82, 0x81, 0x01, 0xA1, 0x02, 0x81, 0x03};
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(data, sizeof(data), &result);
+  assert_non_null(item);
+  cbor_decref(&item);
+
+  struct cbor_decoder_stats stats = stats_now();
+  assert_size_equal(stats.items[CBOR_TYPE_ARRAY], 3);
+  assert_size_equal(stats.items[CBOR_TYPE_MAP], 1);
+  assert_size_equal(stats.items[CBOR_TYPE_UINT], 3);
+  assert_size_equal(stats.bytes, sizeof(data));
+  assert_size_equal(stats.loads, 1);
+  assert_size_equal(stats.failed_loads, 0);
+  assert_size_equal(stats.max_depth, 3);
+  assert_true(stats.load_time_ns >= stats.max_load_time_ns);
+  assert_true(stats.max_load_time_ns >= stats.last_load_time_ns);
+}
+
+static void test_failed_load(void** _state _CBOR_UNUSED) {
+  cbor_decoder_stats_reset();
+
+  unsigned char data[] = {0x82, 0x01};
+  struct cbor_load_result result;
+  assert_null(cbor_load(data, sizeof(data), &result));
+  assert_null(cbor_load(data, 0, &result));
+
+  struct cbor_decoder_stats stats = stats_now();
+  assert_size_equal(stats.loads, 2);
+  assert_size_equal(stats.failed_loads, 2);
+  assert_size_equal(stats.max_depth, 1);
+}
+
+static void test_reset(void** _state _CBOR_UNUSED) {
+  unsigned char data[] = {0x01};
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(data, sizeof(data), &result);
+  cbor_decref(&item);
+
+  cbor_decoder_stats_reset();
+  struct cbor_decoder_stats stats = stats_now();
+  assert_size_equal(stats.items[CBOR_TYPE_UINT], 0);
+  assert_size_equal(stats.bytes, 0);
+  assert_size_equal(stats.loads, 0);
+  assert_true(stats.load_time_ns == 0);
+}
+
+#endif  // CBOR_DECODER_STATS
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_disabled),
+#if CBOR_DECODER_STATS
+      cmocka_unit_test(test_stream_decode),
+      cmocka_unit_test(test_load),
+      cmocka_unit_test(test_failed_load),
+      cmocka_unit_test(test_reset),
+#endif
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+static char output[1024];
+
+static void assert_diag_result(struct cbor_diag_result result,
+                               const char* expected, bool truncated) {
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  assert_size_equal(result.length, strlen(expected));
+  assert_string_equal(output, expected);
+  assert_true(result.truncated == truncated);
+}
+
+/* Check both the conversion of the encoded item and of the decoded tree */
+static void assert_diag_with_options(cbor_data data, size_t length,
+                                     const struct cbor_diag_options* options,
+                                     size_t buffer_size, const char* expected,
+                                     bool truncated) {
+  struct cbor_diag_result result =
+      cbor_diag_bytes(data, length, output, buffer_size, options);
+  assert_diag_result(result, expected, truncated);
+  if (!truncated || result.length + 1 < buffer_size)
+    assert_size_equal(result.read, length);
+
+  struct cbor_load_result load_result;
+  cbor_item_t* item = cbor_load(data, length, &load_result);
+  assert_non_null(item);
+  result = cbor_diag(item, output, buffer_size, options);
+  assert_diag_result(result, expected, truncated);
+  assert_size_equal(result.read, 0);
+  cbor_decref(&item);
+}
+
+#define BYTES(...) (cbor_data)(unsigned char[]){__VA_ARGS__}, \
+                   sizeof((unsigned char[]){__VA_ARGS__})
+
+#define ASSERT_DIAG(expected, ...)                                   \
+  assert_diag_with_options(BYTES(__VA_ARGS__), NULL, sizeof(output), \
+                           expected, false)
+
+static void test_ints(void** _state _CBOR_UNUSED) {
+  ASSERT_DIAG("0", 0x00);
+  ASSERT_DIAG("1000", 0x19, 0x03, 0xE8);
+  ASSERT_DIAG("18446744073709551615", 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+  ASSERT_DIAG("-1", 0x20);
+  ASSERT_DIAG("-18446744073709551616", 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+}
+
+static void test_floats_ctrls(void** _state _CBOR_UNUSED) {
+  ASSERT_DIAG("1.0", 0xF9, 0x3C, 0x00);
+  ASSERT_DIAG("-0.0", 0xF9, 0x80, 0x00);
+  ASSERT_DIAG("100000.0", 0xFA, 0x47, 0xC3, 0x50, 0x00);
+  ASSERT_DIAG("1.1", 0xFB, 0x3F, 0xF1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A);
+  ASSERT_DIAG("1e+300", 0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75,
+              0x9C);
+  ASSERT_DIAG("NaN", 0xF9, 0x7E, 0x00);
+  ASSERT_DIAG("Infinity", 0xF9, 0x7C, 0x00);
+  ASSERT_DIAG("-Infinity", 0xFA, 0xFF, 0x80, 0x00, 0x00);
+  ASSERT_DIAG("[false, true, null, undefined]", 0x84, 0xF4, 0xF5, 0xF6, 0xF7);
+
+  // Unassigned simple values can only be built, not decoded
+  cbor_item_t* item = cbor_build_ctrl(16);
+  struct cbor_diag_result result =
+      cbor_diag(item, output, sizeof(output), NULL);
+  assert_diag_result(result, "simple(16)", false);
+  cbor_decref(&item);
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  ASSERT_DIAG("\"\"", 0x60);
+  ASSERT_DIAG("\"a\\\"\\n\\u0001\xC3\xA1\"", 0x66, 'a', '"', '\n', 0x01,
+              0xC3, 0xA1);
+  ASSERT_DIAG("h''", 0x40);
+  ASSERT_DIAG("h'0109ff'", 0x43, 0x01, 0x09, 0xFF);
+  ASSERT_DIAG("(_ h'01', h'0203')", 0x5F, 0x41, 0x01, 0x42, 0x02, 0x03, 0xFF);
+  ASSERT_DIAG("(_ \"a\", \"\", \"b\")", 0x7F, 0x61, 'a', 0x60, 0x61, 'b',
+              0xFF);
+  ASSERT_DIAG("''_", 0x5F, 0xFF);
+  ASSERT_DIAG("\"\"_", 0x7F, 0xFF);
+}
+
+static void test_long_string(void** _state _CBOR_UNUSED) {
+  unsigned char data[3 + 299] = {0x59, 0x01, 0x2B};
+  memset(data + 3, 0xAB, 299);
+  char expected[2 + 2 * 299 + 2] = "h'";
+  for (size_t i = 0; i < 299; i++) memcpy(expected + 2 + 2 * i, "ab", 2);
+  memcpy(expected + 2 + 2 * 299, "'", 2);
+  assert_diag_with_options(data, sizeof(data), NULL, sizeof(output), expected,
+                           false);
+}
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  ASSERT_DIAG("[]", 0x80);
+  ASSERT_DIAG("{}", 0xA0);
+  ASSERT_DIAG("[_ ]", 0x9F, 0xFF);
+  ASSERT_DIAG("{_ }", 0xBF, 0xFF);
+  ASSERT_DIAG("[1, [2, 3], [_ 4, 5]]", 0x83, 0x01, 0x82, 0x02, 0x03, 0x9F,
+              0x04, 0x05, 0xFF);
+  ASSERT_DIAG("{\"a\": 1, \"b\": [2, 3]}", 0xA2, 0x61, 'a', 0x01, 0x61, 'b',
+              0x82, 0x02, 0x03);
+  ASSERT_DIAG("{_ \"a\": {}, [1]: 2}", 0xBF, 0x61, 'a', 0xA0, 0x81, 0x01,
+              0x02, 0xFF);
+  ASSERT_DIAG("1(1363896240)", 0xC1, 0x1A, 0x51, 0x4B, 0x67, 0xB0);
+  ASSERT_DIAG("[24(h'6449455446'), 32(\"x\"), 1(2(3))]", 0x83, 0xD8, 0x18,
+              0x45, 0x64, 0x49, 0x45, 0x54, 0x46, 0xD8, 0x20, 0x61, 'x', 0xC1,
+              0xC2, 0x03);
+}
+
+static void test_max_depth(void** _state _CBOR_UNUSED) {
+  // [1, [2, [3]], {"a": {}}, 1([]), []]
+  unsigned char data[] = {0x85, 0x01, 0x82, 0x02, 0x81, 0x03, 0xA1,
+                          0x61, 'a',  0xA0, 0xC1, 0x80, 0x80};
+  struct cbor_diag_options options = {.max_depth = 1};
+  assert_diag_with_options(data, sizeof(data), &options, sizeof(output),
+                           "[1, [...], {...}, 1(...), []]", true);
+  options.max_depth = 2;
+  assert_diag_with_options(data, sizeof(data), &options, sizeof(output),
+                           "[1, [2, [...]], {\"a\": {}}, 1([]), []]", true);
+  options.max_depth = 3;
+  assert_diag_with_options(data, sizeof(data), &options, sizeof(output),
+                           "[1, [2, [3]], {\"a\": {}}, 1([]), []]", false);
+
+  // Elided items are decoded to find their end
+  unsigned char indefinite[] = {0x82, 0x9F, 0x5F, 0x41, 0x01, 0xFF,
+                                0xBF, 0xFF, 0xFF, 0x02};
+  options.max_depth = 1;
+  assert_diag_with_options(indefinite, sizeof(indefinite), &options,
+                           sizeof(output), "[[_ ...], 2]", true);
+}
+
+static void test_max_string_length(void** _state _CBOR_UNUSED) {
+  struct cbor_diag_options options = {.max_string_length = 3};
+  assert_diag_with_options(BYTES(0x66, 'a', 'b', 'c', 'd', 'e', 'f'),
+                           &options, sizeof(output), "\"abc\"...", true);
+  assert_diag_with_options(BYTES(0x63, 'a', 'b', 'c'), &options,
+                           sizeof(output), "\"abc\"", false);
+  // Code points are not split
+  assert_diag_with_options(BYTES(0x64, 'a', 'b', 0xC3, 0xA1), &options,
+                           sizeof(output), "\"ab\"...", true);
+  assert_diag_with_options(BYTES(0x44, 0x01, 0x02, 0x03, 0x04), &options,
+                           sizeof(output), "h'010203'...", true);
+  assert_diag_with_options(
+      BYTES(0x5F, 0x44, 0x01, 0x02, 0x03, 0x04, 0x41, 0x05, 0xFF), &options,
+      sizeof(output), "(_ h'010203'..., h'05')", true);
+}
+
+static void test_small_buffer(void** _state _CBOR_UNUSED) {
+  assert_diag_with_options(BYTES(0x85, 0x01, 0x02, 0x03, 0x04, 0x05), NULL,
+                           10, "[1, 2,...", true);
+  assert_diag_with_options(BYTES(0x85, 0x01, 0x02, 0x03, 0x04, 0x05), NULL,
+                           16, "[1, 2, 3, 4, 5]", false);
+  assert_diag_with_options(BYTES(0x85, 0x01, 0x02, 0x03, 0x04, 0x05), NULL,
+                           15, "[1, 2, 3, 4...", true);
+  // The marker does not split code points
+  assert_diag_with_options(BYTES(0x66, 0xC3, 0xA9, 0xC3, 0xA9, 0xC3, 0xA9),
+                           NULL, 8, "\"\xC3\xA9...", true);
+  assert_diag_with_options(BYTES(0x82, 0x01, 0x02), NULL, 3, "..", true);
+  assert_diag_with_options(BYTES(0x82, 0x01, 0x02), NULL, 1, "", true);
+
+  // Nothing is written to an empty buffer
+  output[0] = 'x';
+  struct cbor_diag_result result =
+      cbor_diag_bytes(BYTES(0x01), output, 0, NULL);
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  assert_size_equal(result.length, 0);
+  assert_true(result.truncated);
+  assert_true(output[0] == 'x');
+}
+
+static void assert_diag_error(cbor_data data, size_t length,
+                              cbor_diag_error_code error,
+                              const char* expected) {
+  struct cbor_diag_result result =
+      cbor_diag_bytes(data, length, output, sizeof(output), NULL);
+  assert_true(result.error == error);
+  assert_string_equal(output, expected);
+}
+
+static void test_errors(void** _state _CBOR_UNUSED) {
+  assert_diag_error(BYTES(0x83, 0x01, 0x02), CBOR_DIAG_ERR_NOTENOUGHDATA,
+                    "[1, 2");
+  assert_diag_error(BYTES(0x62, 'a'), CBOR_DIAG_ERR_NOTENOUGHDATA, "");
+  assert_diag_error(BYTES(0xFF), CBOR_DIAG_ERR_MALFORMED, "");
+  assert_diag_error(BYTES(0x82, 0x01, 0xFF), CBOR_DIAG_ERR_MALFORMED, "[1");
+  assert_diag_error(BYTES(0xBF, 0x01, 0xFF), CBOR_DIAG_ERR_MALFORMED, "{_ 1");
+  assert_diag_error(BYTES(0x5F, 0x61, 'a', 0xFF), CBOR_DIAG_ERR_MALFORMED,
+                    "");
+  assert_diag_error(BYTES(0x7F, 0x80, 0xFF), CBOR_DIAG_ERR_MALFORMED, "");
+  assert_diag_error(BYTES(0x81, 0xF0), CBOR_DIAG_ERR_MALFORMED, "[");
+}
+
+static void test_sequence(void** _state _CBOR_UNUSED) {
+  struct cbor_diag_result result =
+      cbor_diag_bytes(BYTES(0x81, 0x01, 0x02), output, sizeof(output), NULL);
+  assert_diag_result(result, "[1]", false);
+  assert_size_equal(result.read, 2);
+}
+
+static void test_built_items(void** _state _CBOR_UNUSED) {
+  cbor_item_t* array = cbor_new_indefinite_array();
+  cbor_item_t* string = cbor_new_indefinite_string();
+  assert_true(cbor_string_add_chunk(string, cbor_move(cbor_build_string("a"))));
+  assert_true(cbor_array_push(array, cbor_move(string)));
+  assert_true(cbor_array_push(array, cbor_move(cbor_build_float8(0.5))));
+  cbor_item_t* map = cbor_new_definite_map(1);
+  assert_true(cbor_map_add(
+      map, (struct cbor_pair){.key = cbor_move(cbor_build_negint8(9)),
+                              .value = cbor_move(cbor_build_bool(true))}));
+  assert_true(cbor_array_push(array, cbor_move(map)));
+  // A definite array with space for more items
+  cbor_item_t* partial = cbor_new_definite_array(4);
+  assert_true(cbor_array_push(partial, cbor_move(cbor_build_uint8(1))));
+  assert_true(cbor_array_push(array, cbor_move(partial)));
+
+  struct cbor_diag_result result =
+      cbor_diag(array, output, sizeof(output), NULL);
+  assert_diag_result(result, "[_ (_ \"a\"), 0.5, {-10: true}, [1]]", false);
+  cbor_decref(&array);
+}
+
+static void test_deep_nesting(void** _state _CBOR_UNUSED) {
+  unsigned char data[CBOR_MAX_STACK_SIZE + 1];
+  memset(data, 0x81, CBOR_MAX_STACK_SIZE);
+  data[CBOR_MAX_STACK_SIZE] = 0x00;
+  struct cbor_diag_result result =
+      cbor_diag_bytes(data, sizeof(data), output, sizeof(output), NULL);
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  assert_true(result.truncated);
+  assert_size_equal(result.length, sizeof(output) - 1);
+
+  struct cbor_diag_options options = {.max_depth = 2};
+  result = cbor_diag_bytes(data, sizeof(data), output, sizeof(output),
+                           &options);
+  assert_diag_result(result, "[[[...]]]", true);
+  assert_size_equal(result.read, sizeof(data));
+
+  unsigned char deeper[CBOR_MAX_STACK_SIZE + 2];
+  memset(deeper, 0x81, CBOR_MAX_STACK_SIZE + 1);
+  deeper[CBOR_MAX_STACK_SIZE + 1] = 0x00;
+  result = cbor_diag_bytes(deeper, sizeof(deeper), output, sizeof(output),
+                           &options);
+  assert_true(result.error == CBOR_DIAG_ERR_MEMERROR);
+
+  // The first 16 levels do not allocate
+  WITH_FAILING_MALLOC({
+    result = cbor_diag_bytes(data + CBOR_MAX_STACK_SIZE - 17, 18, output,
+                             sizeof(output), NULL);
+    assert_true(result.error == CBOR_DIAG_ERR_MEMERROR);
+  });
+  result = cbor_diag_bytes(data + CBOR_MAX_STACK_SIZE - 16, 17, output,
+                           sizeof(output), NULL);
+  assert_true(result.error == CBOR_DIAG_ERR_NONE);
+  assert_size_equal(result.length, 16 + 1 + 16);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_ints),
+      cmocka_unit_test(test_floats_ctrls),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_long_string),
+      cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_max_depth),
+      cmocka_unit_test(test_max_string_length),
+      cmocka_unit_test(test_small_buffer),
+      cmocka_unit_test(test_errors),
+      cmocka_unit_test(test_sequence),
+      cmocka_unit_test(test_built_items),
+      cmocka_unit_test(test_deep_nesting),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <math.h>
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+#define RELAXED (CBOR_EQUAL_IGNORE_DEFINITENESS | CBOR_EQUAL_IGNORE_MAP_ORDER)
+
+static cbor_item_t* load(cbor_data data, size_t length) {
+  struct cbor_load_result result;
+  cbor_item_t* item = cbor_load(data, length, &result);
+  assert_non_null(item);
+  return item;
+}
+
+#define LOAD(...)                                       \
+  load((cbor_data)(unsigned char[]){__VA_ARGS__},       \
+       sizeof((unsigned char[]){__VA_ARGS__}))
+
+// Checks the (in)equality under all options and hash consistency
+static void assert_equality(cbor_item_t* a, cbor_item_t* b, bool strict,
+                            bool definiteness, bool map_order) {
+  assert_true(cbor_equal(a, b) == strict);
+  assert_true(cbor_equal(b, a) == strict);
+  assert_true(cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_DEFINITENESS) ==
+              definiteness);
+  assert_true(cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER) ==
+              map_order);
+  bool relaxed = cbor_equal_with_options(a, b, RELAXED);
+  assert_true(relaxed == cbor_equal_with_options(b, a, RELAXED));
+  if (relaxed) assert_true(cbor_hash(a, 42) == cbor_hash(b, 42));
+  cbor_decref(&a);
+  cbor_decref(&b);
+}
+
+static void assert_different(cbor_item_t* a, cbor_item_t* b) {
+  assert_false(cbor_equal_with_options(a, b, RELAXED));
+  assert_true(cbor_hash(a, 0) != cbor_hash(b, 0));
+  cbor_decref(&a);
+  cbor_decref(&b);
+}
+
+static void test_identity(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_float8(NAN);
+  assert_true(cbor_equal(item, item));
+  cbor_decref(&item);
+}
+
+static void test_ints(void** _state _CBOR_UNUSED) {
+  assert_equality(cbor_build_uint8(1), cbor_build_uint8(1), true, true, true);
+  assert_equality(cbor_build_uint8(1), cbor_build_uint16(1), false, false,
+                  false);
+  assert_different(cbor_build_uint8(1), cbor_build_uint8(2));
+  assert_different(cbor_build_uint8(1), cbor_build_negint8(1));
+  assert_different(cbor_build_uint8(0), cbor_build_bool(false));
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  assert_equality(LOAD(0x63, 'a', 'b', 'c'), cbor_build_string("abc"), true,
+                  true, true);
+  // "abc" and (_ "a", "bc")
+  assert_equality(LOAD(0x63, 'a', 'b', 'c'),
+                  LOAD(0x7F, 0x61, 'a', 0x62, 'b', 'c', 0xFF), false, true,
+                  false);
+  // (_ "ab", "c") and (_ "a", "", "bc")
+  assert_equality(LOAD(0x7F, 0x62, 'a', 'b', 0x61, 'c', 0xFF),
+                  LOAD(0x7F, 0x61, 'a', 0x60, 0x62, 'b', 'c', 0xFF), false,
+                  true, false);
+  assert_equality(LOAD(0x7F, 0x61, 'a', 0x61, 'b', 0xFF),
+                  LOAD(0x7F, 0x61, 'a', 0x61, 'b', 0xFF), true, true, true);
+  assert_different(cbor_build_string("abc"), cbor_build_string("abd"));
+  assert_different(cbor_build_string("abc"), cbor_build_string("ab"));
+  assert_different(LOAD(0x7F, 0x61, 'a', 0xFF), LOAD(0x7F, 0xFF));
+  assert_different(cbor_build_string("a"),
+                   cbor_build_bytestring((cbor_data) "a", 1));
+}
+
+static void test_long_strings(void** _state _CBOR_UNUSED) {
+  // Chunks that do not align with words
+  unsigned char data[] = {0x5F, 0x43, 1, 2,  3,  0x4A, 4, 5, 6, 7, 8, 9,
+                          10,   11,   12, 13, 0x41, 14,  0xFF};
+  cbor_item_t* chunked = load(data, sizeof(data));
+  unsigned char contents[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+  cbor_item_t* definite = cbor_build_bytestring(contents, sizeof(contents));
+  assert_equality(chunked, definite, false, true, false);
+
+  contents[13] = 15;
+  assert_different(load(data, sizeof(data)),
+                   cbor_build_bytestring(contents, sizeof(contents)));
+}
+
+static void test_arrays(void** _state _CBOR_UNUSED) {
+  assert_equality(LOAD(0x82, 0x01, 0x02), LOAD(0x82, 0x01, 0x02), true, true,
+                  true);
+  assert_equality(LOAD(0x82, 0x01, 0x02), LOAD(0x9F, 0x01, 0x02, 0xFF), false,
+                  true, false);
+  assert_different(LOAD(0x82, 0x01, 0x02), LOAD(0x82, 0x02, 0x01));
+  assert_different(LOAD(0x82, 0x01, 0x02), LOAD(0x81, 0x01));
+  assert_different(LOAD(0x81, 0x80), LOAD(0x81, 0xA0));
+}
+
+static void test_maps(void** _state _CBOR_UNUSED) {
+  // {1: 2, 3: 4} and {3: 4, 1: 2}
+  assert_equality(LOAD(0xA2, 0x01, 0x02, 0x03, 0x04),
+                  LOAD(0xA2, 0x03, 0x04, 0x01, 0x02), false, false, true);
+  assert_equality(LOAD(0xA2, 0x01, 0x02, 0x03, 0x04),
+                  LOAD(0xBF, 0x03, 0x04, 0x01, 0x02, 0xFF), false, false,
+                  false);
+  assert_different(LOAD(0xA2, 0x01, 0x02, 0x03, 0x04),
+                   LOAD(0xA2, 0x01, 0x04, 0x03, 0x02));
+  assert_different(LOAD(0xA1, 0x01, 0x02), LOAD(0xA1, 0x02, 0x01));
+}
+
+static void test_maps_duplicate_pairs(void** _state _CBOR_UNUSED) {
+  // {1: 1, 1: 1, 2: 2} and {2: 2, 1: 1, 1: 1}
+  assert_equality(LOAD(0xA3, 0x01, 0x01, 0x01, 0x01, 0x02, 0x02),
+                  LOAD(0xA3, 0x02, 0x02, 0x01, 0x01, 0x01, 0x01), false, false,
+                  true);
+  // {1: 1, 1: 1, 2: 2} and {1: 1, 2: 2, 2: 2}
+  assert_different(LOAD(0xA3, 0x01, 0x01, 0x01, 0x01, 0x02, 0x02),
+                   LOAD(0xA3, 0x01, 0x01, 0x02, 0x02, 0x02, 0x02));
+}
+
+static void test_nested_maps(void** _state _CBOR_UNUSED) {
+  // [{1: {2: 3, 4: 5}, 6: 7}] and [{6: 7, 1: {4: 5, 2: 3}}]
+  assert_equality(
+      LOAD(0x81, 0xA2, 0x01, 0xA2, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07),
+      LOAD(0x81, 0xA2, 0x06, 0x07, 0x01, 0xA2, 0x04, 0x05, 0x02, 0x03), false,
+      false, true);
+  // Differs in a nested value
+  assert_different(
+      LOAD(0x81, 0xA2, 0x01, 0xA2, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07),
+      LOAD(0x81, 0xA2, 0x06, 0x07, 0x01, 0xA2, 0x04, 0x05, 0x02, 0x04));
+}
+
+// {0: {0: ... {0: leaf, 1: 1} ..., 1: 1}, 1: 1}, with the pairs swapped if
+// `reversed`
+static cbor_item_t* build_deep_maps(size_t depth, uint8_t leaf,
+                                    bool reversed) {
+  cbor_item_t* item = cbor_build_uint8(leaf);
+  for (size_t i = 0; i < depth; i++) {
+    cbor_item_t* parent = cbor_new_definite_map(2);
+    struct cbor_pair nested = {cbor_move(cbor_build_uint8(0)), cbor_move(item)};
+    struct cbor_pair other = {cbor_move(cbor_build_uint8(1)),
+                              cbor_move(cbor_build_uint8(1))};
+    assert_true(cbor_map_add(parent, reversed ? other : nested));
+    assert_true(cbor_map_add(parent, reversed ? nested : other));
+    item = parent;
+  }
+  return item;
+}
+
+static void test_deep_nested_maps(void** _state _CBOR_UNUSED) {
+  assert_equality(build_deep_maps(500, 1, false),
+                  build_deep_maps(500, 1, true), false, false, true);
+  assert_different(build_deep_maps(500, 1, false),
+                   build_deep_maps(500, 2, true));
+}
+
+static void test_nested_maps_hashed_once(void** _state _CBOR_UNUSED) {
+  // {1: {2: 3, 4: 5}, 6: 7} and {6: 7, 1: {4: 5, 2: 3}}
+  cbor_item_t* a =
+      LOAD(0xA2, 0x01, 0xA2, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07);
+  cbor_item_t* b =
+      LOAD(0xA2, 0x06, 0x07, 0x01, 0xA2, 0x04, 0x05, 0x02, 0x03);
+  // Pair hashes, the table of nested item hashes, and matches for the outer
+  // maps, then pair hashes and matches for the nested ones, whose hashes are
+  // reused
+  WITH_MOCK_MALLOC(
+      {
+        assert_true(
+            cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER));
+      },
+      7, MALLOC, MALLOC, MALLOC, MALLOC, MALLOC, MALLOC, MALLOC);
+  // Without memory for the table, the nested items are hashed again
+  WITH_MOCK_MALLOC(
+      {
+        assert_true(
+            cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER));
+      },
+      8, MALLOC, MALLOC_FAIL, MALLOC, MALLOC_FAIL, MALLOC, MALLOC, MALLOC,
+      MALLOC);
+  cbor_decref(&a);
+  cbor_decref(&b);
+}
+
+static void test_tags(void** _state _CBOR_UNUSED) {
+  assert_equality(LOAD(0xC1, 0x01), LOAD(0xC1, 0x01), true, true, true);
+  assert_different(LOAD(0xC1, 0x01), LOAD(0xC2, 0x01));
+  assert_different(LOAD(0xC1, 0x01), LOAD(0xC1, 0x02));
+}
+
+static void test_floats_ctrls(void** _state _CBOR_UNUSED) {
+  assert_equality(cbor_build_float4(1.5f), cbor_build_float4(1.5f), true, true,
+                  true);
+  assert_equality(cbor_build_float4(1.5f), cbor_build_float8(1.5), false, false,
+                  false);
+  assert_equality(cbor_build_float8(NAN), cbor_build_float8(-NAN), true, true,
+                  true);
+  assert_equality(cbor_build_float2(0.0f), cbor_build_float2(-0.0f), false,
+                  false, false);
+  assert_equality(cbor_build_bool(true), cbor_build_bool(true), true, true,
+                  true);
+  assert_different(cbor_build_bool(true), cbor_build_bool(false));
+  assert_different(cbor_new_null(), cbor_new_undef());
+}
+
+static void test_shared_subtree(void** _state _CBOR_UNUSED) {
+  cbor_item_t* shared = LOAD(0x82, 0x01, 0x02);
+  cbor_item_t* a = cbor_new_definite_array(1);
+  cbor_item_t* b = cbor_new_definite_array(1);
+  assert_true(cbor_array_push(a, shared));
+  assert_true(cbor_array_push(b, shared));
+  cbor_decref(&shared);
+  assert_equality(a, b, true, true, true);
+}
+
+static cbor_item_t* build_deep(size_t depth, uint8_t leaf) {
+  cbor_item_t* item = cbor_build_uint8(leaf);
+  for (size_t i = 0; i < depth; i++) {
+    cbor_item_t* parent = cbor_new_definite_array(1);
+    assert_true(cbor_array_push(parent, cbor_move(item)));
+    item = parent;
+  }
+  return item;
+}
+
+static void test_deep_nesting(void** _state _CBOR_UNUSED) {
+  assert_equality(build_deep(1000, 1), build_deep(1000, 1), true, true, true);
+  assert_different(build_deep(1000, 1), build_deep(1000, 2));
+  assert_different(build_deep(1000, 1), build_deep(1001, 1));
+}
+
+static void test_hash_seed(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_build_string("Hello!");
+  assert_true(cbor_hash(item, 0) != cbor_hash(item, 1));
+  assert_true(cbor_hash(item, 1) == cbor_hash(item, 1));
+  cbor_decref(&item);
+}
+
+static void test_hash_deep_nesting_without_memory(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_deep(20, 1);
+  uint64_t hash = cbor_hash(item, 0);
+  uint64_t shallow_hash;
+  WITH_FAILING_MALLOC({ shallow_hash = cbor_hash(item, 0); });
+  assert_true(hash != shallow_hash);
+  cbor_decref(&item);
+}
+
+static void test_map_order_alloc_failure(void** _state _CBOR_UNUSED) {
+  cbor_item_t* a = LOAD(0xA2, 0x01, 0x02, 0x03, 0x04);
+  cbor_item_t* b = LOAD(0xA2, 0x03, 0x04, 0x01, 0x02);
+  WITH_MOCK_MALLOC(
+      {
+        assert_false(
+            cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER));
+      },
+      1, MALLOC_FAIL);
+  WITH_MOCK_MALLOC(
+      {
+        assert_false(
+            cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER));
+      },
+      2, MALLOC, MALLOC_FAIL);
+  WITH_MOCK_MALLOC(
+      {
+        assert_false(
+            cbor_equal_with_options(a, b, CBOR_EQUAL_IGNORE_MAP_ORDER));
+      },
+      3, MALLOC, MALLOC, MALLOC_FAIL);
+  cbor_decref(&a);
+  cbor_decref(&b);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_identity),
+      cmocka_unit_test(test_ints),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_long_strings),
+      cmocka_unit_test(test_arrays),
+      cmocka_unit_test(test_maps),
+      cmocka_unit_test(test_maps_duplicate_pairs),
+      cmocka_unit_test(test_nested_maps),
+      cmocka_unit_test(test_deep_nested_maps),
+      cmocka_unit_test(test_nested_maps_hashed_once),
+      cmocka_unit_test(test_tags),
+      cmocka_unit_test(test_floats_ctrls),
+      cmocka_unit_test(test_shared_subtree),
+      cmocka_unit_test(test_deep_nesting),
+      cmocka_unit_test(test_hash_seed),
+      cmocka_unit_test(test_hash_deep_nesting_without_memory),
+      cmocka_unit_test(test_map_order_alloc_failure),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+
+// [1, {"a": (_ h'00' h'01')}, 2("x"), 1.5]
+static cbor_item_t* build_tree(void) {
+  cbor_item_t* bytes = cbor_new_indefinite_bytestring();
+  assert_true(cbor_bytestring_add_chunk(
+      bytes, cbor_move(cbor_build_bytestring((cbor_data) "\x00", 1))));
+  assert_true(cbor_bytestring_add_chunk(
+      bytes, cbor_move(cbor_build_bytestring((cbor_data) "\x01", 1))));
+  cbor_item_t* map = cbor_new_definite_map(1);
+  assert_true(cbor_map_add(map, (struct cbor_pair){
+                                    .key = cbor_move(cbor_build_string("a")),
+                                    .value = cbor_move(bytes)}));
+
+  cbor_item_t* array = cbor_new_definite_array(4);
+  assert_true(cbor_array_push(array, cbor_move(cbor_build_uint8(1))));
+  assert_true(cbor_array_push(array, cbor_move(map)));
+  assert_true(cbor_array_push(
+      array, cbor_move(cbor_build_tag(2, cbor_move(cbor_build_string("x"))))));
+  assert_true(cbor_array_push(array, cbor_move(cbor_build_float4(1.5f))));
+  return array;
+}
+
+static void test_freeze(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_tree();
+  assert_false(cbor_is_frozen(item));
+  assert_true(cbor_freeze(item));
+  assert_true(cbor_freeze(item));
+
+  assert_true(cbor_is_frozen(item));
+  assert_size_equal(cbor_refcount(item), SIZE_MAX);
+  cbor_item_t* map = cbor_array_get(item, 1);
+  assert_true(cbor_is_frozen(map));
+  assert_true(cbor_is_frozen(cbor_map_handle(map)[0].key));
+  cbor_item_t* bytes = cbor_map_handle(map)[0].value;
+  assert_true(cbor_is_frozen(cbor_bytestring_chunks_handle(bytes)[1]));
+  cbor_decref(&map);
+  assert_non_null(map);
+
+  cbor_frozen_release(&item);
+  assert_null(item);
+}
+
+static void test_refcounting_is_noop(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_tree();
+  assert_true(cbor_freeze(item));
+
+  for (int i = 0; i < 3; i++) {
+    assert_ptr_equal(cbor_incref(item), item);
+    assert_ptr_equal(cbor_move(item), item);
+  }
+  cbor_item_t* reference = item;
+  cbor_decref(&reference);
+  cbor_decref(&reference);
+  assert_ptr_equal(reference, item);
+  assert_size_equal(cbor_refcount(item), SIZE_MAX);
+
+  cbor_frozen_release(&item);
+}
+
+static void test_mutators_reject(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_tree();
+  assert_true(cbor_freeze(item));
+  cbor_item_t* value = cbor_build_uint8(42);
+
+  assert_false(cbor_array_push(item, value));
+  assert_false(cbor_array_replace(item, 0, value));
+  assert_false(cbor_array_set(item, 0, value));
+  cbor_item_t* map = cbor_array_get(item, 1);
+  assert_false(
+      cbor_map_add(map, (struct cbor_pair){.key = value, .value = value}));
+  cbor_item_t* bytes = cbor_map_handle(map)[0].value;
+  cbor_item_t* chunk = cbor_build_bytestring((cbor_data) "\x02", 1);
+  assert_false(cbor_bytestring_add_chunk(bytes, chunk));
+  assert_size_equal(cbor_refcount(chunk), 1);
+  cbor_decref(&chunk);
+  assert_size_equal(cbor_refcount(value), 1);
+  assert_size_equal(cbor_array_size(item), 4);
+  assert_size_equal(cbor_bytestring_chunk_count(bytes), 2);
+
+  cbor_decref(&value);
+  cbor_frozen_release(&item);
+}
+
+static void test_shared_items_rejected(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_tree();
+  cbor_item_t* map = cbor_array_get(item, 1);
+  assert_false(cbor_freeze(item));
+  assert_false(cbor_is_frozen(item));
+  assert_false(cbor_is_frozen(map));
+  cbor_decref(&map);
+
+  // Items referenced twice within the tree are rejected as well
+  cbor_item_t* twice = cbor_new_definite_array(2);
+  cbor_item_t* string = cbor_build_string("a");
+  assert_true(cbor_array_push(twice, string));
+  assert_true(cbor_array_push(twice, cbor_move(string)));
+  assert_false(cbor_freeze(twice));
+
+  // A frozen tree cannot be a part of another one
+  assert_true(cbor_freeze(item));
+  cbor_item_t* outer = cbor_new_definite_array(1);
+  assert_true(cbor_array_push(outer, item));
+  assert_false(cbor_freeze(outer));
+
+  cbor_decref(&twice);
+  cbor_decref(&outer);
+  cbor_frozen_release(&item);
+}
+
+static void test_serialized_size(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_tree();
+  size_t size = cbor_serialized_size(item);
+  assert_true(cbor_freeze(item));
+
+  // Mutations elsewhere do not affect the cached size of frozen trees
+  cbor_item_t* other = cbor_new_indefinite_array();
+  assert_true(cbor_array_push(other, cbor_move(cbor_build_uint8(1))));
+  assert_size_equal(cbor_serialized_size(item), size);
+
+  unsigned char buffer[64];
+  assert_size_equal(cbor_serialize(item, buffer, sizeof(buffer)), size);
+
+  cbor_item_t* copy = cbor_copy(item);
+  assert_false(cbor_is_frozen(copy));
+  assert_size_equal(cbor_refcount(copy), 1);
+  assert_size_equal(cbor_serialized_size(copy), size);
+
+  cbor_decref(&copy);
+  cbor_decref(&other);
+  cbor_frozen_release(&item);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_freeze),
+      cmocka_unit_test(test_refcounting_is_noop),
+      cmocka_unit_test(test_mutators_reject),
+      cmocka_unit_test(test_shared_items_rejected),
+      cmocka_unit_test(test_serialized_size),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
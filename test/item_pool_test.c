@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+#ifdef HAS_PTHREADS
+#include <pthread.h>
+#endif
+
+/*
+ * The item pool is transparent, so these tests pass with and without
+ * CBOR_ITEM_POOL. They use enough items to go through several batches of the
+ * per-thread caches.
+ */
+
+#define ITEMS 2000
+
+// An array of scalars of every size, each holding its index
+static cbor_item_t* build_scalars(size_t count) {
+  cbor_item_t* array = cbor_new_definite_array(count);
+  if (array == NULL) return NULL;
+  for (size_t i = 0; i < count; i++) {
+    cbor_item_t* item;
+    switch (i % 6) {
+      case 0:
+        item = cbor_build_uint8((uint8_t)i);
+        break;
+      case 1:
+        item = cbor_build_uint16((uint16_t)i);
+        break;
+      case 2:
+        item = cbor_build_uint32((uint32_t)i);
+        break;
+      case 3:
+        item = cbor_build_uint64(i);
+        break;
+      case 4:
+        item = cbor_build_float8((double)i);
+        break;
+      default:
+        item = cbor_build_tag(i, cbor_move(cbor_build_string("x")));
+        break;
+    }
+    if (item == NULL || !cbor_array_push(array, cbor_move(item))) {
+      cbor_decref(&array);
+      return NULL;
+    }
+  }
+  return array;
+}
+
+static bool check_scalars(cbor_item_t* array) {
+  for (size_t i = 0; i < cbor_array_size(array); i++) {
+    cbor_item_t* item = cbor_array_get(array, i);
+    bool ok;
+    if (i % 6 == 4) {
+      ok = cbor_float_get_float8(item) == (double)i;
+    } else if (i % 6 == 5) {
+      ok = cbor_tag_value(item) == i;
+    } else {
+      ok = cbor_get_int(item) == (i % 6 == 0 ? (uint8_t)i : i);
+    }
+    cbor_decref(&item);
+    if (!ok) return false;
+  }
+  return true;
+}
+
+static void test_build_and_free(void** _state _CBOR_UNUSED) {
+  cbor_item_t* first = build_scalars(ITEMS);
+  cbor_item_t* second = build_scalars(ITEMS);
+  assert_non_null(first);
+  assert_non_null(second);
+  assert_true(check_scalars(first));
+  assert_true(check_scalars(second));
+
+  // Recycled slots do not keep stale contents
+  cbor_decref(&first);
+  cbor_item_t* third = build_scalars(ITEMS);
+  assert_non_null(third);
+  assert_true(check_scalars(second));
+  assert_true(check_scalars(third));
+  cbor_decref(&second);
+  cbor_decref(&third);
+}
+
+static void test_interleaved(void** _state _CBOR_UNUSED) {
+  cbor_item_t* items[ITEMS];
+  for (size_t round = 0; round < 4; round++) {
+    for (size_t i = 0; i < ITEMS; i++) items[i] = cbor_build_uint32(i);
+    // Free every other item, then the rest, in the opposite order
+    for (size_t i = 0; i < ITEMS; i += 2) cbor_decref(&items[i]);
+    for (size_t i = ITEMS - 1; i < ITEMS; i -= 2) {
+      assert_uint32(items[i], i);
+      cbor_decref(&items[i]);
+    }
+  }
+}
+
+static void test_custom_hooks(void** _state _CBOR_UNUSED) {
+  // Items allocated while custom hooks are installed always go through them
+  WITH_FAILING_MALLOC({ assert_null(cbor_build_uint8(1)); });
+  WITH_MOCK_MALLOC(
+      {
+        cbor_item_t* item = cbor_build_uint8(1);
+        assert_non_null(item);
+        cbor_decref(&item);
+      },
+      1, MALLOC);
+}
+
+#ifdef HAS_PTHREADS
+
+#define THREADS 8
+
+static void* build(void* _context _CBOR_UNUSED) {
+  return build_scalars(ITEMS);
+}
+
+static void* build_and_free(void* context) {
+  bool ok = true;
+  for (size_t i = 0; i < 10; i++) {
+    cbor_item_t* item = build_scalars(ITEMS);
+    ok &= item != NULL && check_scalars(item);
+    if (item != NULL) cbor_decref(&item);
+  }
+  return ok ? context : NULL;
+}
+
+static void test_freed_by_another_thread(void** _state _CBOR_UNUSED) {
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    assert_int_equal(pthread_create(&threads[i], NULL, build, NULL), 0);
+  for (size_t i = 0; i < THREADS; i++) {
+    void* result;
+    assert_int_equal(pthread_join(threads[i], &result), 0);
+    cbor_item_t* item = result;
+    assert_non_null(item);
+    assert_true(check_scalars(item));
+    cbor_decref(&item);
+  }
+}
+
+static void test_concurrent(void** _state _CBOR_UNUSED) {
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    assert_int_equal(
+        pthread_create(&threads[i], NULL, build_and_free, threads), 0);
+  for (size_t i = 0; i < THREADS; i++) {
+    void* result;
+    assert_int_equal(pthread_join(threads[i], &result), 0);
+    assert_non_null(result);
+  }
+}
+
+#if CBOR_ITEM_POOL && !CBOR_ALLOC_STATS
+
+// More than a batch, so that the thread caches a partial batch and a spare
+#define EXITING_ITEMS 300
+
+static void* build_and_exit(void* context) {
+  cbor_item_t** items = context;
+  for (size_t i = 0; i < EXITING_ITEMS; i++) items[i] = cbor_build_uint8(1);
+  // Keep the addresses for comparison
+  for (size_t i = 0; i < EXITING_ITEMS; i++) {
+    cbor_item_t* item = items[i];
+    cbor_decref(&item);
+  }
+  return NULL;
+}
+
+static void* build_one(void* _context _CBOR_UNUSED) {
+  return cbor_build_uint8(2);
+}
+
+static void test_thread_exit(void** _state _CBOR_UNUSED) {
+  // The slots cached by a thread are reused by the threads that follow it
+  cbor_item_t* exited[EXITING_ITEMS];
+  pthread_t thread;
+  assert_int_equal(pthread_create(&thread, NULL, build_and_exit, exited), 0);
+  assert_int_equal(pthread_join(thread, NULL), 0);
+  assert_int_equal(pthread_create(&thread, NULL, build_one, NULL), 0);
+  void* result;
+  assert_int_equal(pthread_join(thread, &result), 0);
+  cbor_item_t* item = result;
+  assert_non_null(item);
+  bool reused = false;
+  for (size_t i = 0; i < EXITING_ITEMS; i++) reused |= item == exited[i];
+  assert_true(reused);
+  cbor_decref(&item);
+}
+
+#endif
+
+#endif
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_build_and_free),
+      cmocka_unit_test(test_interleaved),
+      cmocka_unit_test(test_custom_hooks),
+#ifdef HAS_PTHREADS
+      cmocka_unit_test(test_freed_by_another_thread),
+      cmocka_unit_test(test_concurrent),
+#if CBOR_ITEM_POOL && !CBOR_ALLOC_STATS
+      cmocka_unit_test(test_thread_exit),
+#endif
+#endif
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+static unsigned char output[8192];
+
+static void assert_cbor_with_options(const char* json, unsigned options,
+                                     cbor_data expected,
+                                     size_t expected_length) {
+  struct cbor_json_result result = cbor_from_json_buffer(
+      json, strlen(json), options, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, strlen(json));
+  assert_size_equal(result.written, expected_length);
+  assert_memory_equal(output, expected, expected_length);
+}
+
+static void assert_json_error(const char* json, unsigned options,
+                              cbor_json_error_code error) {
+  struct cbor_json_result result = cbor_from_json_buffer(
+      json, strlen(json), options, output, sizeof(output));
+  assert_true(result.error == error);
+  assert_size_equal(result.read, 0);
+}
+
+#define BYTES(...) (cbor_data)(unsigned char[]){__VA_ARGS__}, \
+                   sizeof((unsigned char[]){__VA_ARGS__})
+
+#define ASSERT_CBOR(json, ...) \
+  assert_cbor_with_options(json, CBOR_FROM_JSON_DEFAULT, BYTES(__VA_ARGS__))
+
+static void test_ints(void** _state _CBOR_UNUSED) {
+  ASSERT_CBOR("0", 0x00);
+  ASSERT_CBOR("23", 0x17);
+  ASSERT_CBOR("24", 0x18, 0x18);
+  ASSERT_CBOR("100000", 0x1A, 0x00, 0x01, 0x86, 0xA0);
+  ASSERT_CBOR("18446744073709551615", 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+  ASSERT_CBOR("-1", 0x20);
+  ASSERT_CBOR("-1000", 0x39, 0x03, 0xE7);
+  ASSERT_CBOR("-18446744073709551616", 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+  // Out of range integers become floats
+  ASSERT_CBOR("18446744073709551616", 0xFA, 0x5F, 0x80, 0x00, 0x00);
+  ASSERT_CBOR("-18446744073709551617", 0xFA, 0xDF, 0x80, 0x00, 0x00);
+  ASSERT_CBOR("-0", 0xF9, 0x80, 0x00);
+}
+
+static void test_floats(void** _state _CBOR_UNUSED) {
+  ASSERT_CBOR("1.0", 0xF9, 0x3C, 0x00);
+  ASSERT_CBOR("-1.5", 0xF9, 0xBE, 0x00);
+  ASSERT_CBOR("1e5", 0xFA, 0x47, 0xC3, 0x50, 0x00);
+  ASSERT_CBOR("0.1", 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A);
+  ASSERT_CBOR("3.4028234663852886E+38", 0xFA, 0x7F, 0x7F, 0xFF, 0xFF);
+  ASSERT_CBOR("1e400", 0xF9, 0x7C, 0x00);
+  // Longer than the internal number buffer
+  ASSERT_CBOR("1.000000000000000000000000000000000000000000000000000000000000"
+              "00000000000000000000",
+              0xF9, 0x3C, 0x00);
+}
+
+static void test_literals(void** _state _CBOR_UNUSED) {
+  ASSERT_CBOR("true", 0xF5);
+  ASSERT_CBOR("false", 0xF4);
+  ASSERT_CBOR("null", 0xF6);
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  ASSERT_CBOR("\"\"", 0x60);
+  ASSERT_CBOR("\"a\"", 0x61, 'a');
+  ASSERT_CBOR("\"\xC3\xA1\"", 0x62, 0xC3, 0xA1);
+  ASSERT_CBOR("\"\\n\\u00e1\\ud83D\\uDE00\\/\\\"\\\\\"", 0x6A, 0x0A, 0xC3,
+              0xA1, 0xF0, 0x9F, 0x98, 0x80, '/', '"', '\\');
+  ASSERT_CBOR("\"\\b\\f\\r\\t\\u0000\"", 0x65, '\b', '\f', '\r', '\t', 0x00);
+}
+
+static void test_long_string(void** _state _CBOR_UNUSED) {
+  char json[40];
+  memset(json, 'x', sizeof(json));
+  json[0] = json[33] = '"';
+  json[34] = '\0';
+  unsigned char expected[34] = {0x78, 32};
+  memset(expected + 2, 'x', 32);
+  assert_cbor_with_options(json, CBOR_FROM_JSON_DEFAULT, expected,
+                           sizeof(expected));
+}
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  ASSERT_CBOR("[]", 0x80);
+  ASSERT_CBOR("{ }", 0xA0);
+  ASSERT_CBOR("[1, [2, 3], [], {}]", 0x84, 0x01, 0x82, 0x02, 0x03, 0x80, 0xA0);
+  ASSERT_CBOR("{\"a\": [true], \"b\": {\"c\": null}, \"[\": \"]\"}", 0xA3,
+              0x61, 'a', 0x81, 0xF5, 0x61, 'b', 0xA1, 0x61, 'c', 0xF6, 0x61,
+              '[', 0x61, ']');
+  ASSERT_CBOR(" \t[\n\"a,\\\"b\" ,\r[ ] ] \n", 0x82, 0x64, 'a', ',', '"', 'b',
+              0x80);
+  ASSERT_CBOR("[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]", 0x98, 0x18,
+              0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+              0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+              0x00, 0x00);
+}
+
+static void test_indefinite(void** _state _CBOR_UNUSED) {
+  assert_cbor_with_options(
+      "[1, {\"a\": []}, {}]", CBOR_FROM_JSON_INDEFINITE,
+      BYTES(0x9F, 0x01, 0xBF, 0x61, 'a', 0x9F, 0xFF, 0xFF, 0xBF, 0xFF, 0xFF));
+}
+
+static void test_sequence(void** _state _CBOR_UNUSED) {
+  const char* json = " [1] \n{}\n";
+  struct cbor_json_result result = cbor_from_json_buffer(
+      json, strlen(json), CBOR_FROM_JSON_DEFAULT, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, 6);
+  assert_size_equal(result.written, 2);
+  assert_memory_equal(output, ((unsigned char[]){0x81, 0x01}), 2);
+
+  result = cbor_from_json_buffer(json + 6, strlen(json + 6),
+                                 CBOR_FROM_JSON_DEFAULT, output,
+                                 sizeof(output));
+  assert_size_equal(result.read, 3);
+  assert_size_equal(result.written, 1);
+}
+
+static void test_malformed(void** _state _CBOR_UNUSED) {
+  const char* inputs[] = {"]",         "[1,]",       "[1 2]",
+                          "[1}",       "{1: 2}",     "{\"a\" 1}",
+                          "{\"a\":1,}", "trux",       "nul1",
+                          "-a",        "1.e5",       "1e+a",
+                          "+1",        ".5",         "\"\\x\"",
+                          "\"\x01\"",  "\"\xFF\"",   "\"\\u00g0\"",
+                          "\"\\ud800\"", "\"\\ud800\\n\"",
+                          "\"\\ud800\\u0041\"", "\"\\udc00\"",
+                          "[\"\\ud800x\"]"};
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    assert_json_error(inputs[i], CBOR_FROM_JSON_DEFAULT,
+                      CBOR_JSON_ERR_MALFORMED);
+    assert_json_error(inputs[i], CBOR_FROM_JSON_INDEFINITE,
+                      CBOR_JSON_ERR_MALFORMED);
+  }
+}
+
+static void test_incomplete(void** _state _CBOR_UNUSED) {
+  const char* inputs[] = {"",          " \n",     "[",        "[1",
+                          "[1,",       "{",       "{\"a\"",   "{\"a\":",
+                          "{\"a\":1",  "tru",     "-",        "1.",
+                          "1e+",       "\"abc",   "\"\\",     "\"\\u00",
+                          "\"\\ud83d", "\"\\ud83d\\", "\"\xC3"};
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    assert_json_error(inputs[i], CBOR_FROM_JSON_DEFAULT,
+                      CBOR_JSON_ERR_NOTENOUGHDATA);
+    assert_json_error(inputs[i], CBOR_FROM_JSON_INDEFINITE,
+                      CBOR_JSON_ERR_NOTENOUGHDATA);
+  }
+}
+
+static void test_small_buffer(void** _state _CBOR_UNUSED) {
+  unsigned char buffer[4];
+  struct cbor_json_result result = cbor_from_json_buffer(
+      "[1, 1000]", 9, CBOR_FROM_JSON_DEFAULT, buffer, sizeof(buffer));
+  assert_true(result.error == CBOR_JSON_ERR_SINK);
+
+  result = cbor_from_json_buffer("[1, 100]", 8, CBOR_FROM_JSON_DEFAULT,
+                                 buffer, sizeof(buffer));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.written, 4);
+  assert_memory_equal(buffer, ((unsigned char[]){0x82, 0x01, 0x18, 0x64}), 4);
+}
+
+static void test_deep_nesting(void** _state _CBOR_UNUSED) {
+  char json[2 * CBOR_MAX_STACK_SIZE + 3];
+  memset(json, '[', CBOR_MAX_STACK_SIZE + 1);
+  memset(json + CBOR_MAX_STACK_SIZE + 1, ']', CBOR_MAX_STACK_SIZE + 1);
+  json[2 * CBOR_MAX_STACK_SIZE + 2] = '\0';
+  assert_json_error(json, CBOR_FROM_JSON_DEFAULT, CBOR_JSON_ERR_MEMERROR);
+  assert_json_error(json, CBOR_FROM_JSON_INDEFINITE, CBOR_JSON_ERR_MEMERROR);
+
+  const char* limit = json + 1;
+  json[2 * CBOR_MAX_STACK_SIZE + 1] = '\0';
+  struct cbor_json_result result = cbor_from_json_buffer(
+      limit, strlen(limit), CBOR_FROM_JSON_DEFAULT, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.written, CBOR_MAX_STACK_SIZE);
+  assert_true(output[0] == 0x81 && output[CBOR_MAX_STACK_SIZE - 1] == 0x80);
+
+  // The first 16 levels do not allocate
+  const char* inline_depth = "[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]";
+  WITH_MOCK_MALLOC(
+      {
+        assert_cbor_with_options(inline_depth, CBOR_FROM_JSON_DEFAULT,
+                                 BYTES(0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+                                       0x81, 0x81, 0x81, 0x81, 0x81, 0x81,
+                                       0x81, 0x81, 0x81, 0x80));
+      },
+      // No calls are expected, the expectation is only a placeholder
+      0, MALLOC);
+  const char* deeper = "[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]";
+  // Container sizes and the stack of the first pass
+  WITH_MOCK_MALLOC(
+      {
+        assert_json_error(deeper, CBOR_FROM_JSON_DEFAULT,
+                          CBOR_JSON_ERR_MEMERROR);
+      },
+      1, MALLOC_FAIL);
+  WITH_MOCK_MALLOC(
+      {
+        assert_json_error(deeper, CBOR_FROM_JSON_DEFAULT,
+                          CBOR_JSON_ERR_MEMERROR);
+      },
+      2, MALLOC, MALLOC_FAIL);
+  // Indefinite containers are converted without allocating at any depth
+  WITH_MOCK_MALLOC(
+      {
+        result = cbor_from_json_buffer(limit, strlen(limit),
+                                       CBOR_FROM_JSON_INDEFINITE, output,
+                                       sizeof(output));
+        assert_true(result.error == CBOR_JSON_ERR_NONE);
+        assert_size_equal(result.written, 2 * CBOR_MAX_STACK_SIZE);
+      },
+      0, MALLOC);
+}
+
+static bool failing_sink(void* context _CBOR_UNUSED,
+                         cbor_data data _CBOR_UNUSED,
+                         size_t length _CBOR_UNUSED) {
+  return false;
+}
+
+static void test_sink(void** _state _CBOR_UNUSED) {
+  // Many small values and a string larger than the internal buffer
+  size_t json_size = 1000 * 12 + 5000 + 16;
+  char* json = malloc(json_size);
+  size_t length = 0;
+  json[length++] = '{';
+  for (size_t i = 0; i < 1000; i++)
+    length += (size_t)snprintf(json + length, json_size - length,
+                               "\"%03zu\":%zu,", i, i);
+  length += (size_t)snprintf(json + length, json_size - length, "\"s\":\"");
+  memset(json + length, 'x', 5000);
+  length += 5000;
+  memcpy(json + length, "\"}", 2);
+  length += 2;
+
+  struct cbor_writer_memory memory = {NULL, 0, 0};
+  struct cbor_json_result result = cbor_from_json(
+      json, length, CBOR_FROM_JSON_DEFAULT, cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, length);
+  assert_size_equal(result.written, memory.length);
+
+  struct cbor_load_result load_result;
+  cbor_item_t* item = cbor_load(memory.data, memory.length, &load_result);
+  assert_non_null(item);
+  assert_size_equal(load_result.read, memory.length);
+  assert_true(cbor_map_is_definite(item));
+  assert_size_equal(cbor_map_size(item), 1001);
+  struct cbor_pair last = cbor_map_handle(item)[1000];
+  assert_size_equal(cbor_string_length(last.value), 5000);
+  cbor_decref(&item);
+
+  result = cbor_from_json(json, length, CBOR_FROM_JSON_DEFAULT, failing_sink,
+                          NULL);
+  assert_true(result.error == CBOR_JSON_ERR_SINK);
+  assert_size_equal(result.written, 0);
+
+  free(memory.data);
+  free(json);
+}
+
+static void test_round_trip(void** _state _CBOR_UNUSED) {
+  const char* json =
+      "{\"a\":[1,-2,1.5,0.1,1e+300,\"x\\n\\u0001\xC3\xA1\",true,false,null],"
+      "\"b\":{},\"c\":[[]]}";
+  for (unsigned options = 0; options <= CBOR_FROM_JSON_INDEFINITE;
+       options++) {
+    unsigned char cbor[256];
+    struct cbor_json_result result =
+        cbor_from_json_buffer(json, strlen(json), options, cbor, sizeof(cbor));
+    assert_true(result.error == CBOR_JSON_ERR_NONE);
+    result = cbor_to_json_buffer(cbor, result.written, NULL, output,
+                                 sizeof(output));
+    assert_true(result.error == CBOR_JSON_ERR_NONE);
+    assert_size_equal(result.written, strlen(json));
+    assert_memory_equal(output, json, strlen(json));
+  }
+}
+
+/* Feed the input `chunk` bytes at a time, passing the unconverted rest again
+ * together with the next chunk, and compare with the conversion in one go */
+static void assert_partial(const char* json, size_t chunk) {
+  size_t length = strlen(json);
+  unsigned char expected[256];
+  struct cbor_json_result result =
+      cbor_from_json_buffer(json, length, CBOR_FROM_JSON_INDEFINITE, expected,
+                            sizeof(expected));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  size_t expected_length = result.written;
+
+  struct cbor_from_json_state state = {0};
+  struct cbor_writer_memory memory = {NULL, 0, 0};
+  size_t read = 0, available = 0;
+  do {
+    available = available + chunk < length ? available + chunk : length;
+    result = cbor_from_json_partial(json + read, available - read,
+                                    available == length, &state,
+                                    cbor_writer_memory_sink, &memory);
+    read += result.read;
+  } while (result.error == CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(read, length);
+  assert_size_equal(memory.length, expected_length);
+  assert_memory_equal(memory.data, expected, expected_length);
+  free(memory.data);
+}
+
+static void test_partial(void** _state _CBOR_UNUSED) {
+  const char* inputs[] = {
+      " {\"a\": [1, -2.5e3, true, false, null], \"\\u00e1\\ud83d\\ude00\": "
+      "\"x\\n\xC3\xA1\", \"b\": {}, \"c\": [[]]}",
+      "123456789",
+      "-0.125",
+      "\"\\\"\"",
+      "[]",
+      "false"};
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    for (size_t chunk = 1; chunk <= 8; chunk++)
+      assert_partial(inputs[i], chunk);
+
+  struct cbor_from_json_state state = {0};
+  unsigned char buffer[16];
+  struct cbor_writer_memory memory = {NULL, 0, 0};
+  // Complete tokens are converted, the rest is left for the next call
+  struct cbor_json_result result = cbor_from_json_partial(
+      "[1, tr", 6, false, &state, cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_size_equal(result.read, 4);
+  assert_size_equal(result.written, 2);
+  // A number may continue in the next call
+  result = cbor_from_json_partial("true, 12", 8, false, &state,
+                                  cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_size_equal(result.read, 6);
+  result = cbor_from_json_partial("123] [", 6, false, &state,
+                                  cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, 5);
+  result = cbor_to_json_buffer(memory.data, memory.length, NULL, buffer,
+                               sizeof(buffer));
+  assert_size_equal(result.written, 12);
+  assert_memory_equal(buffer, "[1,true,123]", 12);
+  free(memory.data);
+
+  // The state is ready for the next value
+  memory = (struct cbor_writer_memory){NULL, 0, 0};
+  result = cbor_from_json_partial("[,]", 3, true, &state,
+                                  cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_MALFORMED);
+  assert_size_equal(result.read, 0);
+  state = (struct cbor_from_json_state){0};
+  result = cbor_from_json_partial("[1", 2, true, &state,
+                                  cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_size_equal(result.read, 0);
+  free(memory.data);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_ints),
+      cmocka_unit_test(test_floats),
+      cmocka_unit_test(test_literals),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_long_string),
+      cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_indefinite),
+      cmocka_unit_test(test_sequence),
+      cmocka_unit_test(test_malformed),
+      cmocka_unit_test(test_incomplete),
+      cmocka_unit_test(test_small_buffer),
+      cmocka_unit_test(test_deep_nesting),
+      cmocka_unit_test(test_sink),
+      cmocka_unit_test(test_round_trip),
+      cmocka_unit_test(test_partial),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+#include "test_allocator.h"
+
+static unsigned char output[8192];
+
+static void assert_json_with_options(cbor_data data, size_t length,
+                                     const struct cbor_json_options* options,
+                                     const char* expected) {
+  struct cbor_json_result result =
+      cbor_to_json_buffer(data, length, options, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, length);
+  assert_size_equal(result.written, strlen(expected));
+  assert_memory_equal(output, expected, result.written);
+}
+
+static void assert_json_error(cbor_data data, size_t length,
+                              const struct cbor_json_options* options,
+                              cbor_json_error_code error) {
+  struct cbor_json_result result =
+      cbor_to_json_buffer(data, length, options, output, sizeof(output));
+  assert_true(result.error == error);
+}
+
+#define BYTES(...) (cbor_data)(unsigned char[]){__VA_ARGS__}, \
+                   sizeof((unsigned char[]){__VA_ARGS__})
+
+#define ASSERT_JSON(expected, ...) \
+  assert_json_with_options(BYTES(__VA_ARGS__), NULL, expected)
+
+static const struct cbor_json_options wrap_tags = {
+    .tags = CBOR_JSON_TAGS_WRAP};
+static const struct cbor_json_options reject_all = {
+    .keys = CBOR_JSON_KEYS_REJECT, .tags = CBOR_JSON_TAGS_REJECT};
+
+static void test_ints(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("0", 0x00);
+  ASSERT_JSON("1000", 0x19, 0x03, 0xE8);
+  ASSERT_JSON("18446744073709551615", 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+  ASSERT_JSON("-1", 0x20);
+  ASSERT_JSON("-257", 0x39, 0x01, 0x00);
+  ASSERT_JSON("-18446744073709551616", 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+              0xFF, 0xFF, 0xFF);
+}
+
+static void test_floats(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("1.0", 0xF9, 0x3C, 0x00);
+  ASSERT_JSON("-0.0", 0xF9, 0x80, 0x00);
+  ASSERT_JSON("1.5", 0xFA, 0x3F, 0xC0, 0x00, 0x00);
+  ASSERT_JSON("0.1", 0xFA, 0x3D, 0xCC, 0xCC, 0xCD);
+  ASSERT_JSON("0.1", 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A);
+  ASSERT_JSON("0.30000000000000004", 0xFB, 0x3F, 0xD3, 0x33, 0x33, 0x33,
+              0x33, 0x33, 0x34);
+  ASSERT_JSON("1e+300", 0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75,
+              0x9C);
+  ASSERT_JSON("null", 0xF9, 0x7E, 0x00);
+  ASSERT_JSON("null", 0xF9, 0xFC, 0x00);
+  ASSERT_JSON("null", 0xFB, 0x7F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00);
+}
+
+static void test_simple_values(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("false", 0xF4);
+  ASSERT_JSON("true", 0xF5);
+  ASSERT_JSON("null", 0xF6);
+  ASSERT_JSON("null", 0xF7);
+  ASSERT_JSON("[true,false]", 0x82, 0xF5, 0xF4);
+}
+
+static void test_strings(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("\"\"", 0x60);
+  ASSERT_JSON("\"hello\"", 0x65, 'h', 'e', 'l', 'l', 'o');
+  ASSERT_JSON("\"a\\\"b\\\\c\\n\\t\\u0001\\u001f\x7F\"", 0x6A, 'a', '"', 'b',
+              '\\', 'c', '\n', '\t', 0x01, 0x1F, 0x7F);
+  ASSERT_JSON("\"\xC3\xA1\"", 0x62, 0xC3, 0xA1);
+  // Indefinite strings are concatenated
+  ASSERT_JSON("\"ab\\\"c\"", 0x7F, 0x62, 'a', 'b', 0x60, 0x62, '"', 'c', 0xFF);
+  ASSERT_JSON("\"\"", 0x7F, 0xFF);
+}
+
+static void test_long_strings(void** _state _CBOR_UNUSED) {
+  // Special characters at every position of the vectorized scan
+  for (size_t position = 0; position < 40; position++) {
+    unsigned char data[42] = {0x78, 40};
+    char expected[128];
+    memset(data + 2, 'x', 40);
+    data[2 + position] = position % 2 ? '\\' : '\r';
+    snprintf(expected, sizeof(expected), "\"%.*s%s%.*s\"", (int)position,
+             "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",
+             position % 2 ? "\\\\" : "\\r", (int)(39 - position),
+             "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+    assert_json_with_options(data, sizeof(data), NULL, expected);
+  }
+}
+
+static void test_bytestrings(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("\"\"", 0x40);
+  ASSERT_JSON("\"-w\"", 0x41, 0xFB);
+  ASSERT_JSON("\"__8\"", 0x42, 0xFF, 0xFF);
+  ASSERT_JSON("\"AQID\"", 0x43, 0x01, 0x02, 0x03);
+  // Groups spanning chunks
+  ASSERT_JSON("\"AQIDBA\"", 0x5F, 0x41, 0x01, 0x40, 0x42, 0x02, 0x03, 0x41,
+              0x04, 0xFF);
+  ASSERT_JSON("\"\"", 0x5F, 0xFF);
+}
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("[]", 0x80);
+  ASSERT_JSON("{}", 0xA0);
+  ASSERT_JSON("[1,[2,3],[]]", 0x83, 0x01, 0x82, 0x02, 0x03, 0x80);
+  ASSERT_JSON("{\"a\":1,\"b\":{}}", 0xA2, 0x61, 'a', 0x01, 0x61, 'b', 0xA0);
+  ASSERT_JSON("[1,{\"a\":null},[]]", 0x9F, 0x01, 0xBF, 0x61, 'a', 0xF6, 0xFF,
+              0x9F, 0xFF, 0xFF);
+  // Duplicate keys are preserved
+  ASSERT_JSON("{\"a\":1,\"a\":2}", 0xA2, 0x61, 'a', 0x01, 0x61, 'a', 0x02);
+}
+
+static void test_keys(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("{\"AQ\":0}", 0xA1, 0x41, 0x01, 0x00);
+  ASSERT_JSON("{\"ab\":0}", 0xA1, 0x7F, 0x61, 'a', 0x61, 'b', 0xFF, 0x00);
+  ASSERT_JSON("{\"1\":2,\"-1\":null}", 0xA2, 0x01, 0x02, 0x20, 0xF6);
+  ASSERT_JSON("{\"[1,\\\"\\\\\\\"\\\"]\":{\"true\":0}}", 0xA1, 0x82, 0x01,
+              0x61, '"', 0xA1, 0xF5, 0x00);
+  ASSERT_JSON("{\"{\\\"a\\\":[]}\":0}", 0xBF, 0xA1, 0x61, 'a', 0x80, 0x00,
+              0xFF);
+
+  assert_json_error(BYTES(0xA1, 0x01, 0x02), &reject_all, CBOR_JSON_ERR_KEY);
+  // Non-string keys within non-string keys
+  assert_json_error(BYTES(0xA1, 0xA1, 0x01, 0x02, 0x03), NULL,
+                    CBOR_JSON_ERR_KEY);
+  assert_json_with_options(BYTES(0xA1, 0x61, 'a', 0x01), &reject_all,
+                           "{\"a\":1}");
+}
+
+static void test_tags(void** _state _CBOR_UNUSED) {
+  ASSERT_JSON("1", 0xC1, 0x01);
+  ASSERT_JSON("{\"a\":0}", 0xA1, 0xC0, 0x61, 'a', 0x00);
+  assert_json_with_options(BYTES(0x82, 0xC1, 0xD8, 0x20, 0x01, 0x02),
+                           &wrap_tags,
+                           "[{\"tag\":1,\"value\":{\"tag\":32,\"value\":1}},"
+                           "2]");
+  assert_json_with_options(BYTES(0xA1, 0xC0, 0x61, 'a', 0x00), &wrap_tags,
+                           "{\"{\\\"tag\\\":0,\\\"value\\\":\\\"a\\\"}\":0}");
+  assert_json_error(BYTES(0xC1, 0x01), &reject_all, CBOR_JSON_ERR_TAG);
+}
+
+static void test_malformed(void** _state _CBOR_UNUSED) {
+  assert_json_error(BYTES(0xFF), NULL, CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0x82, 0x01, 0xFF), NULL, CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0xBF, 0x01, 0xFF), NULL, CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0x5F, 0x61, 'a', 0xFF), NULL,
+                    CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0x7F, 0xC1, 0x61, 'a', 0xFF), NULL,
+                    CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0x7F, 0x9F, 0xFF, 0xFF), NULL,
+                    CBOR_JSON_ERR_MALFORMED);
+  assert_json_error(BYTES(0xF8, 0x20), NULL, CBOR_JSON_ERR_MALFORMED);
+
+  assert_json_error(NULL, 0, NULL, CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_json_error(BYTES(0x82, 0x01), NULL, CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_json_error(BYTES(0x9F, 0x01), NULL, CBOR_JSON_ERR_NOTENOUGHDATA);
+  assert_json_error(BYTES(0x62, 'a'), NULL, CBOR_JSON_ERR_NOTENOUGHDATA);
+}
+
+static void test_trailing_data(void** _state _CBOR_UNUSED) {
+  struct cbor_json_result result = cbor_to_json_buffer(
+      BYTES(0x81, 0x01, 0x02), NULL, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, 2);
+  assert_size_equal(result.written, 3);
+}
+
+static void test_small_buffer(void** _state _CBOR_UNUSED) {
+  unsigned char buffer[7];
+  struct cbor_json_result result = cbor_to_json_buffer(
+      BYTES(0x82, 0x01, 0x19, 0x03, 0xE8), NULL, buffer, sizeof(buffer));
+  assert_true(result.error == CBOR_JSON_ERR_SINK);
+
+  result = cbor_to_json_buffer(BYTES(0x82, 0x01, 0x18, 0x64), NULL, buffer,
+                               sizeof(buffer));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.written, 7);
+  assert_memory_equal(buffer, "[1,100]", 7);
+}
+
+static bool failing_sink(void* context _CBOR_UNUSED,
+                         cbor_data data _CBOR_UNUSED,
+                         size_t length _CBOR_UNUSED) {
+  return false;
+}
+
+static void test_sink(void** _state _CBOR_UNUSED) {
+  // Many short items and one string larger than the internal buffer
+  cbor_item_t* item = cbor_new_definite_array(1001);
+  for (size_t i = 0; i < 1000; i++)
+    assert_true(cbor_array_push(item, cbor_move(cbor_build_uint16(i))));
+  char* long_string = malloc(5000);
+  memset(long_string, '"', 5000);
+  cbor_item_t* string = cbor_build_stringn(long_string, 5000);
+  assert_true(cbor_array_push(item, cbor_move(string)));
+  free(long_string);
+  unsigned char* cbor;
+  size_t cbor_size;
+  size_t length = cbor_serialize_alloc(item, &cbor, &cbor_size);
+  cbor_decref(&item);
+
+  struct cbor_writer_memory memory = {NULL, 0, 0};
+  struct cbor_json_result result =
+      cbor_to_json(cbor, length, NULL, cbor_writer_memory_sink, &memory);
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.read, length);
+  assert_size_equal(result.written, memory.length);
+  assert_memory_equal(memory.data, "[0,1,2,", 7);
+  assert_memory_equal(memory.data + memory.length - 6, "\\\"\\\"\"]", 6);
+
+  unsigned char* buffer = malloc(memory.length);
+  result = cbor_to_json_buffer(cbor, length, NULL, buffer, memory.length);
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.written, memory.length);
+  assert_memory_equal(buffer, memory.data, memory.length);
+
+  result = cbor_to_json(cbor, length, NULL, failing_sink, NULL);
+  assert_true(result.error == CBOR_JSON_ERR_SINK);
+  assert_size_equal(result.written, 0);
+
+  free(buffer);
+  free(memory.data);
+  free(cbor);
+}
+
+static void test_deep_nesting(void** _state _CBOR_UNUSED) {
+  unsigned char data[CBOR_MAX_STACK_SIZE + 1];
+  memset(data, 0x81, CBOR_MAX_STACK_SIZE);
+  data[CBOR_MAX_STACK_SIZE] = 0x00;
+  struct cbor_json_result result =
+      cbor_to_json_buffer(data, sizeof(data), NULL, output, sizeof(output));
+  assert_true(result.error == CBOR_JSON_ERR_NONE);
+  assert_size_equal(result.written, 2 * CBOR_MAX_STACK_SIZE + 1);
+  assert_true(output[0] == '[' && output[CBOR_MAX_STACK_SIZE] == '0' &&
+              output[2 * CBOR_MAX_STACK_SIZE] == ']');
+
+  unsigned char too_deep[CBOR_MAX_STACK_SIZE + 2];
+  memset(too_deep, 0x81, CBOR_MAX_STACK_SIZE + 1);
+  too_deep[CBOR_MAX_STACK_SIZE + 1] = 0x00;
+  assert_json_error(too_deep, sizeof(too_deep), NULL, CBOR_JSON_ERR_MEMERROR);
+
+  // The first 16 levels do not allocate
+  WITH_FAILING_MALLOC({
+    assert_json_error(data + CBOR_MAX_STACK_SIZE - 17, 18, NULL,
+                      CBOR_JSON_ERR_MEMERROR);
+  });
+  assert_json_with_options(data + CBOR_MAX_STACK_SIZE - 16, 17, NULL,
+                           "[[[[[[[[[[[[[[[[0]]]]]]]]]]]]]]]]");
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_ints),
+      cmocka_unit_test(test_floats),
+      cmocka_unit_test(test_simple_values),
+      cmocka_unit_test(test_strings),
+      cmocka_unit_test(test_long_strings),
+      cmocka_unit_test(test_bytestrings),
+      cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_keys),
+      cmocka_unit_test(test_tags),
+      cmocka_unit_test(test_malformed),
+      cmocka_unit_test(test_trailing_data),
+      cmocka_unit_test(test_small_buffer),
+      cmocka_unit_test(test_sink),
+      cmocka_unit_test(test_deep_nesting),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+
+static const char* test_file = "load_file_test.cbor";
+
+static void write_test_file(const unsigned char* data, size_t length) {
+  FILE* file = fopen(test_file, "wb");
+  assert_non_null(file);
+  assert_size_equal(fwrite(data, 1, length, file), length);
+  fclose(file);
+}
+
+static int teardown(void** _state _CBOR_UNUSED) {
+  remove(test_file);
+  return 0;
+}
+
+static const int all_flags[] = {CBOR_LOAD_FILE_DEFAULT, CBOR_LOAD_FILE_NO_MMAP};
+
+static void test_load_file(void** _state _CBOR_UNUSED) {
+  // [1, "abc"] followed by trailing data
+  write_test_file((unsigned char[]){0x82, 0x01, 0x63, 'a', 'b', 'c', 0xFF}, 7);
+  for (size_t i = 0; i < sizeof(all_flags) / sizeof(all_flags[0]); i++) {
+    struct cbor_load_result result;
+    cbor_item_t* item = cbor_load_file(test_file, all_flags[i], &result);
+    assert_non_null(item);
+    assert_int_equal(result.error.code, CBOR_ERR_NONE);
+    assert_size_equal(result.read, 6);
+    assert_true(cbor_isa_array(item));
+    assert_size_equal(cbor_array_size(item), 2);
+    cbor_item_t* string = cbor_array_get(item, 1);
+    assert_memory_equal(cbor_string_handle(string), "abc", 3);
+    cbor_decref(&string);
+    cbor_decref(&item);
+  }
+}
+
+static void test_load_file_missing(void** _state _CBOR_UNUSED) {
+  for (size_t i = 0; i < sizeof(all_flags) / sizeof(all_flags[0]); i++) {
+    struct cbor_load_result result;
+    assert_null(cbor_load_file("does/not/exist.cbor", all_flags[i], &result));
+    assert_int_equal(result.error.code, CBOR_ERR_IO);
+  }
+}
+
+static void test_load_file_empty(void** _state _CBOR_UNUSED) {
+  write_test_file(NULL, 0);
+  for (size_t i = 0; i < sizeof(all_flags) / sizeof(all_flags[0]); i++) {
+    struct cbor_load_result result;
+    assert_null(cbor_load_file(test_file, all_flags[i], &result));
+    assert_int_equal(result.error.code, CBOR_ERR_NODATA);
+  }
+}
+
+static void test_load_file_truncated(void** _state _CBOR_UNUSED) {
+  write_test_file((unsigned char[]){0x82, 0x01}, 2);
+  struct cbor_load_result result;
+  assert_null(cbor_load_file(test_file, CBOR_LOAD_FILE_DEFAULT, &result));
+  assert_int_equal(result.error.code, CBOR_ERR_NOTENOUGHDATA);
+}
+
+static void test_load_file_large(void** _state _CBOR_UNUSED) {
+  // Larger than the initial read buffer
+  size_t payload_size = 200000;
+  unsigned char* data = malloc(payload_size + 5);
+  data[0] = 0x5A;
+  data[1] = (unsigned char)(payload_size >> 24);
+  data[2] = (unsigned char)(payload_size >> 16);
+  data[3] = (unsigned char)(payload_size >> 8);
+  data[4] = (unsigned char)payload_size;
+  memset(data + 5, 0x42, payload_size);
+  write_test_file(data, payload_size + 5);
+  free(data);
+
+  for (size_t i = 0; i < sizeof(all_flags) / sizeof(all_flags[0]); i++) {
+    struct cbor_load_result result;
+    cbor_item_t* item = cbor_load_file(test_file, all_flags[i], &result);
+    assert_non_null(item);
+    assert_size_equal(cbor_bytestring_length(item), payload_size);
+    assert_int_equal(cbor_bytestring_handle(item)[payload_size - 1], 0x42);
+    cbor_decref(&item);
+  }
+}
+
+static bool collect_uints(cbor_item_t* item, void* context) {
+  uint64_t* sum = context;
+  *sum += cbor_get_int(item);
+  cbor_decref(&item);
+  return true;
+}
+
+static void test_load_sequence_file(void** _state _CBOR_UNUSED) {
+  write_test_file((unsigned char[]){0x01, 0x18, 0x20, 0x19, 0x01, 0x00}, 6);
+  for (size_t i = 0; i < sizeof(all_flags) / sizeof(all_flags[0]); i++) {
+    uint64_t sum = 0;
+    struct cbor_load_result result;
+    assert_size_equal(cbor_load_sequence_file(test_file, all_flags[i],
+                                              collect_uints, &sum, &result),
+                      3);
+    assert_int_equal(result.error.code, CBOR_ERR_NONE);
+    assert_size_equal(result.read, 6);
+    assert_true(sum == 1 + 32 + 256);
+  }
+}
+
+static bool stop_after_first(cbor_item_t* item, void* context _CBOR_UNUSED) {
+  cbor_decref(&item);
+  return false;
+}
+
+static void test_load_sequence_file_stop(void** _state _CBOR_UNUSED) {
+  write_test_file((unsigned char[]){0x01, 0x02, 0x03}, 3);
+  struct cbor_load_result result;
+  assert_size_equal(
+      cbor_load_sequence_file(test_file, CBOR_LOAD_FILE_DEFAULT,
+                              stop_after_first, NULL, &result),
+      1);
+  assert_int_equal(result.error.code, CBOR_ERR_NONE);
+  assert_size_equal(result.read, 1);
+}
+
+static void test_load_sequence_file_error(void** _state _CBOR_UNUSED) {
+  write_test_file((unsigned char[]){0x01, 0x02, 0x19, 0x01}, 4);
+  uint64_t sum = 0;
+  struct cbor_load_result result;
+  assert_size_equal(cbor_load_sequence_file(test_file, CBOR_LOAD_FILE_DEFAULT,
+                                            collect_uints, &sum, &result),
+                    2);
+  assert_int_equal(result.error.code, CBOR_ERR_NOTENOUGHDATA);
+  assert_size_equal(result.error.position, 2);
+  assert_size_equal(result.read, 2);
+}
+
+static void test_load_sequence_file_missing(void** _state _CBOR_UNUSED) {
+  struct cbor_load_result result;
+  assert_size_equal(
+      cbor_load_sequence_file("does/not/exist.cbor", CBOR_LOAD_FILE_DEFAULT,
+                              stop_after_first, NULL, &result),
+      0);
+  assert_int_equal(result.error.code, CBOR_ERR_IO);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_teardown(test_load_file, teardown),
+      cmocka_unit_test(test_load_file_missing),
+      cmocka_unit_test_teardown(test_load_file_empty, teardown),
+      cmocka_unit_test_teardown(test_load_file_truncated, teardown),
+      cmocka_unit_test_teardown(test_load_file_large, teardown),
+      cmocka_unit_test_teardown(test_load_sequence_file, teardown),
+      cmocka_unit_test_teardown(test_load_sequence_file_stop, teardown),
+      cmocka_unit_test_teardown(test_load_sequence_file_error, teardown),
+      cmocka_unit_test(test_load_sequence_file_missing),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -40,12 +40,13 @@ static void test_realloc_multiple(void** _state _CBOR_UNUSED) {
   unsigned char* data = malloc(1);
   data[0] = 0x2a;
 
-  data = _cbor_realloc_multiple(data, /*item_size=*/1, /*item_count=*/10);
+  data = _cbor_realloc_multiple(/*allocator=*/NULL, data, /*item_size=*/1,
+                                /*item_count=*/10);
   assert_size_equal(data[0], 0x2a);
   data[9] = 0x2b;  // Sanitizer will stop us if not ok
   free(data);
 
-  assert_null(_cbor_realloc_multiple(NULL, SIZE_MAX, 2));
+  assert_null(_cbor_realloc_multiple(/*allocator=*/NULL, NULL, SIZE_MAX, 2));
 }
 
 int main(void) {
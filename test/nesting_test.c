@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+// fileno
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+
+#include "assertions.h"
+#include "cbor.h"
+
+// Deep enough to overflow the C stack of a recursive implementation. The
+// outermost item is a map.
+#define DEEP 100001
+
+// Alternates arrays, maps, and tags around a single integer
+static cbor_item_t* build_nested(size_t depth) {
+  cbor_item_t* item = cbor_build_uint8(42);
+  for (size_t i = 0; i < depth; i++) {
+    cbor_item_t* parent;
+    switch (i % 3) {
+      case 0:
+        parent = cbor_new_definite_array(1);
+        assert_true(cbor_array_push(parent, item));
+        break;
+      case 1:
+        parent = cbor_new_indefinite_map();
+        assert_true(cbor_map_add(
+            parent, (struct cbor_pair){.key = cbor_move(cbor_build_uint8(1)),
+                                       .value = item}));
+        break;
+      default:
+        parent = cbor_build_tag(i, item);
+    }
+    cbor_decref(&item);
+    item = parent;
+  }
+  return item;
+}
+
+static void assert_same_serialization(cbor_item_t* item, cbor_item_t* other) {
+  unsigned char *buffer, *other_buffer;
+  size_t buffer_size, other_buffer_size;
+  size_t length = cbor_serialize_alloc(item, &buffer, &buffer_size);
+  assert_true(length > 0);
+  assert_size_equal(cbor_serialize_alloc(other, &other_buffer,
+                                         &other_buffer_size),
+                    length);
+  assert_memory_equal(buffer, other_buffer, length);
+  free(buffer);
+  free(other_buffer);
+}
+
+static void test_deep_serialize(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  size_t size = cbor_serialized_size(item);
+  assert_true(size > DEEP);
+
+  unsigned char* buffer = malloc(size);
+  assert_size_equal(cbor_serialize(item, buffer, size), size);
+  assert_size_equal(cbor_serialize(item, buffer, size - 1), 0);
+  // Outermost indefinite map with the key 1
+  assert_memory_equal(buffer, ((unsigned char[]){0xBF, 0x01}), 2);
+  assert_true(buffer[size - 1] == 0xFF);
+  free(buffer);
+  cbor_decref(&item);
+  assert_null(item);
+}
+
+// Checks that `file` contains exactly `expected`
+static void assert_file_contents(FILE* file, const unsigned char* expected,
+                                 size_t length) {
+  unsigned char* actual = malloc(length + 1);
+  rewind(file);
+  assert_size_equal(fread(actual, 1, length + 1, file), length);
+  assert_memory_equal(actual, expected, length);
+  free(actual);
+}
+
+static void test_deep_serialize_file(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  unsigned char* expected;
+  size_t expected_size;
+  assert_true(cbor_serialize_alloc(item, &expected, &expected_size) > 0);
+
+  FILE* file = tmpfile();
+  assert_non_null(file);
+  assert_size_equal(cbor_serialize_file(item, file), expected_size);
+  assert_file_contents(file, expected, expected_size);
+  fclose(file);
+  free(expected);
+  cbor_decref(&item);
+}
+
+#ifndef _WIN32
+static void test_deep_serialize_fd(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  unsigned char* expected;
+  size_t expected_size;
+  assert_true(cbor_serialize_alloc(item, &expected, &expected_size) > 0);
+
+  cbor_serialize_fd_mode modes[] = {CBOR_SERIALIZE_FD_STREAM,
+                                    CBOR_SERIALIZE_FD_MMAP};
+  for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    FILE* file = tmpfile();
+    assert_non_null(file);
+    assert_size_equal(cbor_serialize_fd(item, fileno(file), modes[i]),
+                      expected_size);
+    assert_file_contents(file, expected, expected_size);
+    fclose(file);
+  }
+  free(expected);
+  cbor_decref(&item);
+}
+#endif
+
+static void test_deep_serialize_iov(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  unsigned char* expected;
+  size_t expected_size;
+  assert_true(cbor_serialize_alloc(item, &expected, &expected_size) > 0);
+
+  // There are no large payloads, all the data ends up in the scratch buffer
+  unsigned char* scratch = malloc(expected_size);
+  cbor_iovec iov[4];
+  assert_size_equal(cbor_serialize_iov(item, iov, 4, scratch, expected_size),
+                    1);
+  assert_size_equal(iov[0].iov_len, expected_size);
+  assert_memory_equal(iov[0].iov_base, expected, expected_size);
+  assert_size_equal(
+      cbor_serialize_iov(item, iov, 4, scratch, expected_size - 1), 0);
+  free(scratch);
+  free(expected);
+  cbor_decref(&item);
+}
+
+static void test_deep_copy(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  cbor_item_t* copy = cbor_copy(item);
+  cbor_item_t* definite = cbor_copy_definite(item);
+  assert_same_serialization(item, copy);
+  assert_false(cbor_map_is_definite(item));
+  assert_true(cbor_map_is_definite(definite));
+  assert_size_equal(cbor_serialized_size(definite),
+                    cbor_serialized_size(item) - (DEEP + 1) / 3);
+  cbor_decref(&item);
+  cbor_decref(&copy);
+  cbor_decref(&definite);
+}
+
+static void test_deep_shared_subtree(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  cbor_item_t* outer = cbor_new_definite_array(2);
+  assert_true(cbor_array_push(outer, item));
+  assert_true(cbor_array_push(outer, item));
+  cbor_decref(&item);
+
+  cbor_item_t* copy = cbor_copy(outer);
+  cbor_decref(&outer);
+  item = cbor_array_get(copy, 1);
+  cbor_decref(&copy);
+  assert_size_equal(cbor_refcount(item), 1);
+  cbor_decref(&item);
+}
+
+static void test_deep_freeze(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(DEEP);
+  size_t size = cbor_serialized_size(item);
+  assert_true(cbor_freeze(item));
+  assert_true(cbor_is_frozen(cbor_map_handle(item)[0].value));
+  assert_size_equal(cbor_serialized_size(item), size);
+  cbor_frozen_release(&item);
+  assert_null(item);
+}
+
+static void test_load_at_depth_limit(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_nested(CBOR_MAX_STACK_SIZE - 1);
+  unsigned char* buffer;
+  size_t buffer_size;
+  size_t length = cbor_serialize_alloc(item, &buffer, &buffer_size);
+  assert_true(length > 0);
+
+  struct cbor_load_result result;
+  cbor_item_t* loaded = cbor_load(buffer, length, &result);
+  assert_non_null(loaded);
+  assert_size_equal(result.read, length);
+  assert_same_serialization(item, loaded);
+  free(buffer);
+  cbor_decref(&item);
+  cbor_decref(&loaded);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_deep_serialize),
+      cmocka_unit_test(test_deep_serialize_file),
+#ifndef _WIN32
+      cmocka_unit_test(test_deep_serialize_fd),
+#endif
+      cmocka_unit_test(test_deep_serialize_iov),
+      cmocka_unit_test(test_deep_copy),
+      cmocka_unit_test(test_deep_shared_subtree),
+      cmocka_unit_test(test_deep_freeze),
+      cmocka_unit_test(test_load_at_depth_limit),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
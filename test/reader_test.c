@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+
+struct cbor_reader reader;
+
+static void test_scalars(void** _state _CBOR_UNUSED) {
+  unsigned char data[] = {0x18, 0xFF, 0x39, 0x01, 0xF3, 0x1B, 0x80, 0x00,
+                          0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x43, 'a',
+                          'b',  'c',  0x62, 'x',  'y',  0xF9, 0x3E, 0x00,
+                          0xFB, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00,
+                          0x00, 0xF5, 0xF6, 0xF7};
+  cbor_reader_init(&reader, data, sizeof(data));
+  assert_false(cbor_reader_has_item(&reader));
+
+  uint64_t value;
+  int64_t signed_value;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_type(&reader) == CBOR_TYPE_UINT);
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_int_equal(value, 255);
+  assert_true(cbor_reader_int(&reader, &signed_value));
+  assert_int_equal(signed_value, 255);
+  assert_false(cbor_reader_negint(&reader, &value));
+  assert_false(cbor_reader_enter(&reader));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_negint(&reader, &value));
+  assert_int_equal(value, 499);
+  assert_true(cbor_reader_int(&reader, &signed_value));
+  assert_int_equal(signed_value, -500);
+
+  // Does not fit into int64_t
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_false(cbor_reader_int(&reader, &signed_value));
+
+  cbor_data string;
+  size_t length;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_bytestring(&reader, &string, &length));
+  assert_size_equal(length, 3);
+  assert_ptr_equal(string, data + 15);
+  assert_false(cbor_reader_string(&reader, &string, &length));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_string(&reader, &string, &length));
+  assert_size_equal(length, 2);
+  assert_memory_equal(string, "xy", 2);
+
+  double number;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_float(&reader, &number));
+  assert_true(number == 1.5);
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_float(&reader, &number));
+  assert_true(number == 1.0);
+
+  bool boolean;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_bool(&reader, &boolean));
+  assert_true(boolean);
+  assert_false(cbor_reader_is_null(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_is_null(&reader));
+  assert_false(cbor_reader_bool(&reader, &boolean));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_is_undef(&reader));
+
+  // Clean end of the input
+  assert_false(cbor_reader_next(&reader));
+  assert_false(cbor_reader_has_item(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_NONE);
+  assert_size_equal(cbor_reader_position(&reader), sizeof(data));
+  assert_false(cbor_reader_next(&reader));
+}
+
+static void test_containers(void** _state _CBOR_UNUSED) {
+  // {"a": [1, [2, 3], 4], "b": 1(5)}, 6
+  unsigned char data[] = {0xA2, 0x61, 'a',  0x83, 0x01, 0x82, 0x02, 0x03,
+                          0x04, 0x61, 'b',  0xC1, 0x05, 0x06};
+  cbor_reader_init(&reader, data, sizeof(data));
+
+  size_t size;
+  uint64_t value;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_map_size(&reader, &size));
+  assert_size_equal(size, 2);
+  assert_false(cbor_reader_is_indefinite(&reader));
+  assert_true(cbor_reader_enter(&reader));
+  assert_size_equal(cbor_reader_depth(&reader), 1);
+  // Already entered
+  assert_false(cbor_reader_enter(&reader));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_type(&reader) == CBOR_TYPE_STRING);
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_array_size(&reader, &size));
+  assert_size_equal(size, 3);
+  assert_true(cbor_reader_enter(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_int_equal(value, 1);
+  // Leave in the middle, skipping the nested array
+  assert_true(cbor_reader_leave(&reader));
+  assert_size_equal(cbor_reader_depth(&reader), 1);
+  assert_false(cbor_reader_has_item(&reader));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_type(&reader) == CBOR_TYPE_STRING);
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_tag(&reader, &value));
+  assert_int_equal(value, 1);
+  assert_true(cbor_reader_enter(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_int_equal(value, 5);
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_leave(&reader));
+
+  // End of the map
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_leave(&reader));
+  assert_size_equal(cbor_reader_depth(&reader), 0);
+  assert_false(cbor_reader_leave(&reader));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_int_equal(value, 6);
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_NONE);
+}
+
+static void test_indefinite(void** _state _CBOR_UNUSED) {
+  // [_ {_ 1: (_ "ab", "c")}], [_ ]
+  unsigned char data[] = {0x9F, 0xBF, 0x01, 0x7F, 0x62, 'a', 'b', 0x61,
+                          'c',  0xFF, 0xFF, 0xFF, 0x9F, 0xFF};
+  cbor_reader_init(&reader, data, sizeof(data));
+
+  size_t size;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_is_indefinite(&reader));
+  assert_false(cbor_reader_array_size(&reader, &size));
+  assert_true(cbor_reader_enter(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_type(&reader) == CBOR_TYPE_MAP);
+  assert_true(cbor_reader_enter(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_is_indefinite(&reader));
+
+  // Concatenate the chunks
+  char joined[4] = {0};
+  cbor_data chunk;
+  size_t length;
+  assert_true(cbor_reader_enter(&reader));
+  while (cbor_reader_next(&reader)) {
+    assert_true(cbor_reader_string(&reader, &chunk, &length));
+    strncat(joined, (const char*)chunk, length);
+  }
+  assert_string_equal(joined, "abc");
+  assert_true(cbor_reader_leave(&reader));
+
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_leave(&reader));
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_leave(&reader));
+
+  // Skipped without entering
+  assert_true(cbor_reader_next(&reader));
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_NONE);
+  assert_size_equal(cbor_reader_position(&reader), sizeof(data));
+}
+
+static void test_skip(void** _state _CBOR_UNUSED) {
+  // 1, [[1, 2], {_ 3: [4]}], 5
+  unsigned char data[] = {0x01, 0x82, 0x82, 0x01, 0x02, 0xBF,
+                          0x03, 0x81, 0x04, 0xFF, 0x05};
+  cbor_reader_init(&reader, data, sizeof(data));
+  assert_false(cbor_reader_skip(&reader));
+
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_skip(&reader));
+  assert_true(cbor_reader_next(&reader));
+  assert_size_equal(cbor_reader_item_position(&reader), 1);
+  assert_true(cbor_reader_skip(&reader));
+  // The skipped item stays current and its encoding is delimited
+  assert_true(cbor_reader_type(&reader) == CBOR_TYPE_ARRAY);
+  assert_size_equal(cbor_reader_item_position(&reader), 1);
+  assert_size_equal(cbor_reader_position(&reader), 10);
+  assert_size_equal(cbor_reader_depth(&reader), 0);
+  assert_false(cbor_reader_enter(&reader));
+
+  uint64_t value;
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_uint(&reader, &value));
+  assert_int_equal(value, 5);
+}
+
+static void test_nesting(void** _state _CBOR_UNUSED) {
+  // Definite items are skipped regardless of their depth
+  unsigned char deep[1001];
+  memset(deep, 0x81, 1000);
+  deep[1000] = 0x01;
+  cbor_reader_init(&reader, deep, sizeof(deep));
+  for (size_t i = 0; i < CBOR_READER_MAX_DEPTH; i++) {
+    assert_true(cbor_reader_next(&reader));
+    assert_true(cbor_reader_enter(&reader));
+  }
+  assert_true(cbor_reader_next(&reader));
+  assert_false(cbor_reader_enter(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_MEMERROR);
+  assert_size_equal(cbor_reader_error(&reader).position,
+                    CBOR_READER_MAX_DEPTH);
+
+  cbor_reader_init(&reader, deep, sizeof(deep));
+  for (size_t i = 0; i < CBOR_READER_MAX_DEPTH; i++) {
+    assert_true(cbor_reader_next(&reader));
+    assert_true(cbor_reader_enter(&reader));
+  }
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_skip(&reader));
+  assert_size_equal(cbor_reader_position(&reader), sizeof(deep));
+  for (size_t i = 0; i < CBOR_READER_MAX_DEPTH; i++)
+    assert_true(cbor_reader_leave(&reader));
+  assert_false(cbor_reader_next(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_NONE);
+
+  // Indefinite ones take up frames
+  unsigned char indefinite[2 * (CBOR_READER_MAX_DEPTH + 1)];
+  memset(indefinite, 0x9F, CBOR_READER_MAX_DEPTH + 1);
+  memset(indefinite + CBOR_READER_MAX_DEPTH + 1, 0xFF,
+         CBOR_READER_MAX_DEPTH + 1);
+  cbor_reader_init(&reader, indefinite, sizeof(indefinite));
+  assert_true(cbor_reader_next(&reader));
+  assert_false(cbor_reader_skip(&reader));
+  assert_true(cbor_reader_error(&reader).code == CBOR_ERR_MEMERROR);
+
+  cbor_reader_init(&reader, indefinite + 1, sizeof(indefinite) - 2);
+  assert_true(cbor_reader_next(&reader));
+  assert_true(cbor_reader_skip(&reader));
+}
+
+static void assert_error(cbor_data data, size_t size, cbor_error_code code,
+                         size_t position) {
+  cbor_reader_init(&reader, data, size);
+  while (cbor_reader_next(&reader) || cbor_reader_leave(&reader)) {
+    if (cbor_reader_has_item(&reader) && !cbor_reader_enter(&reader))
+      assert_true(cbor_reader_error(&reader).code == CBOR_ERR_NONE);
+  }
+  assert_true(cbor_reader_error(&reader).code == code);
+  assert_size_equal(cbor_reader_error(&reader).position, position);
+  // Errors are sticky
+  assert_false(cbor_reader_next(&reader));
+  assert_false(cbor_reader_has_item(&reader));
+
+  // Skipping finds the same errors
+  cbor_reader_init(&reader, data, size);
+  while (cbor_reader_next(&reader) && cbor_reader_skip(&reader)) {
+  }
+  assert_true(cbor_reader_error(&reader).code == code);
+}
+
+#define ASSERT_ERROR(code, position, ...)                       \
+  do {                                                          \
+    unsigned char data[] = {__VA_ARGS__};                       \
+    assert_error(data, sizeof(data), CBOR_ERR_##code, position); \
+  } while (0)
+
+static void test_errors(void** _state _CBOR_UNUSED) {
+  ASSERT_ERROR(NOTENOUGHDATA, 0, 0x19, 0x01);
+  ASSERT_ERROR(NOTENOUGHDATA, 2, 0x82, 0x01, 0x61);
+  ASSERT_ERROR(NOTENOUGHDATA, 2, 0x9F, 0x01);
+  ASSERT_ERROR(NOTENOUGHDATA, 0, 0x63, 'a', 'b');
+  ASSERT_ERROR(NOTENOUGHDATA, 0, 0x82, 0x01);
+  ASSERT_ERROR(NOTENOUGHDATA, 0, 0xA1, 0x01);
+  ASSERT_ERROR(NOTENOUGHDATA, 1, 0xC1);
+  ASSERT_ERROR(MALFORMATED, 1, 0x81, 0x1C);
+  ASSERT_ERROR(MALFORMATED, 1, 0x81, 0xF8, 0x20);
+  ASSERT_ERROR(MALFORMATED, 0, 0x1F);
+  ASSERT_ERROR(MALFORMATED, 0, 0xDF);
+  ASSERT_ERROR(SYNTAXERROR, 0, 0xFF);
+  ASSERT_ERROR(SYNTAXERROR, 1, 0x81, 0xFF);
+  ASSERT_ERROR(SYNTAXERROR, 1, 0xC1, 0xFF);
+  ASSERT_ERROR(SYNTAXERROR, 2, 0xBF, 0x01, 0xFF);
+  ASSERT_ERROR(SYNTAXERROR, 1, 0x7F, 0x41, 'a', 0xFF);
+  ASSERT_ERROR(SYNTAXERROR, 1, 0x5F, 0x5F, 0xFF, 0xFF);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_scalars),    cmocka_unit_test(test_containers),
+      cmocka_unit_test(test_indefinite), cmocka_unit_test(test_skip),
+      cmocka_unit_test(test_nesting),    cmocka_unit_test(test_errors),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "assertions.h"
+#include "cbor.h"
+
+#ifdef HAS_PTHREADS
+#include <pthread.h>
+#endif
+
+static void test_incref_decref(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = cbor_new_definite_array(1);
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_uint8(1))));
+  assert_size_equal(cbor_refcount(item), 1);
+
+  assert_ptr_equal(cbor_incref(item), item);
+  assert_size_equal(cbor_refcount(item), 2);
+
+  cbor_item_t* reference = item;
+  cbor_decref(&reference);
+  assert_ptr_equal(reference, item);
+  assert_size_equal(cbor_refcount(item), 1);
+
+  cbor_decref(&item);
+  assert_null(item);
+}
+
+static void test_move(void** _state _CBOR_UNUSED) {
+  cbor_item_t* array = cbor_new_definite_array(1);
+  cbor_item_t* value = cbor_build_uint8(1);
+  assert_ptr_equal(cbor_move(value), value);
+  assert_size_equal(cbor_refcount(value), 0);
+  assert_true(cbor_array_push(array, value));
+  assert_size_equal(cbor_refcount(value), 1);
+  cbor_decref(&array);
+}
+
+#ifdef HAS_PTHREADS
+
+#define THREADS 8
+#define ROUNDS 20000
+
+// Uses and releases a reference to ["ab"]. cmocka assertions are not thread
+// safe, so mismatches are reported through the return value instead.
+static void* share(void* context) {
+  cbor_item_t* item = context;
+  bool ok = true;
+  for (size_t i = 0; i < ROUNDS; i++) {
+    cbor_item_t* reference = cbor_incref(item);
+    cbor_item_t* member = cbor_array_get(reference, 0);
+    ok &= cbor_string_length(member) == 2;
+    ok &= cbor_serialized_size(reference) == 4;
+    cbor_decref(&member);
+    cbor_decref(&reference);
+  }
+  cbor_decref(&item);
+  return ok ? context : NULL;
+}
+
+static cbor_item_t* build_shared(void) {
+  cbor_item_t* item = cbor_new_definite_array(1);
+  assert_true(cbor_array_push(item, cbor_move(cbor_build_string("ab"))));
+  return item;
+}
+
+static void join(pthread_t* threads) {
+  for (size_t i = 0; i < THREADS; i++) {
+    void* result;
+    assert_int_equal(pthread_join(threads[i], &result), 0);
+    assert_non_null(result);
+  }
+}
+
+#if CBOR_ATOMIC_REFCOUNT
+static void test_shared_between_threads(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_shared();
+
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    assert_int_equal(
+        pthread_create(&threads[i], NULL, share, cbor_incref(item)), 0);
+  join(threads);
+
+  assert_size_equal(cbor_refcount(item), 1);
+  cbor_item_t* member = cbor_array_get(item, 0);
+  assert_size_equal(cbor_refcount(member), 2);
+  cbor_decref(&member);
+  cbor_decref(&item);
+}
+
+static void test_last_owner_destroys(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_shared();
+
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    assert_int_equal(
+        pthread_create(&threads[i], NULL, share, cbor_incref(item)), 0);
+  // Release the original reference while the workers are still running
+  cbor_decref(&item);
+  join(threads);
+}
+#endif
+
+// Frozen trees can be shared regardless of CBOR_ATOMIC_REFCOUNT
+static void test_frozen_shared_between_threads(void** _state _CBOR_UNUSED) {
+  cbor_item_t* item = build_shared();
+  assert_true(cbor_freeze(item));
+
+  pthread_t threads[THREADS];
+  for (size_t i = 0; i < THREADS; i++)
+    assert_int_equal(
+        pthread_create(&threads[i], NULL, share, cbor_incref(item)), 0);
+  join(threads);
+
+  assert_true(cbor_is_frozen(item));
+  cbor_frozen_release(&item);
+}
+
+#endif
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_incref_decref),
+      cmocka_unit_test(test_move),
+#ifdef HAS_PTHREADS
+#if CBOR_ATOMIC_REFCOUNT
+      cmocka_unit_test(test_shared_between_threads),
+      cmocka_unit_test(test_last_owner_destroys),
+#endif
+      cmocka_unit_test(test_frozen_shared_between_threads),
+#endif
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -156,6 +156,38 @@ void string_start_callback(void* _context _CBOR_UNUSED) {
   current_expectation++;
 }
 
+void assert_bstring_chunk_eq(cbor_data address, size_t length,
+                             uint64_t remaining) {
+  assertions_queue[queue_size++] = (struct test_assertion){
+      BSTRING_CHUNK_EQ,
+      (union test_expectation_data){.chunk = {address, length, remaining}}};
+}
+
+void byte_string_chunk_callback(void* _context _CBOR_UNUSED, cbor_data address,
+                                uint64_t length, uint64_t remaining) {
+  assert_true(current().expectation == BSTRING_CHUNK_EQ);
+  assert_true(current().data.chunk.address == address);
+  assert_true(current().data.chunk.length == length);
+  assert_true(current().data.chunk.remaining == remaining);
+  current_expectation++;
+}
+
+void assert_string_chunk_eq(cbor_data address, size_t length,
+                            uint64_t remaining) {
+  assertions_queue[queue_size++] = (struct test_assertion){
+      STRING_CHUNK_EQ,
+      (union test_expectation_data){.chunk = {address, length, remaining}}};
+}
+
+void string_chunk_callback(void* _context _CBOR_UNUSED, cbor_data address,
+                           uint64_t length, uint64_t remaining) {
+  assert_true(current().expectation == STRING_CHUNK_EQ);
+  assert_true(current().data.chunk.address == address);
+  assert_true(current().data.chunk.length == length);
+  assert_true(current().data.chunk.remaining == remaining);
+  current_expectation++;
+}
+
 void assert_indef_break(void) {
   assertions_queue[queue_size++] =
       (struct test_assertion){.expectation = INDEF_BREAK};
@@ -314,7 +346,10 @@ const struct cbor_callbacks asserting_callbacks = {
     .undefined = &undef_callback,
     .boolean = &bool_callback,
     .null = &null_callback,
-    .indef_break = &indef_break_callback};
+    .indef_break = &indef_break_callback,
+
+    .byte_string_chunk = &byte_string_chunk_callback,
+    .string_chunk = &string_chunk_callback};
 
 struct cbor_decoder_result decode(cbor_data source, size_t source_size) {
   int last_expectation = current_expectation;
@@ -326,3 +361,14 @@ struct cbor_decoder_result decode(cbor_data source, size_t source_size) {
   }
   return result;
 }
+
+struct cbor_decoder_result decode_partial(cbor_data source, size_t source_size,
+                                          struct cbor_stream_state* state) {
+  int last_expectation = current_expectation;
+  struct cbor_decoder_result result = cbor_stream_decode_partial(
+      source, source_size, &asserting_callbacks, NULL, state);
+  if (result.status == CBOR_DECODER_FINISHED) {
+    assert_true(last_expectation + 1 == current_expectation);
+  }
+  return result;
+}
@@ -36,6 +36,10 @@ enum test_expectation {
   STRING_MEM_EQ,
   STRING_INDEF_START,
 
+  // Matches length, memory address, and the remaining length of string parts
+  BSTRING_CHUNK_EQ,
+  STRING_CHUNK_EQ,
+
   ARRAY_START, /* Definite arrays only */
   ARRAY_INDEF_START,
 
@@ -62,6 +66,11 @@ union test_expectation_data {
     cbor_data address;
     size_t length;
   } string;
+  struct chunk {
+    cbor_data address;
+    size_t length;
+    uint64_t remaining;
+  } chunk;
   size_t length;
   float float2;
   float float4;
@@ -74,9 +83,16 @@ struct test_assertion {
   union test_expectation_data data;
 };
 
+/* Callbacks that check the assertions */
+extern const struct cbor_callbacks asserting_callbacks;
+
 /* Test harness -- calls `cbor_stream_decode` and checks assertions */
 struct cbor_decoder_result decode(cbor_data, size_t);
 
+/* Same as `decode`, using `cbor_stream_decode_partial` */
+struct cbor_decoder_result decode_partial(cbor_data, size_t,
+                                          struct cbor_stream_state*);
+
 /* Verify all assertions were applied and clean up */
 int clean_up_stream_assertions(void**);
 
@@ -97,6 +113,9 @@ void assert_bstring_indef_start(void);
 void assert_string_mem_eq(cbor_data, size_t);
 void assert_string_indef_start(void);
 
+void assert_bstring_chunk_eq(cbor_data, size_t, uint64_t);
+void assert_string_chunk_eq(cbor_data, size_t, uint64_t);
+
 void assert_array_start(size_t);
 void assert_indef_array_start(void);
 
@@ -132,6 +151,9 @@ void byte_string_start_callback(void*);
 void string_callback(void*, cbor_data, uint64_t);
 void string_start_callback(void*);
 
+void byte_string_chunk_callback(void*, cbor_data, uint64_t, uint64_t);
+void string_chunk_callback(void*, cbor_data, uint64_t, uint64_t);
+
 void array_start_callback(void*, uint64_t);
 void indef_array_start_callback(void*);
 
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include "cbor/internal/uint_kernels.h"
+#include "assertions.h"
+#include "cbor/big_endian.h"
+
+static void test_bswap(void** _state _CBOR_UNUSED) {
+  assert_true(_cbor_bswap16(0x0102) == 0x0201);
+  assert_true(_cbor_bswap32(0x01020304) == 0x04030201);
+  assert_true(_cbor_bswap64(0x0102030405060708) == 0x0807060504030201);
+}
+
+static void test_load_be(void** _state _CBOR_UNUSED) {
+  // Offset by one to exercise unaligned access
+  unsigned char data[] = {0x00, 0x01, 0x02, 0x03, 0x04,
+                          0x05, 0x06, 0x07, 0x08};
+  assert_true(_cbor_load_be16(data + 1) == 0x0102);
+  assert_true(_cbor_load_be32(data + 1) == 0x01020304);
+  assert_true(_cbor_load_be64(data + 1) == 0x0102030405060708);
+}
+
+static void test_public_load_store(void** _state _CBOR_UNUSED) {
+  // Matches the internal kernels regardless of the alignment
+  unsigned char data[] = {0x00, 0x01, 0x02, 0x03, 0x04,
+                          0x05, 0x06, 0x07, 0x08};
+  assert_true(cbor_load_uint16(data + 1) == 0x0102);
+  assert_true(cbor_load_uint32(data + 1) == 0x01020304);
+  assert_true(cbor_load_uint64(data + 1) == 0x0102030405060708);
+
+  unsigned char half[] = {0x00, 0x3E, 0x00};
+  assert_true(cbor_load_half(half + 1) == 1.5f);
+  unsigned char single[] = {0x00, 0x47, 0xC3, 0x50, 0x00};
+  assert_true(cbor_load_float(single + 1) == 100000.0f);
+  unsigned char wide[] = {0x00, 0x3F, 0xF1, 0x99, 0x99,
+                          0x99, 0x99, 0x99, 0x9A};
+  assert_true(cbor_load_double(wide + 1) == 1.1);
+
+  unsigned char stored[9] = {0};
+  cbor_store_uint16(stored + 1, 0x0102);
+  assert_memory_equal(stored + 1, data + 1, 2);
+  cbor_store_uint32(stored + 1, 0x01020304);
+  assert_memory_equal(stored + 1, data + 1, 4);
+  cbor_store_uint64(stored + 1, 0x0102030405060708);
+  assert_memory_equal(stored + 1, data + 1, 8);
+}
+
+static void test_store_be(void** _state _CBOR_UNUSED) {
+  unsigned char data[9] = {0};
+  _cbor_store_be16(data + 1, 0x0102);
+  assert_memory_equal(data + 1, ((unsigned char[]){0x01, 0x02}), 2);
+  _cbor_store_be32(data + 1, 0x01020304);
+  assert_memory_equal(data + 1, ((unsigned char[]){0x01, 0x02, 0x03, 0x04}),
+                      4);
+  _cbor_store_be64(data + 1, 0x0102030405060708);
+  assert_memory_equal(
+      data + 1,
+      ((unsigned char[]){0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}), 8);
+}
+
+static void test_clz(void** _state _CBOR_UNUSED) {
+  assert_int_equal(_cbor_clz64(1), 63);
+  assert_int_equal(_cbor_clz64(0xFF), 56);
+  assert_int_equal(_cbor_clz64(0x100000000), 31);
+  assert_int_equal(_cbor_clz64(UINT64_MAX), 0);
+}
+
+static void test_width(void** _state _CBOR_UNUSED) {
+  assert_int_equal(_cbor_uint_width_log2(0), 0);
+  assert_int_equal(_cbor_uint_width_log2(UINT8_MAX), 0);
+  assert_int_equal(_cbor_uint_width_log2(UINT8_MAX + 1), 1);
+  assert_int_equal(_cbor_uint_width_log2(UINT16_MAX), 1);
+  assert_int_equal(_cbor_uint_width_log2(UINT16_MAX + 1), 2);
+  assert_int_equal(_cbor_uint_width_log2(0xFFFFFF + 1), 2);
+  assert_int_equal(_cbor_uint_width_log2(UINT32_MAX), 2);
+  assert_int_equal(_cbor_uint_width_log2((uint64_t)UINT32_MAX + 1), 3);
+  assert_int_equal(_cbor_uint_width_log2(UINT64_MAX), 3);
+}
+
+static void test_header_size(void** _state _CBOR_UNUSED) {
+  assert_size_equal(_cbor_uint_header_size(0), 1);
+  assert_size_equal(_cbor_uint_header_size(23), 1);
+  assert_size_equal(_cbor_uint_header_size(24), 2);
+  assert_size_equal(_cbor_uint_header_size(UINT8_MAX), 2);
+  assert_size_equal(_cbor_uint_header_size(UINT8_MAX + 1), 3);
+  assert_size_equal(_cbor_uint_header_size(UINT16_MAX), 3);
+  assert_size_equal(_cbor_uint_header_size(UINT16_MAX + 1), 5);
+  assert_size_equal(_cbor_uint_header_size(UINT32_MAX), 5);
+  assert_size_equal(_cbor_uint_header_size((uint64_t)UINT32_MAX + 1), 9);
+  assert_size_equal(_cbor_uint_header_size(UINT64_MAX), 9);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_bswap),      cmocka_unit_test(test_load_be),
+      cmocka_unit_test(test_store_be),   cmocka_unit_test(test_clz),
+      cmocka_unit_test(test_width),      cmocka_unit_test(test_header_size),
+      cmocka_unit_test(test_public_load_store),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
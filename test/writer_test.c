@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+#include <string.h>
+
+#include "assertions.h"
+#include "cbor.h"
+
+struct cbor_writer_memory output;
+struct cbor_writer* writer;
+size_t sink_calls;
+
+static bool counting_sink(void* context, cbor_data data, size_t length) {
+  sink_calls++;
+  return cbor_writer_memory_sink(context, data, length);
+}
+
+static bool failing_sink(void* context _CBOR_UNUSED,
+                         cbor_data data _CBOR_UNUSED,
+                         size_t length _CBOR_UNUSED) {
+  return false;
+}
+
+static void setup_writer(size_t buffer_size) {
+  output = (struct cbor_writer_memory){0};
+  sink_calls = 0;
+  writer = cbor_writer_new(buffer_size, counting_sink, &output);
+  assert_non_null(writer);
+}
+
+static int teardown(void** _state _CBOR_UNUSED) {
+  cbor_writer_free(writer);
+  writer = NULL;
+  free(output.data);
+  output = (struct cbor_writer_memory){0};
+  return 0;
+}
+
+static void test_buffer_too_small(void** _state _CBOR_UNUSED) {
+  assert_null(cbor_writer_new(8, counting_sink, &output));
+}
+
+static void test_scalars(void** _state _CBOR_UNUSED) {
+  setup_writer(64);
+  assert_true(cbor_writer_uint(writer, 1000));
+  assert_true(cbor_writer_negint(writer, 0));
+  assert_true(cbor_writer_bool(writer, true));
+  assert_true(cbor_writer_null(writer));
+  assert_true(cbor_writer_undef(writer));
+  assert_true(cbor_writer_half(writer, 1.0f));
+  assert_true(cbor_writer_single(writer, 1.0f));
+  assert_true(cbor_writer_double(writer, 1.0));
+  // Nothing is passed to the sink until the buffer fills up
+  assert_size_equal(sink_calls, 0);
+  assert_true(cbor_writer_finish(writer));
+  assert_size_equal(sink_calls, 1);
+
+  unsigned char expected[] = {0x19, 0x03, 0xE8, 0x20, 0xF5, 0xF6, 0xF7,
+                              0xF9, 0x3C, 0x00, 0xFA, 0x3F, 0x80, 0x00,
+                              0x00, 0xFB, 0x3F, 0xF0, 0x00, 0x00, 0x00,
+                              0x00, 0x00, 0x00};
+  assert_size_equal(output.length, sizeof(expected));
+  assert_memory_equal(output.data, expected, sizeof(expected));
+}
+
+static void test_nested_containers(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_array_begin(writer, 2));
+  assert_true(cbor_writer_tag(writer, 1));
+  assert_true(cbor_writer_indef_map_begin(writer));
+  assert_true(cbor_writer_string(writer, "a", 1));
+  assert_true(cbor_writer_indef_array_begin(writer));
+  assert_size_equal(cbor_writer_depth(writer), 3);
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_map_begin(writer, 1));
+  assert_true(cbor_writer_uint(writer, 1));
+  assert_true(cbor_writer_uint(writer, 2));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_finish(writer));
+
+  unsigned char expected[] = {0x82, 0xC1, 0xBF, 0x61, 0x61, 0x9F, 0xFF,
+                              0xFF, 0xA1, 0x01, 0x02};
+  assert_size_equal(output.length, sizeof(expected));
+  assert_memory_equal(output.data, expected, sizeof(expected));
+}
+
+static void test_indef_strings(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_indef_bytestring_begin(writer));
+  assert_true(cbor_writer_bytestring(writer, (cbor_data) "\x01", 1));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_indef_string_begin(writer));
+  assert_true(cbor_writer_string(writer, "b", 1));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_finish(writer));
+
+  unsigned char expected[] = {0x5F, 0x41, 0x01, 0xFF, 0x7F, 0x61, 0x62, 0xFF};
+  assert_size_equal(output.length, sizeof(expected));
+  assert_memory_equal(output.data, expected, sizeof(expected));
+}
+
+static void test_small_buffer_flushes(void** _state _CBOR_UNUSED) {
+  setup_writer(9);
+  assert_true(cbor_writer_indef_array_begin(writer));
+  for (int i = 0; i < 10; i++) {
+    assert_true(cbor_writer_uint(writer, UINT64_MAX));
+  }
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_finish(writer));
+
+  assert_true(sink_calls >= 10);
+  assert_size_equal(output.length, 1 + 10 * 9 + 1);
+  assert_int_equal(output.data[0], 0x9F);
+  assert_int_equal(output.data[1], 0x1B);
+  assert_int_equal(output.data[output.length - 1], 0xFF);
+}
+
+static void test_large_payload_bypass(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  unsigned char payload[100];
+  memset(payload, 0xAB, sizeof(payload));
+  assert_true(cbor_writer_uint(writer, 1));
+  assert_true(cbor_writer_bytestring(writer, payload, sizeof(payload)));
+  assert_true(cbor_writer_finish(writer));
+
+  // Buffered header, payload passed through directly
+  assert_size_equal(sink_calls, 2);
+  assert_size_equal(output.length, 1 + 2 + sizeof(payload));
+  assert_int_equal(output.data[0], 0x01);
+  assert_int_equal(output.data[1], 0x58);
+  assert_int_equal(output.data[2], 100);
+  assert_memory_equal(output.data + 3, payload, sizeof(payload));
+}
+
+static void test_definite_array_overflow(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_array_begin(writer, 1));
+  assert_true(cbor_writer_uint(writer, 1));
+  assert_false(cbor_writer_uint(writer, 2));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+  // Errors are sticky
+  assert_false(cbor_writer_end(writer));
+  assert_false(cbor_writer_finish(writer));
+}
+
+static void test_definite_array_underflow(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_array_begin(writer, 2));
+  assert_true(cbor_writer_uint(writer, 1));
+  assert_false(cbor_writer_end(writer));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_indef_map_odd_items(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_indef_map_begin(writer));
+  assert_true(cbor_writer_uint(writer, 1));
+  assert_false(cbor_writer_end(writer));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_indef_string_wrong_chunk(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_indef_string_begin(writer));
+  assert_false(cbor_writer_bytestring(writer, (cbor_data) "a", 1));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_unclosed(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_indef_array_begin(writer));
+  assert_false(cbor_writer_finish(writer));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_dangling_tag(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_true(cbor_writer_indef_array_begin(writer));
+  assert_true(cbor_writer_tag(writer, 1));
+  assert_false(cbor_writer_end(writer));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_unbalanced_end(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  assert_false(cbor_writer_end(writer));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_NESTING);
+}
+
+static void test_deep_nesting(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  for (int i = 0; i < 100; i++) {
+    assert_true(cbor_writer_array_begin(writer, 1));
+  }
+  assert_true(cbor_writer_null(writer));
+  for (int i = 0; i < 100; i++) {
+    assert_true(cbor_writer_end(writer));
+  }
+  assert_true(cbor_writer_finish(writer));
+  assert_size_equal(output.length, 101);
+}
+
+static void test_item(void** _state _CBOR_UNUSED) {
+  setup_writer(16);
+  unsigned char payload[40];
+  memset(payload, 0xCD, sizeof(payload));
+  cbor_item_t* item = cbor_new_indefinite_map();
+  assert_true(cbor_map_add(
+      item,
+      (struct cbor_pair){
+          .key = cbor_move(cbor_build_uint16(1)),
+          .value = cbor_move(cbor_build_bytestring(payload, sizeof(payload)))}));
+  assert_true(cbor_map_add(
+      item, (struct cbor_pair){
+                .key = cbor_move(cbor_build_tag(2, cbor_move(cbor_new_null()))),
+                .value = cbor_move(cbor_build_float4(1.5f))}));
+
+  assert_true(cbor_writer_item(writer, item));
+  assert_true(cbor_writer_finish(writer));
+
+  unsigned char expected[64];
+  size_t expected_size = cbor_serialize(item, expected, sizeof(expected));
+  assert_size_equal(output.length, expected_size);
+  assert_memory_equal(output.data, expected, expected_size);
+  cbor_decref(&item);
+}
+
+static void test_sink_failure(void** _state _CBOR_UNUSED) {
+  output = (struct cbor_writer_memory){0};
+  writer = cbor_writer_new(9, failing_sink, NULL);
+  assert_true(cbor_writer_uint(writer, UINT64_MAX));
+  assert_false(cbor_writer_uint(writer, 1));
+  assert_int_equal(cbor_writer_error(writer), CBOR_WRITER_ERR_SINK);
+  assert_false(cbor_writer_flush(writer));
+}
+
+static void test_file_sink(void** _state _CBOR_UNUSED) {
+  output = (struct cbor_writer_memory){0};
+  FILE* file = tmpfile();
+  assert_non_null(file);
+  writer = cbor_writer_new(16, cbor_writer_file_sink, file);
+  assert_true(cbor_writer_array_begin(writer, 1));
+  assert_true(cbor_writer_string(writer, "hello", 5));
+  assert_true(cbor_writer_end(writer));
+  assert_true(cbor_writer_finish(writer));
+
+  rewind(file);
+  unsigned char read_back[16];
+  assert_size_equal(fread(read_back, 1, sizeof(read_back), file), 7);
+  assert_memory_equal(read_back, "\x81\x65hello", 7);
+  fclose(file);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_buffer_too_small),
+      cmocka_unit_test_teardown(test_scalars, teardown),
+      cmocka_unit_test_teardown(test_nested_containers, teardown),
+      cmocka_unit_test_teardown(test_indef_strings, teardown),
+      cmocka_unit_test_teardown(test_small_buffer_flushes, teardown),
+      cmocka_unit_test_teardown(test_large_payload_bypass, teardown),
+      cmocka_unit_test_teardown(test_definite_array_overflow, teardown),
+      cmocka_unit_test_teardown(test_definite_array_underflow, teardown),
+      cmocka_unit_test_teardown(test_indef_map_odd_items, teardown),
+      cmocka_unit_test_teardown(test_indef_string_wrong_chunk, teardown),
+      cmocka_unit_test_teardown(test_unclosed, teardown),
+      cmocka_unit_test_teardown(test_dangling_tag, teardown),
+      cmocka_unit_test_teardown(test_unbalanced_end, teardown),
+      cmocka_unit_test_teardown(test_deep_nesting, teardown),
+      cmocka_unit_test_teardown(test_item, teardown),
+      cmocka_unit_test_teardown(test_sink_failure, teardown),
+      cmocka_unit_test_teardown(test_file_sink, teardown),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
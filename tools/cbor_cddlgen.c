@@ -0,0 +1,1459 @@
+/*
+ * Copyright (c) 2014-2020 Pavel Kalvoda <me@pavelkalvoda.com>
+ *
+ * libcbor is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See LICENSE for details.
+ */
+
+/*
+ * Generates C structs with encoders and decoders from a CDDL (RFC 8610)
+ * schema. Usage:
+ *
+ *   cbor_cddlgen schema.cddl output.h output.c
+ *
+ * Every rule defining a map or an array becomes a struct with
+ *
+ *   size_t <rule>_encode(const struct <rule>*, unsigned char*, size_t);
+ *   size_t <rule>_decode(cbor_data, size_t, struct <rule>*);
+ *
+ * The generated code uses the cbor_encode_* functions and the header loaders
+ * directly, so no cbor_item_t is built, and decoding allocates nothing:
+ * strings point into the input and arrays have a fixed capacity.
+ *
+ * Supported subset of CDDL:
+ *  - Types uint, nint, int, bool, float16, float32, float64, float, tstr
+ *    (text), bstr (bytes), references to other rules, and literal integers and
+ *    text strings as map keys.
+ *  - Maps of `key: type`, `"key": type`, and `key => type` entries, where the
+ *    key of `=>` is an integer, a text string, or a rule defining one. Entries
+ *    can be optional (`?`). Other keys are rejected when decoding.
+ *  - Arrays of (optionally named) entries, and arrays of a single type with an
+ *    upper bound on the number of items, e.g. `[0*8 uint]` or `[*16 tstr]`.
+ *  - Maps and arrays nested in other rules, which get a struct named after
+ *    the rule and the entry.
+ * Choices, groups, sockets, controls, and recursive types are not supported.
+ */
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* schema_path;
+
+static void fail(int line, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "%s:%d: error: ", schema_path, line);
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  exit(1);
+}
+
+/* All memory is kept until the generator exits */
+struct allocation {
+  struct allocation* next;
+  union {
+    long double number;
+    void* pointer;
+  } data[];
+};
+
+static struct allocation* allocations;
+
+static void release_allocations(void) {
+  while (allocations != NULL) {
+    struct allocation* next = allocations->next;
+    free(allocations);
+    allocations = next;
+  }
+}
+
+static void* allocate(size_t size) {
+  struct allocation* allocation = calloc(1, sizeof(struct allocation) + size);
+  if (allocation == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  allocation->next = allocations;
+  allocations = allocation;
+  return allocation->data;
+}
+
+static void* grow(void* array, size_t* capacity, size_t count,
+                  size_t element_size) {
+  if (count < *capacity) return array;
+  void* grown = allocate(2 * (*capacity + 4) * element_size);
+  if (count > 0) memcpy(grown, array, count * element_size);
+  *capacity = 2 * (*capacity + 4);
+  return grown;
+}
+
+static char* duplicate(const char* text, size_t length) {
+  char* copy = allocate(length + 1);
+  memcpy(copy, text, length);
+  return copy;
+}
+
+/*
+ * ============================================================================
+ * Tokens
+ * ============================================================================
+ */
+
+enum token_kind { TOKEN_END, TOKEN_ID, TOKEN_INT, TOKEN_TEXT, TOKEN_PUNCT };
+
+struct token {
+  enum token_kind kind;
+  /** Identifier, text string contents, or punctuation */
+  char* text;
+  /** Absolute value of an integer */
+  uint64_t magnitude;
+  bool negative;
+  int line;
+};
+
+static struct token* tokens;
+static size_t token_count;
+
+static bool is_id_start(char c) {
+  return isalpha((unsigned char)c) || c == '_' || c == '@' || c == '$';
+}
+
+static bool is_id_char(char c) {
+  return is_id_start(c) || isdigit((unsigned char)c) || c == '-' || c == '.';
+}
+
+static void add_token(struct token token) {
+  static size_t capacity;
+  tokens = grow(tokens, &capacity, token_count, sizeof(struct token));
+  tokens[token_count++] = token;
+}
+
+static void tokenize(const char* input) {
+  int line = 1;
+  const char* c = input;
+  while (*c != '\0') {
+    if (*c == '\n') {
+      line++;
+      c++;
+    } else if (isspace((unsigned char)*c)) {
+      c++;
+    } else if (*c == ';') {
+      while (*c != '\0' && *c != '\n') c++;
+    } else if (isdigit((unsigned char)*c) ||
+               (*c == '-' && isdigit((unsigned char)c[1]))) {
+      struct token token = {.kind = TOKEN_INT, .line = line};
+      if (*c == '-') {
+        token.negative = true;
+        c++;
+      }
+      const char* start = c;
+      for (; isdigit((unsigned char)*c); c++) {
+        uint64_t digit = (uint64_t)(*c - '0');
+        if (token.magnitude > (UINT64_MAX - digit) / 10)
+          fail(line, "integer out of range");
+        token.magnitude = token.magnitude * 10 + digit;
+      }
+      if (*c == '.' && isdigit((unsigned char)c[1]))
+        fail(line, "floating-point literals are not supported");
+      token.text = duplicate(start, (size_t)(c - start));
+      add_token(token);
+    } else if (is_id_start(*c)) {
+      const char* start = c;
+      while (is_id_char(*c)) c++;
+      // Identifiers do not end with '-' or '.'
+      while (c[-1] == '-' || c[-1] == '.') c--;
+      add_token((struct token){.kind = TOKEN_ID,
+                               .text = duplicate(start, (size_t)(c - start)),
+                               .line = line});
+    } else if (*c == '"') {
+      const char* start = ++c;
+      while (*c != '"') {
+        if (*c == '\0' || *c == '\n') fail(line, "unterminated text string");
+        if (*c == '\\') fail(line, "escape sequences are not supported");
+        c++;
+      }
+      add_token((struct token){.kind = TOKEN_TEXT,
+                               .text = duplicate(start, (size_t)(c - start)),
+                               .line = line});
+      c++;
+    } else if (strncmp(c, "=>", 2) == 0) {
+      add_token((struct token){
+          .kind = TOKEN_PUNCT, .text = duplicate(c, 2), .line = line});
+      c += 2;
+    } else if (strchr("={}[](),:?*+/", *c) != NULL) {
+      add_token((struct token){
+          .kind = TOKEN_PUNCT, .text = duplicate(c, 1), .line = line});
+      c++;
+    } else {
+      fail(line, "unexpected character '%c'", *c);
+    }
+  }
+  add_token((struct token){.kind = TOKEN_END, .text = "", .line = line});
+}
+
+/*
+ * ============================================================================
+ * Schema
+ * ============================================================================
+ */
+
+enum type_kind {
+  TYPE_UINT,
+  TYPE_NINT,
+  TYPE_INT,
+  TYPE_BOOL,
+  TYPE_FLOAT16,
+  TYPE_FLOAT32,
+  TYPE_FLOAT64,
+  TYPE_TSTR,
+  TYPE_BSTR,
+  /** Reference to another rule */
+  TYPE_RULE,
+  TYPE_MAP,
+  /** Array of entries of different types */
+  TYPE_RECORD,
+  /** Array of items of the same type */
+  TYPE_VECTOR,
+  TYPE_LITERAL_INT,
+  TYPE_LITERAL_TEXT
+};
+
+static const struct {
+  const char* name;
+  enum type_kind kind;
+} primitives[] = {
+    {"uint", TYPE_UINT},       {"nint", TYPE_NINT},
+    {"int", TYPE_INT},         {"bool", TYPE_BOOL},
+    {"float16", TYPE_FLOAT16}, {"float32", TYPE_FLOAT32},
+    {"float64", TYPE_FLOAT64}, {"float", TYPE_FLOAT64},
+    {"tstr", TYPE_TSTR},       {"text", TYPE_TSTR},
+    {"bstr", TYPE_BSTR},       {"bytes", TYPE_BSTR},
+};
+
+struct rule;
+struct field;
+
+struct type {
+  enum type_kind kind;
+  int line;
+  /** Name of the referenced rule before resolution */
+  char* reference;
+  struct rule* rule;
+  /** Entries of maps and records */
+  struct field* fields;
+  size_t field_count;
+  /** Item type and bounds of vectors */
+  struct type* element;
+  uint64_t min;
+  uint64_t max;
+  /** Value of literals */
+  bool negative;
+  uint64_t magnitude;
+  char* text;
+};
+
+struct field {
+  /** C identifier */
+  char* name;
+  /** Key of a map entry, a literal type */
+  struct type* key;
+  bool optional;
+  struct type* type;
+  int line;
+};
+
+struct rule {
+  char* name;
+  /** C identifier */
+  char* c_name;
+  struct type* type;
+  int line;
+  /** Emission state: 0 not yet, 1 in progress, 2 emitted */
+  int state;
+};
+
+static struct rule** rules;
+static size_t rule_count;
+
+static struct rule* find_rule(const char* name) {
+  for (size_t i = 0; i < rule_count; i++)
+    if (strcmp(rules[i]->name, name) == 0) return rules[i];
+  return NULL;
+}
+
+static struct rule* add_rule(char* name, struct type* type, int line) {
+  static size_t capacity;
+  if (find_rule(name) != NULL) fail(line, "duplicate rule '%s'", name);
+  rules = grow(rules, &capacity, rule_count, sizeof(struct rule*));
+  struct rule* rule = allocate(sizeof(struct rule));
+  *rule = (struct rule){.name = name, .type = type, .line = line};
+  rules[rule_count++] = rule;
+  return rule;
+}
+
+static const char* const c_keywords[] = {
+    "auto",   "bool",     "break",  "case",     "char",   "const",
+    "continue", "default", "do",    "double",   "else",   "enum",
+    "extern", "float",    "for",    "goto",     "if",     "inline",
+    "int",    "long",     "register", "restrict", "return", "short",
+    "signed", "sizeof",   "static", "struct",   "switch", "typedef",
+    "union",  "unsigned", "void",   "volatile", "while",  "value",
+    "cursor", "end"};
+
+/** Convert a CDDL name to a C identifier */
+static char* c_identifier(const char* name) {
+  size_t length = strlen(name);
+  char* identifier = allocate(length + 2);
+  for (size_t i = 0; i < length; i++)
+    identifier[i] = isalnum((unsigned char)name[i]) ? name[i] : '_';
+  for (size_t i = 0; i < sizeof(c_keywords) / sizeof(c_keywords[0]); i++)
+    if (strcmp(identifier, c_keywords[i]) == 0) identifier[length] = '_';
+  return identifier;
+}
+
+/*
+ * ============================================================================
+ * Parser
+ * ============================================================================
+ */
+
+static size_t position;
+
+static struct token* peek(size_t offset) {
+  size_t index = position + offset;
+  return &tokens[index < token_count ? index : token_count - 1];
+}
+
+static bool is_punct(struct token* token, const char* punct) {
+  return token->kind == TOKEN_PUNCT && strcmp(token->text, punct) == 0;
+}
+
+static bool accept(const char* punct) {
+  if (!is_punct(peek(0), punct)) return false;
+  position++;
+  return true;
+}
+
+static void expect(const char* punct) {
+  if (!accept(punct))
+    fail(peek(0)->line, "expected '%s', found '%s'", punct, peek(0)->text);
+}
+
+static struct type* new_type(enum type_kind kind, int line) {
+  struct type* type = allocate(sizeof(struct type));
+  type->kind = kind;
+  type->line = line;
+  return type;
+}
+
+static struct type* parse_type(void);
+
+/** Parse the entries of a map or an array up to \p closing */
+static struct type* parse_group(enum type_kind kind, const char* closing,
+                                int line) {
+  struct type* type = new_type(kind, line);
+  size_t capacity = 0;
+  bool vector = false;
+  while (!accept(closing)) {
+    struct token* start = peek(0);
+    if (start->kind == TOKEN_END) fail(line, "unterminated group");
+    type->fields =
+        grow(type->fields, &capacity, type->field_count, sizeof(struct field));
+    struct field* field = &type->fields[type->field_count++];
+    *field = (struct field){.line = start->line};
+
+    // Occurrence indicator
+    uint64_t min = 0, max = UINT64_MAX;
+    bool occurrence = false;
+    if (accept("?")) {
+      field->optional = true;
+    } else if (accept("+")) {
+      occurrence = true;
+      min = 1;
+    } else if (is_punct(start, "*") ||
+               (start->kind == TOKEN_INT && is_punct(peek(1), "*"))) {
+      occurrence = true;
+      if (start->kind == TOKEN_INT) {
+        min = start->magnitude;
+        position++;
+      }
+      expect("*");
+      if (peek(0)->kind == TOKEN_INT &&
+          !is_punct(peek(1), ":") && !is_punct(peek(1), "=>")) {
+        max = peek(0)->magnitude;
+        position++;
+      }
+    }
+
+    // Member key
+    struct token* key = peek(0);
+    if ((key->kind == TOKEN_ID || key->kind == TOKEN_TEXT ||
+         key->kind == TOKEN_INT) &&
+        is_punct(peek(1), ":")) {
+      position += 2;
+      field->key = new_type(key->kind == TOKEN_INT ? TYPE_LITERAL_INT
+                                                   : TYPE_LITERAL_TEXT,
+                            key->line);
+      field->key->text = key->text;
+      field->key->negative = key->negative;
+      field->key->magnitude = key->magnitude;
+      field->type = parse_type();
+    } else {
+      field->type = parse_type();
+      if (accept("=>")) {
+        field->key = field->type;
+        field->type = parse_type();
+      }
+    }
+
+    if (occurrence) {
+      if (kind != TYPE_RECORD || type->field_count > 1 || field->key != NULL)
+        fail(field->line,
+             "repeated entries are only supported as the only entry of an "
+             "array, e.g. [0*8 uint]");
+      if (max == UINT64_MAX)
+        fail(field->line,
+             "the number of items needs an upper bound, e.g. [0*8 uint]");
+      if (min > max) fail(field->line, "invalid number of items");
+      type->min = min;
+      type->max = max;
+      vector = true;
+    } else if (vector) {
+      fail(field->line,
+           "repeated entries are only supported as the only entry of an "
+           "array, e.g. [0*8 uint]");
+    }
+    if (!accept(",") && !is_punct(peek(0), closing) &&
+        peek(0)->kind == TOKEN_END)
+      fail(peek(0)->line, "expected '%s'", closing);
+  }
+  if (vector) {
+    type->kind = TYPE_VECTOR;
+    type->element = type->fields[0].type;
+    type->fields = NULL;
+    type->field_count = 0;
+  }
+  return type;
+}
+
+static struct type* parse_type(void) {
+  struct token* token = peek(0);
+  struct type* type;
+  position++;
+  if (is_punct(token, "{")) {
+    type = parse_group(TYPE_MAP, "}", token->line);
+  } else if (is_punct(token, "[")) {
+    type = parse_group(TYPE_RECORD, "]", token->line);
+  } else if (token->kind == TOKEN_INT) {
+    type = new_type(TYPE_LITERAL_INT, token->line);
+    type->negative = token->negative;
+    type->magnitude = token->magnitude;
+    type->text = token->text;
+  } else if (token->kind == TOKEN_TEXT) {
+    type = new_type(TYPE_LITERAL_TEXT, token->line);
+    type->text = token->text;
+  } else if (token->kind == TOKEN_ID) {
+    type = new_type(TYPE_RULE, token->line);
+    type->reference = token->text;
+    for (size_t i = 0; i < sizeof(primitives) / sizeof(primitives[0]); i++)
+      if (strcmp(token->text, primitives[i].name) == 0)
+        type->kind = primitives[i].kind;
+  } else {
+    fail(token->line, "expected a type, found '%s'", token->text);
+    return NULL;
+  }
+  if (is_punct(peek(0), "/"))
+    fail(peek(0)->line, "type choices are not supported");
+  return type;
+}
+
+static void parse(void) {
+  while (peek(0)->kind != TOKEN_END) {
+    struct token* name = peek(0);
+    if (name->kind != TOKEN_ID)
+      fail(name->line, "expected a rule name, found '%s'", name->text);
+    position++;
+    if (is_punct(peek(0), "/") || is_punct(peek(0), "//"))
+      fail(peek(0)->line, "choice assignments are not supported");
+    expect("=");
+    if (is_punct(peek(0), "("))
+      fail(peek(0)->line, "group rules are not supported");
+    add_rule(name->text, parse_type(), name->line);
+  }
+}
+
+/*
+ * ============================================================================
+ * Checks
+ * ============================================================================
+ */
+
+static bool is_container(const struct type* type) {
+  return type->kind == TYPE_MAP || type->kind == TYPE_RECORD ||
+         type->kind == TYPE_VECTOR;
+}
+
+/** Follow references to rules that are not containers, e.g. `id = uint` */
+static struct type* resolve(struct type* type) {
+  for (size_t steps = 0; type->kind == TYPE_RULE; steps++) {
+    if (steps > rule_count) fail(type->line, "circular rule definitions");
+    if (type->rule == NULL) {
+      type->rule = find_rule(type->reference);
+      if (type->rule == NULL)
+        fail(type->line, "undefined rule '%s'", type->reference);
+    }
+    if (is_container(type->rule->type)) return type;
+    type = type->rule->type;
+  }
+  return type;
+}
+
+static void check_type(struct type* type, const char* owner,
+                       const char* field_name);
+
+/** Give a container nested in another rule a rule of its own */
+static struct type* lift(struct type* type, const char* owner,
+                         const char* field_name) {
+  if (!is_container(type)) return type;
+  size_t length = strlen(owner) + strlen(field_name) + 2;
+  char* name = allocate(length);
+  snprintf(name, length, "%s_%s", owner, field_name);
+  struct rule* rule = add_rule(name, type, type->line);
+  rule->c_name = c_identifier(name);
+  check_type(type, rule->c_name, "");
+  struct type* reference = new_type(TYPE_RULE, type->line);
+  reference->reference = name;
+  reference->rule = rule;
+  return reference;
+}
+
+/** Check a type of an entry or an item and lift nested containers */
+static struct type* check_value_type(struct type* type, const char* owner,
+                                     const char* field_name) {
+  type = lift(type, owner, field_name);
+  type = resolve(type);
+  if (type->kind == TYPE_LITERAL_INT || type->kind == TYPE_LITERAL_TEXT)
+    fail(type->line, "literal values are only supported as map keys");
+  return type;
+}
+
+static struct type* check_key(struct type* key, int line) {
+  if (key == NULL) fail(line, "map entries need a key");
+  key = resolve(key);
+  if (key->kind != TYPE_LITERAL_INT && key->kind != TYPE_LITERAL_TEXT)
+    fail(line, "map keys must be integer or text string literals");
+  if (key->kind == TYPE_LITERAL_INT && key->negative && key->magnitude == 0)
+    key->negative = false;
+  if (key->kind == TYPE_LITERAL_INT && key->negative &&
+      key->magnitude > (uint64_t)INT64_MAX)
+    fail(line, "negative keys must fit into int64_t");
+  return key;
+}
+
+static bool same_key(const struct type* a, const struct type* b) {
+  if (a->kind != b->kind) return false;
+  if (a->kind == TYPE_LITERAL_TEXT) return strcmp(a->text, b->text) == 0;
+  return a->negative == b->negative && a->magnitude == b->magnitude;
+}
+
+static char* key_field_name(const struct type* key) {
+  if (key->kind == TYPE_LITERAL_TEXT) return c_identifier(key->text);
+  size_t length = strlen(key->text) + 6;
+  char* name = allocate(length);
+  snprintf(name, length, "key_%s%s", key->negative ? "m" : "", key->text);
+  return name;
+}
+
+static void check_type(struct type* type, const char* owner,
+                       const char* field_name) {
+  (void)field_name;
+  switch (type->kind) {
+    case TYPE_MAP:
+      if (type->field_count > 64)
+        fail(type->line, "maps with more than 64 entries are not supported");
+      for (size_t i = 0; i < type->field_count; i++) {
+        struct field* field = &type->fields[i];
+        struct type* declared_key = field->key;
+        field->key = check_key(field->key, field->line);
+        // `name: type` and `"name": type` name the field after the key,
+        // `rule => type` after the rule
+        field->name = declared_key != NULL && declared_key->kind == TYPE_RULE
+                          ? c_identifier(declared_key->reference)
+                          : key_field_name(field->key);
+        for (size_t j = 0; j < i; j++) {
+          if (same_key(type->fields[j].key, field->key))
+            fail(field->line, "duplicate key");
+          if (strcmp(type->fields[j].name, field->name) == 0)
+            fail(field->line, "duplicate entry name '%s'", field->name);
+        }
+        field->type = check_value_type(field->type, owner, field->name);
+      }
+      break;
+    case TYPE_RECORD:
+      for (size_t i = 0; i < type->field_count; i++) {
+        struct field* field = &type->fields[i];
+        if (field->optional)
+          fail(field->line, "optional array entries are not supported");
+        if (field->key != NULL && field->key->kind == TYPE_LITERAL_TEXT &&
+            field->key->text != NULL) {
+          field->name = c_identifier(field->key->text);
+        } else {
+          char name[32];
+          snprintf(name, sizeof(name), "item_%zu", i);
+          field->name = c_identifier(name);
+        }
+        for (size_t j = 0; j < i; j++)
+          if (strcmp(type->fields[j].name, field->name) == 0)
+            fail(field->line, "duplicate entry name '%s'", field->name);
+        field->type = check_value_type(field->type, owner, field->name);
+      }
+      break;
+    case TYPE_VECTOR:
+      type->element = check_value_type(type->element, owner, "item");
+      break;
+    default:
+      break;
+  }
+}
+
+static void check(void) {
+  // Lifting adds rules, which are checked right away
+  size_t count = rule_count;
+  for (size_t i = 0; i < count; i++) {
+    struct rule* rule = rules[i];
+    rule->c_name = c_identifier(rule->name);
+    for (size_t j = 0; j < i; j++)
+      if (strcmp(rules[j]->c_name, rule->c_name) == 0)
+        fail(rule->line, "rules '%s' and '%s' have the same C name",
+             rules[j]->name, rule->name);
+    resolve(rule->type);
+  }
+  for (size_t i = 0; i < count; i++)
+    if (is_container(rules[i]->type))
+      check_type(rules[i]->type, rules[i]->c_name, "");
+  for (size_t i = 0; i < rule_count; i++)
+    for (size_t j = 0; j < i; j++)
+      if (strcmp(rules[j]->c_name, rules[i]->c_name) == 0)
+        fail(rules[i]->line, "rules '%s' and '%s' have the same C name",
+             rules[j]->name, rules[i]->name);
+}
+
+/*
+ * ============================================================================
+ * Output
+ * ============================================================================
+ */
+
+static FILE* header;
+static FILE* source;
+
+static const char* c_type(const struct type* type) {
+  switch (type->kind) {
+    case TYPE_UINT:
+      return "uint64_t";
+    case TYPE_NINT:
+    case TYPE_INT:
+      return "int64_t";
+    case TYPE_BOOL:
+      return "bool";
+    case TYPE_FLOAT16:
+    case TYPE_FLOAT32:
+      return "float";
+    case TYPE_FLOAT64:
+      return "double";
+    case TYPE_TSTR:
+    case TYPE_BSTR:
+      return "struct cbor_cddl_string";
+    default:
+      return NULL;
+  }
+}
+
+static void emit_declaration(const struct type* type, const char* name,
+                             int indent) {
+  if (type->kind == TYPE_RULE) {
+    fprintf(header, "%*sstruct %s %s;\n", indent, "", type->rule->c_name,
+            name);
+  } else if (type->kind == TYPE_VECTOR) {
+    fprintf(header, "%*sstruct {\n", indent, "");
+    fprintf(header, "%*ssize_t count;\n", indent + 2, "");
+    char items[48];
+    snprintf(items, sizeof(items), "items[%" PRIu64 "]", type->max);
+    emit_declaration(type->element, items, indent + 2);
+    fprintf(header, "%*s} %s;\n", indent, "", name);
+  } else {
+    fprintf(header, "%*s%s %s;\n", indent, "", c_type(type), name);
+  }
+}
+
+static void emit_struct(struct rule* rule);
+
+/** Emit the structs the type depends on */
+static void emit_dependencies(const struct type* type) {
+  if (type->kind == TYPE_RULE) {
+    emit_struct(type->rule);
+  } else if (type->kind == TYPE_VECTOR) {
+    emit_dependencies(type->element);
+  } else {
+    for (size_t i = 0; i < type->field_count; i++)
+      emit_dependencies(type->fields[i].type);
+  }
+}
+
+static void emit_struct(struct rule* rule) {
+  if (rule->state == 2) return;
+  if (rule->state == 1)
+    fail(rule->line, "recursive type '%s' is not supported", rule->name);
+  rule->state = 1;
+  struct type* type = rule->type;
+  emit_dependencies(type);
+  fprintf(header, "struct %s {\n", rule->c_name);
+  if (type->kind == TYPE_VECTOR) {
+    fprintf(header, "  size_t count;\n");
+    char items[48];
+    snprintf(items, sizeof(items), "items[%" PRIu64 "]", type->max);
+    emit_declaration(type->element, items, 2);
+  }
+  for (size_t i = 0; i < type->field_count; i++) {
+    struct field* field = &type->fields[i];
+    if (field->optional) fprintf(header, "  bool has_%s;\n", field->name);
+    emit_declaration(field->type, field->name, 2);
+  }
+  fprintf(header, "};\n\n");
+  fprintf(header,
+          "/** Encode into \\p buffer\n"
+          " *\n"
+          " * @return Number of bytes written, 0 if \\p buffer is too small\n"
+          " */\n"
+          "_CBOR_NODISCARD size_t %s_encode(\n"
+          "    const struct %s* value, unsigned char* buffer, size_t "
+          "buffer_size);\n\n",
+          rule->c_name, rule->c_name);
+  fprintf(header,
+          "/** Decode from \\p source without allocating memory. Strings in\n"
+          " * \\p value point into \\p source.\n"
+          " *\n"
+          " * @return Number of bytes read, 0 if \\p source does not start\n"
+          " *  with a valid item\n"
+          " */\n"
+          "_CBOR_NODISCARD size_t %s_decode(\n"
+          "    cbor_data source, size_t source_size, struct %s* value);\n\n",
+          rule->c_name, rule->c_name);
+  rule->state = 2;
+}
+
+/* Helpers used by the generated code, split to keep the literals short */
+static const char* const runtime[] = {
+    "static inline bool _cddl_advance(unsigned char** cursor, size_t "
+    "written) {\n"
+    "  *cursor += written;\n"
+    "  return written > 0;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_uint(unsigned char** cursor,\n"
+    "                                     unsigned char* end, uint64_t "
+    "value) {\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_uint(value, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_int(unsigned char** cursor,\n"
+    "                                    unsigned char* end, int64_t value) "
+    "{\n"
+    "  size_t space = (size_t)(end - *cursor);\n"
+    "  return _cddl_advance(\n"
+    "      cursor, value >= 0\n"
+    "                  ? cbor_encode_uint((uint64_t)value, *cursor, space)\n"
+    "                  : cbor_encode_negint((uint64_t)(-1 - value), "
+    "*cursor,\n"
+    "                                       space));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_bool(unsigned char** cursor,\n"
+    "                                     unsigned char* end, bool value) {\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_bool(value, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_half(unsigned char** cursor,\n"
+    "                                     unsigned char* end, float value) "
+    "{\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_half(value, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_single(unsigned char** cursor,\n"
+    "                                       unsigned char* end, float value) "
+    "{\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_single(value, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_double(unsigned char** cursor,\n"
+    "                                       unsigned char* end, double "
+    "value) {\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_double(value, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_string(unsigned char** cursor,\n"
+    "                                       unsigned char* end, bool text,\n"
+    "                                       cbor_data data, size_t length) "
+    "{\n"
+    "  size_t space = (size_t)(end - *cursor);\n"
+    "  if (!_cddl_advance(cursor,\n"
+    "                     text ? cbor_encode_string_start(length, *cursor, "
+    "space)\n"
+    "                          : cbor_encode_bytestring_start(length, "
+    "*cursor,\n"
+    "                                                         space)))\n"
+    "    return false;\n"
+    "  if ((size_t)(end - *cursor) < length) return false;\n"
+    "  if (length > 0) memcpy(*cursor, data, length);\n"
+    "  *cursor += length;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_array_start(unsigned char** cursor,\n"
+    "                                            unsigned char* end, size_t "
+    "size) {\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_array_start(size, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_encode_map_start(unsigned char** cursor,\n"
+    "                                          unsigned char* end, size_t "
+    "size) {\n"
+    "  return _cddl_advance(\n"
+    "      cursor, cbor_encode_map_start(size, *cursor, (size_t)(end - "
+    "*cursor)));\n"
+    "}\n"
+    "\n",
+    "/* Read the head of an item. The argument of indefinite items is 0. */\n"
+    "static inline bool _cddl_decode_head(cbor_data* cursor, cbor_data end,\n"
+    "                                     uint8_t* major, uint64_t* "
+    "argument,\n"
+    "                                     bool* indefinite) {\n"
+    "  if (*cursor == end) return false;\n"
+    "  uint8_t initial = **cursor;\n"
+    "  uint8_t info = initial & 0x1F;\n"
+    "  size_t size = info < 24 || info == 31 ? 0 : (size_t)1 << (info - 24);\n"
+    "  if (info >= 28 && info <= 30) return false;\n"
+    "  if ((size_t)(end - *cursor) - 1 < size) return false;\n"
+    "  *major = initial >> 5;\n"
+    "  *indefinite = info == 31;\n"
+    "  switch (size) {\n"
+    "    case 0:\n"
+    "      *argument = info == 31 ? 0 : info;\n"
+    "      break;\n"
+    "    case 1:\n"
+    "      *argument = (*cursor)[1];\n"
+    "      break;\n"
+    "    case 2:\n"
+    "      *argument = cbor_load_uint16(*cursor + 1);\n"
+    "      break;\n"
+    "    case 4:\n"
+    "      *argument = cbor_load_uint32(*cursor + 1);\n"
+    "      break;\n"
+    "    default:\n"
+    "      *argument = cbor_load_uint64(*cursor + 1);\n"
+    "  }\n"
+    "  *cursor += 1 + size;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_uint(cbor_data* cursor, cbor_data end,\n"
+    "                                     uint64_t* value) {\n"
+    "  uint8_t major;\n"
+    "  bool indefinite;\n"
+    "  return _cddl_decode_head(cursor, end, &major, value, &indefinite) &&\n"
+    "         major == 0 && !indefinite;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_int(cbor_data* cursor, cbor_data end,\n"
+    "                                    int64_t* value) {\n"
+    "  uint8_t major;\n"
+    "  uint64_t argument;\n"
+    "  bool indefinite;\n"
+    "  if (!_cddl_decode_head(cursor, end, &major, &argument, &indefinite) "
+    "||\n"
+    "      major > 1 || indefinite || argument > INT64_MAX)\n"
+    "    return false;\n"
+    "  *value = major == 0 ? (int64_t)argument : -1 - (int64_t)argument;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_nint(cbor_data* cursor, cbor_data end,\n"
+    "                                     int64_t* value) {\n"
+    "  return _cddl_decode_int(cursor, end, value) && *value < 0;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_bool(cbor_data* cursor, cbor_data end,\n"
+    "                                     bool* value) {\n"
+    "  if (*cursor == end || (**cursor != 0xF4 && **cursor != 0xF5))\n"
+    "    return false;\n"
+    "  *value = **cursor == 0xF5;\n"
+    "  (*cursor)++;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "/* Decode a float at most \\p max_size bytes wide */\n"
+    "static inline bool _cddl_decode_float(cbor_data* cursor, cbor_data end,\n"
+    "                                      size_t max_size, double* value) {\n"
+    "  if (*cursor == end) return false;\n"
+    "  size_t size;\n"
+    "  switch (**cursor) {\n"
+    "    case 0xF9:\n"
+    "      size = 2;\n"
+    "      break;\n"
+    "    case 0xFA:\n"
+    "      size = 4;\n"
+    "      break;\n"
+    "    case 0xFB:\n"
+    "      size = 8;\n"
+    "      break;\n"
+    "    default:\n"
+    "      return false;\n"
+    "  }\n"
+    "  if (size > max_size || (size_t)(end - *cursor) - 1 < size) return "
+    "false;\n"
+    "  if (size == 2)\n"
+    "    *value = cbor_load_half(*cursor + 1);\n"
+    "  else if (size == 4)\n"
+    "    *value = cbor_load_float(*cursor + 1);\n"
+    "  else\n"
+    "    *value = cbor_load_double(*cursor + 1);\n"
+    "  *cursor += 1 + size;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_single(cbor_data* cursor, cbor_data "
+    "end,\n"
+    "                                       size_t max_size, float* value) {\n"
+    "  double number;\n"
+    "  if (!_cddl_decode_float(cursor, end, max_size, &number)) return "
+    "false;\n"
+    "  *value = (float)number;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_string(cbor_data* cursor, cbor_data "
+    "end,\n"
+    "                                       uint8_t expected_major,\n"
+    "                                       struct cbor_cddl_string* value) "
+    "{\n"
+    "  uint8_t major;\n"
+    "  uint64_t length;\n"
+    "  bool indefinite;\n"
+    "  if (!_cddl_decode_head(cursor, end, &major, &length, &indefinite) ||\n"
+    "      major != expected_major || indefinite ||\n"
+    "      length > (uint64_t)(end - *cursor))\n"
+    "    return false;\n"
+    "  value->data = *cursor;\n"
+    "  value->length = (size_t)length;\n"
+    "  *cursor += length;\n"
+    "  return true;\n"
+    "}\n"
+    "\n",
+    "static inline bool _cddl_decode_container(cbor_data* cursor, cbor_data "
+    "end,\n"
+    "                                          uint8_t expected_major,\n"
+    "                                          uint64_t* size, bool* "
+    "indefinite) {\n"
+    "  uint8_t major;\n"
+    "  return _cddl_decode_head(cursor, end, &major, size, indefinite) &&\n"
+    "         major == expected_major;\n"
+    "}\n"
+    "\n",
+    "/* Consume the break ending an indefinite item, if there is one */\n"
+    "static inline bool _cddl_decode_break(cbor_data* cursor, cbor_data end) "
+    "{\n"
+    "  if (*cursor == end || **cursor != 0xFF) return false;\n"
+    "  (*cursor)++;\n"
+    "  return true;\n"
+    "}\n",
+};
+
+/** Emit a call of a helper, returning false on failure */
+static void emit_call(int indent, const char* helper, const char* arguments) {
+  fprintf(source, "%*sif (!%s(cursor, end, %s)) return false;\n", indent, "",
+          helper, arguments);
+}
+
+/** Emit statements encoding \p expression, returning false on failure */
+static void emit_encode(const struct type* type, const char* expression,
+                        int indent, int depth) {
+  FILE* out = source;
+  switch (type->kind) {
+    case TYPE_UINT:
+      emit_call(indent, "_cddl_encode_uint", expression);
+      break;
+    case TYPE_NINT:
+    case TYPE_INT:
+      emit_call(indent, "_cddl_encode_int", expression);
+      break;
+    case TYPE_BOOL:
+      emit_call(indent, "_cddl_encode_bool", expression);
+      break;
+    case TYPE_FLOAT16:
+      emit_call(indent, "_cddl_encode_half", expression);
+      break;
+    case TYPE_FLOAT32:
+      emit_call(indent, "_cddl_encode_single", expression);
+      break;
+    case TYPE_FLOAT64:
+      emit_call(indent, "_cddl_encode_double", expression);
+      break;
+    case TYPE_TSTR:
+    case TYPE_BSTR:
+      fprintf(out,
+              "%*sif (!_cddl_encode_string(cursor, end, %s, %s.data,\n"
+              "%*s                         %s.length))\n"
+              "%*s  return false;\n",
+              indent, "", type->kind == TYPE_TSTR ? "true" : "false",
+              expression, indent, "", expression, indent, "");
+      break;
+    case TYPE_RULE:
+      fprintf(out, "%*sif (!_%s_encode(&%s, cursor, end)) return false;\n",
+              indent, "", type->rule->c_name, expression);
+      break;
+    case TYPE_VECTOR: {
+      fprintf(out, "%*sif (%s.count > %" PRIu64 " ||\n", indent, "",
+              expression, type->max);
+      if (type->min > 0)
+        fprintf(out, "%*s    %s.count < %" PRIu64 " ||\n", indent, "",
+                expression, type->min);
+      fprintf(out,
+              "%*s    !_cddl_encode_array_start(cursor, end, %s.count))\n"
+              "%*s  return false;\n",
+              indent, "", expression, indent, "");
+      fprintf(out, "%*sfor (size_t i%d = 0; i%d < %s.count; i%d++) {\n",
+              indent, "", depth, depth, expression, depth);
+      size_t length = strlen(expression) + 32;
+      char* item = allocate(length);
+      snprintf(item, length, "%s.items[i%d]", expression, depth);
+      emit_encode(type->element, item, indent + 2, depth + 1);
+      fprintf(out, "%*s}\n", indent, "");
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+static void emit_encode_key(const struct type* key, int indent) {
+  if (key->kind == TYPE_LITERAL_TEXT) {
+    fprintf(source,
+            "%*sif (!_cddl_encode_string(cursor, end, true,\n"
+            "%*s                         (cbor_data) \"%s\", %zu))\n"
+            "%*s  return false;\n",
+            indent, "", indent, "", key->text, strlen(key->text), indent, "");
+  } else {
+    char value[32];
+    snprintf(value, sizeof(value), "%s%s", key->negative ? "-" : "",
+             key->text);
+    emit_call(indent, key->negative ? "_cddl_encode_int" : "_cddl_encode_uint",
+              value);
+  }
+}
+
+/** Emit statements decoding into \p expression, returning false on failure */
+static void emit_decode(const struct type* type, const char* expression,
+                        int indent, int depth) {
+  FILE* out = source;
+  size_t length = strlen(expression) + 8;
+  char* address = allocate(length);
+  snprintf(address, length, "&%s", expression);
+  switch (type->kind) {
+    case TYPE_UINT:
+      emit_call(indent, "_cddl_decode_uint", address);
+      break;
+    case TYPE_NINT:
+      emit_call(indent, "_cddl_decode_nint", address);
+      break;
+    case TYPE_INT:
+      emit_call(indent, "_cddl_decode_int", address);
+      break;
+    case TYPE_BOOL:
+      emit_call(indent, "_cddl_decode_bool", address);
+      break;
+    case TYPE_FLOAT16:
+    case TYPE_FLOAT32:
+      // The maximum width in bytes, smaller floats are accepted too
+      snprintf(address, length, "%d, &%s",
+               type->kind == TYPE_FLOAT16 ? 2 : 4, expression);
+      emit_call(indent, "_cddl_decode_single", address);
+      break;
+    case TYPE_FLOAT64:
+      snprintf(address, length, "8, &%s", expression);
+      emit_call(indent, "_cddl_decode_float", address);
+      break;
+    case TYPE_TSTR:
+    case TYPE_BSTR:
+      // The expected major type
+      snprintf(address, length, "%d, &%s", type->kind == TYPE_TSTR ? 3 : 2,
+               expression);
+      emit_call(indent, "_cddl_decode_string", address);
+      break;
+    case TYPE_RULE:
+      fprintf(out, "%*sif (!_%s_decode(cursor, end, &%s)) return false;\n",
+              indent, "", type->rule->c_name, expression);
+      break;
+    case TYPE_VECTOR: {
+      fprintf(out, "%*s{\n", indent, "");
+      fprintf(out, "%*s  uint64_t size;\n", indent, "");
+      fprintf(out, "%*s  bool indefinite;\n", indent, "");
+      fprintf(out,
+              "%*s  if (!_cddl_decode_container(cursor, end, 4, &size, "
+              "&indefinite))\n"
+              "%*s    return false;\n",
+              indent, "", indent, "");
+      fprintf(out, "%*s  %s.count = 0;\n", indent, "", expression);
+      fprintf(out,
+              "%*s  while (indefinite ? !_cddl_decode_break(cursor, end)\n"
+              "%*s                    : %s.count < size) {\n",
+              indent, "", indent, "", expression);
+      fprintf(out, "%*s    if (%s.count == %" PRIu64 ") return false;\n",
+              indent, "", expression, type->max);
+      length = 2 * strlen(expression) + 32;
+      char* item = allocate(length);
+      snprintf(item, length, "%s.items[%s.count]", expression, expression);
+      emit_decode(type->element, item, indent + 4, depth + 1);
+      fprintf(out, "%*s    %s.count++;\n", indent, "", expression);
+      fprintf(out, "%*s  }\n", indent, "");
+      if (type->min > 0)
+        fprintf(out, "%*s  if (%s.count < %" PRIu64 ") return false;\n",
+                indent, "", expression, type->min);
+      fprintf(out, "%*s}\n", indent, "");
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+static char* member(const char* name) {
+  size_t length = strlen(name) + 8;
+  char* expression = allocate(length);
+  snprintf(expression, length, "value->%s", name);
+  return expression;
+}
+
+/** Emit the function mapping map keys to entry indices */
+static void emit_key_lookup(const struct rule* rule) {
+  const struct type* type = rule->type;
+  bool text = false, uint = false, nint = false;
+  for (size_t i = 0; i < type->field_count; i++) {
+    const struct type* key = type->fields[i].key;
+    if (key->kind == TYPE_LITERAL_TEXT)
+      text = true;
+    else if (key->negative)
+      nint = true;
+    else
+      uint = true;
+  }
+  fprintf(source,
+          "/* Decode a key of %s and get the index of its entry, -1 if it "
+          "is unknown */\n",
+          rule->c_name);
+  fprintf(source, "static int _%s_key(cbor_data* cursor, cbor_data end) {\n",
+          rule->c_name);
+  fprintf(source,
+          "  uint8_t major;\n"
+          "  uint64_t argument;\n"
+          "  bool indefinite;\n"
+          "  if (!_cddl_decode_head(cursor, end, &major, &argument, "
+          "&indefinite) ||\n"
+          "      indefinite)\n"
+          "    return -1;\n");
+  if (text) {
+    // Keys are told apart by their length first, then compared
+    fprintf(source,
+            "  if (major == 3) {\n"
+            "    if (argument > (uint64_t)(end - *cursor)) return -1;\n"
+            "    cbor_data key = *cursor;\n"
+            "    *cursor += argument;\n"
+            "    switch (argument) {\n");
+    bool* done = allocate(type->field_count);
+    for (size_t i = 0; i < type->field_count; i++) {
+      const struct type* key = type->fields[i].key;
+      if (key->kind != TYPE_LITERAL_TEXT || done[i]) continue;
+      size_t length = strlen(key->text);
+      fprintf(source, "      case %zu:\n", length);
+      for (size_t j = i; j < type->field_count; j++) {
+        const struct type* other = type->fields[j].key;
+        if (other->kind != TYPE_LITERAL_TEXT || strlen(other->text) != length)
+          continue;
+        done[j] = true;
+        if (length == 0)
+          fprintf(source, "        return %zu;\n", j);
+        else
+          fprintf(source,
+                  "        if (memcmp(key, \"%s\", %zu) == 0) return %zu;\n",
+                  other->text, length, j);
+      }
+      if (length > 0) fprintf(source, "        return -1;\n");
+    }
+    fprintf(source, "    }\n    return -1;\n  }\n");
+  }
+  for (int negative = 0; negative < 2; negative++) {
+    if (!(negative ? nint : uint)) continue;
+    fprintf(source, "  if (major == %d) {\n    switch (argument) {\n",
+            negative);
+    for (size_t i = 0; i < type->field_count; i++) {
+      const struct type* key = type->fields[i].key;
+      if (key->kind != TYPE_LITERAL_INT || key->negative != (bool)negative)
+        continue;
+      uint64_t argument = negative ? key->magnitude - 1 : key->magnitude;
+      fprintf(source, "      case %" PRIu64 "U:\n        return %zu;\n",
+              argument, i);
+    }
+    fprintf(source, "    }\n  }\n");
+  }
+  fprintf(source, "  return -1;\n}\n\n");
+}
+
+static void emit_functions(const struct rule* rule) {
+  const struct type* type = rule->type;
+  const char* name = rule->c_name;
+
+  // Encoder
+  fprintf(source,
+          "static bool _%s_encode(\n"
+          "    const struct %s* value, unsigned char** cursor, unsigned "
+          "char* end) {\n",
+          name, name);
+  if (type->kind == TYPE_MAP) {
+    size_t required = 0;
+    for (size_t i = 0; i < type->field_count; i++)
+      if (!type->fields[i].optional) required++;
+    fprintf(source, "  size_t size = %zu;\n", required);
+    for (size_t i = 0; i < type->field_count; i++)
+      if (type->fields[i].optional)
+        fprintf(source, "  if (value->has_%s) size++;\n",
+                type->fields[i].name);
+    fprintf(source,
+            "  if (!_cddl_encode_map_start(cursor, end, size)) return "
+            "false;\n");
+    for (size_t i = 0; i < type->field_count; i++) {
+      const struct field* field = &type->fields[i];
+      if (field->optional)
+        fprintf(source, "  if (value->has_%s) {\n", field->name);
+      emit_encode_key(field->key, field->optional ? 4 : 2);
+      emit_encode(field->type, member(field->name), field->optional ? 4 : 2,
+                  0);
+      if (field->optional) fprintf(source, "  }\n");
+    }
+  } else if (type->kind == TYPE_RECORD) {
+    fprintf(source,
+            "  if (!_cddl_encode_array_start(cursor, end, %zu)) return "
+            "false;\n",
+            type->field_count);
+    for (size_t i = 0; i < type->field_count; i++)
+      emit_encode(type->fields[i].type, member(type->fields[i].name), 2, 0);
+  } else {
+    emit_encode(type, "(*value)", 2, 0);
+  }
+  fprintf(source, "  return true;\n}\n\n");
+
+  // Decoder
+  if (type->kind == TYPE_MAP) emit_key_lookup(rule);
+  fprintf(source,
+          "static bool _%s_decode(\n"
+          "    cbor_data* cursor, cbor_data end, struct %s* value) {\n",
+          name, name);
+  if (type->kind == TYPE_MAP) {
+    uint64_t required = 0;
+    for (size_t i = 0; i < type->field_count; i++) {
+      if (type->fields[i].optional)
+        fprintf(source, "  value->has_%s = false;\n", type->fields[i].name);
+      else
+        required |= (uint64_t)1 << i;
+    }
+    fprintf(source,
+            "  uint64_t size;\n"
+            "  bool indefinite;\n"
+            "  if (!_cddl_decode_container(cursor, end, 5, &size, "
+            "&indefinite))\n"
+            "    return false;\n"
+            "  uint64_t seen = 0;\n"
+            "  for (uint64_t i = 0;\n"
+            "       indefinite ? !_cddl_decode_break(cursor, end) : i < size;\n"
+            "       i++) {\n"
+            "    int entry = _%s_key(cursor, end);\n"
+            "    if (entry < 0 || (seen >> entry) & 1) return false;\n"
+            "    seen |= (uint64_t)1 << entry;\n"
+            "    switch (entry) {\n",
+            name);
+    for (size_t i = 0; i < type->field_count; i++) {
+      const struct field* field = &type->fields[i];
+      fprintf(source, "      case %zu:\n", i);
+      emit_decode(field->type, member(field->name), 8, 0);
+      if (field->optional)
+        fprintf(source, "        value->has_%s = true;\n", field->name);
+      fprintf(source, "        break;\n");
+    }
+    fprintf(source,
+            "    }\n"
+            "  }\n"
+            "  return (seen & 0x%" PRIx64 "U) == 0x%" PRIx64 "U;\n"
+            "}\n\n",
+            required, required);
+  } else if (type->kind == TYPE_RECORD) {
+    fprintf(source,
+            "  uint64_t size;\n"
+            "  bool indefinite;\n"
+            "  if (!_cddl_decode_container(cursor, end, 4, &size, "
+            "&indefinite) ||\n"
+            "      (!indefinite && size != %zu))\n"
+            "    return false;\n",
+            type->field_count);
+    for (size_t i = 0; i < type->field_count; i++)
+      emit_decode(type->fields[i].type, member(type->fields[i].name), 2, 0);
+    fprintf(source,
+            "  return !indefinite || _cddl_decode_break(cursor, end);\n"
+            "}\n\n");
+  } else {
+    emit_decode(type, "(*value)", 2, 0);
+    fprintf(source, "  return true;\n}\n\n");
+  }
+
+  // Public wrappers
+  fprintf(source,
+          "size_t %s_encode(const struct %s* value, unsigned char* buffer,\n"
+          "    size_t buffer_size) {\n"
+          "  unsigned char* cursor = buffer;\n"
+          "  if (!_%s_encode(value, &cursor, buffer + buffer_size)) return "
+          "0;\n"
+          "  return (size_t)(cursor - buffer);\n"
+          "}\n\n",
+          name, name, name);
+  fprintf(source,
+          "size_t %s_decode(cbor_data source, size_t source_size,\n"
+          "    struct %s* value) {\n"
+          "  cbor_data cursor = source;\n"
+          "  if (!_%s_decode(&cursor, source + source_size, value)) return "
+          "0;\n"
+          "  return (size_t)(cursor - source);\n"
+          "}\n\n",
+          name, name, name);
+}
+
+static const char* base_name(const char* path) {
+  const char* name = path;
+  for (const char* c = path; *c != '\0'; c++)
+    if (*c == '/' || *c == '\\') name = c + 1;
+  return name;
+}
+
+static void emit(const char* header_path) {
+  const char* header_name = base_name(header_path);
+  char* guard = c_identifier(header_name);
+  for (char* c = guard; *c != '\0'; c++)
+    *c = (char)toupper((unsigned char)*c);
+
+  fprintf(header,
+          "/* Generated by cbor_cddlgen from %s. Do not edit. */\n\n"
+          "#ifndef %s\n#define %s\n\n"
+          "#include \"cbor.h\"\n\n"
+          "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n"
+          "#ifndef CBOR_CDDL_STRING_DEFINED\n"
+          "#define CBOR_CDDL_STRING_DEFINED\n"
+          "/** A text or byte string, pointing into the decoded input */\n"
+          "struct cbor_cddl_string {\n"
+          "  cbor_data data;\n"
+          "  size_t length;\n"
+          "};\n"
+          "#endif\n\n",
+          base_name(schema_path), guard, guard);
+  for (size_t i = 0; i < rule_count; i++)
+    if (is_container(rules[i]->type)) emit_struct(rules[i]);
+  fprintf(header,
+          "#ifdef __cplusplus\n}\n#endif\n\n#endif  // %s\n", guard);
+
+  fprintf(source,
+          "/* Generated by cbor_cddlgen from %s. Do not edit. */\n\n"
+          "#include \"%s\"\n\n"
+          "#include <string.h>\n\n"
+          "#include \"cbor/big_endian.h\"\n\n",
+          base_name(schema_path), header_name);
+  for (size_t i = 0; i < sizeof(runtime) / sizeof(runtime[0]); i++)
+    fputs(runtime[i], source);
+  fputs("\n", source);
+  for (size_t i = 0; i < rule_count; i++) {
+    if (!is_container(rules[i]->type)) continue;
+    fprintf(source,
+            "static bool _%s_encode(\n"
+            "    const struct %s* value, unsigned char** cursor, unsigned "
+            "char* end);\n"
+            "static bool _%s_decode(\n"
+            "    cbor_data* cursor, cbor_data end, struct %s* value);\n",
+            rules[i]->c_name, rules[i]->c_name, rules[i]->c_name,
+            rules[i]->c_name);
+  }
+  fprintf(source, "\n");
+  for (size_t i = 0; i < rule_count; i++)
+    if (is_container(rules[i]->type)) emit_functions(rules[i]);
+}
+
+static char* read_file(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  size_t capacity = 4096, length = 0;
+  char* content = allocate(capacity);
+  size_t read;
+  while ((read = fread(content + length, 1, capacity - length - 1, file)) >
+         0) {
+    length += read;
+    if (length + 1 == capacity)
+      content = grow(content, &capacity, capacity, 1);
+  }
+  content[length] = '\0';
+  fclose(file);
+  return content;
+}
+
+static FILE* open_output(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  return file;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    fprintf(stderr, "Usage: %s schema.cddl output.h output.c\n", argv[0]);
+    return 1;
+  }
+  schema_path = argv[1];
+  atexit(release_allocations);
+  tokenize(read_file(schema_path));
+  parse();
+  check();
+  header = open_output(argv[2]);
+  source = open_output(argv[3]);
+  emit(argv[2]);
+  if (fclose(header) != 0 || fclose(source) != 0) {
+    perror("Writing the output failed");
+    return 1;
+  }
+  return 0;
+}